@@ -0,0 +1,169 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 异步资源加载
+//
+// load()把解码、解析这类纯CPU的工作放到工作线程池中执行，立即返回一个Handle，
+// 渲染线程可以随时用isReady()轮询或者用get()等待结果。工作函数中抛出的异常
+// (比如ThrowIfFailed)会在get()时重新抛出。
+//
+// 需要命令列表的GPU上传不能在工作线程中做，用whenReady()登记上传回调，
+// 渲染线程在命令列表Reset之后调用processUploads()，所有已经加载完成的资源的
+// 上传命令会一起记录到同一个命令列表中。
+class AssetLoader {
+public:
+    template<typename T>
+    class Handle {
+    public:
+        Handle() = default;
+
+        bool valid() const { return future.valid(); }
+
+        bool isReady() const {
+            return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+
+        void wait() const { future.wait(); }
+
+        // 未完成时阻塞等待
+        const T& get() const { return future.get(); }
+
+    private:
+        friend class AssetLoader;
+
+        Handle(std::shared_future<T> inFuture, size_t inTimingIndex) : future(std::move(inFuture)), timingIndex(inTimingIndex) {}
+
+        std::shared_future<T> future;
+        size_t timingIndex = 0;
+    };
+
+    // 单位都是毫秒
+    struct Timing {
+        std::string name;
+        // 从提交到开始执行的排队时间
+        double queued = 0.0;
+        // 工作函数本身的执行时间
+        double load = 0.0;
+        // 上传回调的执行时间，没有登记上传时为0
+        double upload = 0.0;
+        // 从提交到资源可用(有上传时为上传完成)的总时间
+        double total = 0.0;
+        bool finished = false;
+    };
+
+    // workerCount为0时使用硬件线程数 - 1(至少1个)，给渲染线程留一个核心
+    explicit AssetLoader(uint32_t workerCount = 0);
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader& rhs) = delete;
+    AssetLoader& operator=(const AssetLoader& rhs) = delete;
+
+    // function()在工作线程中执行，返回值就是资源
+    template<typename Function>
+    auto load(const std::string& name, Function&& function) -> Handle<decltype(function())> {
+        using T = decltype(function());
+
+        size_t timingIndex = addTiming(name);
+
+        auto task = std::make_shared<std::packaged_task<T()>>(
+            [this, timingIndex, function = std::forward<Function>(function)]() mutable {
+                // 异常时也要记录耗时
+                struct LoadScope {
+                    AssetLoader* loader;
+                    size_t timingIndex;
+                    Clock::time_point startTime;
+
+                    ~LoadScope() {
+                        loader->finishLoad(timingIndex, startTime, Clock::now());
+                    }
+                } scope = { this, timingIndex, Clock::now() };
+
+                return function();
+            });
+
+        Handle<T> handle(task->get_future().share(), timingIndex);
+
+        enqueue([task]() { (*task)(); });
+
+        return handle;
+    }
+
+    // upload(const T&)在handle完成之后的第一次processUploads()中于渲染线程执行
+    template<typename T, typename Upload>
+    void whenReady(const Handle<T>& handle, Upload&& upload) {
+        uploadTiming(handle.timingIndex);
+
+        pendingUploads.push_back([this, handle, upload = std::forward<Upload>(upload)]() mutable {
+            if (!handle.isReady()) {
+                return false;
+            }
+
+            auto startTime = Clock::now();
+
+            upload(handle.get());
+
+            finishUpload(handle.timingIndex, startTime, Clock::now());
+
+            return true;
+        });
+    }
+
+    // 在工作线程中执行不需要结果和耗时记录的任务，比如TextureStreamer的mip加载
+    void run(std::function<void()> task) { enqueue(std::move(task)); }
+
+    // 只能在渲染线程调用，返回本次执行的上传回调个数
+    size_t processUploads();
+
+    // 还有没完成的加载或者上传
+    bool isBusy() const;
+
+    std::vector<Timing> timings() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // whenReady()可能在加载完成之后才调用，所以加载结束的时间在任务中记下，
+    // total和finished在timings()中按是否登记了上传再计算
+    struct TimingRecord {
+        Timing timing;
+        Clock::time_point submitTime;
+        Clock::time_point loadEndTime;
+        Clock::time_point uploadEndTime;
+        bool loaded = false;
+        bool hasUpload = false;
+        bool uploaded = false;
+    };
+
+    void enqueue(std::function<void()> task);
+    void workerLoop();
+
+    size_t addTiming(const std::string& name);
+    void uploadTiming(size_t timingIndex);
+    void finishLoad(size_t timingIndex, Clock::time_point startTime, Clock::time_point endTime);
+    void finishUpload(size_t timingIndex, Clock::time_point startTime, Clock::time_point endTime);
+
+    std::vector<std::thread> workers;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<std::function<void()>> tasks;
+    size_t runningTasks = 0;
+    bool stopping = false;
+
+    mutable std::mutex timingMutex;
+    std::vector<TimingRecord> timingRecords;
+
+    // 仅在渲染线程访问
+    std::vector<std::function<bool()>> pendingUploads;
+};
@@ -0,0 +1,2190 @@
+#include "BlockCompress.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOCK_COMPRESS_SSE2 1
+#endif
+
+namespace BlockCompress {
+    namespace {
+        // 每个线程至少处理的块数
+        const size_t minBlocksPerWorker = 512;
+
+        // 一个块的16个像素，按通道分开保存，一次可以计算4个像素
+        struct BlockPixels {
+            alignas(16) float channels[4][16];
+        };
+
+        void loadBlockPixels(const uint8_t* block, BlockPixels& pixels) {
+            for (uint32_t i = 0; i < 16; i++) {
+                for (uint32_t channel = 0; channel < 4; channel++) {
+                    pixels.channels[channel][i] = static_cast<float>(block[i * 4 + channel]);
+                }
+            }
+        }
+
+        // 从图片中取出一个块，超出图片的部分复制最后一行/列
+        void loadBlock(const uint8_t* src, size_t srcRowPitch, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* block) {
+            for (uint32_t y = 0; y < 4; y++) {
+                const uint8_t* row = src + srcRowPitch * std::min(blockY * 4 + y, height - 1);
+
+                for (uint32_t x = 0; x < 4; x++) {
+                    memcpy(block + (y * 4 + x) * 4, row + static_cast<size_t>(std::min(blockX * 4 + x, width - 1)) * 4, 4);
+                }
+            }
+        }
+
+        void storeBlock(const uint8_t* block, uint8_t* dest, size_t destRowPitch, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY) {
+            for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++) {
+                uint8_t* row = dest + destRowPitch * (blockY * 4 + y);
+
+                for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++) {
+                    memcpy(row + static_cast<size_t>(blockX * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+
+        float clampUNORM(float value) {
+            return std::min(std::max(value, 0.0f), 255.0f);
+        }
+
+        // 主轴：协方差矩阵最大特征值对应的方向，用幂迭代求解。
+        // mask为0的像素不参与计算，返回参与计算的像素数
+        float principalAxis(const float* const* channels, uint32_t channelCount, const float* mask, uint32_t count, float* mean, float* axis) {
+            float weight = 0.0f;
+
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                mean[channel] = 0.0f;
+            }
+
+            for (uint32_t i = 0; i < count; i++) {
+                weight += mask[i];
+
+                for (uint32_t channel = 0; channel < channelCount; channel++) {
+                    mean[channel] += channels[channel][i] * mask[i];
+                }
+            }
+
+            if (weight <= 0.0f) {
+                return 0.0f;
+            }
+
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                mean[channel] /= weight;
+            }
+
+            float covariance[4][4] = {};
+
+            for (uint32_t i = 0; i < count; i++) {
+                float delta[4];
+
+                for (uint32_t channel = 0; channel < channelCount; channel++) {
+                    delta[channel] = (channels[channel][i] - mean[channel]) * mask[i];
+                }
+
+                for (uint32_t row = 0; row < channelCount; row++) {
+                    for (uint32_t column = row; column < channelCount; column++) {
+                        covariance[row][column] += delta[row] * delta[column];
+                    }
+                }
+            }
+
+            // 从方差最大的通道开始迭代，矩阵先除以迹，迭代过程中不会溢出，也不需要每次归一化
+            uint32_t largest = 0;
+            float trace = 0.0f;
+
+            for (uint32_t row = 0; row < channelCount; row++) {
+                for (uint32_t column = 0; column < row; column++) {
+                    covariance[row][column] = covariance[column][row];
+                }
+
+                if (covariance[row][row] > covariance[largest][largest]) {
+                    largest = row;
+                }
+
+                trace += covariance[row][row];
+            }
+
+            float scale = trace > 0.0f ? 1.0f / trace : 0.0f;
+
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                axis[channel] = covariance[largest][channel] * scale;
+            }
+
+            for (uint32_t iteration = 0; iteration < 6; iteration++) {
+                float next[4] = {};
+
+                for (uint32_t row = 0; row < channelCount; row++) {
+                    for (uint32_t column = 0; column < channelCount; column++) {
+                        next[row] += covariance[row][column] * axis[column];
+                    }
+                }
+
+                for (uint32_t channel = 0; channel < channelCount; channel++) {
+                    axis[channel] = next[channel] * scale;
+                }
+
+                // 特征值很接近时收敛很慢，每两次迭代放大一次，避免变成非规格化数
+                if (iteration & 1) {
+                    float length = 0.0f;
+
+                    for (uint32_t channel = 0; channel < channelCount; channel++) {
+                        length = std::max(length, std::fabs(axis[channel]));
+                    }
+
+                    if (length <= 0.0f) {
+                        break;
+                    }
+
+                    length = 1.0f / length;
+
+                    for (uint32_t channel = 0; channel < channelCount; channel++) {
+                        axis[channel] *= length;
+                    }
+                }
+            }
+
+            float length = 0.0f;
+
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                length += axis[channel] * axis[channel];
+            }
+
+            if (length <= 0.0f) {
+                // 所有像素相同
+                for (uint32_t channel = 0; channel < channelCount; channel++) {
+                    axis[channel] = 0.0f;
+                }
+            }
+            else {
+                length = 1.0f / std::sqrt(length);
+
+                for (uint32_t channel = 0; channel < channelCount; channel++) {
+                    axis[channel] *= length;
+                }
+            }
+
+            return weight;
+        }
+
+        // 沿主轴取两个端点，endpoint0在投影最大的一端
+        void rangeFit(const float* const* channels, uint32_t channelCount, const float* mask, uint32_t count, float* endpoint0, float* endpoint1) {
+            float mean[4];
+            float axis[4];
+
+            principalAxis(channels, channelCount, mask, count, mean, axis);
+
+            float minProjection = FLT_MAX;
+            float maxProjection = -FLT_MAX;
+
+            for (uint32_t i = 0; i < count; i++) {
+                if (mask[i] <= 0.0f) {
+                    continue;
+                }
+
+                float projection = 0.0f;
+
+                for (uint32_t channel = 0; channel < channelCount; channel++) {
+                    projection += (channels[channel][i] - mean[channel]) * axis[channel];
+                }
+
+                minProjection = std::min(minProjection, projection);
+                maxProjection = std::max(maxProjection, projection);
+            }
+
+            if (minProjection > maxProjection) {
+                minProjection = maxProjection = 0.0f;
+            }
+
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                endpoint0[channel] = clampUNORM(mean[channel] + axis[channel] * maxProjection);
+                endpoint1[channel] = clampUNORM(mean[channel] + axis[channel] * minProjection);
+            }
+        }
+
+        // 已知每个像素在两个端点之间的位置t(0为endpoint0，1为endpoint1)，用最小二乘求端点。
+        // 所有像素位置相同时无解，返回false
+        bool leastSquaresFit(const float* const* channels, uint32_t channelCount, const float* mask, const float* t, uint32_t count, float* endpoint0, float* endpoint1) {
+            float a = 0.0f;
+            float b = 0.0f;
+            float c = 0.0f;
+            float x0[4] = {};
+            float x1[4] = {};
+
+            for (uint32_t i = 0; i < count; i++) {
+                float w1 = t[i] * mask[i];
+                float w0 = (1.0f - t[i]) * mask[i];
+
+                a += w0 * (1.0f - t[i]);
+                b += w0 * t[i];
+                c += w1 * t[i];
+
+                for (uint32_t channel = 0; channel < channelCount; channel++) {
+                    x0[channel] += w0 * channels[channel][i];
+                    x1[channel] += w1 * channels[channel][i];
+                }
+            }
+
+            float determinant = a * c - b * b;
+
+            if (std::fabs(determinant) < 1e-6f) {
+                return false;
+            }
+
+            float inverse = 1.0f / determinant;
+
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                endpoint0[channel] = clampUNORM((c * x0[channel] - b * x1[channel]) * inverse);
+                endpoint1[channel] = clampUNORM((a * x1[channel] - b * x0[channel]) * inverse);
+            }
+
+            return true;
+        }
+
+        // 为每个像素选择最接近的调色板项，返回误差平方和(mask为0的像素不计)。
+        // palette[entry][channel]，像素数count必须是4的倍数
+        float findNearest(const float* const* channels, uint32_t channelCount, const float* mask, uint32_t count,
+                          const float (*palette)[4], uint32_t paletteSize, uint8_t* indices) {
+#if BLOCK_COMPRESS_SSE2
+            __m128 totalError = _mm_setzero_ps();
+
+            for (uint32_t i = 0; i < count; i += 4) {
+                __m128 values[4];
+
+                for (uint32_t channel = 0; channel < channelCount; channel++) {
+                    values[channel] = _mm_loadu_ps(channels[channel] + i);
+                }
+
+                __m128 bestError = _mm_set1_ps(FLT_MAX);
+                __m128 bestIndex = _mm_setzero_ps();
+
+                for (uint32_t entry = 0; entry < paletteSize; entry++) {
+                    __m128 error = _mm_setzero_ps();
+
+                    for (uint32_t channel = 0; channel < channelCount; channel++) {
+                        __m128 delta = _mm_sub_ps(values[channel], _mm_set1_ps(palette[entry][channel]));
+                        error = _mm_add_ps(error, _mm_mul_ps(delta, delta));
+                    }
+
+                    __m128 less = _mm_cmplt_ps(error, bestError);
+
+                    bestError = _mm_min_ps(error, bestError);
+                    bestIndex = _mm_or_ps(_mm_and_ps(less, _mm_set1_ps(static_cast<float>(entry))), _mm_andnot_ps(less, bestIndex));
+                }
+
+                totalError = _mm_add_ps(totalError, _mm_mul_ps(bestError, _mm_loadu_ps(mask + i)));
+
+                alignas(16) int32_t lanes[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_cvttps_epi32(bestIndex));
+
+                for (uint32_t lane = 0; lane < 4; lane++) {
+                    indices[i + lane] = static_cast<uint8_t>(lanes[lane]);
+                }
+            }
+
+            alignas(16) float sums[4];
+            _mm_store_ps(sums, totalError);
+
+            return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+            float totalError = 0.0f;
+
+            for (uint32_t i = 0; i < count; i++) {
+                float bestError = FLT_MAX;
+                uint32_t bestIndex = 0;
+
+                for (uint32_t entry = 0; entry < paletteSize; entry++) {
+                    float error = 0.0f;
+
+                    for (uint32_t channel = 0; channel < channelCount; channel++) {
+                        float delta = channels[channel][i] - palette[entry][channel];
+                        error += delta * delta;
+                    }
+
+                    if (error < bestError) {
+                        bestError = error;
+                        bestIndex = entry;
+                    }
+                }
+
+                totalError += bestError * mask[i];
+                indices[i] = static_cast<uint8_t>(bestIndex);
+            }
+
+            return totalError;
+#endif
+        }
+
+        // ---------------------------------------------------------------------------------------------
+        // BC1的颜色块
+
+        int32_t expand5(int32_t value) {
+            return (value << 3) | (value >> 2);
+        }
+
+        int32_t expand6(int32_t value) {
+            return (value << 2) | (value >> 4);
+        }
+
+        void unpack565(uint16_t color, int32_t* rgb) {
+            rgb[0] = expand5((color >> 11) & 31);
+            rgb[1] = expand6((color >> 5) & 63);
+            rgb[2] = expand5(color & 31);
+        }
+
+        uint16_t pack565(const float* rgb) {
+            int32_t r = static_cast<int32_t>(rgb[0] * 31.0f / 255.0f + 0.5f);
+            int32_t g = static_cast<int32_t>(rgb[1] * 63.0f / 255.0f + 0.5f);
+            int32_t b = static_cast<int32_t>(rgb[2] * 31.0f / 255.0f + 0.5f);
+
+            return static_cast<uint16_t>((std::min(r, 31) << 11) | (std::min(g, 63) << 5) | std::min(b, 31));
+        }
+
+        // 4色模式(color0 > color1)：color0, color1, 2/3 * color0 + 1/3 * color1, 1/3 * color0 + 2/3 * color1
+        // 3色模式(color0 <= color1)：color0, color1, 1/2 * (color0 + color1), 透明黑色
+        uint32_t colorPalette(uint16_t color0, uint16_t color1, bool fourColor, int32_t (*palette)[4]) {
+            unpack565(color0, palette[0]);
+            unpack565(color1, palette[1]);
+
+            palette[0][3] = 255;
+            palette[1][3] = 255;
+            palette[2][3] = 255;
+
+            if (fourColor) {
+                palette[3][3] = 255;
+
+                for (uint32_t channel = 0; channel < 3; channel++) {
+                    palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+                    palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+                }
+
+                return 4;
+            }
+
+            for (uint32_t channel = 0; channel < 3; channel++) {
+                palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+                palette[3][channel] = 0;
+            }
+
+            palette[3][3] = 0;
+
+            return 3;
+        }
+
+        // 单色块：对每个8位的值，找到2/3 * e0 + 1/3 * e1最接近它的一对5位(6位)端点，所有像素使用索引2
+        struct SingleColorTables {
+            uint8_t match5[256][2];
+            uint8_t match6[256][2];
+        };
+
+        void buildSingleColorTable(uint8_t (*table)[2], int32_t bits) {
+            int32_t maxValue = (1 << bits) - 1;
+
+            for (int32_t value = 0; value < 256; value++) {
+                int32_t bestError = INT32_MAX;
+
+                for (int32_t a = 0; a <= maxValue; a++) {
+                    for (int32_t b = 0; b <= maxValue; b++) {
+                        int32_t ea = bits == 5 ? expand5(a) : expand6(a);
+                        int32_t eb = bits == 5 ? expand5(b) : expand6(b);
+                        // 误差相同时选择端点较近的一对，对解码时插值的舍入误差不敏感
+                        int32_t error = std::abs((2 * ea + eb) / 3 - value) * 256 + std::abs(ea - eb);
+
+                        if (error < bestError) {
+                            bestError = error;
+                            table[value][0] = static_cast<uint8_t>(a);
+                            table[value][1] = static_cast<uint8_t>(b);
+                        }
+                    }
+                }
+            }
+        }
+
+        const SingleColorTables& singleColorTables() {
+            static const SingleColorTables tables = []() {
+                SingleColorTables result;
+                buildSingleColorTable(result.match5, 5);
+                buildSingleColorTable(result.match6, 6);
+
+                return result;
+            }();
+
+            return tables;
+        }
+
+        void writeColorBlock(uint16_t color0, uint16_t color1, uint32_t indices, uint8_t* output) {
+            output[0] = static_cast<uint8_t>(color0);
+            output[1] = static_cast<uint8_t>(color0 >> 8);
+            output[2] = static_cast<uint8_t>(color1);
+            output[3] = static_cast<uint8_t>(color1 >> 8);
+            memcpy(output + 4, &indices, 4);
+        }
+
+        // 用量化后的端点计算索引，返回误差
+        float evaluateColorBlock(const BlockPixels& pixels, const float* mask, uint16_t color0, uint16_t color1, bool fourColor, uint32_t& packedIndices) {
+            int32_t palette[4][4];
+            uint32_t paletteSize = colorPalette(color0, color1, fourColor, palette);
+
+            float floatPalette[4][4];
+
+            for (uint32_t entry = 0; entry < 4; entry++) {
+                for (uint32_t channel = 0; channel < 3; channel++) {
+                    floatPalette[entry][channel] = static_cast<float>(palette[entry][channel]);
+                }
+            }
+
+            const float* channels[3] = { pixels.channels[0], pixels.channels[1], pixels.channels[2] };
+            uint8_t indices[16];
+
+            float error = findNearest(channels, 3, mask, 16, floatPalette, paletteSize, indices);
+
+            packedIndices = 0;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                // 3色模式下透明的像素使用索引3
+                uint32_t index = mask[i] > 0.0f ? indices[i] : 3;
+                packedIndices |= index << (i * 2);
+            }
+
+            return error;
+        }
+
+        // threeColorAlpha为true时，mask为0的像素是透明的，使用3色模式
+        void compressColorBlock(const BlockPixels& pixels, const float* mask, bool threeColorAlpha, uint8_t* output) {
+            const float* channels[3] = { pixels.channels[0], pixels.channels[1], pixels.channels[2] };
+
+            float first[3] = {};
+            bool singleColor = true;
+            bool anyOpaque = false;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                if (mask[i] <= 0.0f) {
+                    continue;
+                }
+
+                if (!anyOpaque) {
+                    first[0] = channels[0][i];
+                    first[1] = channels[1][i];
+                    first[2] = channels[2][i];
+                    anyOpaque = true;
+                }
+                else if (channels[0][i] != first[0] || channels[1][i] != first[1] || channels[2][i] != first[2]) {
+                    singleColor = false;
+                }
+            }
+
+            if (!anyOpaque) {
+                // 全部透明：color0 == color1是3色模式，索引3是透明黑色
+                writeColorBlock(0, 0, 0xffffffffu, output);
+                return;
+            }
+
+            if (singleColor && !threeColorAlpha) {
+                const SingleColorTables& tables = singleColorTables();
+                int32_t r = static_cast<int32_t>(first[0]);
+                int32_t g = static_cast<int32_t>(first[1]);
+                int32_t b = static_cast<int32_t>(first[2]);
+
+                uint16_t color0 = static_cast<uint16_t>((tables.match5[r][0] << 11) | (tables.match6[g][0] << 5) | tables.match5[b][0]);
+                uint16_t color1 = static_cast<uint16_t>((tables.match5[r][1] << 11) | (tables.match6[g][1] << 5) | tables.match5[b][1]);
+
+                if (color0 > color1) {
+                    writeColorBlock(color0, color1, 0xaaaaaaaau, output);
+                }
+                else if (color0 < color1) {
+                    // 交换端点后2/3 * e0 + 1/3 * e1是索引3
+                    writeColorBlock(color1, color0, 0xffffffffu, output);
+                }
+                else {
+                    writeColorBlock(color0, color1, 0, output);
+                }
+
+                return;
+            }
+
+            bool fourColor = !threeColorAlpha;
+
+            float endpoint0[3];
+            float endpoint1[3];
+
+            rangeFit(channels, 3, mask, 16, endpoint0, endpoint1);
+
+            uint16_t bestColor0 = 0;
+            uint16_t bestColor1 = 0;
+            uint32_t bestIndices = 0;
+            float bestError = FLT_MAX;
+
+            // 先沿主轴取端点，再按得到的索引用最小二乘修正
+            for (uint32_t iteration = 0; iteration < 3; iteration++) {
+                uint16_t color0 = pack565(endpoint0);
+                uint16_t color1 = pack565(endpoint1);
+
+                // 4色模式要求color0 > color1，3色模式要求color0 <= color1
+                if (fourColor ? color0 < color1 : color0 > color1) {
+                    std::swap(color0, color1);
+                }
+
+                uint32_t indices = 0;
+                float error = evaluateColorBlock(pixels, mask, color0, color1, fourColor && color0 != color1, indices);
+
+                if (error < bestError) {
+                    bestError = error;
+                    bestColor0 = color0;
+                    bestColor1 = color1;
+                    bestIndices = indices;
+                }
+                else {
+                    break;
+                }
+
+                if (bestError <= 0.0f) {
+                    break;
+                }
+
+                // 每个索引在两个端点之间的位置
+                const float fourColorT[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+                const float threeColorT[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+                float t[16];
+
+                for (uint32_t i = 0; i < 16; i++) {
+                    uint32_t index = (indices >> (i * 2)) & 3;
+                    t[i] = fourColor ? fourColorT[index] : threeColorT[index];
+                }
+
+                if (!leastSquaresFit(channels, 3, mask, t, 16, endpoint0, endpoint1)) {
+                    break;
+                }
+            }
+
+            writeColorBlock(bestColor0, bestColor1, bestIndices, output);
+        }
+
+        void decompressColorBlock(const uint8_t* input, bool alwaysFourColor, uint8_t* block) {
+            uint16_t color0 = static_cast<uint16_t>(input[0] | (input[1] << 8));
+            uint16_t color1 = static_cast<uint16_t>(input[2] | (input[3] << 8));
+
+            int32_t palette[4][4];
+            colorPalette(color0, color1, alwaysFourColor || color0 > color1, palette);
+
+            uint32_t indices = 0;
+            memcpy(&indices, input + 4, 4);
+
+            for (uint32_t i = 0; i < 16; i++) {
+                const int32_t* color = palette[(indices >> (i * 2)) & 3];
+
+                for (uint32_t channel = 0; channel < 4; channel++) {
+                    block[i * 4 + channel] = static_cast<uint8_t>(color[channel]);
+                }
+            }
+        }
+
+        // ---------------------------------------------------------------------------------------------
+        // BC4的单通道块
+
+        // 8值模式(value0 > value1)：value0, value1, 6个插值
+        // 6值模式(value0 <= value1)：value0, value1, 4个插值, 0, 255
+        void channelPalette(int32_t value0, int32_t value1, int32_t* palette) {
+            palette[0] = value0;
+            palette[1] = value1;
+
+            if (value0 > value1) {
+                for (int32_t i = 2; i < 8; i++) {
+                    palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+                }
+            }
+            else {
+                for (int32_t i = 2; i < 6; i++) {
+                    palette[i] = ((6 - i) * value0 + (i - 1) * value1 + 2) / 5;
+                }
+
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        uint32_t evaluateChannelBlock(const uint8_t* values, int32_t value0, int32_t value1, uint8_t* indices) {
+            int32_t palette[8];
+            channelPalette(value0, value1, palette);
+
+#if BLOCK_COMPRESS_SSE2
+            // 16个值正好是一个寄存器，无符号饱和减法的差求绝对值
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+            __m128i bestError = _mm_set1_epi8(-1);
+            __m128i bestIndex = _mm_setzero_si128();
+
+            for (int32_t entry = 0; entry < 8; entry++) {
+                __m128i value = _mm_set1_epi8(static_cast<char>(palette[entry]));
+                __m128i error = _mm_or_si128(_mm_subs_epu8(pixels, value), _mm_subs_epu8(value, pixels));
+                __m128i minimum = _mm_min_epu8(error, bestError);
+                // error < bestError
+                __m128i less = _mm_andnot_si128(_mm_cmpeq_epi8(minimum, bestError), _mm_set1_epi8(-1));
+
+                bestError = minimum;
+                bestIndex = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi8(static_cast<char>(entry))), _mm_andnot_si128(less, bestIndex));
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), bestIndex);
+
+            __m128i zero = _mm_setzero_si128();
+            __m128i low = _mm_unpacklo_epi8(bestError, zero);
+            __m128i high = _mm_unpackhi_epi8(bestError, zero);
+            __m128i sums = _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+
+            alignas(16) uint32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums);
+
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+            uint32_t totalError = 0;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                int32_t bestError = INT32_MAX;
+
+                for (int32_t entry = 0; entry < 8; entry++) {
+                    int32_t error = std::abs(static_cast<int32_t>(values[i]) - palette[entry]);
+
+                    if (error < bestError) {
+                        bestError = error;
+                        indices[i] = static_cast<uint8_t>(entry);
+                    }
+                }
+
+                totalError += static_cast<uint32_t>(bestError * bestError);
+            }
+
+            return totalError;
+#endif
+        }
+
+        void compressChannelBlock(const uint8_t* values, uint8_t* output) {
+            int32_t minValue = 255;
+            int32_t maxValue = 0;
+            // 不包括0和255的范围，用于6值模式
+            int32_t innerMin = 255;
+            int32_t innerMax = 0;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                minValue = std::min<int32_t>(minValue, values[i]);
+                maxValue = std::max<int32_t>(maxValue, values[i]);
+
+                if (values[i] != 0 && values[i] != 255) {
+                    innerMin = std::min<int32_t>(innerMin, values[i]);
+                    innerMax = std::max<int32_t>(innerMax, values[i]);
+                }
+            }
+
+            int32_t bestValue0 = minValue;
+            int32_t bestValue1 = maxValue;
+            uint8_t bestIndices[16] = {};
+            uint32_t bestError = UINT32_MAX;
+
+            auto tryEndpoints = [&](int32_t value0, int32_t value1) {
+                uint8_t indices[16];
+                uint32_t error = evaluateChannelBlock(values, value0, value1, indices);
+
+                if (error < bestError) {
+                    bestError = error;
+                    bestValue0 = value0;
+                    bestValue1 = value1;
+                    memcpy(bestIndices, indices, 16);
+                }
+
+                return error;
+            };
+
+            if (minValue == maxValue) {
+                tryEndpoints(minValue, maxValue);
+            }
+            else {
+                tryEndpoints(maxValue, minValue);
+
+                // 8值模式下按索引用最小二乘修正端点
+                for (uint32_t iteration = 0; iteration < 2 && bestError > 0 && bestValue0 > bestValue1; iteration++) {
+                    float t[16];
+                    float values0[16];
+                    float mask[16];
+
+                    for (uint32_t i = 0; i < 16; i++) {
+                        t[i] = bestIndices[i] == 0 ? 0.0f : (bestIndices[i] == 1 ? 1.0f : (bestIndices[i] - 1) / 7.0f);
+                        values0[i] = static_cast<float>(values[i]);
+                        mask[i] = 1.0f;
+                    }
+
+                    const float* channels[1] = { values0 };
+                    float endpoint0 = 0.0f;
+                    float endpoint1 = 0.0f;
+
+                    if (!leastSquaresFit(channels, 1, mask, t, 16, &endpoint0, &endpoint1)) {
+                        break;
+                    }
+
+                    int32_t value0 = static_cast<int32_t>(endpoint0 + 0.5f);
+                    int32_t value1 = static_cast<int32_t>(endpoint1 + 0.5f);
+
+                    if (value0 <= value1 || (value0 == bestValue0 && value1 == bestValue1)) {
+                        break;
+                    }
+
+                    if (tryEndpoints(value0, value1) > bestError) {
+                        break;
+                    }
+                }
+
+                // 有0或255的块可以用6值模式，0和255不需要占用端点之间的插值
+                if ((minValue == 0 || maxValue == 255) && innerMin <= innerMax) {
+                    tryEndpoints(innerMin, innerMax);
+                }
+            }
+
+            output[0] = static_cast<uint8_t>(bestValue0);
+            output[1] = static_cast<uint8_t>(bestValue1);
+
+            uint64_t packed = 0;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                packed |= static_cast<uint64_t>(bestIndices[i]) << (i * 3);
+            }
+
+            for (uint32_t i = 0; i < 6; i++) {
+                output[2 + i] = static_cast<uint8_t>(packed >> (i * 8));
+            }
+        }
+
+        // 解码一个BC4块，结果写到block的channel通道
+        void decompressChannelBlock(const uint8_t* input, uint8_t* block, uint32_t channel) {
+            int32_t palette[8];
+            channelPalette(input[0], input[1], palette);
+
+            uint64_t packed = 0;
+
+            for (uint32_t i = 0; i < 6; i++) {
+                packed |= static_cast<uint64_t>(input[2 + i]) << (i * 8);
+            }
+
+            for (uint32_t i = 0; i < 16; i++) {
+                block[i * 4 + channel] = static_cast<uint8_t>(palette[(packed >> (i * 3)) & 7]);
+            }
+        }
+
+        void extractChannel(const uint8_t* block, uint32_t channel, uint8_t* values) {
+            for (uint32_t i = 0; i < 16; i++) {
+                values[i] = block[i * 4 + channel];
+            }
+        }
+
+        // ---------------------------------------------------------------------------------------------
+        // BC7
+
+        struct ModeInfo {
+            uint32_t subsets;
+            uint32_t partitionBits;
+            uint32_t rotationBits;
+            uint32_t indexSelectionBits;
+            uint32_t colorBits;
+            uint32_t alphaBits;
+            uint32_t endpointPBits;     // 每个端点一个p位
+            uint32_t sharedPBits;       // 一个子集的两个端点共用一个p位
+            uint32_t indexBits;
+            uint32_t secondaryIndexBits;
+        };
+
+        const ModeInfo modeInfos[8] = {
+            { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+            { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+            { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+            { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+            { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+            { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+            { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+            { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+        };
+
+        // 两个子集的分区，第i位为第i个像素所属的子集
+        const uint16_t partitions2[64] = {
+            0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+            0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+            0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+            0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+            0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+            0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+            0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+            0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+        };
+
+        // 三个子集的分区，每个像素所属的子集
+        const uint8_t partitions3[64][16] = {
+            { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 },
+            { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+            { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+            { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 },
+            { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+            { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 },
+            { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 },
+            { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+            { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+            { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+            { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 },
+            { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+            { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+            { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+            { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 },
+            { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+            { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 },
+            { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+            { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 },
+            { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+            { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 },
+            { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+            { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 },
+            { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+            { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 },
+            { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+            { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 },
+            { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+            { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 },
+            { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+            { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+            { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 },
+            { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+            { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 },
+            { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+            { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 },
+            { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+            { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 },
+            { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+            { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 },
+            { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+            { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 },
+            { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+            { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 },
+            { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+            { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 },
+            { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+            { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 },
+            { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+            { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 },
+            { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+            { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 },
+            { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+            { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 },
+            { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+            { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 },
+            { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+            { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 },
+            { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+            { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+            { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 }
+        };
+
+        // 每个子集的锚点(anchor)像素，它的索引最高位总是0，不保存。子集0的锚点总是像素0
+        const uint8_t anchors2[64] = {
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+            15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+             6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+        };
+
+        const uint8_t anchors3Second[64] = {
+             3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+             3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+             8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+             3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+        };
+
+        const uint8_t anchors3Third[64] = {
+            15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+            15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+            15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+            15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+        };
+
+        const int32_t weights2[4] = { 0, 21, 43, 64 };
+        const int32_t weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+        const int32_t weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        const int32_t* weightTable(uint32_t indexBits) {
+            return indexBits == 2 ? weights2 : (indexBits == 3 ? weights3 : weights4);
+        }
+
+        int32_t interpolate(int32_t endpoint0, int32_t endpoint1, int32_t weight) {
+            return ((64 - weight) * endpoint0 + weight * endpoint1 + 32) >> 6;
+        }
+
+        uint32_t subsetOf(uint32_t subsets, uint32_t partition, uint32_t pixel) {
+            if (subsets == 2) {
+                return (partitions2[partition] >> pixel) & 1;
+            }
+
+            if (subsets == 3) {
+                return partitions3[partition][pixel];
+            }
+
+            return 0;
+        }
+
+        uint32_t anchorOf(uint32_t subsets, uint32_t partition, uint32_t subset) {
+            if (subset == 0) {
+                return 0;
+            }
+
+            if (subsets == 2) {
+                return anchors2[partition];
+            }
+
+            return subset == 1 ? anchors3Second[partition] : anchors3Third[partition];
+        }
+
+        // 端点加上p位之后共bits位，扩展到8位
+        int32_t expandBits(int32_t value, uint32_t bits) {
+            value <<= 8 - bits;
+
+            return value | (value >> bits);
+        }
+
+        class BitWriter {
+        public:
+            explicit BitWriter(uint8_t* output)
+                : output(output) {
+                memset(output, 0, 16);
+            }
+
+            void write(uint32_t value, uint32_t bits) {
+                for (uint32_t bit = 0; bit < bits; bit++, position++) {
+                    output[position >> 3] |= static_cast<uint8_t>(((value >> bit) & 1) << (position & 7));
+                }
+            }
+
+        private:
+            uint8_t* output;
+            uint32_t position = 0;
+        };
+
+        class BitReader {
+        public:
+            explicit BitReader(const uint8_t* input)
+                : input(input) {
+            }
+
+            uint32_t read(uint32_t bits) {
+                uint32_t value = 0;
+
+                for (uint32_t bit = 0; bit < bits; bit++, position++) {
+                    value |= static_cast<uint32_t>((input[position >> 3] >> (position & 7)) & 1) << bit;
+                }
+
+                return value;
+            }
+
+        private:
+            const uint8_t* input;
+            uint32_t position = 0;
+        };
+
+        enum class PBits {
+            None,
+            Unique,
+            Shared
+        };
+
+        // 一组端点的量化方式：拟合firstChannel开始的channelCount个通道
+        struct EndpointFormat {
+            uint32_t firstChannel = 0;
+            uint32_t channelCount = 4;
+            uint32_t colorBits = 7;
+            uint32_t alphaBits = 0;
+            PBits pbits = PBits::None;
+            uint32_t indexBits = 2;
+        };
+
+        // 一个子集中的像素，数量向上补齐到4的倍数，补齐的像素mask为0
+        struct SubsetPixels {
+            alignas(16) float channels[4][16];
+            alignas(16) float mask[16];
+            uint8_t positions[16];
+            uint32_t count = 0;
+            uint32_t paddedCount = 0;
+        };
+
+        struct SubsetFit {
+            int32_t quantized[2][4] = {};   // 不包括p位
+            int32_t pbits[2] = {};
+            uint8_t indices[16] = {};       // 按SubsetPixels中的顺序
+            float error = FLT_MAX;
+        };
+
+        struct SearchSettings {
+            uint32_t refineIterations;
+            bool perturb;
+        };
+
+        void gatherSubset(const BlockPixels& block, uint32_t subsets, uint32_t partition, uint32_t subset, SubsetPixels& pixels) {
+            pixels.count = 0;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                if (subsetOf(subsets, partition, i) == subset) {
+                    pixels.positions[pixels.count++] = static_cast<uint8_t>(i);
+                }
+            }
+
+            pixels.paddedCount = (pixels.count + 3) & ~3u;
+
+            for (uint32_t i = 0; i < pixels.paddedCount; i++) {
+                uint32_t position = pixels.positions[i < pixels.count ? i : 0];
+
+                for (uint32_t channel = 0; channel < 4; channel++) {
+                    pixels.channels[channel][i] = block.channels[channel][position];
+                }
+
+                pixels.mask[i] = i < pixels.count ? 1.0f : 0.0f;
+            }
+        }
+
+        uint32_t channelBits(const EndpointFormat& format, uint32_t channel) {
+            return channel == 3 ? format.alphaBits : format.colorBits;
+        }
+
+        int32_t dequantize(const EndpointFormat& format, uint32_t channel, int32_t quantized, int32_t pbit) {
+            uint32_t bits = channelBits(format, channel);
+
+            if (format.pbits == PBits::None) {
+                return expandBits(quantized, bits);
+            }
+
+            return expandBits((quantized << 1) | pbit, bits + 1);
+        }
+
+        // 每种位数(不包括p位)和p位下，使解码结果最接近每个8位值的量化值
+        struct QuantizeTables {
+            // [bits][0为没有p位，1、2为p位是0、1][value]
+            uint8_t nearest[9][3][256];
+        };
+
+        const QuantizeTables& quantizeTables() {
+            static const QuantizeTables tables = []() {
+                QuantizeTables result = {};
+
+                for (uint32_t bits = 4; bits <= 8; bits++) {
+                    for (uint32_t variant = 0; variant < 3; variant++) {
+                        if (bits == 8 && variant > 0) {
+                            continue;
+                        }
+
+                        for (int32_t value = 0; value < 256; value++) {
+                            int32_t bestError = INT32_MAX;
+
+                            for (int32_t candidate = 0; candidate < (1 << bits); candidate++) {
+                                int32_t decoded = variant == 0 ? expandBits(candidate, bits) : expandBits((candidate << 1) | static_cast<int32_t>(variant - 1), bits + 1);
+                                int32_t error = std::abs(decoded - value);
+
+                                if (error < bestError) {
+                                    bestError = error;
+                                    result.nearest[bits][variant][value] = static_cast<uint8_t>(candidate);
+                                }
+                            }
+                        }
+                    }
+                }
+
+                return result;
+            }();
+
+            return tables;
+        }
+
+        // 在给定的p位下量化一个端点，返回误差
+        float quantizeEndpoint(const EndpointFormat& format, const float* endpoint, int32_t pbit, int32_t* quantized) {
+            const QuantizeTables& tables = quantizeTables();
+            uint32_t variant = format.pbits == PBits::None ? 0 : 1 + pbit;
+            float error = 0.0f;
+
+            for (uint32_t channel = format.firstChannel; channel < format.firstChannel + format.channelCount; channel++) {
+                float value = endpoint[channel];
+
+                uint32_t bits = channelBits(format, channel);
+                int32_t guess = tables.nearest[bits][variant][static_cast<int32_t>(value + 0.5f)];
+                int32_t maxValue = (1 << bits) - 1;
+
+                // 查表用的是取整之后的值，再比较相邻的两个量化值
+                float bestError = FLT_MAX;
+
+                for (int32_t candidate = std::max(guess - 1, 0); candidate <= std::min(guess + 1, maxValue); candidate++) {
+                    float delta = static_cast<float>(dequantize(format, channel, candidate, pbit)) - value;
+
+                    if (delta * delta < bestError) {
+                        bestError = delta * delta;
+                        quantized[channel] = candidate;
+                    }
+                }
+
+                error += bestError;
+            }
+
+            return error;
+        }
+
+        void quantizeEndpoints(const EndpointFormat& format, const float (*endpoints)[4], SubsetFit& fit) {
+            if (format.pbits == PBits::None) {
+                quantizeEndpoint(format, endpoints[0], 0, fit.quantized[0]);
+                quantizeEndpoint(format, endpoints[1], 0, fit.quantized[1]);
+                fit.pbits[0] = fit.pbits[1] = 0;
+
+                return;
+            }
+
+            int32_t quantized[2][2][4];
+            float errors[2][2];
+
+            for (int32_t pbit = 0; pbit < 2; pbit++) {
+                errors[0][pbit] = quantizeEndpoint(format, endpoints[0], pbit, quantized[0][pbit]);
+                errors[1][pbit] = quantizeEndpoint(format, endpoints[1], pbit, quantized[1][pbit]);
+            }
+
+            if (format.pbits == PBits::Unique) {
+                fit.pbits[0] = errors[0][1] < errors[0][0] ? 1 : 0;
+                fit.pbits[1] = errors[1][1] < errors[1][0] ? 1 : 0;
+            }
+            else {
+                fit.pbits[0] = fit.pbits[1] = errors[0][1] + errors[1][1] < errors[0][0] + errors[1][0] ? 1 : 0;
+            }
+
+            memcpy(fit.quantized[0], quantized[0][fit.pbits[0]], sizeof(fit.quantized[0]));
+            memcpy(fit.quantized[1], quantized[1][fit.pbits[1]], sizeof(fit.quantized[1]));
+        }
+
+        // 用量化后的端点为每个像素选择索引，结果写入fit.indices和fit.error
+        void evaluateSubset(const SubsetPixels& pixels, const EndpointFormat& format, SubsetFit& fit) {
+            const int32_t* weights = weightTable(format.indexBits);
+            uint32_t paletteSize = 1u << format.indexBits;
+
+            float palette[16][4];
+            int32_t endpoints[2][4];
+
+            for (uint32_t channel = format.firstChannel; channel < format.firstChannel + format.channelCount; channel++) {
+                endpoints[0][channel] = dequantize(format, channel, fit.quantized[0][channel], fit.pbits[0]);
+                endpoints[1][channel] = dequantize(format, channel, fit.quantized[1][channel], fit.pbits[1]);
+            }
+
+            for (uint32_t entry = 0; entry < paletteSize; entry++) {
+                for (uint32_t channel = 0; channel < format.channelCount; channel++) {
+                    uint32_t source = format.firstChannel + channel;
+                    palette[entry][channel] = static_cast<float>(interpolate(endpoints[0][source], endpoints[1][source], weights[entry]));
+                }
+            }
+
+            const float* channels[4];
+
+            for (uint32_t channel = 0; channel < format.channelCount; channel++) {
+                channels[channel] = pixels.channels[format.firstChannel + channel];
+            }
+
+            fit.error = findNearest(channels, format.channelCount, pixels.mask, pixels.paddedCount, palette, paletteSize, fit.indices);
+        }
+
+        void fitSubset(const SubsetPixels& pixels, const EndpointFormat& format, const SearchSettings& settings, SubsetFit& fit) {
+            const float* channels[4] = {};
+
+            for (uint32_t channel = 0; channel < format.channelCount; channel++) {
+                channels[channel] = pixels.channels[format.firstChannel + channel];
+            }
+
+            float fitted[2][4];
+            float endpoints[2][4] = {};
+
+            rangeFit(channels, format.channelCount, pixels.mask, pixels.paddedCount, fitted[0], fitted[1]);
+
+            for (uint32_t channel = 0; channel < format.channelCount; channel++) {
+                endpoints[0][format.firstChannel + channel] = fitted[0][channel];
+                endpoints[1][format.firstChannel + channel] = fitted[1][channel];
+            }
+
+            quantizeEndpoints(format, endpoints, fit);
+            evaluateSubset(pixels, format, fit);
+
+            const int32_t* weights = weightTable(format.indexBits);
+
+            for (uint32_t iteration = 0; iteration < settings.refineIterations && fit.error > 0.0f; iteration++) {
+                float t[16];
+
+                for (uint32_t i = 0; i < pixels.paddedCount; i++) {
+                    t[i] = weights[fit.indices[i]] / 64.0f;
+                }
+
+                if (!leastSquaresFit(channels, format.channelCount, pixels.mask, t, pixels.paddedCount, fitted[0], fitted[1])) {
+                    break;
+                }
+
+                for (uint32_t channel = 0; channel < format.channelCount; channel++) {
+                    endpoints[0][format.firstChannel + channel] = fitted[0][channel];
+                    endpoints[1][format.firstChannel + channel] = fitted[1][channel];
+                }
+
+                SubsetFit refined;
+                quantizeEndpoints(format, endpoints, refined);
+                evaluateSubset(pixels, format, refined);
+
+                if (refined.error >= fit.error) {
+                    break;
+                }
+
+                fit = refined;
+            }
+
+            if (!settings.perturb) {
+                return;
+            }
+
+            // 量化后的端点逐个通道加减1，保留误差更小的结果
+            for (uint32_t endpoint = 0; endpoint < 2 && fit.error > 0.0f; endpoint++) {
+                for (uint32_t channel = format.firstChannel; channel < format.firstChannel + format.channelCount; channel++) {
+                    int32_t maxValue = (1 << channelBits(format, channel)) - 1;
+
+                    for (int32_t step = -1; step <= 1; step += 2) {
+                        int32_t value = fit.quantized[endpoint][channel] + step;
+
+                        if (value < 0 || value > maxValue) {
+                            continue;
+                        }
+
+                        SubsetFit candidate = fit;
+                        candidate.quantized[endpoint][channel] = value;
+                        evaluateSubset(pixels, format, candidate);
+
+                        if (candidate.error < fit.error) {
+                            fit = candidate;
+                        }
+                    }
+                }
+            }
+        }
+
+        // 一个候选的编码结果
+        struct BC7Candidate {
+            uint32_t mode = 0;
+            uint32_t partition = 0;
+            uint32_t rotation = 0;
+            uint32_t indexSelection = 0;
+            SubsetFit color[3];
+            // 模式4和5的Alpha单独拟合
+            SubsetFit alpha;
+            // 按像素位置的索引
+            uint8_t colorIndices[16] = {};
+            uint8_t alphaIndices[16] = {};
+            float error = FLT_MAX;
+        };
+
+        EndpointFormat colorFormat(uint32_t mode, uint32_t indexSelection) {
+            const ModeInfo& info = modeInfos[mode];
+            EndpointFormat format;
+
+            format.colorBits = info.colorBits;
+            format.alphaBits = info.alphaBits;
+            format.pbits = info.endpointPBits ? PBits::Unique : (info.sharedPBits ? PBits::Shared : PBits::None);
+
+            if (mode == 4 || mode == 5) {
+                // 颜色和Alpha分开拟合，模式4的indexSelection为1时颜色使用3位的第二组索引
+                format.firstChannel = 0;
+                format.channelCount = 3;
+                format.indexBits = indexSelection ? info.secondaryIndexBits : info.indexBits;
+            }
+            else {
+                format.channelCount = info.alphaBits ? 4 : 3;
+                format.indexBits = info.indexBits;
+            }
+
+            return format;
+        }
+
+        EndpointFormat alphaFormat(uint32_t mode, uint32_t indexSelection) {
+            const ModeInfo& info = modeInfos[mode];
+            EndpointFormat format;
+
+            format.firstChannel = 3;
+            format.channelCount = 1;
+            format.colorBits = info.colorBits;
+            format.alphaBits = info.alphaBits;
+            format.indexBits = indexSelection ? info.indexBits : info.secondaryIndexBits;
+
+            return format;
+        }
+
+        // block已经按rotation交换过通道
+        void encodeMode(const BlockPixels& block, uint32_t mode, uint32_t partition, uint32_t rotation, uint32_t indexSelection,
+                        const SearchSettings& settings, BC7Candidate& candidate) {
+            const ModeInfo& info = modeInfos[mode];
+
+            candidate.mode = mode;
+            candidate.partition = partition;
+            candidate.rotation = rotation;
+            candidate.indexSelection = indexSelection;
+            candidate.error = 0.0f;
+
+            EndpointFormat format = colorFormat(mode, indexSelection);
+            SubsetPixels pixels;
+
+            for (uint32_t subset = 0; subset < info.subsets; subset++) {
+                gatherSubset(block, info.subsets, partition, subset, pixels);
+                fitSubset(pixels, format, settings, candidate.color[subset]);
+
+                candidate.error += candidate.color[subset].error;
+
+                for (uint32_t i = 0; i < pixels.count; i++) {
+                    candidate.colorIndices[pixels.positions[i]] = candidate.color[subset].indices[i];
+                }
+            }
+
+            if (mode == 4 || mode == 5) {
+                EndpointFormat alpha = alphaFormat(mode, indexSelection);
+
+                fitSubset(pixels, alpha, settings, candidate.alpha);
+
+                candidate.error += candidate.alpha.error;
+                memcpy(candidate.alphaIndices, candidate.alpha.indices, 16);
+            }
+            else if (info.alphaBits == 0) {
+                // 模式0 ~ 3的Alpha总是255
+                for (uint32_t i = 0; i < 16; i++) {
+                    float delta = 255.0f - block.channels[3][i];
+                    candidate.error += delta * delta;
+                }
+            }
+        }
+
+        // 锚点像素的索引最高位必须为0，否则交换两个端点并反转子集中的所有索引
+        void fixAnchor(SubsetFit& fit, const EndpointFormat& format, uint8_t* indices, uint32_t subsets, uint32_t partition, uint32_t subset) {
+            uint32_t highBit = 1u << (format.indexBits - 1);
+
+            if ((indices[anchorOf(subsets, partition, subset)] & highBit) == 0) {
+                return;
+            }
+
+            for (uint32_t channel = format.firstChannel; channel < format.firstChannel + format.channelCount; channel++) {
+                std::swap(fit.quantized[0][channel], fit.quantized[1][channel]);
+            }
+
+            std::swap(fit.pbits[0], fit.pbits[1]);
+
+            uint32_t maxIndex = (1u << format.indexBits) - 1;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                if (subsetOf(subsets, partition, i) == subset) {
+                    indices[i] = static_cast<uint8_t>(maxIndex - indices[i]);
+                }
+            }
+        }
+
+        void writeIndices(BitWriter& writer, const uint8_t* indices, uint32_t indexBits, uint32_t subsets, uint32_t partition) {
+            for (uint32_t i = 0; i < 16; i++) {
+                bool anchor = false;
+
+                for (uint32_t subset = 0; subset < subsets; subset++) {
+                    anchor = anchor || anchorOf(subsets, partition, subset) == i;
+                }
+
+                writer.write(indices[i], anchor ? indexBits - 1 : indexBits);
+            }
+        }
+
+        void packBC7Block(BC7Candidate candidate, uint8_t* output) {
+            const ModeInfo& info = modeInfos[candidate.mode];
+            EndpointFormat color = colorFormat(candidate.mode, candidate.indexSelection);
+
+            for (uint32_t subset = 0; subset < info.subsets; subset++) {
+                fixAnchor(candidate.color[subset], color, candidate.colorIndices, info.subsets, candidate.partition, subset);
+            }
+
+            if (candidate.mode == 4 || candidate.mode == 5) {
+                fixAnchor(candidate.alpha, alphaFormat(candidate.mode, candidate.indexSelection), candidate.alphaIndices, 1, 0, 0);
+
+                for (uint32_t endpoint = 0; endpoint < 2; endpoint++) {
+                    candidate.color[0].quantized[endpoint][3] = candidate.alpha.quantized[endpoint][3];
+                }
+            }
+
+            BitWriter writer(output);
+
+            // 模式号是mode个0之后的一个1
+            writer.write(1u << candidate.mode, candidate.mode + 1);
+            writer.write(candidate.partition, info.partitionBits);
+            writer.write(candidate.rotation, info.rotationBits);
+            writer.write(candidate.indexSelection, info.indexSelectionBits);
+
+            // 端点按通道、子集、端点的顺序排列
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                uint32_t bits = channel == 3 ? info.alphaBits : info.colorBits;
+
+                for (uint32_t subset = 0; subset < info.subsets; subset++) {
+                    for (uint32_t endpoint = 0; endpoint < 2; endpoint++) {
+                        writer.write(candidate.color[subset].quantized[endpoint][channel], bits);
+                    }
+                }
+            }
+
+            for (uint32_t subset = 0; subset < info.subsets; subset++) {
+                if (info.endpointPBits) {
+                    writer.write(candidate.color[subset].pbits[0], 1);
+                    writer.write(candidate.color[subset].pbits[1], 1);
+                }
+                else if (info.sharedPBits) {
+                    writer.write(candidate.color[subset].pbits[0], 1);
+                }
+            }
+
+            if (candidate.mode == 4 || candidate.mode == 5) {
+                // 第一组索引是2位的，模式4的indexSelection为1时第一组属于Alpha
+                const uint8_t* primary = candidate.indexSelection ? candidate.alphaIndices : candidate.colorIndices;
+                const uint8_t* secondary = candidate.indexSelection ? candidate.colorIndices : candidate.alphaIndices;
+
+                writeIndices(writer, primary, info.indexBits, 1, 0);
+                writeIndices(writer, secondary, info.secondaryIndexBits, 1, 0);
+            }
+            else {
+                writeIndices(writer, candidate.colorIndices, info.indexBits, info.subsets, candidate.partition);
+            }
+        }
+
+        // 每个像素的一阶和二阶矩：4个通道的值，10个两两乘积，计数，对齐到16个float
+        struct PixelMoments {
+            alignas(16) float values[16][16];
+        };
+
+        const uint32_t productOffset = 4;
+        const uint32_t countOffset = 14;
+
+        void computeMoments(const BlockPixels& block, PixelMoments& moments) {
+            for (uint32_t i = 0; i < 16; i++) {
+                float* values = moments.values[i];
+                uint32_t product = productOffset;
+
+                for (uint32_t row = 0; row < 4; row++) {
+                    values[row] = block.channels[row][i];
+
+                    for (uint32_t column = row; column < 4; column++) {
+                        values[product++] = block.channels[row][i] * block.channels[column][i];
+                    }
+                }
+
+                values[countOffset] = 1.0f;
+                values[15] = 0.0f;
+            }
+        }
+
+        void addMoments(float* sum, const float* values) {
+#if BLOCK_COMPRESS_SSE2
+            for (uint32_t i = 0; i < 16; i += 4) {
+                _mm_store_ps(sum + i, _mm_add_ps(_mm_load_ps(sum + i), _mm_load_ps(values + i)));
+            }
+#else
+            for (uint32_t i = 0; i < 16; i++) {
+                sum[i] += values[i];
+            }
+#endif
+        }
+
+        // 一个子集的像素到主轴的距离平方和 = 协方差矩阵的迹 - 最大特征值
+        template<uint32_t channelCount>
+        float lineFitError(const float* moments) {
+            float count = moments[countOffset];
+
+            if (count <= 1.0f) {
+                return 0.0f;
+            }
+
+            float inverseCount = 1.0f / count;
+            float covariance[4][4];
+            float trace = 0.0f;
+            uint32_t product = productOffset;
+
+            for (uint32_t row = 0; row < 4; row++) {
+                for (uint32_t column = row; column < 4; column++, product++) {
+                    covariance[row][column] = covariance[column][row] = moments[product] - moments[row] * moments[column] * inverseCount;
+                }
+            }
+
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                trace += covariance[channel][channel];
+            }
+
+            if (trace <= 0.0f) {
+                return 0.0f;
+            }
+
+            // 最大特征值：从方差最大的通道开始幂迭代一次，再求瑞利商。只用于给分区排序，不需要很精确
+            uint32_t largest = 0;
+
+            for (uint32_t channel = 1; channel < channelCount; channel++) {
+                if (covariance[channel][channel] > covariance[largest][largest]) {
+                    largest = channel;
+                }
+            }
+
+            const float* axis = covariance[largest];
+            float next[4];
+
+            for (uint32_t row = 0; row < channelCount; row++) {
+                next[row] = 0.0f;
+
+                for (uint32_t column = 0; column < channelCount; column++) {
+                    next[row] += covariance[row][column] * axis[column];
+                }
+            }
+
+            float numerator = 0.0f;
+            float denominator = 0.0f;
+
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                numerator += axis[channel] * next[channel];
+                denominator += axis[channel] * axis[channel];
+            }
+
+            float eigenvalue = denominator > 0.0f ? numerator / denominator : 0.0f;
+
+            return std::max(trace - eigenvalue, 0.0f);
+        }
+
+        // 每个分区中子集1、2的像素列表，估计分区误差时不用逐个像素判断所属的子集
+        struct PartitionPixels {
+            // [subsets - 2][partition]
+            uint8_t counts[2][64][3];
+            uint8_t pixels[2][64][3][16];
+        };
+
+        const PartitionPixels& partitionPixels() {
+            static const PartitionPixels table = []() {
+                PartitionPixels result = {};
+
+                for (uint32_t subsets = 2; subsets <= 3; subsets++) {
+                    for (uint32_t partition = 0; partition < 64; partition++) {
+                        uint8_t* counts = result.counts[subsets - 2][partition];
+
+                        for (uint32_t i = 0; i < 16; i++) {
+                            uint32_t subset = subsetOf(subsets, partition, i);
+                            result.pixels[subsets - 2][partition][subset][counts[subset]++] = static_cast<uint8_t>(i);
+                        }
+                    }
+                }
+
+                return result;
+            }();
+
+            return table;
+        }
+
+        // 估计每个分区的误差：每个子集中的像素到主轴的距离平方和。
+        // 只累加子集1、2的矩，子集0的矩由整个块的矩减去得到
+        void estimatePartitions(const PixelMoments& moments, uint32_t subsets, uint32_t partitionCount, uint32_t channelCount, float* errors) {
+            const PartitionPixels& table = partitionPixels();
+
+            alignas(16) float total[16] = {};
+
+            for (uint32_t i = 0; i < 16; i++) {
+                addMoments(total, moments.values[i]);
+            }
+
+            for (uint32_t partition = 0; partition < partitionCount; partition++) {
+                alignas(16) float sums[3][16] = {};
+
+                for (uint32_t subset = 1; subset < subsets; subset++) {
+                    const uint8_t* pixels = table.pixels[subsets - 2][partition][subset];
+                    uint32_t count = table.counts[subsets - 2][partition][subset];
+
+                    for (uint32_t i = 0; i < count; i++) {
+                        addMoments(sums[subset], moments.values[pixels[i]]);
+                    }
+                }
+
+                for (uint32_t i = 0; i < 16; i++) {
+                    sums[0][i] = total[i] - sums[1][i] - sums[2][i];
+                }
+
+                float error = 0.0f;
+
+                for (uint32_t subset = 0; subset < subsets; subset++) {
+                    error += channelCount == 4 ? lineFitError<4>(sums[subset]) : lineFitError<3>(sums[subset]);
+                }
+
+                errors[partition] = error;
+            }
+        }
+
+        // 按估计的误差从小到大选出count个分区
+        uint32_t selectPartitions(const float* errors, uint32_t partitionCount, uint32_t count, uint32_t* selected) {
+            count = std::min(count, partitionCount);
+
+            uint32_t order[64];
+
+            for (uint32_t partition = 0; partition < partitionCount; partition++) {
+                order[partition] = partition;
+            }
+
+            std::partial_sort(order, order + count, order + partitionCount, [errors](uint32_t a, uint32_t b) {
+                return errors[a] < errors[b];
+            });
+
+            memcpy(selected, order, count * sizeof(uint32_t));
+
+            return count;
+        }
+
+        uint32_t bitCount16(uint32_t bits) {
+            bits = bits - ((bits >> 1) & 0x5555);
+            bits = (bits & 0x3333) + ((bits >> 2) & 0x3333);
+            bits = (bits + (bits >> 4)) & 0x0f0f;
+
+            return (bits + (bits >> 8)) & 0x1f;
+        }
+
+        // 把像素按在整个块主轴上的投影分成两组，选出与分组最接近(不同的像素最少)的两子集分区。
+        // 比estimatePartitions粗糙，但只需要一次主轴计算和64次位运算
+        uint32_t matchPartition2(const BlockPixels& block, uint32_t channelCount) {
+            const float* channels[4] = { block.channels[0], block.channels[1], block.channels[2], block.channels[3] };
+            float mask[16];
+            float mean[4];
+            float axis[4];
+
+            std::fill(mask, mask + 16, 1.0f);
+            principalAxis(channels, channelCount, mask, 16, mean, axis);
+
+            uint32_t bits = 0;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                float projection = 0.0f;
+
+                for (uint32_t channel = 0; channel < channelCount; channel++) {
+                    projection += (channels[channel][i] - mean[channel]) * axis[channel];
+                }
+
+                bits |= (projection > 0.0f ? 1u : 0u) << i;
+            }
+
+            uint32_t bestPartition = 0;
+            uint32_t bestDistance = 17;
+
+            for (uint32_t partition = 0; partition < 64; partition++) {
+                // 两个子集交换后是同一种分组
+                uint32_t distance = bitCount16(partitions2[partition] ^ bits);
+                distance = std::min(distance, 16 - distance);
+
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestPartition = partition;
+                }
+            }
+
+            return bestPartition;
+        }
+
+        // 交换Alpha和rotation - 1通道，解码时再交换回来
+        void rotateBlock(const BlockPixels& block, uint32_t rotation, BlockPixels& rotated) {
+            rotated = block;
+
+            if (rotation > 0) {
+                memcpy(rotated.channels[rotation - 1], block.channels[3], sizeof(block.channels[3]));
+                memcpy(rotated.channels[3], block.channels[rotation - 1], sizeof(block.channels[3]));
+            }
+        }
+
+        struct BC7Settings {
+            SearchSettings search;
+            uint32_t partitions2;       // 模式1、3、7尝试的分区数
+            uint32_t partitions3;       // 模式0、2尝试的分区数
+            bool multiSubsetOpaque;     // 不透明的块尝试模式3、0、2
+            bool separateAlpha;         // 模式4、5
+            bool separateAlphaOpaque;   // 不透明的块也尝试模式4、5，很少被选中
+            bool allRotations;
+            // 误差(16个像素各通道的平方误差之和)不超过它时停止搜索
+            float goodEnoughError;
+            // 用matchPartition2直接选出模式1的分区，不估计每个分区的误差
+            bool matchPartitions;
+        };
+
+        BC7Settings bc7Settings(uint32_t quality) {
+            switch (std::min(quality, 3u)) {
+            case 0:
+                return { { 1, false }, 1, 0, false, false, false, false, 96.0f, true };
+            case 1:
+                return { { 1, false }, 4, 0, true, true, false, false, 96.0f, false };
+            case 2:
+                return { { 2, false }, 16, 8, true, true, true, true, 0.0f, false };
+            default:
+                return { { 3, true }, 64, 64, true, true, true, true, 0.0f, false };
+            }
+        }
+
+        void compressBC7Block(const uint8_t* rgba, uint8_t* output, const Options& options, Stats* stats) {
+            BC7Settings settings = bc7Settings(options.bc7Quality);
+
+            BlockPixels block;
+            loadBlockPixels(rgba, block);
+
+            bool opaque = true;
+            bool solid = true;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                opaque = opaque && rgba[i * 4 + 3] == 255;
+                solid = solid && memcmp(rgba + i * 4, rgba, 4) == 0;
+            }
+
+            // 单色的块(UI、遮罩中很常见)继续搜索，尽量完全准确
+            float goodEnoughError = solid ? 0.0f : settings.goodEnoughError;
+
+            BC7Candidate best;
+            BC7Candidate candidate;
+
+            auto tryMode = [&](const BlockPixels& pixels, uint32_t mode, uint32_t partition, uint32_t rotation, uint32_t indexSelection) {
+                encodeMode(pixels, mode, partition, rotation, indexSelection, settings.search, candidate);
+
+                if (candidate.error < best.error) {
+                    best = candidate;
+                }
+            };
+
+            // 模式6(单子集，RGBA各7位 + p位，4位索引)对大多数块都不错，先试它，误差足够小时不再搜索
+            tryMode(block, 6, 0, 0, 0);
+
+            PixelMoments moments;
+            computeMoments(block, moments);
+
+            float errors[64];
+            uint32_t selected[64];
+
+            if (opaque) {
+                if (best.error > goodEnoughError) {
+                    uint32_t count = 1;
+
+                    if (settings.matchPartitions) {
+                        selected[0] = matchPartition2(block, 3);
+                    }
+                    else {
+                        estimatePartitions(moments, 2, 64, 3, errors);
+                        count = selectPartitions(errors, 64, settings.partitions2, selected);
+                    }
+
+                    for (uint32_t i = 0; i < count && best.error > goodEnoughError; i++) {
+                        tryMode(block, 1, selected[i], 0, 0);
+
+                        if (settings.multiSubsetOpaque) {
+                            tryMode(block, 3, selected[i], 0, 0);
+                        }
+                    }
+                }
+
+                if (best.error > goodEnoughError && settings.multiSubsetOpaque && settings.partitions3 > 0) {
+                    estimatePartitions(moments, 3, 64, 3, errors);
+
+                    // 模式0只有16个分区
+                    uint32_t count = selectPartitions(errors, 16, settings.partitions3, selected);
+
+                    for (uint32_t i = 0; i < count && best.error > goodEnoughError; i++) {
+                        tryMode(block, 0, selected[i], 0, 0);
+                    }
+
+                    count = selectPartitions(errors, 64, settings.partitions3, selected);
+
+                    for (uint32_t i = 0; i < count && best.error > goodEnoughError; i++) {
+                        tryMode(block, 2, selected[i], 0, 0);
+                    }
+                }
+            }
+            else if (best.error > goodEnoughError && settings.separateAlpha) {
+                estimatePartitions(moments, 2, 64, 4, errors);
+
+                uint32_t count = selectPartitions(errors, 64, settings.partitions2, selected);
+
+                for (uint32_t i = 0; i < count && best.error > goodEnoughError; i++) {
+                    tryMode(block, 7, selected[i], 0, 0);
+                }
+            }
+
+            // 模式4、5的颜色和Alpha各有一组端点和索引，适合Alpha与颜色无关的块
+            if (best.error > goodEnoughError && (!opaque || settings.separateAlphaOpaque)) {
+                uint32_t rotations = settings.allRotations ? 4 : 1;
+                BlockPixels rotated;
+
+                for (uint32_t rotation = 0; rotation < rotations && best.error > goodEnoughError; rotation++) {
+                    rotateBlock(block, rotation, rotated);
+                    tryMode(rotated, 5, 0, rotation, 0);
+
+                    if (settings.separateAlpha) {
+                        tryMode(rotated, 4, 0, rotation, 0);
+                        tryMode(rotated, 4, 0, rotation, 1);
+                    }
+                }
+            }
+
+            packBC7Block(best, output);
+
+            if (stats != nullptr) {
+                stats->bc7ModeBlocks[best.mode]++;
+            }
+        }
+
+        void decompressBC7Block(const uint8_t* input, uint8_t* block) {
+            BitReader reader(input);
+
+            uint32_t mode = 0;
+
+            while (mode < 8 && reader.read(1) == 0) {
+                mode++;
+            }
+
+            if (mode == 8) {
+                // 保留的模式解码为0
+                memset(block, 0, 64);
+                return;
+            }
+
+            const ModeInfo& info = modeInfos[mode];
+
+            uint32_t partition = reader.read(info.partitionBits);
+            uint32_t rotation = reader.read(info.rotationBits);
+            uint32_t indexSelection = reader.read(info.indexSelectionBits);
+
+            int32_t endpoints[3][2][4] = {};
+
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                uint32_t bits = channel == 3 ? info.alphaBits : info.colorBits;
+
+                for (uint32_t subset = 0; subset < info.subsets; subset++) {
+                    for (uint32_t endpoint = 0; endpoint < 2; endpoint++) {
+                        endpoints[subset][endpoint][channel] = static_cast<int32_t>(reader.read(bits));
+                    }
+                }
+            }
+
+            int32_t pbits[3][2] = {};
+
+            for (uint32_t subset = 0; subset < info.subsets; subset++) {
+                if (info.endpointPBits) {
+                    pbits[subset][0] = static_cast<int32_t>(reader.read(1));
+                    pbits[subset][1] = static_cast<int32_t>(reader.read(1));
+                }
+                else if (info.sharedPBits) {
+                    pbits[subset][0] = pbits[subset][1] = static_cast<int32_t>(reader.read(1));
+                }
+            }
+
+            uint32_t extraBit = (info.endpointPBits || info.sharedPBits) ? 1 : 0;
+
+            for (uint32_t subset = 0; subset < info.subsets; subset++) {
+                for (uint32_t endpoint = 0; endpoint < 2; endpoint++) {
+                    for (uint32_t channel = 0; channel < 4; channel++) {
+                        int32_t& value = endpoints[subset][endpoint][channel];
+                        uint32_t bits = channel == 3 ? info.alphaBits : info.colorBits;
+
+                        if (bits == 0) {
+                            value = 255;
+                        }
+                        else if (extraBit) {
+                            value = expandBits((value << 1) | pbits[subset][endpoint], bits + 1);
+                        }
+                        else {
+                            value = expandBits(value, bits);
+                        }
+                    }
+                }
+            }
+
+            uint8_t primary[16];
+            uint8_t secondary[16] = {};
+
+            for (uint32_t i = 0; i < 16; i++) {
+                bool anchor = false;
+
+                for (uint32_t subset = 0; subset < info.subsets; subset++) {
+                    anchor = anchor || anchorOf(info.subsets, partition, subset) == i;
+                }
+
+                primary[i] = static_cast<uint8_t>(reader.read(anchor ? info.indexBits - 1 : info.indexBits));
+            }
+
+            if (info.secondaryIndexBits) {
+                for (uint32_t i = 0; i < 16; i++) {
+                    secondary[i] = static_cast<uint8_t>(reader.read(i == 0 ? info.secondaryIndexBits - 1 : info.secondaryIndexBits));
+                }
+            }
+
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t subset = subsetOf(info.subsets, partition, i);
+                const int32_t* endpoint0 = endpoints[subset][0];
+                const int32_t* endpoint1 = endpoints[subset][1];
+
+                int32_t colorWeight;
+                int32_t alphaWeight;
+
+                if (info.secondaryIndexBits == 0) {
+                    colorWeight = alphaWeight = weightTable(info.indexBits)[primary[i]];
+                }
+                else if (indexSelection) {
+                    colorWeight = weightTable(info.secondaryIndexBits)[secondary[i]];
+                    alphaWeight = weightTable(info.indexBits)[primary[i]];
+                }
+                else {
+                    colorWeight = weightTable(info.indexBits)[primary[i]];
+                    alphaWeight = weightTable(info.secondaryIndexBits)[secondary[i]];
+                }
+
+                uint8_t pixel[4];
+
+                for (uint32_t channel = 0; channel < 3; channel++) {
+                    pixel[channel] = static_cast<uint8_t>(interpolate(endpoint0[channel], endpoint1[channel], colorWeight));
+                }
+
+                pixel[3] = static_cast<uint8_t>(interpolate(endpoint0[3], endpoint1[3], alphaWeight));
+
+                if (rotation > 0) {
+                    std::swap(pixel[3], pixel[rotation - 1]);
+                }
+
+                memcpy(block + i * 4, pixel, 4);
+            }
+        }
+    }
+
+    DXGI_FORMAT dxgiFormat(Format format, bool sRGB) {
+        switch (format) {
+        case Format::BC1:
+            return sRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+        case Format::BC3:
+            return sRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+        case Format::BC4:
+            return DXGI_FORMAT_BC4_UNORM;
+        case Format::BC5:
+            return DXGI_FORMAT_BC5_UNORM;
+        case Format::BC7:
+            return sRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+        }
+
+        return DXGI_FORMAT_UNKNOWN;
+    }
+
+    uint32_t bytesPerBlock(Format format) {
+        return format == Format::BC1 || format == Format::BC4 ? 8 : 16;
+    }
+
+    size_t rowPitch(Format format, uint32_t width) {
+        return static_cast<size_t>((width + 3) / 4) * bytesPerBlock(format);
+    }
+
+    uint32_t blockRows(uint32_t height) {
+        return (height + 3) / 4;
+    }
+
+    void compressBlock(Format format, const uint8_t* block, uint8_t* output, const Options& options, Stats* stats) {
+        switch (format) {
+        case Format::BC1: {
+            BlockPixels pixels;
+            loadBlockPixels(block, pixels);
+
+            float mask[16];
+            bool transparent = false;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                mask[i] = (options.bc1PunchThroughAlpha && block[i * 4 + 3] < 128) ? 0.0f : 1.0f;
+                transparent = transparent || mask[i] == 0.0f;
+            }
+
+            compressColorBlock(pixels, mask, transparent, output);
+            break;
+        }
+        case Format::BC3: {
+            uint8_t alpha[16];
+            extractChannel(block, 3, alpha);
+            compressChannelBlock(alpha, output);
+
+            BlockPixels pixels;
+            loadBlockPixels(block, pixels);
+
+            const float mask[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+            compressColorBlock(pixels, mask, false, output + 8);
+            break;
+        }
+        case Format::BC4: {
+            uint8_t values[16];
+            extractChannel(block, 0, values);
+            compressChannelBlock(values, output);
+            break;
+        }
+        case Format::BC5: {
+            uint8_t values[16];
+            extractChannel(block, 0, values);
+            compressChannelBlock(values, output);
+            extractChannel(block, 1, values);
+            compressChannelBlock(values, output + 8);
+            break;
+        }
+        case Format::BC7:
+            compressBC7Block(block, output, options, stats);
+            break;
+        }
+    }
+
+    void decompressBlock(Format format, const uint8_t* input, uint8_t* block) {
+        switch (format) {
+        case Format::BC1:
+            decompressColorBlock(input, false, block);
+            break;
+        case Format::BC3:
+            // BC3的颜色块总是4色模式
+            decompressColorBlock(input + 8, true, block);
+            decompressChannelBlock(input, block, 3);
+            break;
+        case Format::BC4:
+        case Format::BC5:
+            for (uint32_t i = 0; i < 16; i++) {
+                block[i * 4 + 0] = 0;
+                block[i * 4 + 1] = 0;
+                block[i * 4 + 2] = 0;
+                block[i * 4 + 3] = 255;
+            }
+
+            decompressChannelBlock(input, block, 0);
+
+            if (format == Format::BC5) {
+                decompressChannelBlock(input + 8, block, 1);
+            }
+            break;
+        case Format::BC7:
+            decompressBC7Block(input, block);
+            break;
+        }
+    }
+
+    bool compress(const uint8_t* src, size_t srcRowPitch, uint32_t width, uint32_t height,
+                  Format format, uint8_t* dest, size_t destRowPitch, const Options& options, Stats* stats) {
+        if (src == nullptr || dest == nullptr || width == 0 || height == 0) {
+            return false;
+        }
+
+        if (srcRowPitch == 0) {
+            srcRowPitch = static_cast<size_t>(width) * 4;
+        }
+
+        if (destRowPitch == 0) {
+            destRowPitch = rowPitch(format, width);
+        }
+
+        uint32_t blocksWide = (width + 3) / 4;
+        uint32_t blocksHigh = blockRows(height);
+        uint32_t blockBytes = bytesPerBlock(format);
+
+        uint32_t workers = Parallel::workerCount(blocksHigh, std::max<size_t>(1, minBlocksPerWorker / blocksWide));
+
+        // 每个线程单独统计，最后按顺序合并
+        std::vector<Stats> workerStats(workers);
+
+        Parallel::forEachRange(blocksHigh, workers, [&](size_t begin, size_t end, uint32_t workerIndex) {
+            uint8_t block[64];
+
+            for (size_t blockY = begin; blockY < end; blockY++) {
+                uint8_t* output = dest + destRowPitch * blockY;
+
+                for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+                    loadBlock(src, srcRowPitch, width, height, blockX, static_cast<uint32_t>(blockY), block);
+                    compressBlock(format, block, output + static_cast<size_t>(blockX) * blockBytes, options, &workerStats[workerIndex]);
+                }
+            }
+        });
+
+        if (stats != nullptr) {
+            for (const Stats& worker : workerStats) {
+                for (uint32_t mode = 0; mode < 8; mode++) {
+                    stats->bc7ModeBlocks[mode] += worker.bc7ModeBlocks[mode];
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool decompress(const uint8_t* src, size_t srcRowPitch, Format format, uint32_t width, uint32_t height,
+                    uint8_t* dest, size_t destRowPitch) {
+        if (src == nullptr || dest == nullptr || width == 0 || height == 0) {
+            return false;
+        }
+
+        if (srcRowPitch == 0) {
+            srcRowPitch = rowPitch(format, width);
+        }
+
+        if (destRowPitch == 0) {
+            destRowPitch = static_cast<size_t>(width) * 4;
+        }
+
+        uint32_t blocksWide = (width + 3) / 4;
+        uint32_t blocksHigh = blockRows(height);
+        uint32_t blockBytes = bytesPerBlock(format);
+
+        uint32_t workers = Parallel::workerCount(blocksHigh, std::max<size_t>(1, minBlocksPerWorker / blocksWide));
+
+        Parallel::forEachRange(blocksHigh, workers, [&](size_t begin, size_t end, uint32_t) {
+            uint8_t block[64];
+
+            for (size_t blockY = begin; blockY < end; blockY++) {
+                const uint8_t* input = src + srcRowPitch * blockY;
+
+                for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+                    decompressBlock(format, input + static_cast<size_t>(blockX) * blockBytes, block);
+                    storeBlock(block, dest, destRowPitch, width, height, blockX, static_cast<uint32_t>(blockY));
+                }
+            }
+        });
+
+        return true;
+    }
+
+    double psnr(Format format, const uint8_t* a, size_t aRowPitch, const uint8_t* b, size_t bRowPitch,
+                uint32_t width, uint32_t height, const Options& options) {
+        uint32_t firstChannel = 0;
+        uint32_t lastChannel = 4;
+
+        if (format == Format::BC1 && !options.bc1PunchThroughAlpha) {
+            lastChannel = 3;
+        }
+        else if (format == Format::BC4) {
+            lastChannel = 1;
+        }
+        else if (format == Format::BC5) {
+            lastChannel = 2;
+        }
+
+        if (aRowPitch == 0) {
+            aRowPitch = static_cast<size_t>(width) * 4;
+        }
+
+        if (bRowPitch == 0) {
+            bRowPitch = static_cast<size_t>(width) * 4;
+        }
+
+        double sum = 0.0;
+
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* rowA = a + aRowPitch * y;
+            const uint8_t* rowB = b + bRowPitch * y;
+
+            for (uint32_t x = 0; x < width; x++) {
+                for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+                    double delta = static_cast<double>(rowA[x * 4 + channel]) - rowB[x * 4 + channel];
+                    sum += delta * delta;
+                }
+            }
+        }
+
+        double meanSquaredError = sum / (static_cast<double>(width) * height * (lastChannel - firstChannel));
+
+        if (meanSquaredError <= 0.0) {
+            return 99.0;
+        }
+
+        return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+    }
+}
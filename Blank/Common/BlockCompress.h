@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <dxgiformat.h>
+
+// 块压缩编码器：把R8G8B8A8像素编码为BC1/BC3/BC4/BC5/BC7
+//
+// 每4 x 4个像素编码为一个块，BC1和BC4每块8字节，其他每块16字节，相比R8G8B8A8节省4 ~ 8倍的显存和带宽。
+//   BC1  RGB(可选1位Alpha)，主轴上取端点(range fit)再用最小二乘修正一次
+//   BC3  BC1的颜色 + BC4的Alpha
+//   BC4  单通道，用于高度图、遮罩等
+//   BC5  两个BC4通道，用于法线贴图(保存XY，Z在着色器中重建)
+//   BC7  RGBA，按Options::bc7Quality搜索模式、分区和端点
+// 编码结果的布局与DDSTextureLoader加载的DXGI_FORMAT_BC*格式相同，可以直接按GetCopyableFootprints的布局上传。
+//
+// 整张图片按块的行分给多个线程，块内的索引查找一次计算4个像素(SSE2)。
+namespace BlockCompress {
+    enum class Format {
+        BC1,
+        BC3,
+        BC4,
+        BC5,
+        BC7
+    };
+
+    struct Options {
+        // BC7模式搜索的质量，0 ~ 3。括号中是单线程的大致速度(照片类纹理，越平坦越快)
+        //   0  只尝试模式6和按主轴分组选出的一个分区的模式1(不透明)或模式5(带Alpha)，
+        //      模式6的误差足够小时不再尝试其他模式(2 ~ 5 MPix/s)
+        //   1  不透明的块尝试模式6、1、3，带Alpha的块尝试模式6、7、4、5，两子集模式尝试估计误差最小的4个分区，
+        //      同样在误差足够小时停止(1 ~ 2 MPix/s，适合加载时压缩)
+        //   2  所有模式，更多分区和模式4/5的所有通道旋转，端点多修正一次(约0.1 MPix/s)
+        //   3  尝试所有分区，端点在量化后再逐个通道微调(约0.02 MPix/s，只适合离线预处理)
+        uint32_t bc7Quality = 1;
+        // BC1中Alpha小于128的像素使用3色模式的透明索引，否则Alpha被忽略
+        bool bc1PunchThroughAlpha = false;
+    };
+
+    struct Stats {
+        // 选中每种BC7模式的块数
+        uint64_t bc7ModeBlocks[8] = {};
+    };
+
+    // BC4和BC5没有sRGB格式，sRGB被忽略
+    DXGI_FORMAT dxgiFormat(Format format, bool sRGB);
+
+    uint32_t bytesPerBlock(Format format);
+
+    // 一行块(4行像素)的字节数
+    size_t rowPitch(Format format, uint32_t width);
+
+    uint32_t blockRows(uint32_t height);
+
+    // block为按行排列的16个R8G8B8A8像素，output为一个块(8或16字节)
+    void compressBlock(Format format, const uint8_t* block, uint8_t* output, const Options& options = Options(), Stats* stats = nullptr);
+
+    // 解码一个块为16个R8G8B8A8像素，与硬件的结果相同(插值的舍入可能有1的差别)。
+    // BC4解码为(R, 0, 0, 255)，BC5解码为(R, G, 0, 255)
+    void decompressBlock(Format format, const uint8_t* input, uint8_t* block);
+
+    // src为R8G8B8A8像素，srcRowPitch为0时表示行之间紧密排列；
+    // dest的每一行是一行块，destRowPitch为0时表示紧密排列，通常就是上传堆中的RowPitch。
+    // 宽高不是4的倍数时，边缘的块用最后一行/列的像素补齐
+    bool compress(const uint8_t* src, size_t srcRowPitch, uint32_t width, uint32_t height,
+                  Format format, uint8_t* dest, size_t destRowPitch, const Options& options = Options(), Stats* stats = nullptr);
+
+    bool decompress(const uint8_t* src, size_t srcRowPitch, Format format, uint32_t width, uint32_t height,
+                    uint8_t* dest, size_t destRowPitch);
+
+    // 两张R8G8B8A8图片的峰值信噪比(dB)，只比较format保存的通道：
+    // BC1为RGB(bc1PunchThroughAlpha时为RGBA)，BC4为R，BC5为RG，其他为RGBA。完全相同时返回99
+    double psnr(Format format, const uint8_t* a, size_t aRowPitch, const uint8_t* b, size_t bRowPitch,
+                uint32_t width, uint32_t height, const Options& options = Options());
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 派生数据缓存
+//
+// 解码、格式转换、网格处理这类结果只取决于源数据和处理参数，用源文件内容的哈希
+// 加上处理参数作为键，把处理好的、可以直接上传的数据保存在本地缓存目录中，热启动时
+// 直接读取，跳过整个解码过程。源文件内容或者处理参数任何一个变化，键都会变化。
+//
+// 每个条目一个文件，文件的修改时间就是最近使用时间(命中时会更新)。
+// 写入新条目后按最近最少使用的顺序删除旧条目，直到总大小不超过上限。
+// 所有接口都可以在多个工作线程中同时调用。
+class DerivedDataCache {
+public:
+    explicit DerivedDataCache(const std::string& directory, uint64_t maxSize = 512ull << 20);
+
+    static uint64_t makeKey(const void* sourceData, size_t sourceSize, const std::string& parameters);
+
+    // 源文件无法打开时返回false
+    static bool makeFileKey(const std::string& sourceFileName, const std::string& parameters, uint64_t& key);
+
+    // 条目不存在或者已损坏时返回false
+    bool get(uint64_t key, std::vector<uint8_t>& payload) const;
+    bool put(uint64_t key, const void* payload, size_t size);
+
+    // 按最近最少使用的顺序删除条目，直到总大小不超过maxSize
+    void trim();
+
+    const std::string& getDirectory() const { return directory; }
+    uint64_t getMaxSize() const { return maxSize; }
+
+private:
+    std::string entryFileName(uint64_t key) const;
+
+    std::string directory;
+    uint64_t maxSize;
+};
@@ -0,0 +1,101 @@
+#include "Hash.h"
+
+#include <cstring>
+
+namespace Hash {
+    namespace {
+        const uint64_t prime1 = 0x9E3779B185EBCA87ull;
+        const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+        const uint64_t prime3 = 0x165667B19E3779F9ull;
+        const uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+        const uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+        uint64_t rotateLeft(uint64_t value, int bits) {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        uint64_t read64(const uint8_t* p) {
+            uint64_t value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint32_t read32(const uint8_t* p) {
+            uint32_t value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint64_t round(uint64_t accumulator, uint64_t input) {
+            accumulator += input * prime2;
+            accumulator = rotateLeft(accumulator, 31);
+            return accumulator * prime1;
+        }
+
+        uint64_t mergeRound(uint64_t accumulator, uint64_t value) {
+            accumulator ^= round(0, value);
+            return accumulator * prime1 + prime4;
+        }
+    }
+
+    uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+        const uint8_t* end = p + size;
+
+        uint64_t hash;
+
+        if (size >= 32) {
+            // 4路并行累加，每次处理32字节
+            uint64_t v1 = seed + prime1 + prime2;
+            uint64_t v2 = seed + prime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - prime1;
+
+            const uint8_t* limit = end - 32;
+
+            do {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+
+            hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+            hash = mergeRound(hash, v1);
+            hash = mergeRound(hash, v2);
+            hash = mergeRound(hash, v3);
+            hash = mergeRound(hash, v4);
+        }
+        else {
+            hash = seed + prime5;
+        }
+
+        hash += static_cast<uint64_t>(size);
+
+        for (; p + 8 <= end; p += 8) {
+            hash ^= round(0, read64(p));
+            hash = rotateLeft(hash, 27) * prime1 + prime4;
+        }
+
+        if (p + 4 <= end) {
+            hash ^= static_cast<uint64_t>(read32(p)) * prime1;
+            hash = rotateLeft(hash, 23) * prime2 + prime3;
+            p += 4;
+        }
+
+        for (; p < end; p++) {
+            hash ^= (*p) * prime5;
+            hash = rotateLeft(hash, 11) * prime1;
+        }
+
+        // 雪崩
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+
+        return hash;
+    }
+}
@@ -0,0 +1,412 @@
+#include "MipGenerator.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2 1
+#endif
+
+namespace MipGenerator {
+    namespace {
+        // 每个线程至少处理的像素数
+        const size_t minPixelsPerWorker = 1 << 15;
+
+        const float pi = 3.14159265358979f;
+
+        // 滤波核的半径，单位是目标像素
+        const float windowRadius = 3.0f;
+        const float kaiserAlpha = 4.0f;
+
+        struct Pixel {
+            float rgba[4];
+        };
+
+        // 一个轴上每个目标像素的权重：从start开始的count个源像素，权重按maxCount的步长紧密排列
+        struct Contributors {
+            std::vector<uint32_t> start;
+            std::vector<uint32_t> count;
+            std::vector<float> weights;
+            uint32_t maxCount = 0;
+        };
+
+        float sinc(float x) {
+            if (std::fabs(x) < 1e-6f) {
+                return 1.0f;
+            }
+
+            return std::sin(pi * x) / (pi * x);
+        }
+
+        // 第一类零阶修正贝塞尔函数
+        float bessel0(float x) {
+            float sum = 1.0f;
+            float term = 1.0f;
+            float halfX = x * 0.5f;
+
+            for (int32_t k = 1; k < 32; k++) {
+                term *= (halfX / static_cast<float>(k)) * (halfX / static_cast<float>(k));
+                sum += term;
+
+                if (term < sum * 1e-8f) {
+                    break;
+                }
+            }
+
+            return sum;
+        }
+
+        float windowedWeight(Filter filter, float t) {
+            if (std::fabs(t) >= windowRadius) {
+                return 0.0f;
+            }
+
+            if (filter == Filter::Lanczos) {
+                return sinc(t) * sinc(t / windowRadius);
+            }
+
+            float ratio = t / windowRadius;
+
+            return sinc(t) * bessel0(kaiserAlpha * std::sqrt(1.0f - ratio * ratio)) / bessel0(kaiserAlpha);
+        }
+
+        Contributors buildContributors(Filter filter, uint32_t srcSize, uint32_t dstSize) {
+            Contributors contributors;
+            contributors.start.resize(dstSize);
+            contributors.count.resize(dstSize);
+
+            double scale = static_cast<double>(srcSize) / static_cast<double>(dstSize);
+
+            std::vector<std::vector<float>> rows(dstSize);
+
+            for (uint32_t i = 0; i < dstSize; i++) {
+                double begin = i * scale;
+                double end = (i + 1) * scale;
+
+                int32_t first = 0;
+                int32_t last = 0;
+                std::vector<float>& weights = rows[i];
+
+                if (filter == Filter::Box) {
+                    // 每个源像素的权重就是它落在目标像素范围内的长度
+                    first = static_cast<int32_t>(std::floor(begin));
+                    last = std::min(static_cast<int32_t>(std::ceil(end)) - 1, static_cast<int32_t>(srcSize) - 1);
+
+                    for (int32_t j = first; j <= last; j++) {
+                        weights.push_back(static_cast<float>(std::min<double>(j + 1, end) - std::max<double>(j, begin)));
+                    }
+                }
+                else {
+                    double center = (begin + end) * 0.5;
+                    double support = windowRadius * scale;
+
+                    first = static_cast<int32_t>(std::floor(center - support));
+                    last = static_cast<int32_t>(std::ceil(center + support));
+
+                    // 超出边界的源像素按Clamp寻址归到边上的像素
+                    int32_t clampedFirst = std::max(first, 0);
+                    int32_t clampedLast = std::min(last, static_cast<int32_t>(srcSize) - 1);
+
+                    weights.assign(clampedLast - clampedFirst + 1, 0.0f);
+
+                    for (int32_t j = first; j <= last; j++) {
+                        float t = static_cast<float>((j + 0.5 - center) / scale);
+                        int32_t index = std::min(std::max(j, clampedFirst), clampedLast) - clampedFirst;
+
+                        weights[index] += windowedWeight(filter, t);
+                    }
+
+                    first = clampedFirst;
+                }
+
+                float sum = 0.0f;
+
+                for (float weight : weights) {
+                    sum += weight;
+                }
+
+                for (float& weight : weights) {
+                    weight /= sum;
+                }
+
+                contributors.start[i] = static_cast<uint32_t>(first);
+                contributors.count[i] = static_cast<uint32_t>(weights.size());
+                contributors.maxCount = std::max(contributors.maxCount, contributors.count[i]);
+            }
+
+            contributors.weights.assign(static_cast<size_t>(dstSize) * contributors.maxCount, 0.0f);
+
+            for (uint32_t i = 0; i < dstSize; i++) {
+                std::copy(rows[i].begin(), rows[i].end(), contributors.weights.begin() + static_cast<size_t>(i) * contributors.maxCount);
+            }
+
+            return contributors;
+        }
+
+        const uint32_t encodeBuckets = 4096;
+
+        // sRGB的解码表和编码用的阈值：线性值落在[thresholds[v - 1], thresholds[v])之间时编码为v。
+        // 编码时先按线性值查bucketStart得到所在区间开头的编码，再向后比较阈值，
+        // 每个区间内sRGB编码最多变化一次左右，结果与直接二分查找阈值相同
+        struct ColorTables {
+            float sRGBToLinear[256];
+            float linearToSRGBThresholds[255];
+            uint8_t bucketStart[encodeBuckets];
+            float unormToFloat[256];
+
+            ColorTables() {
+                for (uint32_t value = 0; value < 256; value++) {
+                    sRGBToLinear[value] = decodeSRGB(value / 255.0f);
+                    unormToFloat[value] = value / 255.0f;
+                }
+
+                for (uint32_t value = 0; value < 255; value++) {
+                    linearToSRGBThresholds[value] = decodeSRGB((value + 0.5f) / 255.0f);
+                }
+
+                for (uint32_t bucket = 0; bucket < encodeBuckets; bucket++) {
+                    float linear = static_cast<float>(bucket) / static_cast<float>(encodeBuckets);
+
+                    bucketStart[bucket] = static_cast<uint8_t>(
+                        std::upper_bound(linearToSRGBThresholds, linearToSRGBThresholds + 255, linear) - linearToSRGBThresholds);
+                }
+            }
+
+            static float decodeSRGB(float value) {
+                return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            }
+        };
+
+        const ColorTables& colorTables() {
+            static const ColorTables tables;
+            return tables;
+        }
+
+        uint8_t encodeSRGB(const ColorTables& tables, float linear) {
+            linear = std::min(std::max(linear, 0.0f), 1.0f);
+
+            uint32_t bucket = std::min(static_cast<uint32_t>(linear * encodeBuckets), encodeBuckets - 1);
+            uint32_t value = tables.bucketStart[bucket];
+
+            while (value < 255 && linear >= tables.linearToSRGBThresholds[value]) {
+                value++;
+            }
+
+            return static_cast<uint8_t>(value);
+        }
+
+        uint8_t encodeUNORM(float value) {
+            return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+
+        // 一行的一个像素：sum(weights[k] * pixels[k * stride])
+        void accumulate(const Pixel* pixels, size_t stride, const float* weights, uint32_t count, Pixel& result) {
+#if defined(MIP_GENERATOR_SSE2)
+            __m128 sum = _mm_setzero_ps();
+
+            for (uint32_t k = 0; k < count; k++) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(pixels[k * stride].rgba)));
+            }
+
+            _mm_storeu_ps(result.rgba, sum);
+#else
+            float sum[4] = {};
+
+            for (uint32_t k = 0; k < count; k++) {
+                for (uint32_t channel = 0; channel < 4; channel++) {
+                    sum[channel] += weights[k] * pixels[k * stride].rgba[channel];
+                }
+            }
+
+            memcpy(result.rgba, sum, sizeof(sum));
+#endif
+        }
+
+        void downsample(const std::vector<Pixel>& src, uint32_t srcWidth, uint32_t srcHeight,
+                        std::vector<Pixel>& dst, uint32_t dstWidth, uint32_t dstHeight,
+                        Filter filter, std::vector<Pixel>& temp) {
+            Contributors horizontal = buildContributors(filter, srcWidth, dstWidth);
+            Contributors vertical = buildContributors(filter, srcHeight, dstHeight);
+
+            temp.resize(static_cast<size_t>(dstWidth) * srcHeight);
+            dst.resize(static_cast<size_t>(dstWidth) * dstHeight);
+
+            // 水平方向：srcWidth x srcHeight -> dstWidth x srcHeight
+            uint32_t workers = Parallel::workerCount(srcHeight, std::max<size_t>(1, minPixelsPerWorker / srcWidth));
+
+            Parallel::forEachRange(srcHeight, workers, [&](size_t begin, size_t end, uint32_t) {
+                for (size_t y = begin; y < end; y++) {
+                    const Pixel* srcRow = src.data() + y * srcWidth;
+                    Pixel* tempRow = temp.data() + y * dstWidth;
+
+                    for (uint32_t x = 0; x < dstWidth; x++) {
+                        accumulate(srcRow + horizontal.start[x], 1,
+                                   horizontal.weights.data() + static_cast<size_t>(x) * horizontal.maxCount, horizontal.count[x], tempRow[x]);
+                    }
+                }
+            });
+
+            // 垂直方向：dstWidth x srcHeight -> dstWidth x dstHeight
+            workers = Parallel::workerCount(dstHeight, std::max<size_t>(1, minPixelsPerWorker / dstWidth));
+
+            Parallel::forEachRange(dstHeight, workers, [&](size_t begin, size_t end, uint32_t) {
+                for (size_t y = begin; y < end; y++) {
+                    const Pixel* tempColumn = temp.data() + static_cast<size_t>(vertical.start[y]) * dstWidth;
+                    const float* weights = vertical.weights.data() + y * vertical.maxCount;
+                    Pixel* dstRow = dst.data() + y * dstWidth;
+
+                    for (uint32_t x = 0; x < dstWidth; x++) {
+                        accumulate(tempColumn + x, dstWidth, weights, vertical.count[y], dstRow[x]);
+                    }
+                }
+            });
+        }
+
+        // Alpha乘以scale之后大于reference的像素比例
+        float alphaCoverage(const std::vector<Pixel>& pixels, float reference, float scale) {
+            size_t covered = 0;
+
+            for (const auto& pixel : pixels) {
+                covered += pixel.rgba[3] * scale > reference ? 1 : 0;
+            }
+
+            return static_cast<float>(covered) / static_cast<float>(std::max<size_t>(pixels.size(), 1));
+        }
+
+        // 二分查找使覆盖率最接近target的缩放系数
+        float findAlphaScale(const std::vector<Pixel>& pixels, float reference, float target) {
+            float low = 0.0f;
+            float high = 4.0f;
+            float best = 1.0f;
+            float bestError = std::fabs(alphaCoverage(pixels, reference, 1.0f) - target);
+
+            for (uint32_t iteration = 0; iteration < 16; iteration++) {
+                float scale = (low + high) * 0.5f;
+                float coverage = alphaCoverage(pixels, reference, scale);
+                float error = std::fabs(coverage - target);
+
+                if (error < bestError) {
+                    best = scale;
+                    bestError = error;
+                }
+
+                if (coverage < target) {
+                    low = scale;
+                }
+                else {
+                    high = scale;
+                }
+            }
+
+            return best;
+        }
+
+        void encodeLevel(const std::vector<Pixel>& pixels, uint32_t width, uint32_t height, const Level& level, bool sRGB, float alphaScale) {
+            const ColorTables& tables = colorTables();
+            uint32_t workers = Parallel::workerCount(height, std::max<size_t>(1, minPixelsPerWorker / width));
+
+            Parallel::forEachRange(height, workers, [&](size_t begin, size_t end, uint32_t) {
+                for (size_t y = begin; y < end; y++) {
+                    const Pixel* row = pixels.data() + y * width;
+                    uint8_t* out = level.data + level.rowPitch * y;
+
+                    for (uint32_t x = 0; x < width; x++) {
+                        for (uint32_t channel = 0; channel < 3; channel++) {
+                            out[x * 4 + channel] = sRGB ? encodeSRGB(tables, row[x].rgba[channel]) : encodeUNORM(row[x].rgba[channel]);
+                        }
+
+                        out[x * 4 + 3] = encodeUNORM(row[x].rgba[3] * alphaScale);
+                    }
+                }
+            });
+        }
+    }
+
+    uint32_t mipCount(uint32_t width, uint32_t height) {
+        uint32_t count = 1;
+
+        while (width > 1 || height > 1) {
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+            count++;
+        }
+
+        return count;
+    }
+
+    uint32_t mipSize(uint32_t size, uint32_t mip) {
+        return std::max(size >> mip, 1u);
+    }
+
+    bool generate(const uint8_t* src, size_t srcRowPitch, uint32_t width, uint32_t height,
+                  const Level* levels, uint32_t levelCount, const Options& options) {
+        if (width == 0 || height == 0 || levelCount == 0 || levelCount > mipCount(width, height)) {
+            return false;
+        }
+
+        if (srcRowPitch == 0) {
+            srcRowPitch = static_cast<size_t>(width) * 4;
+        }
+
+        for (uint32_t y = 0; y < height; y++) {
+            memcpy(levels[0].data + levels[0].rowPitch * y, src + srcRowPitch * y, static_cast<size_t>(width) * 4);
+        }
+
+        if (levelCount == 1) {
+            return true;
+        }
+
+        // 第0级转换为线性的浮点
+        const ColorTables& tables = colorTables();
+        const float* colorTable = options.sRGB ? tables.sRGBToLinear : tables.unormToFloat;
+
+        std::vector<Pixel> current(static_cast<size_t>(width) * height);
+
+        uint32_t workers = Parallel::workerCount(height, std::max<size_t>(1, minPixelsPerWorker / width));
+
+        Parallel::forEachRange(height, workers, [&](size_t begin, size_t end, uint32_t) {
+            for (size_t y = begin; y < end; y++) {
+                const uint8_t* row = src + srcRowPitch * y;
+
+                for (uint32_t x = 0; x < width; x++) {
+                    Pixel& pixel = current[y * width + x];
+
+                    pixel.rgba[0] = colorTable[row[x * 4 + 0]];
+                    pixel.rgba[1] = colorTable[row[x * 4 + 1]];
+                    pixel.rgba[2] = colorTable[row[x * 4 + 2]];
+                    pixel.rgba[3] = tables.unormToFloat[row[x * 4 + 3]];
+                }
+            }
+        });
+
+        float targetCoverage = options.preserveAlphaCoverage ? alphaCoverage(current, options.alphaReference, 1.0f) : 0.0f;
+
+        std::vector<Pixel> next;
+        std::vector<Pixel> temp;
+
+        uint32_t levelWidth = width;
+        uint32_t levelHeight = height;
+
+        for (uint32_t mip = 1; mip < levelCount; mip++) {
+            uint32_t nextWidth = mipSize(width, mip);
+            uint32_t nextHeight = mipSize(height, mip);
+
+            downsample(current, levelWidth, levelHeight, next, nextWidth, nextHeight, options.filter, temp);
+
+            // 缩放只作用于输出，下一级仍然从没有缩放的结果计算
+            float alphaScale = options.preserveAlphaCoverage ? findAlphaScale(next, options.alphaReference, targetCoverage) : 1.0f;
+
+            encodeLevel(next, nextWidth, nextHeight, levels[mip], options.sRGB, alphaScale);
+
+            current.swap(next);
+            levelWidth = nextWidth;
+            levelHeight = nextHeight;
+        }
+
+        return true;
+    }
+}
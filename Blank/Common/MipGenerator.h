@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 在CPU上生成R8G8B8A8纹理的完整mip链
+//
+// 每一级由上一级缩小一半(向下取整，最小为1)得到，宽高可以是任意值(非2的幂时奇数边按面积或滤波核的权重处理)。
+// 滤波在浮点线性空间中进行：sRGB时RGB先查表线性化，结果再编码回sRGB，Alpha始终是线性的。
+// 水平和垂直两遍分离滤波，一个像素的四个通道用一个SSE寄存器计算，每一遍按行分给多个线程。
+//
+// 结果直接写进调用者给出的每一级的地址和行大小，通常就是Map之后的上传堆加上GetCopyableFootprints给出的Offset和RowPitch。
+namespace MipGenerator {
+    enum class Filter {
+        Box,        // 按面积平均，偶数边时就是2 x 2平均
+        Kaiser,     // Kaiser窗的sinc，半径3，alpha = 4
+        Lanczos     // Lanczos3
+    };
+
+    struct Options {
+        Filter filter = Filter::Kaiser;
+        // RGB是sRGB编码的(一般的图片都是)，在线性空间中平均，避免缩小后变暗
+        bool sRGB = true;
+        // 缩放每一级的Alpha，使Alpha大于alphaReference的像素比例与第0级相同，
+        // 避免用Alpha测试的树叶、头发等在远处变得稀疏
+        bool preserveAlphaCoverage = false;
+        float alphaReference = 0.5f;
+    };
+
+    struct Level {
+        uint8_t* data = nullptr;
+        size_t rowPitch = 0;
+    };
+
+    // 完整mip链的级数，包括第0级
+    uint32_t mipCount(uint32_t width, uint32_t height);
+
+    uint32_t mipSize(uint32_t size, uint32_t mip);
+
+    // src为第0级的R8G8B8A8像素，srcRowPitch为0时表示行之间紧密排列。
+    // levels[0]也会被写入(复制src)，levelCount不能超过mipCount()
+    bool generate(const uint8_t* src, size_t srcRowPitch, uint32_t width, uint32_t height,
+                  const Level* levels, uint32_t levelCount, const Options& options = Options());
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// 加载阶段使用的简单并行工具：把[0, count)切成连续的区间分给若干线程
+// 区间的划分只取决于count和线程数，所以按workerIndex顺序合并结果就是确定性的
+namespace Parallel {
+    inline uint32_t workerCount(size_t count, size_t minItemsPerWorker) {
+        uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        size_t maxWorkers = std::max<size_t>(1, count / std::max<size_t>(1, minItemsPerWorker));
+
+        return static_cast<uint32_t>(std::min<size_t>(hardwareThreads, maxWorkers));
+    }
+
+    // function(begin, end, workerIndex)，workerIndex < workers
+    template<typename Function>
+    void forEachRange(size_t count, uint32_t workers, Function&& function) {
+        if (workers <= 1 || count == 0) {
+            function(size_t(0), count, 0u);
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+
+        size_t step = (count + workers - 1) / workers;
+
+        for (uint32_t worker = 1; worker < workers; worker++) {
+            size_t begin = std::min(count, worker * step);
+            size_t end = std::min(count, begin + step);
+
+            threads.emplace_back([&function, begin, end, worker]() {
+                function(begin, end, worker);
+            });
+        }
+
+        // 调用线程自己处理第一段
+        function(size_t(0), std::min(count, step), 0u);
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+}
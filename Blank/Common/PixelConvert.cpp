@@ -0,0 +1,520 @@
+#include "PixelConvert.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <immintrin.h>
+#define PIXEL_CONVERT_SSE2 1
+
+// SSSE3/AVX2只在运行时检测到支持时才会调用，
+// GCC/Clang需要给使用这些指令的函数单独指定target，MSVC可以直接使用
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PIXEL_CONVERT_TARGET(isa)
+#else
+#include <cpuid.h>
+#define PIXEL_CONVERT_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace PixelConvert {
+    namespace {
+        // 每个线程至少处理的像素数，太少时线程的创建开销比转换本身还大
+        const size_t minPixelsPerWorker = 1 << 18;
+
+        uint16_t floatToHalf(float value) {
+            uint32_t bits = 0;
+            memcpy(&bits, &value, sizeof(bits));
+
+            uint32_t sign = (bits >> 16) & 0x8000;
+            int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+            uint32_t mantissa = bits & 0x7fffff;
+
+            if (exponent <= 0) {
+                // 非规格化数，这里的输入都在[0, 1]之内，不会出现溢出
+                if (exponent < -10) {
+                    return static_cast<uint16_t>(sign);
+                }
+
+                mantissa |= 0x800000;
+
+                uint32_t shift = static_cast<uint32_t>(14 - exponent);
+                uint32_t halfMantissa = mantissa >> shift;
+                uint32_t remainder = mantissa & ((1u << shift) - 1);
+                uint32_t halfway = 1u << (shift - 1);
+
+                if (remainder > halfway || (remainder == halfway && (halfMantissa & 1) != 0)) {
+                    halfMantissa++;
+                }
+
+                return static_cast<uint16_t>(sign | halfMantissa);
+            }
+
+            // 舍入到最近，正好一半时取偶数，进位会自然地进到指数上
+            uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+            uint32_t remainder = mantissa & 0x1fff;
+
+            if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0)) {
+                half++;
+            }
+
+            return static_cast<uint16_t>(half);
+        }
+
+        // 8位UNORM只有256个取值，half直接查表
+        struct HalfTable {
+            uint16_t values[256];
+
+            HalfTable() {
+                for (uint32_t value = 0; value < 256; value++) {
+                    values[value] = floatToHalf(static_cast<float>(value) / 255.0f);
+                }
+            }
+        };
+
+        const HalfTable& halfTable() {
+            static const HalfTable table;
+            return table;
+        }
+
+        bool isBGR(SourceFormat format) {
+            return format == SourceFormat::BGR24 || format == SourceFormat::BGRA32;
+        }
+
+        // 读取一个像素，按RGBA顺序
+        void readPixel(const uint8_t* src, SourceFormat format, uint8_t rgba[4]) {
+            switch (format) {
+            case SourceFormat::Gray8:
+                rgba[0] = rgba[1] = rgba[2] = src[0];
+                rgba[3] = 255;
+                break;
+            case SourceFormat::GrayAlpha8:
+                rgba[0] = rgba[1] = rgba[2] = src[0];
+                rgba[3] = src[1];
+                break;
+            case SourceFormat::RGB24:
+                rgba[0] = src[0];
+                rgba[1] = src[1];
+                rgba[2] = src[2];
+                rgba[3] = 255;
+                break;
+            case SourceFormat::BGR24:
+                rgba[0] = src[2];
+                rgba[1] = src[1];
+                rgba[2] = src[0];
+                rgba[3] = 255;
+                break;
+            case SourceFormat::RGBA32:
+                memcpy(rgba, src, 4);
+                break;
+            case SourceFormat::BGRA32:
+                rgba[0] = src[2];
+                rgba[1] = src[1];
+                rgba[2] = src[0];
+                rgba[3] = src[3];
+                break;
+            }
+        }
+
+#if defined(PIXEL_CONVERT_SSE2)
+        struct CPUFeatures {
+            bool ssse3 = false;
+            bool avx2 = false;
+        };
+
+        CPUFeatures detectCPUFeatures() {
+            CPUFeatures features;
+
+#if defined(_MSC_VER)
+            int info[4] = {};
+
+            __cpuid(info, 0);
+            int maxLeaf = info[0];
+
+            __cpuid(info, 1);
+            features.ssse3 = (info[2] & (1 << 9)) != 0;
+
+            // AVX2还需要操作系统保存YMM寄存器(OSXSAVE + XCR0)
+            bool osSavesYMM = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+
+            if (maxLeaf >= 7 && osSavesYMM) {
+                __cpuidex(info, 7, 0);
+                features.avx2 = (info[1] & (1 << 5)) != 0;
+            }
+#else
+            __builtin_cpu_init();
+            features.ssse3 = __builtin_cpu_supports("ssse3") != 0;
+            features.avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+
+            return features;
+        }
+
+        const CPUFeatures& cpuFeatures() {
+            static const CPUFeatures features = detectCPUFeatures();
+            return features;
+        }
+
+        // 以下SIMD函数从第x个像素开始处理整块，返回第一个没有处理的像素，剩下的由标量代码处理
+
+        uint32_t grayToRGBA8SSE2(const uint8_t* src, uint8_t* dest, uint32_t x, uint32_t width) {
+            const __m128i alpha = _mm_set1_epi8(-1);
+
+            for (; x + 16 <= width; x += 16) {
+                __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+
+                // (g, g)和(g, 255)两组字节再按16位交错就是(g, g, g, 255)
+                __m128i grayGray0 = _mm_unpacklo_epi8(gray, gray);
+                __m128i grayGray1 = _mm_unpackhi_epi8(gray, gray);
+                __m128i grayAlpha0 = _mm_unpacklo_epi8(gray, alpha);
+                __m128i grayAlpha1 = _mm_unpackhi_epi8(gray, alpha);
+
+                __m128i* out = reinterpret_cast<__m128i*>(dest + static_cast<size_t>(x) * 4);
+
+                _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(grayGray0, grayAlpha0));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(grayGray0, grayAlpha0));
+                _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(grayGray1, grayAlpha1));
+                _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(grayGray1, grayAlpha1));
+            }
+
+            return x;
+        }
+
+        uint32_t grayAlphaToRGBA8SSE2(const uint8_t* src, uint8_t* dest, uint32_t x, uint32_t width) {
+            const __m128i lowByte = _mm_set1_epi16(0xff);
+
+            for (; x + 8 <= width; x += 8) {
+                __m128i grayAlpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + static_cast<size_t>(x) * 2));
+
+                __m128i gray = _mm_and_si128(grayAlpha, lowByte);
+                __m128i grayGray = _mm_or_si128(gray, _mm_slli_epi16(gray, 8));
+
+                __m128i* out = reinterpret_cast<__m128i*>(dest + static_cast<size_t>(x) * 4);
+
+                _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(grayGray, grayAlpha));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(grayGray, grayAlpha));
+            }
+
+            return x;
+        }
+
+        // 交换每个像素的R和B
+        uint32_t swapRBSSE2(const uint8_t* src, uint8_t* dest, uint32_t x, uint32_t width) {
+            const __m128i alphaGreen = _mm_set1_epi32(static_cast<int32_t>(0xff00ff00));
+            const __m128i redBlue = _mm_set1_epi32(0x00ff00ff);
+
+            for (; x + 4 <= width; x += 4) {
+                __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + static_cast<size_t>(x) * 4));
+
+                __m128i swapped = _mm_and_si128(pixels, redBlue);
+                swapped = _mm_shufflelo_epi16(swapped, _MM_SHUFFLE(2, 3, 0, 1));
+                swapped = _mm_shufflehi_epi16(swapped, _MM_SHUFFLE(2, 3, 0, 1));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + static_cast<size_t>(x) * 4),
+                                 _mm_or_si128(swapped, _mm_and_si128(pixels, alphaGreen)));
+            }
+
+            return x;
+        }
+
+        // 每次读16个字节，只用前12个字节(4个像素)，所以要保证读取不越过这一行的末尾
+        PIXEL_CONVERT_TARGET("ssse3")
+        uint32_t rgbToRGBA8SSSE3(const uint8_t* src, uint8_t* dest, uint32_t x, uint32_t width, bool swap) {
+            const __m128i alpha = _mm_set1_epi32(static_cast<int32_t>(0xff000000));
+            const __m128i shuffle = swap ?
+                _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1) :
+                _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+            for (; x + 6 <= width; x += 4) {
+                __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + static_cast<size_t>(x) * 3));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + static_cast<size_t>(x) * 4),
+                                 _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+            }
+
+            return x;
+        }
+
+        // 每次读32个字节，用前24个字节(8个像素)：先把第3~6个32位字移到高128位，两半再用相同的shuffle展开
+        PIXEL_CONVERT_TARGET("avx2")
+        uint32_t rgbToRGBA8AVX2(const uint8_t* src, uint8_t* dest, uint32_t x, uint32_t width, bool swap) {
+            const __m256i alpha = _mm256_set1_epi32(static_cast<int32_t>(0xff000000));
+            const __m256i permute = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+            const __m256i shuffle = swap ?
+                _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+                                 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1) :
+                _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+            for (; x + 11 <= width; x += 8) {
+                __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + static_cast<size_t>(x) * 3));
+
+                pixels = _mm256_permutevar8x32_epi32(pixels, permute);
+
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + static_cast<size_t>(x) * 4),
+                                    _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+            }
+
+            return x;
+        }
+
+        // 字节与自身交错就是v * 257
+        uint32_t rgba8ToRGBA16SSE2(const uint8_t* src, uint8_t* dest, uint32_t x, uint32_t width) {
+            for (; x + 4 <= width; x += 4) {
+                __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + static_cast<size_t>(x) * 4));
+
+                __m128i* out = reinterpret_cast<__m128i*>(dest + static_cast<size_t>(x) * 8);
+
+                _mm_storeu_si128(out + 0, _mm_unpacklo_epi8(pixels, pixels));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(pixels, pixels));
+            }
+
+            return x;
+        }
+
+        // 用除法而不是乘以1/255，与标量实现的v / 255.0f逐位相同
+        uint32_t rgba8ToRGBA32FSSE2(const uint8_t* src, uint8_t* dest, uint32_t x, uint32_t width) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128 scale = _mm_set1_ps(255.0f);
+
+            for (; x + 4 <= width; x += 4) {
+                __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + static_cast<size_t>(x) * 4));
+
+                __m128i words0 = _mm_unpacklo_epi8(pixels, zero);
+                __m128i words1 = _mm_unpackhi_epi8(pixels, zero);
+
+                float* out = reinterpret_cast<float*>(dest + static_cast<size_t>(x) * 16);
+
+                _mm_storeu_ps(out + 0, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words0, zero)), scale));
+                _mm_storeu_ps(out + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words0, zero)), scale));
+                _mm_storeu_ps(out + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words1, zero)), scale));
+                _mm_storeu_ps(out + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words1, zero)), scale));
+            }
+
+            return x;
+        }
+#endif
+
+        // 转换为R8G8B8A8，swap为true时输出B8G8R8A8
+        void toRGBA8(const uint8_t* src, SourceFormat format, uint8_t* dest, uint32_t width, bool swap) {
+            uint32_t x = 0;
+            uint32_t srcBytesPerPixel = bytesPerPixel(format);
+
+            if ((format == SourceFormat::RGBA32 || format == SourceFormat::BGRA32) && !swap) {
+                memcpy(dest, src, static_cast<size_t>(width) * 4);
+                return;
+            }
+
+#if defined(PIXEL_CONVERT_SSE2)
+            switch (format) {
+            case SourceFormat::Gray8:
+                x = grayToRGBA8SSE2(src, dest, x, width);
+                break;
+            case SourceFormat::GrayAlpha8:
+                x = grayAlphaToRGBA8SSE2(src, dest, x, width);
+                break;
+            case SourceFormat::RGB24:
+            case SourceFormat::BGR24:
+                if (cpuFeatures().avx2) {
+                    x = rgbToRGBA8AVX2(src, dest, x, width, swap);
+                }
+
+                if (cpuFeatures().ssse3) {
+                    x = rgbToRGBA8SSSE3(src, dest, x, width, swap);
+                }
+                break;
+            case SourceFormat::RGBA32:
+            case SourceFormat::BGRA32:
+                x = swapRBSSE2(src, dest, x, width);
+                break;
+            }
+#endif
+
+            for (; x < width; x++) {
+                uint8_t* out = dest + static_cast<size_t>(x) * 4;
+
+                // readPixel已经把BGR源转成了RGBA顺序，swap需要相对于源格式重新判断
+                readPixel(src + static_cast<size_t>(x) * srcBytesPerPixel, format, out);
+
+                if (swap != isBGR(format)) {
+                    std::swap(out[0], out[2]);
+                }
+            }
+        }
+
+        void expandRGBA8(const uint8_t* src, uint8_t* dest, DestFormat format, uint32_t width) {
+            uint32_t x = 0;
+
+            switch (format) {
+            case DestFormat::RGBA8:
+            case DestFormat::BGRA8:
+                memcpy(dest, src, static_cast<size_t>(width) * 4);
+                break;
+            case DestFormat::RGBA16: {
+#if defined(PIXEL_CONVERT_SSE2)
+                x = rgba8ToRGBA16SSE2(src, dest, x, width);
+#endif
+                uint16_t* out = reinterpret_cast<uint16_t*>(dest);
+
+                for (size_t i = static_cast<size_t>(x) * 4; i < static_cast<size_t>(width) * 4; i++) {
+                    out[i] = static_cast<uint16_t>(src[i] * 257);
+                }
+                break;
+            }
+            case DestFormat::RGBA16F: {
+                const uint16_t* table = halfTable().values;
+                uint16_t* out = reinterpret_cast<uint16_t*>(dest);
+
+                for (size_t i = 0; i < static_cast<size_t>(width) * 4; i++) {
+                    out[i] = table[src[i]];
+                }
+                break;
+            }
+            case DestFormat::RGBA32F: {
+#if defined(PIXEL_CONVERT_SSE2)
+                x = rgba8ToRGBA32FSSE2(src, dest, x, width);
+#endif
+                float* out = reinterpret_cast<float*>(dest);
+
+                for (size_t i = static_cast<size_t>(x) * 4; i < static_cast<size_t>(width) * 4; i++) {
+                    out[i] = static_cast<float>(src[i]) / 255.0f;
+                }
+                break;
+            }
+            }
+        }
+    }
+
+    uint32_t bytesPerPixel(SourceFormat format) {
+        switch (format) {
+        case SourceFormat::Gray8:
+            return 1;
+        case SourceFormat::GrayAlpha8:
+            return 2;
+        case SourceFormat::RGB24:
+        case SourceFormat::BGR24:
+            return 3;
+        case SourceFormat::RGBA32:
+        case SourceFormat::BGRA32:
+            return 4;
+        }
+
+        return 0;
+    }
+
+    uint32_t bytesPerPixel(DestFormat format) {
+        switch (format) {
+        case DestFormat::RGBA8:
+        case DestFormat::BGRA8:
+            return 4;
+        case DestFormat::RGBA16:
+        case DestFormat::RGBA16F:
+            return 8;
+        case DestFormat::RGBA32F:
+            return 16;
+        }
+
+        return 0;
+    }
+
+    bool sourceFormatFromChannels(int32_t channels, SourceFormat& format) {
+        switch (channels) {
+        case 1:
+            format = SourceFormat::Gray8;
+            return true;
+        case 2:
+            format = SourceFormat::GrayAlpha8;
+            return true;
+        case 3:
+            format = SourceFormat::RGB24;
+            return true;
+        case 4:
+            format = SourceFormat::RGBA32;
+            return true;
+        }
+
+        return false;
+    }
+
+    size_t alignedRowPitch(uint32_t width, DestFormat format) {
+        // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+        const size_t pitchAlignment = 256;
+        size_t rowBytes = static_cast<size_t>(width) * bytesPerPixel(format);
+
+        return (rowBytes + pitchAlignment - 1) & ~(pitchAlignment - 1);
+    }
+
+    void convertRow(const uint8_t* src, SourceFormat srcFormat, uint8_t* dest, DestFormat destFormat, uint32_t width) {
+        // B8G8R8A8的源和目标之间只需要交换R和B，其他目标格式都先转换为R8G8B8A8
+        bool swap = isBGR(srcFormat) != (destFormat == DestFormat::BGRA8);
+
+        if (destFormat == DestFormat::RGBA8 || destFormat == DestFormat::BGRA8) {
+            toRGBA8(src, srcFormat, dest, width, swap);
+            return;
+        }
+
+        thread_local std::vector<uint8_t> row;
+        row.resize(static_cast<size_t>(width) * 4);
+
+        toRGBA8(src, srcFormat, row.data(), width, swap);
+        expandRGBA8(row.data(), dest, destFormat, width);
+    }
+
+    void convert(const uint8_t* src, size_t srcRowPitch, SourceFormat srcFormat,
+                 uint8_t* dest, size_t destRowPitch, DestFormat destFormat,
+                 uint32_t width, uint32_t height) {
+        if (srcRowPitch == 0) {
+            srcRowPitch = static_cast<size_t>(width) * bytesPerPixel(srcFormat);
+        }
+
+        if (destRowPitch == 0) {
+            destRowPitch = static_cast<size_t>(width) * bytesPerPixel(destFormat);
+        }
+
+        size_t minRowsPerWorker = std::max<size_t>(1, minPixelsPerWorker / std::max(width, 1u));
+        uint32_t workers = Parallel::workerCount(height, minRowsPerWorker);
+
+        Parallel::forEachRange(height, workers, [&](size_t begin, size_t end, uint32_t) {
+            for (size_t row = begin; row < end; row++) {
+                convertRow(src + srcRowPitch * row, srcFormat, dest + destRowPitch * row, destFormat, width);
+            }
+        });
+    }
+
+    void convertRowScalar(const uint8_t* src, SourceFormat srcFormat, uint8_t* dest, DestFormat destFormat, uint32_t width) {
+        const uint16_t* table = halfTable().values;
+        uint32_t srcBytesPerPixel = bytesPerPixel(srcFormat);
+        uint32_t destBytesPerPixel = bytesPerPixel(destFormat);
+
+        for (uint32_t x = 0; x < width; x++) {
+            uint8_t rgba[4];
+            readPixel(src + static_cast<size_t>(x) * srcBytesPerPixel, srcFormat, rgba);
+
+            uint8_t* out = dest + static_cast<size_t>(x) * destBytesPerPixel;
+
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                // B8G8R8A8的第0个字节是B
+                uint8_t value = rgba[destFormat == DestFormat::BGRA8 && channel != 1 && channel != 3 ? 2 - channel : channel];
+
+                switch (destFormat) {
+                case DestFormat::RGBA8:
+                case DestFormat::BGRA8:
+                    out[channel] = value;
+                    break;
+                case DestFormat::RGBA16:
+                    reinterpret_cast<uint16_t*>(out)[channel] = static_cast<uint16_t>(value * 257);
+                    break;
+                case DestFormat::RGBA16F:
+                    reinterpret_cast<uint16_t*>(out)[channel] = table[value];
+                    break;
+                case DestFormat::RGBA32F:
+                    reinterpret_cast<float*>(out)[channel] = static_cast<float>(value) / 255.0f;
+                    break;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 像素格式转换：把stb_image等解码器输出的8位像素转换为纹理可以直接使用的格式，
+// 代替逐字节的fill8bit/fill24Bit以及依赖WIC的格式转换。
+//
+// 目标的行大小可以是任意值(通常是按D3D12_TEXTURE_DATA_PITCH_ALIGNMENT对齐后的RowPitch)，
+// 所以可以直接写进Map之后的上传堆，不需要先转换到一块紧密排列的内存中再按行复制。
+//
+// x86上根据CPU在运行时选择SSE2/SSSE3/AVX2实现，其他平台使用标量实现，所有实现的结果逐位相同。
+// 大图按行分给多个线程。
+namespace PixelConvert {
+    enum class SourceFormat {
+        Gray8,          // stb_image channels == 1
+        GrayAlpha8,     // stb_image channels == 2
+        RGB24,          // stb_image channels == 3
+        BGR24,
+        RGBA32,         // stb_image channels == 4
+        BGRA32
+    };
+
+    enum class DestFormat {
+        RGBA8,          // DXGI_FORMAT_R8G8B8A8_UNORM
+        BGRA8,          // DXGI_FORMAT_B8G8R8A8_UNORM
+        RGBA16,         // DXGI_FORMAT_R16G16B16A16_UNORM，v * 257
+        RGBA16F,        // DXGI_FORMAT_R16G16B16A16_FLOAT，v / 255舍入到最近的half
+        RGBA32F         // DXGI_FORMAT_R32G32B32A32_FLOAT，v / 255
+    };
+
+    uint32_t bytesPerPixel(SourceFormat format);
+    uint32_t bytesPerPixel(DestFormat format);
+
+    // stb_image的通道数对应的源格式，不支持的通道数返回false
+    bool sourceFormatFromChannels(int32_t channels, SourceFormat& format);
+
+    // 按D3D12_TEXTURE_DATA_PITCH_ALIGNMENT(256字节)对齐的行大小
+    size_t alignedRowPitch(uint32_t width, DestFormat format);
+
+    // 转换一行，width个像素
+    void convertRow(const uint8_t* src, SourceFormat srcFormat, uint8_t* dest, DestFormat destFormat, uint32_t width);
+
+    // 转换整张图片，srcRowPitch和destRowPitch为0时表示行之间紧密排列
+    void convert(const uint8_t* src, size_t srcRowPitch, SourceFormat srcFormat,
+                 uint8_t* dest, size_t destRowPitch, DestFormat destFormat,
+                 uint32_t width, uint32_t height);
+
+    // 与convertRow相同的逐像素实现，用来校验SIMD实现
+    void convertRowScalar(const uint8_t* src, SourceFormat srcFormat, uint8_t* dest, DestFormat destFormat, uint32_t width);
+}
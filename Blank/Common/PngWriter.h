@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 快速PNG编码，用于截图这类需要尽快写出的场合
+//
+// lodepng::encode默认对每一行尝试所有滤波器并分别压缩来挑选，deflate也是单线程的，全高清截图要几百毫秒。这里：
+//   直接读取调用者的像素，行之间可以有填充(比如回读堆中按256字节对齐的行)，不先复制成紧密排列
+//   每一行只用一种滤波器，按滤波结果(看作有符号数)的绝对值之和最小来选择，一次用SSE2处理16个字节
+//   滤波后的数据按行分成若干段，每段由一个线程压缩成独立的deflate块，段尾用空的存储块对齐到字节，
+//   各段的输出直接拼接就是一个完整的zlib流；每段都可以引用前一段末尾32KB的数据，压缩率几乎没有损失
+//   每段写成一个IDAT块，CRC在各自的线程中计算，Adler-32按段计算之后合并
+// 只支持8位RGBA，与saveImage相同。
+namespace PngWriter {
+    enum class Filter {
+        None,
+        Sub,
+        Up,
+        Average,
+        Paeth,
+        // 每一行选择绝对值之和最小的滤波器
+        Adaptive
+    };
+
+    struct Options {
+        // 与zlib的压缩级别含义相同：0不压缩，1最快，9压缩率最高
+        int level = 2;
+        Filter filter = Filter::Adaptive;
+        // 每段至少的行数，段太小时段首的匹配变少
+        uint32_t minRowsPerBand = 32;
+    };
+
+    // rgba为R8G8B8A8像素，rowPitch为0时表示行之间紧密排列
+    bool encode(const uint8_t* rgba, size_t rowPitch, uint32_t width, uint32_t height,
+                std::vector<uint8_t>& png, const Options& options = Options());
+
+    bool save(const std::string& fileName, const uint8_t* rgba, size_t rowPitch, uint32_t width, uint32_t height,
+              const Options& options = Options());
+}
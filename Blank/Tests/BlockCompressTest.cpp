@@ -0,0 +1,216 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "Common/stb_image.h"
+
+#include "Common/BlockCompress.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+using namespace BlockCompress;
+
+namespace {
+    struct Image {
+        std::vector<uint8_t> pixels;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    bool loadImage(const char* fileName, Image& image) {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        uint8_t* pixels = stbi_load(fileName, &width, &height, &channels, 4);
+
+        if (pixels == nullptr) {
+            return false;
+        }
+
+        image.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        image.width = static_cast<uint32_t>(width);
+        image.height = static_cast<uint32_t>(height);
+
+        stbi_image_free(pixels);
+
+        return true;
+    }
+
+    // 由颜色生成Alpha：亮的部分不透明，其余部分是渐变，用来测试带Alpha的模式
+    void addSyntheticAlpha(Image& image) {
+        for (size_t i = 0; i < image.pixels.size(); i += 4) {
+            uint32_t luma = (image.pixels[i] * 3 + image.pixels[i + 1] * 5) / 8;
+            image.pixels[i + 3] = luma > 100 ? 255 : image.pixels[i + 2];
+        }
+    }
+
+    struct ModeRun {
+        const char* name;
+        Format format;
+        uint32_t bc7Quality;
+        // 低于这个值说明编码质量退化了
+        double minPSNR;
+    };
+
+    // 每种格式和BC7的每个质量等级：吞吐量、PSNR，BC7还有每种模式选中的块数
+    void testModes(const char* fileName, bool syntheticAlpha, const std::vector<ModeRun>& runs) {
+        Image image;
+
+        if (!CHECK(loadImage(fileName, image))) {
+            return;
+        }
+
+        if (syntheticAlpha) {
+            addSyntheticAlpha(image);
+        }
+
+        printf("%s %ux%u%s\n", fileName, image.width, image.height, syntheticAlpha ? " (synthetic alpha)" : "");
+
+        for (const auto& run : runs) {
+            Options options;
+            options.bc7Quality = run.bc7Quality;
+
+            std::vector<uint8_t> compressed(rowPitch(run.format, image.width) * blockRows(image.height));
+            std::vector<uint8_t> decompressed(image.pixels.size());
+            Stats stats;
+
+            double milliseconds = TestUtil::timeMilliseconds(1, [&] {
+                stats = Stats();
+                CHECK(compress(image.pixels.data(), 0, image.width, image.height, run.format, compressed.data(), 0, options, &stats));
+            });
+
+            CHECK(decompress(compressed.data(), 0, run.format, image.width, image.height, decompressed.data(), 0));
+
+            double quality = psnr(run.format, image.pixels.data(), 0, decompressed.data(), 0, image.width, image.height, options);
+
+            if (!CHECK(quality >= run.minPSNR)) {
+                printf("%s: PSNR %.2f dB < %.2f dB\n", run.name, quality, run.minPSNR);
+            }
+
+            printf("  %-7s %8.1f ms %7.1f MPix/s  PSNR %.2f dB", run.name, milliseconds,
+                image.width * image.height / milliseconds / 1000.0, quality);
+
+            if (run.format == Format::BC7) {
+                printf("  modes");
+
+                for (uint32_t mode = 0; mode < 8; mode++) {
+                    printf(" %llu", static_cast<unsigned long long>(stats.bc7ModeBlocks[mode]));
+                }
+            }
+
+            printf("\n");
+        }
+    }
+
+    // 纯色块：BC4/BC5以及黑白两色无损，其他颜色受端点精度限制，但误差不超过1
+    void testSolidBlocks() {
+        const uint8_t colors[][4] = { { 0, 0, 0, 255 }, { 255, 255, 255, 255 }, { 12, 200, 77, 255 }, { 90, 30, 160, 128 } };
+
+        for (const auto& color : colors) {
+            uint8_t block[64];
+
+            for (uint32_t i = 0; i < 16; i++) {
+                memcpy(block + i * 4, color, 4);
+            }
+
+            bool blackOrWhite = color[0] == color[1] && color[1] == color[2] && (color[0] == 0 || color[0] == 255);
+
+            for (Format format : { Format::BC1, Format::BC3, Format::BC4, Format::BC5, Format::BC7 }) {
+                uint8_t encoded[16] = {};
+                uint8_t decoded[64] = {};
+
+                compressBlock(format, block, encoded);
+                decompressBlock(format, encoded, decoded);
+
+                double quality = psnr(format, block, 16, decoded, 16, 4, 4);
+
+                if (blackOrWhite || format == Format::BC4 || format == Format::BC5) {
+                    CHECK(quality == 99.0);
+                } else {
+                    CHECK(quality > 48.0);
+                }
+            }
+        }
+    }
+
+    // 宽高不是4的倍数、带行填充的图片：多线程的结果与逐块压缩相同
+    void testEdgesAndPitch() {
+        Image image;
+
+        if (!CHECK(loadImage("Textures/Kanna.jpg", image))) {
+            return;
+        }
+
+        const uint32_t width = image.width - 3;
+        const uint32_t height = image.height - 2;
+        const size_t srcRowPitch = static_cast<size_t>(image.width) * 4;
+        const Format format = Format::BC7;
+        const size_t destRowPitch = rowPitch(format, width) + 48;
+
+        std::vector<uint8_t> compressed(destRowPitch * blockRows(height), 0xcd);
+
+        if (!CHECK(compress(image.pixels.data(), srcRowPitch, width, height, format, compressed.data(), destRowPitch))) {
+            return;
+        }
+
+        bool blocksMatch = true;
+        bool paddingIntact = true;
+
+        for (uint32_t blockY = 0; blockY < blockRows(height); blockY++) {
+            for (uint32_t blockX = 0; blockX < (width + 3) / 4; blockX++) {
+                // 边缘用最后一行/列的像素补齐
+                uint8_t block[64];
+
+                for (uint32_t y = 0; y < 4; y++) {
+                    for (uint32_t x = 0; x < 4; x++) {
+                        uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+                        uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+                        memcpy(block + (y * 4 + x) * 4, image.pixels.data() + srcRowPitch * sourceY + sourceX * 4, 4);
+                    }
+                }
+
+                uint8_t expected[16];
+                compressBlock(format, block, expected);
+
+                blocksMatch = blocksMatch && memcmp(compressed.data() + destRowPitch * blockY + blockX * 16, expected, 16) == 0;
+            }
+
+            for (size_t x = rowPitch(format, width); x < destRowPitch; x++) {
+                paddingIntact = paddingIntact && compressed[destRowPitch * blockY + x] == 0xcd;
+            }
+        }
+
+        CHECK(blocksMatch);
+        CHECK(paddingIntact);
+    }
+}
+
+int main() {
+    testSolidBlocks();
+    testEdgesAndPitch();
+
+    testModes("Textures/lena.jpg", false, {
+        { "BC1",    Format::BC1, 0, 35.0 },
+        { "BC4",    Format::BC4, 0, 44.0 },
+        { "BC5",    Format::BC5, 0, 43.0 },
+        { "BC7 q0", Format::BC7, 0, 43.0 },
+        { "BC7 q1", Format::BC7, 1, 44.0 },
+    });
+
+    // 高质量等级很慢，用小图
+    testModes("Textures/Kanna.jpg", false, {
+        { "BC7 q1", Format::BC7, 1, 44.0 },
+        { "BC7 q2", Format::BC7, 2, 44.5 },
+        { "BC7 q3", Format::BC7, 3, 44.5 },
+    });
+
+    testModes("Textures/rexie01.jpg", true, {
+        { "BC3",    Format::BC3, 0, 38.0 },
+        { "BC7 q0", Format::BC7, 0, 38.0 },
+        { "BC7 q1", Format::BC7, 1, 42.0 },
+    });
+
+    return TestUtil::finish();
+}
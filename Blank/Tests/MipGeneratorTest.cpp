@@ -0,0 +1,325 @@
+#include "Common/MipGenerator.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace MipGenerator;
+
+namespace {
+    const Filter filters[] = { Filter::Box, Filter::Kaiser, Filter::Lanczos };
+
+    // 每一级的行后面留出的哨兵字节，写越界时会被改掉
+    const size_t guardBytes = 12;
+    const uint8_t guardValue = 0xcd;
+
+    // 按完整mip链分配的输出，每一级的行大小都比宽度多guardBytes
+    struct Chain {
+        std::vector<std::vector<uint8_t>> storage;
+        std::vector<Level> levels;
+        std::vector<uint32_t> widths;
+        std::vector<uint32_t> heights;
+
+        Chain(uint32_t width, uint32_t height) {
+            uint32_t count = mipCount(width, height);
+
+            storage.resize(count);
+            levels.resize(count);
+
+            for (uint32_t mip = 0; mip < count; mip++) {
+                widths.push_back(mipSize(width, mip));
+                heights.push_back(mipSize(height, mip));
+
+                levels[mip].rowPitch = size_t(widths[mip]) * 4 + guardBytes;
+                storage[mip].assign(levels[mip].rowPitch * heights[mip], guardValue);
+                levels[mip].data = storage[mip].data();
+            }
+        }
+
+        const uint8_t* pixel(uint32_t mip, uint32_t x, uint32_t y) const {
+            return storage[mip].data() + levels[mip].rowPitch * y + size_t(x) * 4;
+        }
+
+        bool guardsIntact() const {
+            for (size_t mip = 0; mip < levels.size(); mip++) {
+                for (uint32_t y = 0; y < heights[mip]; y++) {
+                    for (size_t i = size_t(widths[mip]) * 4; i < levels[mip].rowPitch; i++) {
+                        if (storage[mip][levels[mip].rowPitch * y + i] != guardValue) {
+                            return false;
+                        }
+                    }
+                }
+            }
+
+            return true;
+        }
+    };
+
+    std::vector<uint8_t> solidImage(uint32_t width, uint32_t height, const uint8_t color[4]) {
+        std::vector<uint8_t> image(size_t(width) * height * 4);
+
+        for (size_t i = 0; i < image.size(); i++) {
+            image[i] = color[i % 4];
+        }
+
+        return image;
+    }
+
+    // 棋盘格：(x + y)为偶数的像素是a，否则是b
+    std::vector<uint8_t> checkerboard(uint32_t width, uint32_t height, const uint8_t a[4], const uint8_t b[4]) {
+        std::vector<uint8_t> image(size_t(width) * height * 4);
+
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                const uint8_t* color = ((x + y) % 2 == 0) ? a : b;
+
+                for (uint32_t channel = 0; channel < 4; channel++) {
+                    image[(size_t(y) * width + x) * 4 + channel] = color[channel];
+                }
+            }
+        }
+
+        return image;
+    }
+
+    bool generateChain(const std::vector<uint8_t>& image, uint32_t width, uint32_t height, const Options& options, Chain& chain) {
+        return generate(image.data(), 0, width, height, chain.levels.data(), static_cast<uint32_t>(chain.levels.size()), options);
+    }
+
+    void testMipCount() {
+        CHECK(mipCount(1, 1) == 1);
+        CHECK(mipCount(2, 1) == 2);
+        CHECK(mipCount(5, 3) == 3);
+        CHECK(mipCount(7, 1) == 3);
+        CHECK(mipCount(256, 256) == 9);
+        CHECK(mipCount(1000, 3) == 10);
+
+        CHECK(mipSize(5, 1) == 2 && mipSize(5, 2) == 1 && mipSize(5, 7) == 1);
+        CHECK(mipSize(1000, 3) == 125);
+
+        uint8_t pixel[4] = {};
+        Level level = { pixel, 4 };
+
+        CHECK(!generate(pixel, 0, 0, 1, &level, 1));
+        CHECK(!generate(pixel, 0, 1, 1, &level, 0));
+        CHECK(!generate(pixel, 0, 1, 1, &level, 2));
+    }
+
+    // 任意奇数宽高、所有滤波器和颜色空间下，单色图片的每一级都保持原来的颜色，不写出每一级的宽度之外
+    void testSolidOddSizes() {
+        const uint8_t color[4] = { 200, 37, 90, 161 };
+        const uint32_t sizes[][2] = { { 1, 1 }, { 3, 5 }, { 7, 7 }, { 13, 2 }, { 1, 9 }, { 255, 17 }, { 33, 65 } };
+
+        bool allExact = true;
+        bool allGuarded = true;
+
+        for (const auto& size : sizes) {
+            auto image = solidImage(size[0], size[1], color);
+
+            for (Filter filter : filters) {
+                for (bool sRGB : { false, true }) {
+                    Options options;
+                    options.filter = filter;
+                    options.sRGB = sRGB;
+
+                    Chain chain(size[0], size[1]);
+                    CHECK(generateChain(image, size[0], size[1], options, chain));
+
+                    for (uint32_t mip = 0; mip < chain.levels.size(); mip++) {
+                        for (uint32_t y = 0; y < chain.heights[mip]; y++) {
+                            for (uint32_t x = 0; x < chain.widths[mip]; x++) {
+                                const uint8_t* pixel = chain.pixel(mip, x, y);
+                                allExact = allExact && pixel[0] == color[0] && pixel[1] == color[1] && pixel[2] == color[2] && pixel[3] == color[3];
+                            }
+                        }
+                    }
+
+                    allGuarded = allGuarded && chain.guardsIntact();
+                }
+            }
+        }
+
+        CHECK(allExact);
+        CHECK(allGuarded);
+    }
+
+    // 奇数边的Box滤波按面积加权：与直接计算的加权平均比较(线性空间，允许1的舍入差别)
+    void testBoxOddSizes() {
+        std::mt19937 random(45);
+        std::uniform_int_distribution<int> distribution(0, 255);
+
+        bool allMatch = true;
+
+        for (uint32_t width : { 3u, 5u, 7u, 9u, 1u }) {
+            for (uint32_t height : { 1u, 3u, 6u, 11u }) {
+                if (width == 1 && height == 1) {
+                    continue;
+                }
+
+                std::vector<uint8_t> image(size_t(width) * height * 4);
+
+                for (auto& value : image) {
+                    value = static_cast<uint8_t>(distribution(random));
+                }
+
+                Options options;
+                options.filter = Filter::Box;
+                options.sRGB = false;
+
+                Chain chain(width, height);
+                CHECK(generateChain(image, width, height, options, chain));
+
+                uint32_t dstWidth = chain.widths[1];
+                uint32_t dstHeight = chain.heights[1];
+                double scaleX = double(width) / dstWidth;
+                double scaleY = double(height) / dstHeight;
+
+                for (uint32_t y = 0; y < dstHeight; y++) {
+                    for (uint32_t x = 0; x < dstWidth; x++) {
+                        double sum[4] = {};
+                        double weightSum = 0.0;
+
+                        for (uint32_t sy = 0; sy < height; sy++) {
+                            double wy = std::min((y + 1) * scaleY, sy + 1.0) - std::max(y * scaleY, double(sy));
+
+                            for (uint32_t sx = 0; sx < width && wy > 0.0; sx++) {
+                                double wx = std::min((x + 1) * scaleX, sx + 1.0) - std::max(x * scaleX, double(sx));
+
+                                if (wx <= 0.0) {
+                                    continue;
+                                }
+
+                                for (uint32_t channel = 0; channel < 4; channel++) {
+                                    sum[channel] += wx * wy * image[(size_t(sy) * width + sx) * 4 + channel];
+                                }
+
+                                weightSum += wx * wy;
+                            }
+                        }
+
+                        const uint8_t* pixel = chain.pixel(1, x, y);
+
+                        for (uint32_t channel = 0; channel < 4; channel++) {
+                            allMatch = allMatch && std::fabs(pixel[channel] - sum[channel] / weightSum) <= 1.0;
+                        }
+                    }
+                }
+            }
+        }
+
+        CHECK(allMatch);
+    }
+
+    // sRGB时在线性空间中平均：黑白棋盘格缩小后是线性0.5对应的188，而不是128；Alpha始终按线性平均
+    void testSRGBVersusLinear() {
+        const uint8_t black[4] = { 0, 0, 0, 0 };
+        const uint8_t white[4] = { 255, 255, 255, 255 };
+
+        for (Filter filter : filters) {
+            for (uint32_t size : { 8u, 9u }) {
+                auto image = checkerboard(size, size, black, white);
+
+                Options options;
+                options.filter = filter;
+
+                Chain linear(size, size);
+                options.sRGB = false;
+                CHECK(generateChain(image, size, size, options, linear));
+
+                Chain sRGB(size, size);
+                options.sRGB = true;
+                CHECK(generateChain(image, size, size, options, sRGB));
+
+                // 奇数边的边缘像素中黑白的面积不完全相等，只看中间的像素
+                uint32_t center = linear.widths[1] / 2;
+                const uint8_t* linearPixel = linear.pixel(1, center, center);
+                const uint8_t* sRGBPixel = sRGB.pixel(1, center, center);
+
+                CHECK(std::abs(linearPixel[0] - 128) <= 2 && linearPixel[0] == linearPixel[1] && linearPixel[1] == linearPixel[2]);
+                CHECK(std::abs(sRGBPixel[0] - 188) <= 2 && sRGBPixel[0] == sRGBPixel[1] && sRGBPixel[1] == sRGBPixel[2]);
+                CHECK(std::abs(linearPixel[3] - 128) <= 2 && sRGBPixel[3] == linearPixel[3]);
+            }
+        }
+
+        // 第0级原样复制，不经过颜色空间转换
+        auto image = checkerboard(4, 4, black, white);
+        Chain chain(4, 4);
+        Options options;
+        CHECK(generateChain(image, 4, 4, options, chain));
+        CHECK(chain.pixel(0, 1, 0)[0] == 255 && chain.pixel(0, 0, 0)[0] == 0);
+    }
+
+    // 源图片的行大小大于宽度时只读取每行的前width个像素，levelCount小于完整的级数时只写前几级
+    void testPitchAndPartialChain() {
+        const uint32_t width = 6;
+        const uint32_t height = 5;
+        const size_t srcRowPitch = width * 4 + 20;
+        const uint8_t color[4] = { 10, 20, 30, 255 };
+
+        std::vector<uint8_t> image(srcRowPitch * height, 0xff);
+
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                memcpy(&image[srcRowPitch * y + x * 4], color, 4);
+            }
+        }
+
+        Chain chain(width, height);
+        CHECK(generate(image.data(), srcRowPitch, width, height, chain.levels.data(), 2));
+
+        bool exact = true;
+
+        for (uint32_t mip = 0; mip < 2; mip++) {
+            for (uint32_t y = 0; y < chain.heights[mip]; y++) {
+                for (uint32_t x = 0; x < chain.widths[mip]; x++) {
+                    exact = exact && memcmp(chain.pixel(mip, x, y), color, 4) == 0;
+                }
+            }
+        }
+
+        CHECK(exact);
+        CHECK(chain.guardsIntact());
+        CHECK(*chain.pixel(2, 0, 0) == guardValue);
+    }
+
+    void testPerformance() {
+        const uint32_t size = 2048;
+
+        std::mt19937 random(45);
+        std::vector<uint8_t> image(size_t(size) * size * 4);
+
+        for (auto& value : image) {
+            value = static_cast<uint8_t>(random());
+        }
+
+        for (Filter filter : filters) {
+            Options options;
+            options.filter = filter;
+
+            Chain chain(size, size);
+
+            double milliseconds = TestUtil::timeMilliseconds(3, [&] {
+                generateChain(image, size, size, options, chain);
+            });
+
+            printf("%s 2048x2048 sRGB, %u levels: %.1f ms\n",
+                   filter == Filter::Box ? "Box" : (filter == Filter::Kaiser ? "Kaiser" : "Lanczos"),
+                   static_cast<uint32_t>(chain.levels.size()), milliseconds);
+        }
+    }
+}
+
+int main() {
+    testMipCount();
+    testSolidOddSizes();
+    testBoxOddSizes();
+    testSRGBVersusLinear();
+    testPitchAndPartialChain();
+    testPerformance();
+
+    return TestUtil::finish();
+}
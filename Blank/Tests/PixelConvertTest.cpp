@@ -0,0 +1,165 @@
+#include "Common/PixelConvert.h"
+#include "TestUtil.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace PixelConvert;
+
+namespace {
+    const SourceFormat sourceFormats[] = {
+        SourceFormat::Gray8, SourceFormat::GrayAlpha8, SourceFormat::RGB24,
+        SourceFormat::BGR24, SourceFormat::RGBA32, SourceFormat::BGRA32
+    };
+
+    const DestFormat destFormats[] = {
+        DestFormat::RGBA8, DestFormat::BGRA8, DestFormat::RGBA16, DestFormat::RGBA16F, DestFormat::RGBA32F
+    };
+
+    // 目标行后面留出的哨兵字节，写越界时会被改掉
+    const size_t guardBytes = 64;
+    const uint8_t guardValue = 0xcd;
+
+    std::vector<uint8_t> randomBytes(std::mt19937& random, size_t count) {
+        std::uniform_int_distribution<int> distribution(0, 255);
+        std::vector<uint8_t> bytes(count);
+
+        for (auto& byte : bytes) {
+            byte = static_cast<uint8_t>(distribution(random));
+        }
+
+        // 开头放上0和255，确认两端的值也逐位相同
+        for (size_t i = 0; i < count && i < 8; i++) {
+            bytes[i] = (i & 1) ? 255 : 0;
+        }
+
+        return bytes;
+    }
+
+    bool guardIntact(const std::vector<uint8_t>& dest, size_t usedBytes) {
+        for (size_t i = usedBytes; i < dest.size(); i++) {
+            if (dest[i] != guardValue) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // 各种宽度覆盖SIMD的整块、剩余的标量部分以及不足一块的行
+    void testRowsMatchScalar() {
+        std::mt19937 random(2024);
+        bool allMatch = true;
+        bool allGuarded = true;
+
+        for (SourceFormat srcFormat : sourceFormats) {
+            for (DestFormat destFormat : destFormats) {
+                for (uint32_t width : { 1u, 3u, 7u, 8u, 15u, 16u, 17u, 31u, 32u, 33u, 63u, 64u, 65u, 100u, 1023u }) {
+                    std::vector<uint8_t> src = randomBytes(random, static_cast<size_t>(width) * bytesPerPixel(srcFormat));
+
+                    size_t destBytes = static_cast<size_t>(width) * bytesPerPixel(destFormat);
+                    std::vector<uint8_t> simd(destBytes + guardBytes, guardValue);
+                    std::vector<uint8_t> scalar(destBytes + guardBytes, guardValue);
+
+                    convertRow(src.data(), srcFormat, simd.data(), destFormat, width);
+                    convertRowScalar(src.data(), srcFormat, scalar.data(), destFormat, width);
+
+                    if (memcmp(simd.data(), scalar.data(), destBytes) != 0) {
+                        printf("mismatch: source %d, dest %d, width %u\n", static_cast<int>(srcFormat), static_cast<int>(destFormat), width);
+                        allMatch = false;
+                    }
+
+                    allGuarded = allGuarded && guardIntact(simd, destBytes);
+                }
+            }
+        }
+
+        CHECK(allMatch);
+        CHECK(allGuarded);
+    }
+
+    // 几个可以手算的值
+    void testKnownValues() {
+        const uint8_t rgb[] = { 0, 128, 255 };
+
+        uint8_t bgra[4] = {};
+        convertRow(rgb, SourceFormat::RGB24, bgra, DestFormat::BGRA8, 1);
+        CHECK(bgra[0] == 255 && bgra[1] == 128 && bgra[2] == 0 && bgra[3] == 255);
+
+        uint16_t rgba16[4] = {};
+        convertRow(rgb, SourceFormat::RGB24, reinterpret_cast<uint8_t*>(rgba16), DestFormat::RGBA16, 1);
+        CHECK(rgba16[0] == 0 && rgba16[1] == 128 * 257 && rgba16[2] == 65535 && rgba16[3] == 65535);
+
+        // 0 -> 0，255 -> 1.0 (0x3c00)
+        uint16_t rgba16f[4] = {};
+        convertRow(rgb, SourceFormat::RGB24, reinterpret_cast<uint8_t*>(rgba16f), DestFormat::RGBA16F, 1);
+        CHECK(rgba16f[0] == 0 && rgba16f[2] == 0x3c00 && rgba16f[3] == 0x3c00);
+
+        float rgba32f[4] = {};
+        convertRow(rgb, SourceFormat::RGB24, reinterpret_cast<uint8_t*>(rgba32f), DestFormat::RGBA32F, 1);
+        CHECK(rgba32f[0] == 0.0f && rgba32f[1] == 128.0f / 255.0f && rgba32f[2] == 1.0f && rgba32f[3] == 1.0f);
+
+        const uint8_t grayAlpha[] = { 10, 20 };
+        uint8_t rgba[4] = {};
+        convertRow(grayAlpha, SourceFormat::GrayAlpha8, rgba, DestFormat::RGBA8, 1);
+        CHECK(rgba[0] == 10 && rgba[1] == 10 && rgba[2] == 10 && rgba[3] == 20);
+    }
+
+    // 整张图片：源和目标都带行尾的填充，大图会分给多个线程
+    void testImageMatchesScalar() {
+        std::mt19937 random(7);
+
+        const uint32_t width = 1021;
+        const uint32_t height = 613;
+        const SourceFormat srcFormat = SourceFormat::RGB24;
+
+        for (DestFormat destFormat : destFormats) {
+            size_t srcRowPitch = static_cast<size_t>(width) * bytesPerPixel(srcFormat) + 5;
+            size_t destRowPitch = alignedRowPitch(width, destFormat);
+            size_t destRowBytes = static_cast<size_t>(width) * bytesPerPixel(destFormat);
+
+            std::vector<uint8_t> src = randomBytes(random, srcRowPitch * height);
+            std::vector<uint8_t> dest(destRowPitch * height, guardValue);
+            std::vector<uint8_t> scalarRow(destRowBytes);
+
+            double milliseconds = TestUtil::timeMilliseconds(5, [&] {
+                convert(src.data(), srcRowPitch, srcFormat, dest.data(), destRowPitch, destFormat, width, height);
+            });
+
+            bool rowsMatch = true;
+            bool paddingIntact = true;
+
+            for (uint32_t y = 0; y < height; y++) {
+                convertRowScalar(src.data() + srcRowPitch * y, srcFormat, scalarRow.data(), destFormat, width);
+
+                rowsMatch = rowsMatch && memcmp(dest.data() + destRowPitch * y, scalarRow.data(), destRowBytes) == 0;
+
+                // 行尾对齐填充的部分不应该被写入
+                for (size_t x = destRowBytes; x < destRowPitch; x++) {
+                    paddingIntact = paddingIntact && dest[destRowPitch * y + x] == guardValue;
+                }
+            }
+
+            CHECK(rowsMatch);
+            CHECK(paddingIntact);
+
+            double scalarMilliseconds = TestUtil::timeMilliseconds(5, [&] {
+                for (uint32_t y = 0; y < height; y++) {
+                    convertRowScalar(src.data() + srcRowPitch * y, srcFormat, dest.data() + destRowPitch * y, destFormat, width);
+                }
+            });
+
+            printf("RGB24 -> dest %d, %ux%u: convert %.3f ms, scalar %.3f ms\n",
+                static_cast<int>(destFormat), width, height, milliseconds, scalarMilliseconds);
+        }
+    }
+}
+
+int main() {
+    testRowsMatchScalar();
+    testKnownValues();
+    testImageMatchesScalar();
+
+    return TestUtil::finish();
+}
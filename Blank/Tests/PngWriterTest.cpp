@@ -0,0 +1,157 @@
+#include "Common/PngWriter.h"
+#include "Common/lodepng.h"
+#include "TestUtil.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace PngWriter;
+
+namespace {
+    const Filter filters[] = { Filter::None, Filter::Sub, Filter::Up, Filter::Average, Filter::Paeth, Filter::Adaptive };
+
+    // 渐变加上少量噪声，既有长匹配也有各种滤波器都处理不好的字节
+    std::vector<uint8_t> testImage(std::mt19937& random, uint32_t width, uint32_t height, size_t rowPitch) {
+        std::vector<uint8_t> image(rowPitch * height, 0xcd);
+
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                uint8_t* pixel = &image[rowPitch * y + size_t(x) * 4];
+                uint32_t noise = random() % 8 == 0 ? random() : 0;
+
+                pixel[0] = static_cast<uint8_t>(x * 3 + (noise & 0xff));
+                pixel[1] = static_cast<uint8_t>(y * 5 + x);
+                pixel[2] = static_cast<uint8_t>((x ^ y) + (noise >> 8));
+                pixel[3] = static_cast<uint8_t>(255 - (x + y) / 4);
+            }
+        }
+
+        return image;
+    }
+
+    // 用lodepng解码，像素与编码前逐字节相同(不包括行尾的填充)
+    bool decodesTo(const std::vector<uint8_t>& png, const std::vector<uint8_t>& image, uint32_t width, uint32_t height, size_t rowPitch) {
+        std::vector<unsigned char> decoded;
+        unsigned decodedWidth = 0;
+        unsigned decodedHeight = 0;
+
+        if (lodepng::decode(decoded, decodedWidth, decodedHeight, png) != 0 || decodedWidth != width || decodedHeight != height) {
+            return false;
+        }
+
+        for (uint32_t y = 0; y < height; y++) {
+            if (memcmp(&decoded[size_t(y) * width * 4], &image[rowPitch * y], size_t(width) * 4) != 0) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // 所有滤波器和压缩级别，各种宽高(包括1像素、奇数宽度和不足一段的高度)，紧密排列和带填充的行
+    void testRoundTrip() {
+        const uint32_t sizes[][2] = { { 1, 1 }, { 3, 2 }, { 17, 5 }, { 1, 300 }, { 255, 67 }, { 640, 200 } };
+
+        std::mt19937 random(50);
+        bool allMatch = true;
+
+        for (const auto& size : sizes) {
+            uint32_t width = size[0];
+            uint32_t height = size[1];
+
+            for (size_t padding : { size_t(0), size_t(20) }) {
+                size_t rowPitch = size_t(width) * 4 + padding;
+                auto image = testImage(random, width, height, rowPitch);
+
+                for (Filter filter : filters) {
+                    for (int level : { 0, 1, 2, 6, 9 }) {
+                        Options options;
+                        options.filter = filter;
+                        options.level = level;
+
+                        std::vector<uint8_t> png;
+                        bool encoded = encode(image.data(), padding == 0 ? 0 : rowPitch, width, height, png, options);
+
+                        if (!encoded || !decodesTo(png, image, width, height, rowPitch)) {
+                            printf("mismatch: %ux%u, padding %zu, filter %d, level %d\n",
+                                   width, height, padding, static_cast<int>(filter), level);
+                            allMatch = false;
+                        }
+                    }
+                }
+            }
+        }
+
+        CHECK(allMatch);
+    }
+
+    // 每段一行时段数最多，每段的deflate块和IDAT块都要正确衔接
+    void testManyBands() {
+        const uint32_t width = 300;
+        const uint32_t height = 257;
+
+        std::mt19937 random(50);
+        auto image = testImage(random, width, height, size_t(width) * 4);
+
+        Options options;
+        options.minRowsPerBand = 1;
+
+        std::vector<uint8_t> png;
+        CHECK(encode(image.data(), 0, width, height, png, options));
+        CHECK(decodesTo(png, image, width, height, size_t(width) * 4));
+
+        // 重复的内容跨段引用前一段的数据，压缩后远小于原始数据
+        std::vector<uint8_t> stripes(size_t(width) * height * 4);
+
+        for (size_t i = 0; i < stripes.size(); i++) {
+            stripes[i] = static_cast<uint8_t>((i / 4) % 7 * 30);
+        }
+
+        CHECK(encode(stripes.data(), 0, width, height, png, options));
+        CHECK(decodesTo(png, stripes, width, height, size_t(width) * 4));
+        CHECK(png.size() < stripes.size() / 20);
+    }
+
+    void testInvalidArguments() {
+        uint8_t pixel[4] = {};
+        std::vector<uint8_t> png(16, 1);
+
+        CHECK(!encode(nullptr, 0, 1, 1, png) && png.empty());
+        CHECK(!encode(pixel, 0, 0, 1, png));
+        CHECK(!encode(pixel, 0, 1, 0, png));
+        CHECK(!encode(pixel, 3, 1, 1, png));
+    }
+
+    void testPerformance() {
+        const uint32_t width = 1920;
+        const uint32_t height = 1080;
+
+        std::mt19937 random(50);
+        auto image = testImage(random, width, height, size_t(width) * 4);
+
+        std::vector<uint8_t> png;
+
+        double milliseconds = TestUtil::timeMilliseconds(5, [&] {
+            encode(image.data(), 0, width, height, png);
+        });
+
+        std::vector<unsigned char> lodepngOutput;
+
+        double lodepngMilliseconds = TestUtil::timeMilliseconds(1, [&] {
+            lodepng::encode(lodepngOutput, image.data(), width, height);
+        });
+
+        printf("encode 1920x1080: %.1f ms, %zu bytes (lodepng %.1f ms, %zu bytes)\n",
+               milliseconds, png.size(), lodepngMilliseconds, lodepngOutput.size());
+    }
+}
+
+int main() {
+    testRoundTrip();
+    testManyBands();
+    testInvalidArguments();
+    testPerformance();
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+// 模块测试共用的最小工具：CHECK失败时打印表达式和位置并记下失败，
+// main最后返回TestUtil::finish()，ctest据此判断测试是否通过
+namespace TestUtil {
+    inline int& failureCount() {
+        static int count = 0;
+        return count;
+    }
+
+    inline bool check(bool condition, const char* expression, const char* file, int line) {
+        if (!condition) {
+            printf("%s(%d): CHECK(%s) failed\n", file, line, expression);
+            failureCount()++;
+        }
+
+        return condition;
+    }
+
+    inline int finish() {
+        if (failureCount() > 0) {
+            printf("%d check(s) failed\n", failureCount());
+            return 1;
+        }
+
+        printf("all checks passed\n");
+        return 0;
+    }
+
+    // 重复运行repeat次，返回单次的平均毫秒数
+    template<typename Function>
+    double timeMilliseconds(int repeat, Function&& function) {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < repeat; i++) {
+            function();
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / repeat;
+    }
+}
+
+#define CHECK(condition) TestUtil::check((condition), #condition, __FILE__, __LINE__)
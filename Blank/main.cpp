@@ -18,6 +18,12 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "Common/stb_image.h"
 #include "Common/lodepng.h"
+#include "Common/DerivedDataCache.h"
+#include "Common/PixelConvert.h"
+#include "Common/MipGenerator.h"
+#include "Common/BlockCompress.h"
+#include "Common/PngWriter.h"
+#include "Common/AssetLoader.h"
 
 using namespace Microsoft::WRL;
 using namespace DirectX;
@@ -184,38 +190,15 @@ std::string loadShader(const std::string& binaryName) {
     return shaderData;
 }
 
-void saveImage(const std::string& path, byte* pixels, uint32_t width, uint32_t height) {
-	std::vector<unsigned char> pixelBuffer;
-
-	int pixelCount = width * height;
-
-	byte* src = pixels;
-
-	// for (int i = 0; i < pixelCount; i++) {
-	// 	// pixelBuffer.push_back((unsigned char)pixelPtr[i * 4]);
-	// 	// pixelBuffer.push_back((unsigned char)pixelPtr[i * 4 + 1]);
-	// 	// pixelBuffer.push_back((unsigned char)pixelPtr[i * 4 + 2]);
-	// 	// pixelBuffer.push_back((unsigned char)pixelPtr[i * 4 + 3]);
-	// 	pixelBuffer.push_back((unsigned char)pixelPtr[0]);
-	// 	pixelBuffer.push_back((unsigned char)pixelPtr[1]);
-	// 	pixelBuffer.push_back((unsigned char)pixelPtr[2]);
-	// 	pixelBuffer.push_back((unsigned char)pixelPtr[3]);
-	// 	pixelPtr += 4;
-	// }
-
-    for (uint32_t h = 0; h < height; h++) {
-        for (uint32_t w = 0; w < width; w++) {
-            pixelBuffer.push_back(*src++);
-            pixelBuffer.push_back(*src++);
-            pixelBuffer.push_back(*src++);
-            pixelBuffer.push_back(*src++);
-        }
+// 编码或写文件失败时输出到调试器并返回false
+bool saveImage(const std::string& path, byte* pixels, uint32_t width, uint32_t height) {
+    // 直接从回读的像素编码，不再逐字节复制到临时的vector
+    if (!PngWriter::save(path, pixels, static_cast<size_t>(width) * 4, width, height)) {
+        ::OutputDebugStringA(("saveImage: failed to write " + path + "\n").c_str());
+        return false;
     }
 
-	//Encode the image
-	unsigned error = lodepng::encode(path, pixelBuffer, width, height);
-
-	pixelBuffer.clear();
+    return true;
 }
 
 uint32_t calculateConstantBufferSize(uint32_t size) {
@@ -239,34 +222,94 @@ XMFLOAT4 lookAt = {0.0f, 0.0f, 0.0f, 1.0f};
 float frameTime = 0.0f;
 bool windowActive = true;
 
-// 使用stb_image加载图片的时候，要将非32位色深的数据格式对齐到DirectX 12所需的DXGI_FORMAT_R8G8B8A8_UNORM格式
-// 如果是8位图片，从源数据中取1字节，然后用它填充目标数据的RGB部分，然后将A设置位255
-// 如果是24位图片，从源数据中读取RGG，然后将A设置位255
-// 并且每次外层循环(每行)，通过padding来对齐(因为DirectX 12要求纹理的行以256字节对齐，整个以512字节对齐(偶数行))
-void fill8bit(byte* dest, const byte* src, uint32_t width, uint32_t height, uint32_t padding) {
-    for (uint32_t h = 0; h < width; h++) {
-        for (uint32_t w = 0; w < height; w++) {
-            *dest++ = *src;
-            *dest++ = *src;
-            *dest++ = *src++;
-            *dest++ = 255;
+// 纹理在加载时压缩为BC7，显存和采样带宽是R8G8B8A8的1/4
+bool compressTextures = true;
+
+// 加载图片并转换为紧密排列(行不对齐)的DXGI_FORMAT_R8G8B8A8_UNORM像素
+// 转换结果按文件内容的哈希保存在派生数据缓存中，热启动时不再解码JPEG
+bool loadImageRGBA(DerivedDataCache& cache, const std::string& fileName, uint32_t& width, uint32_t& height, std::vector<byte>& pixels) {
+    struct CachedImageHeader {
+        uint32_t width;
+        uint32_t height;
+    };
+
+    uint64_t key = 0;
+
+    if (!DerivedDataCache::makeFileKey(fileName, "stbi_load R8G8B8A8_UNORM:v2", key)) {
+        return false;
+    }
+
+    std::vector<uint8_t> payload;
+
+    if (cache.get(key, payload) && payload.size() >= sizeof(CachedImageHeader)) {
+        CachedImageHeader header;
+        memcpy(&header, payload.data(), sizeof(header));
+
+        if (payload.size() == sizeof(header) + static_cast<size_t>(header.width) * header.height * 4) {
+            width = header.width;
+            height = header.height;
+            pixels.assign(payload.begin() + sizeof(header), payload.end());
+
+            return true;
         }
+    }
+
+    int32_t imageWidth = 0;
+    int32_t imageHeight = 0;
+    int32_t channels = 0;
+
+    byte* imageData = stbi_load(fileName.c_str(), &imageWidth, &imageHeight, &channels, 0);
 
-        dest += padding;
+    if (imageData == nullptr) {
+        return false;
     }
+
+    PixelConvert::SourceFormat sourceFormat;
+
+    if (!PixelConvert::sourceFormatFromChannels(channels, sourceFormat)) {
+        stbi_image_free(imageData);
+        return false;
+    }
+
+    width = static_cast<uint32_t>(imageWidth);
+    height = static_cast<uint32_t>(imageHeight);
+    pixels.resize(static_cast<size_t>(width) * height * 4);
+
+    // 将8位，16位(灰度 + Alpha)，24位像素格式转换为DirectX 12所需的DXGI_FORMAT_R8G8B8A8_UNORM，行之间没有填充
+    PixelConvert::convert(imageData, 0, sourceFormat, pixels.data(), 0, PixelConvert::DestFormat::RGBA8, width, height);
+
+    stbi_image_free(imageData);
+
+    CachedImageHeader header = { width, height };
+
+    payload.resize(sizeof(header) + pixels.size());
+    memcpy(payload.data(), &header, sizeof(header));
+    memcpy(payload.data() + sizeof(header), pixels.data(), pixels.size());
+
+    cache.put(key, payload.data(), payload.size());
+
+    return true;
 }
 
-void fill24Bit(byte* dest, const byte* src, uint32_t width, uint32_t height, uint32_t padding) {
-    for (uint32_t h = 0; h < width; h++) {
-        for (uint32_t w = 0; w < height; w++) {
-            *dest++ = *src++;
-            *dest++ = *src++;
-            *dest++ = *src++;
-            *dest++ = 255;
-        }
+// 在工作线程中解码(或者从派生数据缓存中读取)好的图片
+struct DecodedImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<byte> pixels;
+};
+
+// 交给AssetLoader在工作线程中执行，失败时抛出异常，在get()时重新抛出
+DecodedImage decodeImageRGBA(const std::string& fileName) {
+    DecodedImage image;
 
-        dest += padding;
+    // 只有这里用到派生数据缓存，打开缓存时扫描目录也在工作线程中进行
+    DerivedDataCache derivedDataCache("DerivedDataCache");
+
+    if (!loadImageRGBA(derivedDataCache, fileName, image.width, image.height, image.pixels)) {
+        ThrowIfFailed(E_FAIL);
     }
+
+    return image;
 }
 
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
@@ -282,6 +325,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
 #if defined(DEBUG) | defined(_DEBUG)
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
+
+    // 纹理的解码和着色器的读取交给工作线程，与窗口、设备等的创建同时进行，用到的时候再等待
+    AssetLoader assetLoader;
+
+    auto textureImage = assetLoader.load("Textures/Kanna.jpg", []() { return decodeImageRGBA("Textures/Kanna.jpg"); });
+    auto vertexShaderBinary = assetLoader.load("Shaders/vs.bin", []() { return loadShader("Shaders/vs.bin"); });
+    auto pixelShaderBinary = assetLoader.load("Shaders/ps.bin", []() { return loadShader("Shaders/ps.bin"); });
     
     const uint32_t backBufferCount = 3;
 
@@ -589,8 +639,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
 
         // 10.编译&加载Shader(Shader在项目构建之前通过dxc进行了离线编译)
         // 这里只需加载编译好的二进制代码即可
-        std::string vertexShader = loadShader("Shaders/vs.bin");
-        std::string pixelShader = loadShader("Shaders/ps.bin");
+        const std::string& vertexShader = vertexShaderBinary.get();
+        const std::string& pixelShader = pixelShaderBinary.get();
 
         // 10.创建顶点输入布局(Input Layout)
         // struct D3D12_INPUT_ELEMENT_DESC
@@ -917,21 +967,29 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
                 D3D12_RESOURCE_STATE_COMMON,
                 D3D12_RESOURCE_STATE_DEPTH_WRITE));
 
-        int32_t imageWidth = 0;
-        int32_t imageHeight = 0;
-        int32_t channels = 0;
+        // 解码在工作线程中进行，这里只等待结果
+        const auto& image = textureImage.get();
 
-        byte* imageData = stbi_load("Textures/Kanna.jpg", &imageWidth, &imageHeight, &channels, 0);
+        uint32_t imageWidth = image.width;
+        uint32_t imageHeight = image.height;
+        const std::vector<byte>& imageData = image.pixels;
 
         ComPtr<ID3D12Resource> texture;
 
+        // 完整的mip链，缩小显示时采样器(D3D12_FILTER_MIN_MAG_MIP_LINEAR)才有合适的级别可用
+        uint32_t mipLevels = MipGenerator::mipCount(imageWidth, imageHeight);
+
+        // 块压缩纹理第0级的宽高必须是4的倍数，否则仍然使用R8G8B8A8
+        bool blockCompressed = compressTextures && imageWidth % 4 == 0 && imageHeight % 4 == 0;
+        DXGI_FORMAT textureFormat = blockCompressed ? BlockCompress::dxgiFormat(BlockCompress::Format::BC7, false) : DXGI_FORMAT_R8G8B8A8_UNORM;
+
         D3D12_RESOURCE_DESC textureDesc = {};
         textureDesc.Alignment = 0;
         textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        textureDesc.Format = textureFormat;
         textureDesc.Width = imageWidth;
         textureDesc.Height = imageHeight;
-        textureDesc.MipLevels = 1;
+        textureDesc.MipLevels = static_cast<uint16_t>(mipLevels);
         textureDesc.DepthOrArraySize = 1;
         textureDesc.SampleDesc.Count = 1;
         textureDesc.SampleDesc.Quality = 0;
@@ -947,15 +1005,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
 
         D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
         SRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        SRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        SRVDesc.Format = textureFormat;
         SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        SRVDesc.Texture2D.MipLevels = 1;
+        SRVDesc.Texture2D.MipLevels = mipLevels;
 
         CBVCPUDescriptorHandle.Offset(1, CBVSRVUAVDescritproSize);
 
         device->CreateShaderResourceView(texture.Get(), &SRVDesc, CBVCPUDescriptorHandle);
         
-        uint64_t textureUploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, 1);
+        uint64_t textureUploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, mipLevels);
 
         ComPtr<ID3D12Resource> textureUploadBuffer = nullptr;
 
@@ -981,66 +1039,70 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
             IID_PPV_ARGS(textureUploadBuffer.GetAddressOf())));
 
         uint64_t requiredSize = 0;
-        uint32_t numSubresources = 1;
-        D3D12_PLACED_SUBRESOURCE_FOOTPRINT textureLayout = {};
-        uint64_t textureRowSize = 0;
-        uint32_t textureRowNum = 0;
+        uint32_t numSubresources = mipLevels;
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> textureLayouts(numSubresources);
+        std::vector<uint64_t> textureRowSizes(numSubresources);
+        std::vector<uint32_t> textureRowNums(numSubresources);
 
         device->GetCopyableFootprints(
             &textureDesc,
             0,
             numSubresources,
             0,
-            &textureLayout,
-            &textureRowNum,
-            &textureRowSize,
+            textureLayouts.data(),
+            textureRowNums.data(),
+            textureRowSizes.data(),
             &requiredSize);
 
-        uint32_t rowPitch = textureLayout.Footprint.RowPitch;
-        uint32_t bufferSize = imageHeight * rowPitch;
-        
-        uint32_t bitPerComponent = 4;
-
-        // 每行需要填充的对齐字节数
-        uint32_t padding = rowPitch - imageWidth * bitPerComponent;
+        byte* mappedTextureUploadBufferData = nullptr;
 
-        byte* convertedImageData = new byte[requiredSize];
+        ThrowIfFailed(textureUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedTextureUploadBufferData)));
 
-        const byte* src = imageData;
-        byte* dest = convertedImageData;
+        // 源数据的行是紧密排列的，上传堆中每一级的行按RowPitch(256字节)对齐，
+        // 不压缩时MipGenerator直接把每一级写到上传堆中对应的位置
+        std::vector<MipGenerator::Level> mips(numSubresources);
+        std::vector<std::vector<byte>> mipPixels;
 
-        // 按照位深进行字节填充(将8位，24位像素格式填充到32位，并将行对齐到256字节)
-        if (channels == 1) {
-            fill8bit(dest, src, imageWidth, imageHeight, padding);
-        }
-        else if (channels == 3) {
-            fill24Bit(dest, src, imageWidth, imageHeight, padding);
+        if (blockCompressed) {
+            mipPixels.resize(numSubresources);
         }
 
-        stbi_image_free(imageData);
-
-        byte* mappedTextureUploadBufferData = nullptr;
+        for (uint32_t mip = 0; mip < numSubresources; mip++) {
+            if (blockCompressed) {
+                uint32_t mipWidth = MipGenerator::mipSize(imageWidth, mip);
 
-        ThrowIfFailed(textureUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedTextureUploadBufferData)));
+                mipPixels[mip].resize(static_cast<size_t>(mipWidth) * MipGenerator::mipSize(imageHeight, mip) * 4);
+                mips[mip].data = mipPixels[mip].data();
+                mips[mip].rowPitch = static_cast<size_t>(mipWidth) * 4;
+            }
+            else {
+                mips[mip].data = mappedTextureUploadBufferData + textureLayouts[mip].Offset;
+                mips[mip].rowPitch = textureLayouts[mip].Footprint.RowPitch;
+            }
+        }
 
-        byte* destSlice = reinterpret_cast<byte*>(mappedTextureUploadBufferData) + textureLayout.Offset;
-        byte* srcSlice = convertedImageData;
+        MipGenerator::generate(imageData.data(), 0, imageWidth, imageHeight, mips.data(), numSubresources);
 
-        for (uint32_t row = 0; row < textureRowNum; row++) {
-            memcpy_s(destSlice + static_cast<size_t>(textureLayout.Footprint.RowPitch) * row, textureLayout.Footprint.RowPitch,
-                     srcSlice + static_cast<size_t>(rowPitch) * row, rowPitch);
+        if (blockCompressed) {
+            // 上传堆中的一行是一行4 x 4的块
+            for (uint32_t mip = 0; mip < numSubresources; mip++) {
+                BlockCompress::compress(mips[mip].data, mips[mip].rowPitch,
+                                        MipGenerator::mipSize(imageWidth, mip), MipGenerator::mipSize(imageHeight, mip),
+                                        BlockCompress::Format::BC7,
+                                        mappedTextureUploadBufferData + textureLayouts[mip].Offset, textureLayouts[mip].Footprint.RowPitch);
+            }
         }
 
         // saveImage("test.png", mappedTextureUploadBufferData, 704, 700);
 
-        delete convertedImageData;
-
         textureUploadBuffer->Unmap(0, nullptr);
 
-        CD3DX12_TEXTURE_COPY_LOCATION destLocation(texture.Get(), 0);
-        CD3DX12_TEXTURE_COPY_LOCATION srcLocation(textureUploadBuffer.Get(), textureLayout);
+        for (uint32_t mip = 0; mip < numSubresources; mip++) {
+            CD3DX12_TEXTURE_COPY_LOCATION destLocation(texture.Get(), mip);
+            CD3DX12_TEXTURE_COPY_LOCATION srcLocation(textureUploadBuffer.Get(), textureLayouts[mip]);
 
-        commandList->CopyTextureRegion(&destLocation, 0, 0, 0, &srcLocation, nullptr);
+            commandList->CopyTextureRegion(&destLocation, 0, 0, 0, &srcLocation, nullptr);
+        }
 
         D3D12_RESOURCE_BARRIER resourceBarrier = {};
         resourceBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -1048,6 +1110,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
         resourceBarrier.Transition.pResource = texture.Get();
         resourceBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
         resourceBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+        resourceBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
 
         commandList->ResourceBarrier(1, &resourceBarrier);
 
@@ -1211,6 +1274,16 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
                             ImGui::Text("counter = %d", counter);
 
                             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+                            for (const auto& timing : assetLoader.timings()) {
+                                if (timing.finished) {
+                                    ImGui::Text("%s: queued %.2f ms, load %.2f ms, total %.2f ms",
+                                                timing.name.c_str(), timing.queued, timing.load, timing.total);
+                                }
+                                else {
+                                    ImGui::Text("%s: loading...", timing.name.c_str());
+                                }
+                            }
                             ImGui::End();
                         }
                     }
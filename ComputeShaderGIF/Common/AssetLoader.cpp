@@ -0,0 +1,167 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+
+namespace {
+    double milliseconds(std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+}
+
+AssetLoader::AssetLoader(uint32_t workerCount) {
+    if (workerCount == 0) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    workers.reserve(workerCount);
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+AssetLoader::~AssetLoader() {
+    // 还在排队的任务直接丢弃，正在执行的任务执行完毕后线程退出
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+        tasks.clear();
+    }
+
+    queueCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t AssetLoader::processUploads() {
+    size_t before = pendingUploads.size();
+
+    // 按登记顺序执行，没完成的留到下一帧
+    pendingUploads.erase(std::remove_if(pendingUploads.begin(), pendingUploads.end(),
+        [](std::function<bool()>& upload) { return upload(); }), pendingUploads.end());
+
+    return before - pendingUploads.size();
+}
+
+bool AssetLoader::isBusy() const {
+    if (!pendingUploads.empty()) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    return !tasks.empty() || runningTasks > 0;
+}
+
+std::vector<AssetLoader::Timing> AssetLoader::timings() const {
+    std::lock_guard<std::mutex> lock(timingMutex);
+
+    std::vector<Timing> result;
+    result.reserve(timingRecords.size());
+
+    for (const auto& record : timingRecords) {
+        Timing timing = record.timing;
+
+        if (record.hasUpload) {
+            timing.finished = record.uploaded;
+            timing.total = record.uploaded ? milliseconds(record.uploadEndTime - record.submitTime) : 0.0;
+        }
+        else {
+            timing.finished = record.loaded;
+            timing.total = record.loaded ? milliseconds(record.loadEndTime - record.submitTime) : 0.0;
+        }
+
+        result.push_back(timing);
+    }
+
+    return result;
+}
+
+void AssetLoader::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        tasks.push_back(std::move(task));
+    }
+
+    queueCondition.notify_one();
+}
+
+void AssetLoader::workerLoop() {
+#ifdef _WIN32
+    // WIC解码器需要COM
+    HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (stopping) {
+                break;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            runningTasks++;
+        }
+
+        // packaged_task会捕获异常，这里不会抛出
+        task();
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        runningTasks--;
+    }
+
+#ifdef _WIN32
+    if (SUCCEEDED(comResult)) {
+        CoUninitialize();
+    }
+#endif
+}
+
+size_t AssetLoader::addTiming(const std::string& name) {
+    std::lock_guard<std::mutex> lock(timingMutex);
+
+    TimingRecord record;
+    record.timing.name = name;
+    record.submitTime = Clock::now();
+
+    timingRecords.push_back(record);
+
+    return timingRecords.size() - 1;
+}
+
+void AssetLoader::uploadTiming(size_t timingIndex) {
+    std::lock_guard<std::mutex> lock(timingMutex);
+
+    timingRecords[timingIndex].hasUpload = true;
+}
+
+void AssetLoader::finishLoad(size_t timingIndex, Clock::time_point startTime, Clock::time_point endTime) {
+    std::lock_guard<std::mutex> lock(timingMutex);
+
+    auto& record = timingRecords[timingIndex];
+    record.timing.queued = milliseconds(startTime - record.submitTime);
+    record.timing.load = milliseconds(endTime - startTime);
+    record.loadEndTime = endTime;
+    record.loaded = true;
+}
+
+void AssetLoader::finishUpload(size_t timingIndex, Clock::time_point startTime, Clock::time_point endTime) {
+    std::lock_guard<std::mutex> lock(timingMutex);
+
+    auto& record = timingRecords[timingIndex];
+    record.timing.upload = milliseconds(endTime - startTime);
+    record.uploadEndTime = endTime;
+    record.uploaded = true;
+}
@@ -0,0 +1,144 @@
+#include "FrameDelta.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace FrameDelta {
+    namespace {
+        bool tileChanged(const uint8_t* previous, const uint8_t* current, size_t rowBytes, size_t tileRowBytes, uint32_t rows) {
+            for (uint32_t row = 0; row < rows; row++) {
+                if (memcmp(previous + row * rowBytes, current + row * rowBytes, tileRowBytes) != 0) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void appendRect(const uint8_t* current, uint32_t width, uint32_t bytesPerPixel, const Rect& rect, Delta& delta) {
+            size_t rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+            size_t rectRowBytes = static_cast<size_t>(rect.width) * bytesPerPixel;
+            size_t offset = delta.pixels.size();
+
+            delta.rects.push_back(rect);
+            delta.pixels.resize(offset + rectRowBytes * rect.height);
+
+            for (uint32_t row = 0; row < rect.height; row++) {
+                memcpy(delta.pixels.data() + offset + rectRowBytes * row,
+                       current + rowBytes * (rect.top + row) + static_cast<size_t>(rect.left) * bytesPerPixel,
+                       rectRowBytes);
+            }
+        }
+    }
+
+    void full(const uint8_t* current, uint32_t width, uint32_t height, uint32_t bytesPerPixel, Delta& delta) {
+        delta.rects.clear();
+        delta.pixels.clear();
+        delta.fullBytes = static_cast<size_t>(width) * height * bytesPerPixel;
+
+        Rect rect;
+        rect.width = width;
+        rect.height = height;
+
+        appendRect(current, width, bytesPerPixel, rect, delta);
+    }
+
+    void diff(const uint8_t* previous, const uint8_t* current, uint32_t width, uint32_t height, uint32_t bytesPerPixel,
+              Delta& delta, uint32_t tileSize) {
+        delta.rects.clear();
+        delta.pixels.clear();
+        delta.fullBytes = static_cast<size_t>(width) * height * bytesPerPixel;
+
+        size_t rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+
+        // 上一行块中还可以继续向下延伸的矩形
+        std::vector<Rect> open;
+        std::vector<Rect> runs;
+        std::vector<Rect> closed;
+
+        for (uint32_t tileTop = 0; tileTop < height; tileTop += tileSize) {
+            uint32_t tileRows = std::min(tileSize, height - tileTop);
+
+            runs.clear();
+
+            for (uint32_t tileLeft = 0; tileLeft < width; tileLeft += tileSize) {
+                uint32_t tileWidth = std::min(tileSize, width - tileLeft);
+                size_t offset = rowBytes * tileTop + static_cast<size_t>(tileLeft) * bytesPerPixel;
+
+                if (!tileChanged(previous + offset, current + offset, rowBytes, static_cast<size_t>(tileWidth) * bytesPerPixel, tileRows)) {
+                    continue;
+                }
+
+                if (!runs.empty() && runs.back().left + runs.back().width == tileLeft) {
+                    runs.back().width += tileWidth;
+                }
+                else {
+                    Rect run;
+                    run.left = tileLeft;
+                    run.top = tileTop;
+                    run.width = tileWidth;
+                    run.height = tileRows;
+                    runs.push_back(run);
+                }
+            }
+
+            // 与上一行块中左右范围相同的矩形合并，其余的矩形到此结束
+            std::vector<Rect> nextOpen;
+
+            for (auto& run : runs) {
+                auto match = std::find_if(open.begin(), open.end(), [&run](const Rect& rect) {
+                    return rect.left == run.left && rect.width == run.width;
+                });
+
+                if (match != open.end()) {
+                    match->height += run.height;
+                    nextOpen.push_back(*match);
+                    match->width = 0;
+                }
+                else {
+                    nextOpen.push_back(run);
+                }
+            }
+
+            for (const auto& rect : open) {
+                if (rect.width != 0) {
+                    closed.push_back(rect);
+                }
+            }
+
+            open.swap(nextOpen);
+        }
+
+        closed.insert(closed.end(), open.begin(), open.end());
+
+        // 变化的部分超过整帧的fullFrameRatio时整帧上传，一次复制比很多个小矩形更划算
+        uint64_t dirtyPixels = 0;
+
+        for (const auto& rect : closed) {
+            dirtyPixels += static_cast<uint64_t>(rect.width) * rect.height;
+        }
+
+        if (dirtyPixels * fullFrameRatio[1] >= static_cast<uint64_t>(width) * height * fullFrameRatio[0]) {
+            full(current, width, height, bytesPerPixel, delta);
+            return;
+        }
+
+        for (const auto& rect : closed) {
+            appendRect(current, width, bytesPerPixel, rect, delta);
+        }
+    }
+
+    void apply(const Delta& delta, uint8_t* frame, uint32_t width, uint32_t bytesPerPixel) {
+        size_t rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+        const uint8_t* source = delta.pixels.data();
+
+        for (const auto& rect : delta.rects) {
+            size_t rectRowBytes = static_cast<size_t>(rect.width) * bytesPerPixel;
+
+            for (uint32_t row = 0; row < rect.height; row++) {
+                memcpy(frame + rowBytes * (rect.top + row) + static_cast<size_t>(rect.left) * bytesPerPixel, source, rectRowBytes);
+                source += rectRowBytes;
+            }
+        }
+    }
+}
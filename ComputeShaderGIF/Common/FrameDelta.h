@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 动画帧的脏矩形增量
+//
+// 把两帧按tileSize x tileSize切成小块逐块比较，同一行中相邻的脏块合并成一段，
+// 上下相邻且左右范围相同的段再合并成一个矩形。上传时只需要复制这些矩形，
+// 没有变化的部分直接沿用纹理中已有的内容。
+//
+// 像素按bytesPerPixel字节处理，R8G8B8A8和调色板格式的R8索引都可以用。
+namespace FrameDelta {
+    const uint32_t defaultTileSize = 16;
+    // 脏矩形的面积达到整帧的3/4时直接整帧上传
+    const uint32_t fullFrameRatio[2] = { 3, 4 };
+
+    struct Rect {
+        uint32_t left = 0;
+        uint32_t top = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    struct Delta {
+        std::vector<Rect> rects;
+        // 每个矩形的像素按rects的顺序紧密排列，行宽为width * bytesPerPixel
+        std::vector<uint8_t> pixels;
+        // 整帧的字节数，用来与增量的字节数比较
+        size_t fullBytes = 0;
+
+        bool empty() const { return rects.empty(); }
+        size_t deltaBytes() const { return pixels.size(); }
+    };
+
+    // 整帧作为一个矩形，用于第一帧或者纹理中还没有内容的时候
+    void full(const uint8_t* current, uint32_t width, uint32_t height, uint32_t bytesPerPixel, Delta& delta);
+
+    // 比较previous和current，两帧相同时delta.rects为空，变化太多时是整帧一个矩形
+    void diff(const uint8_t* previous, const uint8_t* current, uint32_t width, uint32_t height, uint32_t bytesPerPixel,
+              Delta& delta, uint32_t tileSize = defaultTileSize);
+
+    // 把增量应用到frame上，CPU端的参考实现
+    void apply(const Delta& delta, uint8_t* frame, uint32_t width, uint32_t bytesPerPixel);
+}
@@ -46,11 +46,19 @@ namespace FrameUtil {
         uint32_t indexCount = 0;
         uint32_t startIndexLocation = 0;
         int32_t baseVertexLocation = 0;
+
+        // 纹理坐标的缩放(xy)和偏移(zw)，用来采样图集中的一块区域
+        XMFLOAT4 uvTransform = XMFLOAT4(1.0f, 1.0f, 0.0f, 0.0f);
+
+        // 采样的纹理在textures[]中的索引
+        uint32_t textureIndex = 0;
     };
 
     // 单个物体的物体常量数据(不变的)
     struct ObjectConstants {
         XMFLOAT4X4 world = MathHelper::Identity4x4(); 
+        XMFLOAT4 uvTransform = XMFLOAT4(1.0f, 1.0f, 0.0f, 0.0f);
+        uint32_t textureIndex = 0;
     };
 
     //单个物体的过程常量数据(每帧变化)
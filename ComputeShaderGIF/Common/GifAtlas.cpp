@@ -0,0 +1,341 @@
+#include "GifAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    double milliseconds(std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // 把画布复制到四周各多出border像素的图块中，边框填充最近的边缘像素
+    void copyWithBorder(const uint32_t* canvas, uint32_t canvasWidth, uint32_t canvasHeight, uint32_t border, std::vector<uint32_t>& tile) {
+        uint32_t tileWidth = canvasWidth + border * 2;
+        uint32_t tileHeight = canvasHeight + border * 2;
+
+        tile.resize(static_cast<size_t>(tileWidth) * tileHeight);
+
+        for (uint32_t y = 0; y < tileHeight; y++) {
+            uint32_t sourceY = std::min(std::max(y, border) - border, canvasHeight - 1);
+            const uint32_t* sourceRow = canvas + static_cast<size_t>(sourceY) * canvasWidth;
+            uint32_t* row = tile.data() + static_cast<size_t>(y) * tileWidth;
+
+            std::fill(row, row + border, sourceRow[0]);
+            memcpy(row + border, sourceRow, canvasWidth * sizeof(uint32_t));
+            std::fill(row + border + canvasWidth, row + tileWidth, sourceRow[canvasWidth - 1]);
+        }
+    }
+}
+
+GifAtlas::GifAtlas(uint32_t inWidth, uint32_t inHeight, uint32_t workerCount) : width(inWidth), height(inHeight) {
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    workers.reserve(workerCount);
+
+    for (uint32_t worker = 0; worker < workerCount; worker++) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    stats.workers = workerCount;
+    batch.fullBytes = static_cast<size_t>(width) * height * sizeof(uint32_t);
+}
+
+GifAtlas::~GifAtlas() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+
+    jobCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+int32_t GifAtlas::add(const GifDecoder::GIF& gif) {
+    if (gif.frames.empty() || gif.pixelWidth == 0 || gif.pixelHeight == 0) {
+        return -1;
+    }
+
+    uint32_t paddedWidth = gif.pixelWidth + padding * 2;
+    uint32_t paddedHeight = gif.pixelHeight + padding * 2;
+
+    if (paddedWidth > width) {
+        return -1;
+    }
+
+    // 放进第一个高度足够且剩余宽度足够的货架，都放不下时在最下面开一个新货架
+    Shelf* target = nullptr;
+
+    for (auto& shelf : shelves) {
+        if (shelf.height >= paddedHeight && width - shelf.used >= paddedWidth) {
+            target = &shelf;
+            break;
+        }
+    }
+
+    if (target == nullptr) {
+        uint32_t top = shelves.empty() ? 0 : shelves.back().top + shelves.back().height;
+
+        if (paddedHeight > height - top) {
+            return -1;
+        }
+
+        Shelf shelf;
+        shelf.top = top;
+        shelf.height = paddedHeight;
+        shelves.push_back(shelf);
+
+        target = &shelves.back();
+    }
+
+    auto animation = std::make_unique<Animation>();
+
+    animation->gif = gif;
+    animation->gif.frameCount = static_cast<uint32_t>(gif.frames.size());
+
+    animation->rect.left = target->used + padding;
+    animation->rect.top = target->top + padding;
+    animation->rect.width = gif.pixelWidth;
+    animation->rect.height = gif.pixelHeight;
+
+    target->used += paddedWidth;
+
+    animation->frameStartMS.reserve(gif.frames.size() + 1);
+    animation->frameStartMS.push_back(0.0);
+
+    for (const auto& frame : gif.frames) {
+        animation->frameStartMS.push_back(animation->frameStartMS.back() + frame.delay);
+    }
+
+    animation->totalSequences = gif.hasLoop ? static_cast<uint64_t>(gif.totalLoopCount) * animation->gif.frameCount : 0;
+    animation->compositor.reset(animation->gif);
+
+    animations.push_back(std::move(animation));
+    stats.animations = static_cast<uint32_t>(animations.size());
+
+    return static_cast<int32_t>(animations.size() - 1);
+}
+
+uint64_t GifAtlas::sequenceAt(const Animation& animation, double elapsedMS) const {
+    double loopMS = animation.frameStartMS.back();
+
+    // 所有帧的delay都是0时一直显示第0帧
+    if (loopMS <= 0.0) {
+        return 0;
+    }
+
+    uint64_t loop = static_cast<uint64_t>(elapsedMS / loopMS);
+    double inLoopMS = elapsedMS - static_cast<double>(loop) * loopMS;
+
+    // 第一个开始时间大于inLoopMS的帧的前一帧
+    auto it = std::upper_bound(animation.frameStartMS.begin(), animation.frameStartMS.end() - 1, inLoopMS);
+    uint64_t index = static_cast<uint64_t>(std::max<ptrdiff_t>(it - animation.frameStartMS.begin() - 1, 0));
+
+    uint64_t sequence = loop * animation.gif.frameCount + index;
+
+    if (animation.totalSequences > 0) {
+        sequence = std::min(sequence, animation.totalSequences - 1);
+    }
+
+    return sequence;
+}
+
+const FrameDelta::Delta& GifAtlas::update(double timeMS) {
+    auto startTime = Clock::now();
+
+    changed.clear();
+
+    for (auto& animation : animations) {
+        if (animation->failed) {
+            continue;
+        }
+
+        if (!animation->started) {
+            animation->started = true;
+            animation->startTimeMS = timeMS;
+        }
+
+        uint64_t target = sequenceAt(*animation, std::max(timeMS - animation->startTimeMS, 0.0));
+
+        if (animation->hasComposited && target < animation->nextSequence) {
+            continue;
+        }
+
+        animation->targetSequence = target;
+        changed.push_back(animation.get());
+    }
+
+    runJobs();
+
+    // 按动画编号的顺序合并，批次的内容与线程数无关
+    batch.rects.clear();
+    batch.pixels.clear();
+
+    uint32_t compositedFrames = 0;
+    uint32_t failedAnimations = 0;
+
+    for (Animation* animation : changed) {
+        compositedFrames += animation->compositedFrames;
+
+        if (animation->failed) {
+            continue;
+        }
+
+        size_t offset = batch.pixels.size();
+
+        batch.pixels.resize(offset + animation->delta.pixels.size());
+        memcpy(batch.pixels.data() + offset, animation->delta.pixels.data(), animation->delta.pixels.size());
+
+        for (auto rect : animation->delta.rects) {
+            rect.left += animation->rect.left - padding;
+            rect.top += animation->rect.top - padding;
+            batch.rects.push_back(rect);
+        }
+    }
+
+    for (const auto& animation : animations) {
+        failedAnimations += animation->failed ? 1 : 0;
+    }
+
+    stats.changedAnimations = static_cast<uint32_t>(changed.size());
+    stats.compositedFrames = compositedFrames;
+    stats.failedAnimations = failedAnimations;
+    stats.lastUploadBytes = batch.deltaBytes();
+    stats.lastUploadRects = static_cast<uint32_t>(batch.rects.size());
+    stats.lastUpdateMS = milliseconds(Clock::now() - startTime);
+
+    return batch;
+}
+
+void GifAtlas::advance(Animation& animation) {
+    const uint32_t frameCount = animation.gif.frameCount;
+    uint64_t sequence = animation.nextSequence;
+
+    animation.compositedFrames = 0;
+
+    // 落后整整一遍以上时直接从目标所在那一遍的第0帧开始，第0帧会清空画布，之前的帧不需要合成
+    if (animation.targetSequence / frameCount > sequence / frameCount) {
+        sequence = (animation.targetSequence / frameCount) * frameCount;
+    }
+
+    for (; sequence <= animation.targetSequence; sequence++) {
+        uint32_t index = static_cast<uint32_t>(sequence % frameCount);
+
+        if (!GifDecoder::decodeFrameRGBA(animation.gif, index, animation.framePixels)) {
+            animation.failed = true;
+            return;
+        }
+
+        animation.compositor.composite(index, animation.gif.frames[index], animation.framePixels.data());
+        animation.compositedFrames++;
+    }
+
+    animation.nextSequence = sequence;
+
+    // 边缘像素变化时边框也跟着变化，脏矩形自然会包含对应的边框
+    copyWithBorder(animation.compositor.getCanvas().data(), animation.rect.width, animation.rect.height, padding, animation.tile);
+
+    const uint8_t* current = reinterpret_cast<const uint8_t*>(animation.tile.data());
+    uint32_t tileWidth = animation.rect.width + padding * 2;
+    uint32_t tileHeight = animation.rect.height + padding * 2;
+
+    if (!animation.hasComposited) {
+        FrameDelta::full(current, tileWidth, tileHeight, sizeof(uint32_t), animation.delta);
+        animation.hasComposited = true;
+    }
+    else {
+        FrameDelta::diff(reinterpret_cast<const uint8_t*>(animation.uploadedTile.data()), current,
+                         tileWidth, tileHeight, sizeof(uint32_t), animation.delta);
+    }
+
+    std::swap(animation.uploadedTile, animation.tile);
+}
+
+void GifAtlas::runJobs() {
+    nextJob = 0;
+
+    if (changed.empty()) {
+        return;
+    }
+
+    // 只有一两个动画需要合成时不值得唤醒工作线程
+    bool useWorkers = !workers.empty() && changed.size() > 1;
+
+    if (useWorkers) {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            busyWorkers = static_cast<uint32_t>(workers.size());
+            jobGeneration++;
+        }
+
+        jobCondition.notify_all();
+    }
+
+    for (size_t job = nextJob++; job < changed.size(); job = nextJob++) {
+        advance(*changed[job]);
+    }
+
+    if (useWorkers) {
+        std::unique_lock<std::mutex> lock(jobMutex);
+        doneCondition.wait(lock, [this]() { return busyWorkers == 0; });
+    }
+}
+
+void GifAtlas::workerLoop() {
+    uint64_t seenGeneration = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobCondition.wait(lock, [this, seenGeneration]() { return stopping || jobGeneration != seenGeneration; });
+
+            if (stopping) {
+                return;
+            }
+
+            seenGeneration = jobGeneration;
+        }
+
+        for (size_t job = nextJob++; job < changed.size(); job = nextJob++) {
+            advance(*changed[job]);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+
+            if (--busyWorkers == 0) {
+                doneCondition.notify_one();
+            }
+        }
+    }
+}
+
+GifAtlas::UVRect GifAtlas::getUVRect(uint32_t animation) const {
+    const FrameDelta::Rect& rect = animations[animation]->rect;
+
+    UVRect uvRect;
+    uvRect.u0 = static_cast<float>(rect.left) / static_cast<float>(width);
+    uvRect.v0 = static_cast<float>(rect.top) / static_cast<float>(height);
+    uvRect.u1 = static_cast<float>(rect.left + rect.width) / static_cast<float>(width);
+    uvRect.v1 = static_cast<float>(rect.top + rect.height) / static_cast<float>(height);
+
+    return uvRect;
+}
+
+FrameDelta::Rect GifAtlas::getRect(uint32_t animation) const {
+    return animations[animation]->rect;
+}
+
+uint32_t GifAtlas::getCurrentFrame(uint32_t animation) const {
+    const Animation& state = *animations[animation];
+
+    if (!state.hasComposited) {
+        return 0;
+    }
+
+    return static_cast<uint32_t>((state.nextSequence - 1) % state.gif.frameCount);
+}
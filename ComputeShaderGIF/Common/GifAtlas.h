@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GifDecoder.h"
+#include "GifCompositor.h"
+#include "FrameDelta.h"
+
+// 同时播放大量GIF(比如几百个表情贴纸)
+//
+// 所有动画的画布按货架(shelf)方式排在一张固定大小的R8G8B8A8图集中，每个动画对应图集中的一个矩形，
+// 绘制时用getUVRect()得到的UV范围采样同一张纹理，不需要每个动画一张纹理、一次Dispatch。
+//
+// 所有动画共用一条时间线：每次update()用同一个timeMS算出每个动画此刻应该显示的帧(规则与GifPlayer相同)，
+// 只有帧号变化的动画才会被合成。合成分给常驻的工作线程并行执行，每个动画只由一个线程处理。
+// 合成后与该动画上一次上传的图块(画布加上边框)比较，变化的脏矩形换算成图集坐标，合并成一个上传批次，
+// 一帧只需要一次Map和若干CopyTextureRegion，与ComputeShaderGIF::uploadGIFFrame使用的格式相同。
+//
+// add()和update()都只能在同一个线程(渲染线程)中调用。
+class GifAtlas {
+public:
+    struct UVRect {
+        float u0 = 0.0f;
+        float v0 = 0.0f;
+        float u1 = 0.0f;
+        float v1 = 0.0f;
+    };
+
+    struct Stats {
+        uint32_t animations = 0;
+        // 上一次update()中帧号发生变化的动画数
+        uint32_t changedAnimations = 0;
+        // 上一次update()中合成的帧数，落后时一个动画可能要合成多帧
+        uint32_t compositedFrames = 0;
+        uint32_t failedAnimations = 0;
+        uint32_t workers = 0;
+        double lastUpdateMS = 0.0;
+        size_t lastUploadBytes = 0;
+        uint32_t lastUploadRects = 0;
+    };
+
+    // 每个动画四周各留出的边框像素，填充画布边缘像素的复制(相当于钳制寻址)，
+    // 双线性采样到动画边缘时不会混入相邻动画的颜色
+    static const uint32_t padding = 1;
+
+    // workerCount为0时使用hardware_concurrency() - 1个工作线程，渲染线程自己也参与合成
+    GifAtlas(uint32_t inWidth, uint32_t inHeight, uint32_t workerCount = 0);
+    ~GifAtlas();
+
+    GifAtlas(const GifAtlas& rhs) = delete;
+    GifAtlas& operator=(const GifAtlas& rhs) = delete;
+
+    // 返回动画的编号，图集放不下或者GIF没有帧时返回-1。
+    // 动画从下一次update()开始计时，第一次update()时整张画布都会进入上传批次
+    int32_t add(const GifDecoder::GIF& gif);
+
+    // 推进所有动画并返回这一帧需要上传到图集纹理的内容，返回的引用在下一次update()之前有效。
+    // 批次为空(rects为空)时图集不需要更新
+    const FrameDelta::Delta& update(double timeMS);
+
+    UVRect getUVRect(uint32_t animation) const;
+    FrameDelta::Rect getRect(uint32_t animation) const;
+
+    // 动画当前显示的帧号
+    uint32_t getCurrentFrame(uint32_t animation) const;
+
+    uint32_t getWidth() const { return width; }
+    uint32_t getHeight() const { return height; }
+
+    Stats getStats() const { return stats; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Animation {
+        GifDecoder::GIF gif;
+        // 画布在图集中的位置，不包括边框
+        FrameDelta::Rect rect;
+
+        // 每一帧在一遍中的开始时间，最后一个元素是一遍的总时长
+        std::vector<double> frameStartMS;
+        // 有限循环时的总帧数，无限循环时为0
+        uint64_t totalSequences = 0;
+
+        bool started = false;
+        double startTimeMS = 0.0;
+
+        // 下一个要合成的帧序号和这一次update()的目标帧序号
+        uint64_t nextSequence = 0;
+        uint64_t targetSequence = 0;
+        bool hasComposited = false;
+        bool failed = false;
+
+        GifCompositor compositor;
+        std::vector<uint32_t> framePixels;
+        // 画布加上四周的边框，脏矩形相对于图块的左上角
+        std::vector<uint32_t> tile;
+        // 上一次上传的图块，用来计算脏矩形
+        std::vector<uint32_t> uploadedTile;
+        FrameDelta::Delta delta;
+        uint32_t compositedFrames = 0;
+    };
+
+    struct Shelf {
+        uint32_t top = 0;
+        uint32_t height = 0;
+        uint32_t used = 0;
+    };
+
+    uint64_t sequenceAt(const Animation& animation, double elapsedMS) const;
+
+    // 把animation合成到targetSequence并计算脏矩形，在工作线程中执行
+    void advance(Animation& animation);
+
+    void runJobs();
+    void workerLoop();
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    std::vector<std::unique_ptr<Animation>> animations;
+    std::vector<Shelf> shelves;
+
+    // 这一次update()中需要合成的动画
+    std::vector<Animation*> changed;
+    FrameDelta::Delta batch;
+
+    std::vector<std::thread> workers;
+    std::mutex jobMutex;
+    std::condition_variable jobCondition;
+    std::condition_variable doneCondition;
+    uint64_t jobGeneration = 0;
+    uint32_t busyWorkers = 0;
+    bool stopping = false;
+    std::atomic<size_t> nextJob{0};
+
+    Stats stats;
+};
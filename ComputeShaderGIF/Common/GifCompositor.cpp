@@ -0,0 +1,149 @@
+#include "GifCompositor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define GIF_COMPOSITOR_SSE2 1
+#endif
+
+namespace {
+    const uint32_t alphaMask = 0xff000000u;
+
+    // 0xAARRGGBB -> R8G8B8A8
+    uint32_t argbToRGBA(uint32_t color) {
+        return ((color >> 16) & 0xff)
+            | (color & 0x0000ff00u)
+            | ((color & 0xff) << 16)
+            | (color & alphaMask);
+    }
+
+    // dest = src.a ? src : dest
+    void keyedCopyRow(uint32_t* dest, const uint32_t* src, uint32_t count) {
+        uint32_t i = 0;
+
+#ifdef GIF_COMPOSITOR_SSE2
+        const __m128i mask = _mm_set1_epi32(static_cast<int>(alphaMask));
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; i + 4 <= count; i += 4) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+
+            // 透明像素的通道全为1
+            __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(s, mask), zero);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                             _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, s)));
+        }
+#endif
+
+        for (; i < count; i++) {
+            if (src[i] & alphaMask) {
+                dest[i] = src[i];
+            }
+        }
+    }
+
+    // dest = src.a ? src : fill
+    void keyedFillRow(uint32_t* dest, const uint32_t* src, uint32_t count, uint32_t fill) {
+        uint32_t i = 0;
+
+#ifdef GIF_COMPOSITOR_SSE2
+        const __m128i mask = _mm_set1_epi32(static_cast<int>(alphaMask));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i f = _mm_set1_epi32(static_cast<int>(fill));
+
+        for (; i + 4 <= count; i += 4) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(s, mask), zero);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                             _mm_or_si128(_mm_and_si128(transparent, f), _mm_andnot_si128(transparent, s)));
+        }
+#endif
+
+        for (; i < count; i++) {
+            dest[i] = (src[i] & alphaMask) ? src[i] : fill;
+        }
+    }
+}
+
+void GifCompositor::reset(uint32_t inWidth, uint32_t inHeight, uint32_t backgroundColor) {
+    width = inWidth;
+    height = inHeight;
+    background = argbToRGBA(backgroundColor);
+
+    canvas.assign(static_cast<size_t>(width) * height, background);
+
+    previousRegion.clear();
+    hasPreviousRegion = false;
+}
+
+void GifCompositor::reset(const GifDecoder::GIF& gif) {
+    reset(gif.pixelWidth, gif.pixelHeight, gif.backgroundColor);
+}
+
+void GifCompositor::restorePrevious() {
+    if (!hasPreviousRegion) {
+        return;
+    }
+
+    for (uint32_t row = 0; row < previousSize[1]; row++) {
+        memcpy(canvas.data() + static_cast<size_t>(previousLeftTop[1] + row) * width + previousLeftTop[0],
+               previousRegion.data() + static_cast<size_t>(row) * previousSize[0],
+               previousSize[0] * sizeof(uint32_t));
+    }
+
+    hasPreviousRegion = false;
+}
+
+void GifCompositor::composite(uint32_t frameIndex, const GifDecoder::GIFFrame& frame, const uint32_t* pixels) {
+    if (frameIndex == 0) {
+        std::fill(canvas.begin(), canvas.end(), background);
+        hasPreviousRegion = false;
+    }
+    else {
+        restorePrevious();
+    }
+
+    // 裁剪到画布范围内，与UAV越界写入被丢弃的行为一致
+    uint32_t left = frame.leftTop[0];
+    uint32_t top = frame.leftTop[1];
+
+    if (left >= width || top >= height) {
+        return;
+    }
+
+    uint32_t clippedWidth = std::min(frame.size[0], width - left);
+    uint32_t clippedHeight = std::min(frame.size[1], height - top);
+
+    if (frame.disposal == GifDecoder::disposalPrevious) {
+        previousRegion.resize(static_cast<size_t>(clippedWidth) * clippedHeight);
+
+        for (uint32_t row = 0; row < clippedHeight; row++) {
+            memcpy(previousRegion.data() + static_cast<size_t>(row) * clippedWidth,
+                   canvas.data() + static_cast<size_t>(top + row) * width + left,
+                   clippedWidth * sizeof(uint32_t));
+        }
+
+        previousLeftTop[0] = left;
+        previousLeftTop[1] = top;
+        previousSize[0] = clippedWidth;
+        previousSize[1] = clippedHeight;
+        hasPreviousRegion = true;
+    }
+
+    for (uint32_t row = 0; row < clippedHeight; row++) {
+        uint32_t* dest = canvas.data() + static_cast<size_t>(top + row) * width + left;
+        const uint32_t* src = pixels + static_cast<size_t>(row) * frame.size[0];
+
+        if (frame.disposal == GifDecoder::disposalBackground) {
+            keyedFillRow(dest, src, clippedWidth, background);
+        }
+        else {
+            keyedCopyRow(dest, src, clippedWidth);
+        }
+    }
+}
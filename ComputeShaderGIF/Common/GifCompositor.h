@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GifDecoder.h"
+
+// 在CPU上执行与Shaders/ProcessGIF_CS.hlsl相同的GIF帧合成，可以用来校验Compute Shader的结果，
+// 或者在不能使用Compute Shader时代替它。
+//
+// 画布和帧像素都是R8G8B8A8(R在最低字节)，帧像素直接使用GifDecoder::decodeFrameRGBA的结果。
+// 合成规则与Shader相同：
+//   第0帧先用背景色清空画布
+//   disposalBackground：帧中不透明的像素覆盖画布，透明的像素填背景色
+//   disposalPrevious：按Alpha覆盖画布，合成下一帧之前把这一帧覆盖的区域恢复成绘制前的内容
+//                     (Shader中这里只是一个自赋值，相当于不绘制这一帧)
+//   其他取值：帧中不透明的像素覆盖画布，透明的像素保留画布原来的内容
+//
+// 每一行按16字节(4个像素)一组用SSE2做选择，超出画布的部分会被裁掉。
+class GifCompositor {
+public:
+    // backgroundColor为0xAARRGGBB，与GifDecoder::GIF::backgroundColor相同
+    void reset(uint32_t width, uint32_t height, uint32_t backgroundColor);
+    void reset(const GifDecoder::GIF& gif);
+
+    // frameIndex为0时先清空画布，pixels为frame.size[0] * frame.size[1]个像素
+    void composite(uint32_t frameIndex, const GifDecoder::GIFFrame& frame, const uint32_t* pixels);
+
+    uint32_t getWidth() const { return width; }
+    uint32_t getHeight() const { return height; }
+
+    const std::vector<uint32_t>& getCanvas() const { return canvas; }
+
+private:
+    void restorePrevious();
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t background = 0;
+
+    std::vector<uint32_t> canvas;
+
+    // disposalPrevious帧绘制前被覆盖区域的内容
+    std::vector<uint32_t> previousRegion;
+    uint32_t previousLeftTop[2] = {};
+    uint32_t previousSize[2] = {};
+    bool hasPreviousRegion = false;
+};
@@ -0,0 +1,451 @@
+#include "GifDecoder.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace GifDecoder {
+    namespace {
+        const uint32_t maxCodeSize = 12;
+        const uint32_t maxCodes = 1 << maxCodeSize;
+
+        class Reader {
+        public:
+            Reader(const uint8_t* inData, size_t inSize) : data(inData), size(inSize) {}
+
+            bool has(size_t count) const { return size - position >= count; }
+
+            uint8_t u8() { return data[position++]; }
+
+            uint16_t u16() {
+                uint16_t value = static_cast<uint16_t>(data[position] | (data[position + 1] << 8));
+                position += 2;
+                return value;
+            }
+
+            // 跳过一串数据子块，直到长度为0的结束块
+            bool skipSubBlocks() {
+                while (has(1)) {
+                    uint8_t blockSize = u8();
+
+                    if (blockSize == 0) {
+                        return true;
+                    }
+
+                    if (!has(blockSize)) {
+                        return false;
+                    }
+
+                    position += blockSize;
+                }
+
+                return false;
+            }
+
+            const uint8_t* data;
+            size_t size;
+            size_t position = 0;
+        };
+
+        bool readPalette(Reader& reader, uint32_t colorCount, Palette& palette) {
+            if (!reader.has(colorCount * 3)) {
+                return false;
+            }
+
+            palette.colorCount = colorCount;
+
+            for (uint32_t i = 0; i < colorCount; i++) {
+                uint32_t r = reader.u8();
+                uint32_t g = reader.u8();
+                uint32_t b = reader.u8();
+
+                palette.colors[i] = r | (g << 8) | (b << 16) | 0xff000000u;
+            }
+
+            return true;
+        }
+
+        // 把数据子块拼接成连续的码流，末尾多留8个0字节，读码时不用检查边界
+        void gatherSubBlocks(const uint8_t* data, size_t size, size_t position, std::vector<uint8_t>& stream) {
+            stream.clear();
+
+            while (position < size) {
+                uint8_t blockSize = data[position++];
+
+                if (blockSize == 0 || size - position < blockSize) {
+                    break;
+                }
+
+                stream.insert(stream.end(), data + position, data + position + blockSize);
+                position += blockSize;
+            }
+
+            stream.resize(stream.size() + 8, 0);
+        }
+
+        // 表驱动的LZW解码：每个码记录前缀码、末尾字节、首字节和串长，输出时
+        // 已知串长，所以沿前缀链从后往前直接写到输出位置，不需要额外的栈
+        size_t decodeLZW(const uint8_t* stream, size_t streamSize, uint32_t minCodeSize, uint8_t* output, size_t outputSize) {
+            uint16_t prefix[maxCodes];
+            uint8_t suffix[maxCodes];
+            uint8_t first[maxCodes];
+            uint16_t length[maxCodes];
+
+            const uint32_t clearCode = 1u << minCodeSize;
+            const uint32_t endCode = clearCode + 1;
+
+            for (uint32_t code = 0; code < clearCode; code++) {
+                prefix[code] = 0;
+                suffix[code] = static_cast<uint8_t>(code);
+                first[code] = static_cast<uint8_t>(code);
+                length[code] = 1;
+            }
+
+            uint32_t codeSize = minCodeSize + 1;
+            uint32_t codeMask = (1u << codeSize) - 1;
+            uint32_t nextCode = clearCode + 2;
+            uint32_t previousCode = maxCodes;
+
+            uint64_t bitBuffer = 0;
+            uint32_t bitCount = 0;
+            size_t streamPosition = 0;
+            size_t outputPosition = 0;
+
+            while (outputPosition < outputSize) {
+                while (bitCount < codeSize) {
+                    if (streamPosition >= streamSize) {
+                        return outputPosition;
+                    }
+
+                    bitBuffer |= static_cast<uint64_t>(stream[streamPosition++]) << bitCount;
+                    bitCount += 8;
+                }
+
+                uint32_t code = static_cast<uint32_t>(bitBuffer) & codeMask;
+                bitBuffer >>= codeSize;
+                bitCount -= codeSize;
+
+                if (code == clearCode) {
+                    codeSize = minCodeSize + 1;
+                    codeMask = (1u << codeSize) - 1;
+                    nextCode = clearCode + 2;
+                    previousCode = maxCodes;
+                    continue;
+                }
+
+                if (code == endCode) {
+                    break;
+                }
+
+                uint32_t outputCode = code;
+
+                if (previousCode == maxCodes) {
+                    // 清除码之后的第一个码必须是单个字节
+                    if (code >= clearCode) {
+                        break;
+                    }
+                }
+                else if (code <= nextCode && nextCode < maxCodes) {
+                    // code == nextCode是KwKwK的情况：新串是前一个串加上前一个串的首字节
+                    uint8_t firstByte = code < nextCode ? first[code] : first[previousCode];
+
+                    prefix[nextCode] = static_cast<uint16_t>(previousCode);
+                    suffix[nextCode] = firstByte;
+                    first[nextCode] = first[previousCode];
+                    length[nextCode] = static_cast<uint16_t>(length[previousCode] + 1);
+                    nextCode++;
+
+                    if (nextCode > codeMask && codeSize < maxCodeSize) {
+                        codeSize++;
+                        codeMask = (1u << codeSize) - 1;
+                    }
+                }
+                else if (code >= nextCode) {
+                    // 码表已满(只能继续使用已有的码)或者是无效的码
+                    break;
+                }
+
+                uint32_t stringLength = length[outputCode];
+                uint32_t current = outputCode;
+
+                if (outputPosition + stringLength <= outputSize) {
+                    uint8_t* destination = output + outputPosition;
+
+                    for (uint32_t i = stringLength; i > 1; i--) {
+                        destination[i - 1] = suffix[current];
+                        current = prefix[current];
+                    }
+
+                    destination[0] = suffix[current];
+                    outputPosition += stringLength;
+                }
+                else {
+                    // 数据比帧大的部分丢弃
+                    for (uint32_t i = stringLength; i > 0; i--) {
+                        if (outputPosition + i - 1 < outputSize) {
+                            output[outputPosition + i - 1] = suffix[current];
+                        }
+
+                        current = prefix[current];
+                    }
+
+                    outputPosition = outputSize;
+                }
+
+                previousCode = code;
+            }
+
+            return outputPosition;
+        }
+    }
+
+    bool load(const std::string& fileName, GIF& gif, uint32_t defaultBackgroundColor) {
+        std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+
+        if (!file) {
+            return false;
+        }
+
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+
+        std::vector<uint8_t> data(static_cast<size_t>(size));
+
+        if (!file.read(reinterpret_cast<char*>(data.data()), size)) {
+            return false;
+        }
+
+        if (!parse(data.data(), data.size(), gif, defaultBackgroundColor)) {
+            return false;
+        }
+
+        gif.fileData = std::move(data);
+
+        return true;
+    }
+
+    bool parse(const uint8_t* data, size_t size, GIF& gif, uint32_t defaultBackgroundColor) {
+        gif = GIF();
+
+        Reader reader(data, size);
+
+        if (!reader.has(13) || (memcmp(data, "GIF87a", 6) != 0 && memcmp(data, "GIF89a", 6) != 0)) {
+            return false;
+        }
+
+        reader.position = 6;
+
+        gif.width = reader.u16();
+        gif.height = reader.u16();
+
+        uint8_t flags = reader.u8();
+        gif.backgroundIndex = reader.u8();
+        uint8_t pixelAspectRatio = reader.u8();
+
+        gif.hasGlobalPalette = (flags & 0x80) != 0;
+
+        if (gif.hasGlobalPalette && !readPalette(reader, 2u << (flags & 0x07), gif.globalPalette)) {
+            return false;
+        }
+
+        // 背景色转换成WICColor的ARGB顺序
+        if (gif.hasGlobalPalette && gif.backgroundIndex < gif.globalPalette.colorCount) {
+            uint32_t color = gif.globalPalette.colors[gif.backgroundIndex];
+            gif.backgroundColor = 0xff000000u | ((color & 0xff) << 16) | (color & 0xff00) | ((color >> 16) & 0xff);
+        }
+        else {
+            gif.backgroundColor = defaultBackgroundColor;
+        }
+
+        if (pixelAspectRatio != 0) {
+            float aspectRatio = (pixelAspectRatio + 15.0f) / 64.0f;
+
+            if (aspectRatio > 1.0f) {
+                gif.pixelWidth = gif.width;
+                gif.pixelHeight = static_cast<uint32_t>(gif.height / aspectRatio);
+            }
+            else {
+                gif.pixelWidth = static_cast<uint32_t>(gif.width * aspectRatio);
+                gif.pixelHeight = gif.height;
+            }
+        }
+        else {
+            gif.pixelWidth = gif.width;
+            gif.pixelHeight = gif.height;
+        }
+
+        // 图形控制扩展作用于紧随其后的一帧
+        GIFFrame pending;
+
+        while (reader.has(1)) {
+            uint8_t blockType = reader.u8();
+
+            if (blockType == 0x3b) {
+                break;
+            }
+
+            if (blockType == 0x21) {
+                if (!reader.has(1)) {
+                    return false;
+                }
+
+                uint8_t label = reader.u8();
+
+                if (label == 0xf9 && reader.has(6) && data[reader.position] == 4) {
+                    reader.position++;
+
+                    uint8_t controlFlags = reader.u8();
+                    uint32_t delay = reader.u16();
+                    uint8_t transparentIndex = reader.u8();
+
+                    pending.disposal = (controlFlags >> 2) & 0x07;
+                    pending.delay = delay * 10;
+                    pending.transparentIndex = (controlFlags & 0x01) ? transparentIndex : noTransparency;
+                }
+                else if (label == 0xff && reader.has(12) && data[reader.position] == 11) {
+                    const uint8_t* identifier = data + reader.position + 1;
+
+                    reader.position += 12;
+
+                    // NETSCAPE2.0/ANIMEXTS1.0的第一个子块：01 循环次数(16位)
+                    if ((memcmp(identifier, "NETSCAPE2.0", 11) == 0 || memcmp(identifier, "ANIMEXTS1.0", 11) == 0)
+                        && reader.has(4) && data[reader.position] >= 3 && data[reader.position + 1] == 1) {
+                        gif.totalLoopCount = data[reader.position + 2] | (data[reader.position + 3] << 8);
+                        gif.hasLoop = gif.totalLoopCount != 0;
+                    }
+                }
+
+                if (!reader.skipSubBlocks()) {
+                    return false;
+                }
+
+                continue;
+            }
+
+            if (blockType != 0x2c || !reader.has(9)) {
+                return false;
+            }
+
+            GIFFrame frame = pending;
+            pending = GIFFrame();
+
+            frame.leftTop[0] = reader.u16();
+            frame.leftTop[1] = reader.u16();
+            frame.size[0] = reader.u16();
+            frame.size[1] = reader.u16();
+
+            uint8_t imageFlags = reader.u8();
+
+            frame.interlaced = (imageFlags & 0x40) != 0;
+            frame.hasLocalPalette = (imageFlags & 0x80) != 0;
+
+            if (frame.hasLocalPalette && !readPalette(reader, 2u << (imageFlags & 0x07), frame.localPalette)) {
+                return false;
+            }
+
+            if (frame.delay == 0) {
+                frame.delay = 100;
+            }
+
+            frame.dataOffset = reader.position;
+
+            if (!reader.has(1)) {
+                return false;
+            }
+
+            reader.position++;
+
+            if (!reader.skipSubBlocks()) {
+                return false;
+            }
+
+            gif.frames.push_back(frame);
+        }
+
+        gif.frameCount = static_cast<uint32_t>(gif.frames.size());
+
+        return gif.frameCount > 0;
+    }
+
+    const Palette& framePalette(const GIF& gif, const GIFFrame& frame) {
+        return frame.hasLocalPalette ? frame.localPalette : gif.globalPalette;
+    }
+
+    bool decodeFrameIndices(const GIF& gif, uint32_t frameIndex, std::vector<uint8_t>& indices) {
+        if (frameIndex >= gif.frames.size()) {
+            return false;
+        }
+
+        const GIFFrame& frame = gif.frames[frameIndex];
+        const uint8_t* data = gif.fileData.data();
+        size_t size = gif.fileData.size();
+
+        if (frame.dataOffset >= size) {
+            return false;
+        }
+
+        uint32_t minCodeSize = data[frame.dataOffset];
+
+        if (minCodeSize < 1 || minCodeSize > 11) {
+            return false;
+        }
+
+        std::vector<uint8_t> stream;
+        gatherSubBlocks(data, size, frame.dataOffset + 1, stream);
+
+        size_t width = frame.size[0];
+        size_t height = frame.size[1];
+
+        indices.assign(width * height, 0);
+
+        if (!frame.interlaced) {
+            decodeLZW(stream.data(), stream.size() - 8, minCodeSize, indices.data(), indices.size());
+            return true;
+        }
+
+        // 交错存储：第1遍每8行从第0行开始，第2遍每8行从第4行开始，第3遍每4行从第2行开始，第4遍每2行从第1行开始
+        std::vector<uint8_t> interlaced(width * height, 0);
+        decodeLZW(stream.data(), stream.size() - 8, minCodeSize, interlaced.data(), interlaced.size());
+
+        static const size_t passStart[4] = { 0, 4, 2, 1 };
+        static const size_t passStep[4] = { 8, 8, 4, 2 };
+
+        const uint8_t* source = interlaced.data();
+
+        for (int pass = 0; pass < 4; pass++) {
+            for (size_t row = passStart[pass]; row < height; row += passStep[pass]) {
+                memcpy(indices.data() + row * width, source, width);
+                source += width;
+            }
+        }
+
+        return true;
+    }
+
+    bool decodeFrameRGBA(const GIF& gif, uint32_t frameIndex, std::vector<uint32_t>& pixels) {
+        std::vector<uint8_t> indices;
+
+        if (!decodeFrameIndices(gif, frameIndex, indices)) {
+            return false;
+        }
+
+        const GIFFrame& frame = gif.frames[frameIndex];
+
+        // 调色板展开成256项的查找表，透明索引和调色板之外的索引都是0
+        uint32_t lookup[256] = {};
+        const Palette& palette = framePalette(gif, frame);
+
+        memcpy(lookup, palette.colors, palette.colorCount * sizeof(uint32_t));
+
+        if (frame.transparentIndex != noTransparency) {
+            lookup[frame.transparentIndex] = 0;
+        }
+
+        pixels.resize(indices.size());
+
+        for (size_t i = 0; i < indices.size(); i++) {
+            pixels[i] = lookup[indices[i]];
+        }
+
+        return true;
+    }
+}
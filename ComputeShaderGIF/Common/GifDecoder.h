@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 不依赖WIC的GIF解码器
+//
+// load/parse只解析文件结构(逻辑屏幕描述、调色板、图形控制扩展、图像描述)，
+// 不解压任何像素；decodeFrameIndices按需解压某一帧的LZW数据得到调色板索引，
+// decodeFrameRGBA再用局部或者全局调色板展开成与WIC转换结果相同的R8G8B8A8像素
+// (透明索引的alpha为0)。
+namespace GifDecoder {
+    // 取值与WICUtils.h中的DisposalMethod相同
+    const uint32_t disposalUndefined = 0;
+    const uint32_t disposalNone = 1;
+    const uint32_t disposalBackground = 2;
+    const uint32_t disposalPrevious = 3;
+
+    const int32_t noTransparency = -1;
+
+    struct Palette {
+        uint32_t colorCount = 0;
+        // R8G8B8A8，R在最低字节
+        uint32_t colors[256] = {};
+    };
+
+    // 与WICUtils.h中GIFFrame的帧信息一一对应
+    struct GIFFrame {
+        uint32_t disposal = disposalUndefined;
+        // 毫秒，文件中为0时按100毫秒处理
+        uint32_t delay = 0;
+        uint32_t leftTop[2] = {};
+        uint32_t size[2] = {};
+        int32_t transparentIndex = noTransparency;
+        bool interlaced = false;
+        bool hasLocalPalette = false;
+        Palette localPalette;
+
+        // LZW最小码长所在的位置，后面是数据子块
+        size_t dataOffset = 0;
+    };
+
+    // 与WICUtils.h中GIF的全局信息一一对应
+    struct GIF {
+        // 0xAARRGGBB，与WICColor相同，可以直接使用ARGB_R等宏
+        uint32_t backgroundColor = 0;
+        uint32_t backgroundIndex = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t pixelWidth = 0;
+        uint32_t pixelHeight = 0;
+        uint32_t totalLoopCount = 0;
+        uint32_t frameCount = 0;
+        bool hasLoop = false;
+        bool hasGlobalPalette = false;
+        Palette globalPalette;
+
+        std::vector<GIFFrame> frames;
+
+        // 播放状态，由使用者维护，解码器不会修改
+        uint32_t currentFrame = 0;
+
+        // 整个文件的内容，解码帧时从这里读取LZW数据
+        std::vector<uint8_t> fileData;
+    };
+
+    bool load(const std::string& fileName, GIF& gif, uint32_t defaultBackgroundColor = 0u);
+    bool parse(const uint8_t* data, size_t size, GIF& gif, uint32_t defaultBackgroundColor = 0u);
+
+    // 帧所使用的调色板：有局部调色板时用局部的，否则用全局的
+    const Palette& framePalette(const GIF& gif, const GIFFrame& frame);
+
+    // 解压第frameIndex帧的调色板索引，size[0] * size[1]个，交错存储的帧已经按正常行序排列。
+    // 数据提前结束时剩余像素填0
+    bool decodeFrameIndices(const GIF& gif, uint32_t frameIndex, std::vector<uint8_t>& indices);
+
+    // 解压并展开成R8G8B8A8像素，透明索引的像素为0
+    bool decodeFrameRGBA(const GIF& gif, uint32_t frameIndex, std::vector<uint32_t>& pixels);
+}
@@ -0,0 +1,192 @@
+#include "GifPlayer.h"
+
+#include <algorithm>
+
+namespace {
+    double milliseconds(std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+}
+
+GifPlayer::GifPlayer(const GifDecoder::GIF& inGIF, uint32_t inRingSize) : gif(inGIF) {
+    gif.frameCount = static_cast<uint32_t>(gif.frames.size());
+
+    frameStartMS.reserve(gif.frames.size() + 1);
+    frameStartMS.push_back(0.0);
+
+    for (const auto& frame : gif.frames) {
+        frameStartMS.push_back(frameStartMS.back() + frame.delay);
+    }
+
+    totalSequences = gif.hasLoop ? static_cast<uint64_t>(gif.totalLoopCount) * gif.frameCount : 0;
+
+    ring.resize(std::max(inRingSize, 1u));
+    stats.ringSize = static_cast<uint32_t>(ring.size());
+
+    if (gif.frameCount == 0) {
+        failed = true;
+        return;
+    }
+
+    decoder = std::thread([this]() { decodeLoop(); });
+}
+
+GifPlayer::~GifPlayer() {
+    {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        stopping = true;
+    }
+
+    ringCondition.notify_all();
+
+    if (decoder.joinable()) {
+        decoder.join();
+    }
+}
+
+uint64_t GifPlayer::sequenceAt(double elapsedMS) const {
+    double loopMS = frameStartMS.back();
+
+    uint64_t loop = static_cast<uint64_t>(elapsedMS / loopMS);
+    double inLoopMS = elapsedMS - static_cast<double>(loop) * loopMS;
+
+    // 第一个开始时间大于inLoopMS的帧的前一帧
+    auto it = std::upper_bound(frameStartMS.begin(), frameStartMS.end() - 1, inLoopMS);
+    uint64_t index = static_cast<uint64_t>(std::max<ptrdiff_t>(it - frameStartMS.begin() - 1, 0));
+
+    uint64_t sequence = loop * gif.frameCount + index;
+
+    if (totalSequences > 0) {
+        sequence = std::min(sequence, totalSequences - 1);
+    }
+
+    return sequence;
+}
+
+void GifPlayer::decodeLoop() {
+    GifCompositor compositor;
+    compositor.reset(gif);
+
+    std::vector<uint32_t> framePixels;
+    uint64_t sequence = 0;
+
+    while (totalSequences == 0 || sequence < totalSequences) {
+        {
+            std::unique_lock<std::mutex> lock(ringMutex);
+            ringCondition.wait(lock, [this]() { return stopping || ringCount < ring.size(); });
+
+            if (stopping) {
+                return;
+            }
+        }
+
+        // 落后整整一遍以上时直接从目标所在那一遍的第0帧开始，第0帧会清空画布，之前的帧不需要合成
+        uint64_t target = targetSequence.load();
+
+        if (target / gif.frameCount > sequence / gif.frameCount) {
+            sequence = (target / gif.frameCount) * gif.frameCount;
+        }
+
+        uint32_t index = static_cast<uint32_t>(sequence % gif.frameCount);
+
+        auto startTime = Clock::now();
+
+        if (!GifDecoder::decodeFrameRGBA(gif, index, framePixels)) {
+            failed = true;
+            return;
+        }
+
+        compositor.composite(index, gif.frames[index], framePixels.data());
+
+        double decodeMS = milliseconds(Clock::now() - startTime);
+
+        {
+            std::lock_guard<std::mutex> lock(ringMutex);
+
+            stats.decodedFrames++;
+            stats.lastDecodeMS = decodeMS;
+            stats.maxDecodeMS = std::max(stats.maxDecodeMS, decodeMS);
+            totalDecodeMS += decodeMS;
+            stats.averageDecodeMS = totalDecodeMS / static_cast<double>(stats.decodedFrames);
+
+            // 渲染线程已经越过这一帧，合成结果只作为后面帧的底图，不放进缓冲
+            if (sequence >= targetSequence.load()) {
+                Slot& slot = ring[(ringHead + ringCount) % ring.size()];
+
+                slot.sequence = sequence;
+                slot.pixels.assign(compositor.getCanvas().begin(), compositor.getCanvas().end());
+
+                ringCount++;
+            }
+        }
+
+        sequence++;
+    }
+}
+
+const GifPlayer::Frame* GifPlayer::update(double timeMS) {
+    std::unique_lock<std::mutex> lock(ringMutex);
+
+    if (!started) {
+        // 第一帧准备好之后才开始计时，避免启动时的解码时间被算成掉帧
+        if (ringCount == 0) {
+            return nullptr;
+        }
+
+        started = true;
+        startTimeMS = timeMS;
+    }
+
+    uint64_t target = sequenceAt(std::max(timeMS - startTimeMS, 0.0));
+    targetSequence.store(target);
+
+    // 取缓冲中不晚于target的最新一帧，更早的帧直接丢弃
+    bool hasNewFrame = false;
+    uint64_t previousSequence = presented.sequence;
+
+    while (ringCount > 0 && ring[ringHead].sequence <= target) {
+        Slot& slot = ring[ringHead];
+
+        // 交换而不是复制，两边的内存都会被重复使用
+        presented.sequence = slot.sequence;
+        presented.pixels.swap(slot.pixels);
+        hasNewFrame = true;
+
+        ringHead = static_cast<uint32_t>((ringHead + 1) % ring.size());
+        ringCount--;
+    }
+
+    if (hasNewFrame) {
+        // 帧序号是递增的，两次显示之间的序号差就是掉帧数
+        if (hasPresented) {
+            stats.droppedFrames += presented.sequence - previousSequence - 1;
+        }
+
+        stats.presentedFrames++;
+        hasPresented = true;
+    }
+
+    stats.readyFrames = ringCount;
+
+    lock.unlock();
+    ringCondition.notify_all();
+
+    if (!hasNewFrame) {
+        return nullptr;
+    }
+
+    presented.index = static_cast<uint32_t>(presented.sequence % gif.frameCount);
+    presented.loop = static_cast<uint32_t>(presented.sequence / gif.frameCount);
+
+    if (totalSequences > 0 && presented.sequence == totalSequences - 1) {
+        finished = true;
+    }
+
+    return &presented;
+}
+
+GifPlayer::Stats GifPlayer::getStats() const {
+    std::lock_guard<std::mutex> lock(ringMutex);
+
+    return stats;
+}
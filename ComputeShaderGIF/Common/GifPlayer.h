@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GifDecoder.h"
+#include "GifCompositor.h"
+
+// GIF播放
+//
+// 后台线程按顺序解码并合成帧，把合成好的整张画面放进一个有界的环形缓冲，最多提前ringSize帧。
+// 渲染线程每帧调用update()，根据从开始播放到现在的绝对时间和每一帧的delay算出此刻应该显示的帧，
+// 画面落后时跳过中间的帧，而不是像逐帧累减延迟那样越播越慢。
+//
+// 帧序号sequence从0开始一直递增，sequence % frameCount就是帧号，sequence / frameCount就是第几遍。
+// totalLoopCount为0时无限循环，否则播放totalLoopCount遍后停在最后一帧。
+class GifPlayer {
+public:
+    struct Frame {
+        uint64_t sequence = 0;
+        uint32_t index = 0;
+        uint32_t loop = 0;
+        // 整张画布，R8G8B8A8，pixelWidth * pixelHeight个像素
+        std::vector<uint32_t> pixels;
+    };
+
+    struct Stats {
+        uint64_t presentedFrames = 0;
+        // 该显示但是没有显示的帧
+        uint64_t droppedFrames = 0;
+        uint64_t decodedFrames = 0;
+        // 解码 + 合成一帧的时间，单位毫秒
+        double lastDecodeMS = 0.0;
+        double averageDecodeMS = 0.0;
+        double maxDecodeMS = 0.0;
+        // 当前缓冲中已经准备好的帧数
+        uint32_t readyFrames = 0;
+        uint32_t ringSize = 0;
+    };
+
+    explicit GifPlayer(const GifDecoder::GIF& inGIF, uint32_t inRingSize = 4);
+    ~GifPlayer();
+
+    GifPlayer(const GifPlayer& rhs) = delete;
+    GifPlayer& operator=(const GifPlayer& rhs) = delete;
+
+    // timeMS为单调递增的时间，第一帧准备好的那一次调用作为时间线的起点。
+    // 需要显示新的一帧时返回这一帧，返回的指针在下一次update()之前有效；不需要更新画面时返回nullptr
+    const Frame* update(double timeMS);
+
+    // 有限循环已经播放到最后一帧
+    bool isFinished() const { return finished; }
+
+    // 解码失败，后台线程已经退出
+    bool hasFailed() const { return failed; }
+
+    Stats getStats() const;
+
+    uint32_t getWidth() const { return gif.pixelWidth; }
+    uint32_t getHeight() const { return gif.pixelHeight; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Slot {
+        uint64_t sequence = 0;
+        std::vector<uint32_t> pixels;
+    };
+
+    void decodeLoop();
+
+    // 时间线上elapsedMS处应该显示的帧序号
+    uint64_t sequenceAt(double elapsedMS) const;
+
+    GifDecoder::GIF gif;
+
+    // 每一帧在一遍中的开始时间，最后一个元素是一遍的总时长
+    std::vector<double> frameStartMS;
+    // 有限循环时的总帧数，无限循环时为0
+    uint64_t totalSequences = 0;
+
+    std::thread decoder;
+
+    mutable std::mutex ringMutex;
+    std::condition_variable ringCondition;
+    std::vector<Slot> ring;
+    uint32_t ringHead = 0;
+    uint32_t ringCount = 0;
+    bool stopping = false;
+
+    // 渲染线程当前想要的帧序号，解码线程据此跳过已经过期的帧
+    std::atomic<uint64_t> targetSequence{0};
+
+    std::atomic<bool> finished{false};
+    std::atomic<bool> failed{false};
+
+    // 以下仅在渲染线程访问
+    Frame presented;
+    bool hasPresented = false;
+    bool started = false;
+    double startTimeMS = 0.0;
+
+    // 由ringMutex保护
+    Stats stats;
+    double totalDecodeMS = 0.0;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 快速的非加密哈希(XXH64算法)，用于缓存文件的校验和内容寻址
+namespace Hash {
+    uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+}
@@ -8,6 +8,51 @@
 
 #include <iostream>
 
+namespace {
+    // 每个脏矩形在上传堆中单独占一段，起始位置按D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT对齐，
+    // 行大小按D3D12_TEXTURE_DATA_PITCH_ALIGNMENT对齐，返回需要的上传堆大小
+    uint64_t layoutFootprints(const FrameDelta::Delta& delta, std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT>& footprints) {
+        uint64_t uploadSize = 0;
+
+        footprints.resize(delta.rects.size());
+
+        for (size_t rectIndex = 0; rectIndex < delta.rects.size(); rectIndex++) {
+            const auto& rect = delta.rects[rectIndex];
+            auto& footprint = footprints[rectIndex];
+
+            footprint.Offset = d3dUtil::Align(uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+            footprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+            footprint.Footprint.Width = rect.width;
+            footprint.Footprint.Height = rect.height;
+            footprint.Footprint.Depth = 1;
+            footprint.Footprint.RowPitch = static_cast<uint32_t>(d3dUtil::Align(rect.width * sizeof(uint32_t), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT));
+
+            uploadSize = footprint.Offset + static_cast<uint64_t>(footprint.Footprint.RowPitch) * rect.height;
+        }
+
+        return uploadSize;
+    }
+
+    // 把紧密排列的脏矩形像素按footprints复制到上传堆中
+    void copyToFootprints(const FrameDelta::Delta& delta, const std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT>& footprints, uint8_t* uploadBufferData) {
+        const uint8_t* srcSlice = delta.pixels.data();
+
+        for (size_t rectIndex = 0; rectIndex < delta.rects.size(); rectIndex++) {
+            const auto& rect = delta.rects[rectIndex];
+            const auto& footprint = footprints[rectIndex];
+            uint32_t rectRowPitch = rect.width * sizeof(uint32_t);
+
+            for (uint32_t row = 0; row < rect.height; row++) {
+                memcpy(uploadBufferData + footprint.Offset + static_cast<size_t>(footprint.Footprint.RowPitch) * row,
+                       srcSlice + static_cast<size_t>(rectRowPitch) * row,
+                       rectRowPitch);
+            }
+
+            srcSlice += static_cast<size_t>(rectRowPitch) * rect.height;
+        }
+    }
+}
+
 ComputeShaderGIF::ComputeShaderGIF(HINSTANCE inInstance, const uint32_t inWindowWidth, const uint32_t inWindowHeight)
 : d3dApp(inInstance, inWindowWidth, inWindowHeight) {
 
@@ -39,6 +84,9 @@ LRESULT ComputeShaderGIF::msgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPa
 }
 
 bool ComputeShaderGIF::initialize() {
+    // 先把GIF的解析、着色器的编译和读取交给工作线程，与设备和窗口的创建同时进行
+    requestAssets();
+
     if(!d3dApp::initialize()) {
         return false;
     }
@@ -47,6 +95,7 @@ bool ComputeShaderGIF::initialize() {
 
     createBoxGeometry();
     buildShapeGeometry();
+    loadGIFAtlas();
     buildRenderItems();
     createCBVSRVDescriptorHeaps();
     loadResources();
@@ -101,29 +150,83 @@ void ComputeShaderGIF::update(float delta) {
 }
 
 void ComputeShaderGIF::compute() {
-    if (gif.currentFrame == 0 || frameIntervalMS >= gifPlayDelay) {
-        ThrowIfFailed(computeCommandAllocator->Reset());
-        ThrowIfFailed(computeCommandList->Reset(computeCommandAllocator.Get(), PSOs["compute"].Get()));
+    // 解码和合成都在GifPlayer的后台线程中完成，这里只根据时间线取出此刻应该显示的画面
+    const GifPlayer::Frame* playerFrame = gifPlayer->update(timer.TotalTime() * 1000.0);
+
+    if (gifPlayer->hasFailed()) {
+        ThrowIfFailed(E_FAIL);
+    }
 
-        gifFrame.bmp.Reset();
-        gifFrame.frame.Reset();
-        gifFrame.delay = 0;
+    // 按画面的Hash查找之前上传过的槽位：与Compute Shader正在读取的画面相同(比如静止的画面)时什么都不做，
+    // 与更早的某个画面相同时直接读取那个槽位的纹理，不需要上传，只有新的画面才需要上传
+    uint32_t gifSlot = UINT32_MAX;
+    bool bUploadFrame = false;
 
-        if (!loadGIFFrame(factory.Get(), gif, gifFrame)) {
-            ThrowIfFailed(E_FAIL);
+    if (playerFrame != nullptr) {
+        uint64_t frameHash = Hash::hash64(playerFrame->pixels.data(), playerFrame->pixels.size() * sizeof(uint32_t));
+        auto candidates = gifFrameSlotsByHash.equal_range(frameHash);
+
+        for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+            if (gifFrameSlots[candidate->second].pixels == playerFrame->pixels) {
+                gifSlot = candidate->second;
+                break;
+            }
         }
 
-        gifTexture.Reset();
-        textureUpload.Reset();
+        if (gifSlot == UINT32_MAX) {
+            gifSlot = acquireGIFFrameSlot();
 
-        if (!uploadGIFFrame(device.Get(),
-            computeCommandList.Get(),
-            factory.Get(),
-            gifFrame,
-            gifTexture.GetAddressOf(),
-            textureUpload.GetAddressOf())) {
-                ThrowIfFailed(E_FAIL);
+            gifFrameSlots[gifSlot].pixels = playerFrame->pixels;
+            gifFrameSlots[gifSlot].hash = frameHash;
+            gifFrameSlotsByHash.emplace(frameHash, gifSlot);
+
+            bUploadFrame = true;
         }
+        else {
+            gifUploadStats.aliasedFrames++;
+
+            if (gifSlot == gifCurrentSlot) {
+                playerFrame = nullptr;
+            }
+        }
+    }
+
+    bReDrawFrame = playerFrame != nullptr;
+
+    if (bReDrawFrame) {
+        ThrowIfFailed(computeCommandAllocator->Reset());
+        ThrowIfFailed(computeCommandList->Reset(computeCommandAllocator.Get(), PSOs["compute"].Get()));
+
+        if (bUploadFrame) {
+            // 与Compute Shader现在读取的画面比较，只上传变化的块
+            const uint8_t* currentPixels = reinterpret_cast<const uint8_t*>(gifFrameSlots[gifSlot].pixels.data());
+
+            if (gifCurrentSlot == UINT32_MAX) {
+                FrameDelta::full(currentPixels, gif.pixelWidth, gif.pixelHeight, sizeof(uint32_t), gifFrameDelta);
+            }
+            else {
+                FrameDelta::diff(reinterpret_cast<const uint8_t*>(gifFrameSlots[gifCurrentSlot].pixels.data()), currentPixels,
+                                 gif.pixelWidth, gif.pixelHeight, sizeof(uint32_t), gifFrameDelta);
+            }
+
+            uploadGIFFrame(gifFrameDelta, gifCurrentSlot, gifSlot);
+
+            gifUploadStats.uploadedFrames++;
+            gifUploadStats.lastFullBytes = gifFrameDelta.fullBytes;
+            gifUploadStats.lastUploadBytes = gifFrameDelta.deltaBytes();
+            gifUploadStats.totalFullBytes += gifFrameDelta.fullBytes;
+            gifUploadStats.totalUploadBytes += gifFrameDelta.deltaBytes();
+        }
+
+        gifCurrentSlot = gifSlot;
+
+        // GifPlayer给出的是合成好的整张画布，按DM_BACKGROUND整体覆盖RWTexture：
+        // 透明的像素只会出现在背景色本身透明的地方，用背景色填充结果不变
+        gifFrame.disposal = GifDecoder::disposalBackground;
+        gifFrame.leftTop[0] = 0;
+        gifFrame.leftTop[1] = 0;
+        gifFrame.size[0] = gifPlayer->getWidth();
+        gifFrame.size[1] = gifPlayer->getHeight();
 
         // 设置GIF的背景色，注意Shader中颜色值一般是RGBA格式
         FrameUtil::GIFFrameParam gifFrameParam;
@@ -134,7 +237,7 @@ void ComputeShaderGIF::compute() {
             ARGB_B(gif.backgroundColor),
             ARGB_A(gif.backgroundColor));
 
-        gifFrameParam.currentFrame = gif.currentFrame;
+        gifFrameParam.currentFrame = playerFrame->index;
         gifFrameParam.disposal = gifFrame.disposal;
 
         gifFrameParam.leftTop[0] = gifFrame.leftTop[0];
@@ -143,33 +246,6 @@ void ComputeShaderGIF::compute() {
         gifFrameParam.size[1] = gifFrame.size[1];
 
         currentFrameResource->gifFrameConstantBuffer->CopyData(0, gifFrameParam);
-
-        D3D12_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc = {};
-
-        shaderResourceViewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        shaderResourceViewDesc.Format = gifFrame.textureFormat;
-        shaderResourceViewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        shaderResourceViewDesc.Texture1D.MipLevels = 1;
-
-        D3D12_CPU_DESCRIPTOR_HANDLE computeCBVCPUDescriptorHandle(computeCBVDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-        computeCBVCPUDescriptorHandle.ptr += CBVSRVUAVDescriptorSize * frameResourcesCount;
-        device->CreateShaderResourceView(gifTexture.Get(), &shaderResourceViewDesc, computeCBVCPUDescriptorHandle);
-
-        gifPlayDelay = gifFrame.delay;
-
-        // 更新到下一帧帧号
-        gif.currentFrame = (++gif.currentFrame) % gif.frameCount;
-
-        bReDrawFrame = true;
-    }
-    else {
-        if (!SUCCEEDED(ULongLongSub(gifPlayDelay, static_cast<uint64_t>(frameIntervalMS), &gifPlayDelay))) {
-            // 这个调用失败说明一定是已经超时到下一帧的时间了，那就开始下一循环绘制下一帧
-            gifPlayDelay = 0;
-        }
-
-        // 只更新延迟时间，不绘制
-        bReDrawFrame = false;
     }
 
     if (bReDrawFrame) {
@@ -197,10 +273,11 @@ void ComputeShaderGIF::compute() {
    
         computeCommandList->SetComputeRootDescriptorTable(0, computeCBVGPUDescriptorHandle);
 
-        computeCBVGPUDescriptorHandle.ptr += (frameResourcesCount - currentFrameIndex) * CBVSRVUAVDescriptorSize;
+        // 每个槽位的SRV在loadResources中创建好，这里只切换描述符表，不改写还在使用中的描述符
+        computeCBVGPUDescriptorHandle.ptr += (frameResourcesCount + gifCurrentSlot - currentFrameIndex) * CBVSRVUAVDescriptorSize;
         computeCommandList->SetComputeRootDescriptorTable(1, computeCBVGPUDescriptorHandle);
 
-        computeCBVGPUDescriptorHandle.ptr += CBVSRVUAVDescriptorSize;
+        computeCBVGPUDescriptorHandle.ptr += (maxGIFFrameSlots - gifCurrentSlot) * CBVSRVUAVDescriptorSize;
         computeCommandList->SetComputeRootDescriptorTable(2, computeCBVGPUDescriptorHandle);
 
         // 执行Compute Shader
@@ -261,6 +338,9 @@ void ComputeShaderGIF::draw(float delta) {
         ThrowIfFailed(graphicsCommandList->Reset(commandAllocator.Get(), PSOs["opaque"].Get()));
     }
 
+    // 更新GIF贴纸图集中变化的部分
+    uploadGIFAtlas();
+
     // 对资源的状态进行转换，将资源从呈现状态转换为渲染目标状态
     graphicsCommandList->ResourceBarrier(
         1, &CD3DX12_RESOURCE_BARRIER::Transition(
@@ -409,7 +489,8 @@ void ComputeShaderGIF::createCommandObjects() {
 }
 
 void ComputeShaderGIF::createCBVSRVDescriptorHeaps() {
-    textures.resize(1);
+    // t0: 经由Compute Shader处理过后的GIF纹理，t1: GIF贴纸图集
+    textures.resize(2);
 
     D3D12_DESCRIPTOR_HEAP_DESC graphicsCBVDescriptorHeapDesc;
     // objectCount * frameBackBufferCount + CRV(1) + SRV(1)
@@ -436,7 +517,8 @@ void ComputeShaderGIF::createCBVSRVDescriptorHeaps() {
 
     // 创建Compute Shader需要的描述符堆
     D3D12_DESCRIPTOR_HEAP_DESC computeCBVDescriptorHeapDesc;
-    computeCBVDescriptorHeapDesc.NumDescriptors = frameResourcesCount + 2;
+    // 每个FrameResource一个CBV + 每个GIF画面槽位一个SRV + RWTexture的UAV
+    computeCBVDescriptorHeapDesc.NumDescriptors = frameResourcesCount + maxGIFFrameSlots + 1;
     computeCBVDescriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     computeCBVDescriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     computeCBVDescriptorHeapDesc.NodeMask = 0;
@@ -569,7 +651,7 @@ void ComputeShaderGIF::createShaderResourceView() {
     D3D12_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc = {};
 
     shaderResourceViewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    shaderResourceViewDesc.Format = gifFrame.textureFormat;
+    shaderResourceViewDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     shaderResourceViewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     shaderResourceViewDesc.Texture2D.MipLevels = 1;
 
@@ -589,6 +671,12 @@ void ComputeShaderGIF::createShaderResourceView() {
     device->CreateShaderResourceView(RWTexture.Get(), &shaderResourceViewDesc, graphicsCBVCPUDescriptorHanle);
 
     RWTexture->SetName(L"RWTexture");
+
+    graphicsCBVCPUDescriptorHanle.Offset(CBVSRVUAVDescriptorSize);
+
+    device->CreateShaderResourceView(gifAtlasTexture.Get(), &shaderResourceViewDesc, graphicsCBVCPUDescriptorHanle);
+
+    gifAtlasTexture->SetName(L"GIFAtlas");
 }
 
 void ComputeShaderGIF::createSampler() {
@@ -676,9 +764,10 @@ void ComputeShaderGIF::createGraphicsRootSignature() {
                                                              0,      // registerSpace
                       D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
 
+    // Pixel Shader也要读取物体常量中的textureIndex
     slotRootParameter[0].InitAsDescriptorTable(1, 
                                                &CBVDescriptorTable[0],
-                                               D3D12_SHADER_VISIBILITY_VERTEX);
+                                               D3D12_SHADER_VISIBILITY_ALL);
 
     slotRootParameter[1].InitAsDescriptorTable(1, 
                                                &CBVDescriptorTable[1],
@@ -814,8 +903,9 @@ void ComputeShaderGIF::createComputeRootSignature() {
 
 void ComputeShaderGIF::createShadersAndInputLayout() {
 
-    vertexShaderByteCode = d3dUtil::compileShader(L"Shaders/Basic.hlsl", L"VS", L"vs_6_0");
-    pixelShaderByteCode = d3dUtil::compileShader(L"Shaders/Basic.hlsl", L"PS", L"ps_6_0");
+    // 编译在requestAssets中就已经交给工作线程，这里通常不需要等待
+    vertexShaderByteCode = compiledVertexShader.get();
+    pixelShaderByteCode = compiledPixelShader.get();
     
     inputLayout = 
     {
@@ -942,16 +1032,12 @@ void ComputeShaderGIF::createPipelineStateOjbect() {
     graphicsPSODesc.InputLayout = {inputLayout.data(), (UINT)inputLayout.size()};
     graphicsPSODesc.pRootSignature = graphicsRootSignature.Get();
 
-    std::string vertexShader;
-    
-    d3dUtil::loadShader("Shaders/vs.bin", vertexShader);
+    const std::string& vertexShader = vertexShaderBinary.get();
 
     graphicsPSODesc.VS.pShaderBytecode = vertexShader.data();
     graphicsPSODesc.VS.BytecodeLength = vertexShader.size();
 
-    std::string pixelShader;
-
-     d3dUtil::loadShader("Shaders/ps.bin", pixelShader);
+    const std::string& pixelShader = pixelShaderBinary.get();
 
     graphicsPSODesc.PS.pShaderBytecode = pixelShader.data();
     graphicsPSODesc.PS.BytecodeLength = pixelShader.size();
@@ -995,9 +1081,7 @@ void ComputeShaderGIF::createPipelineStateOjbect() {
 
     computePSODesc.pRootSignature = computeRootSignature.Get();
 
-    std::string computeShader;
-
-     d3dUtil::loadShader("Shaders/cs.bin", computeShader);
+    const std::string& computeShader = computeShaderBinary.get();
 
     computePSODesc.CS.pShaderBytecode = computeShader.data();
     computePSODesc.CS.BytecodeLength = computeShader.size();
@@ -1009,13 +1093,60 @@ void ComputeShaderGIF::createPipelineStateOjbect() {
     PSOs["compute"] = computePSO;
 }
 
-void ComputeShaderGIF::loadResources() {
-    ThrowIfFailed(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf())));
+void ComputeShaderGIF::requestAssets() {
+    assetLoader = std::make_unique<AssetLoader>();
 
-    if (!loadGIF(L"Textures/Kanna1.gif", factory.Get(), gif)) {
+    // 画布大小决定了纹理的大小，loadResources中等待它完成
+    gifFile = assetLoader->load("Textures/Kanna1.gif", []() { return loadGIF("Textures/Kanna1.gif"); });
+
+    // 贴纸各自在一个工作线程中解析，loadGIFAtlas中按顺序加入图集
+    for (const char* stickerFileName : {"Textures/Kanna0.gif", "Textures/Kanna1.gif", "Textures/Kanna2.gif"}) {
+        std::string fileName = stickerFileName;
+        stickerFiles.push_back(assetLoader->load(fileName + " sticker", [fileName]() { return loadGIF(fileName); }));
+    }
+
+    // PSO要用到着色器，createShadersAndInputLayout和createPipelineStateOjbect中等待
+    compiledVertexShader = assetLoader->load("Shaders/Basic.hlsl VS", []() { return d3dUtil::compileShader(L"Shaders/Basic.hlsl", L"VS", L"vs_6_0"); });
+    compiledPixelShader = assetLoader->load("Shaders/Basic.hlsl PS", []() { return d3dUtil::compileShader(L"Shaders/Basic.hlsl", L"PS", L"ps_6_0"); });
+    vertexShaderBinary = assetLoader->load("Shaders/vs.bin", []() { return loadShaderBinary("Shaders/vs.bin"); });
+    pixelShaderBinary = assetLoader->load("Shaders/ps.bin", []() { return loadShaderBinary("Shaders/ps.bin"); });
+    computeShaderBinary = assetLoader->load("Shaders/cs.bin", []() { return loadShaderBinary("Shaders/cs.bin"); });
+}
+
+GifDecoder::GIF ComputeShaderGIF::loadGIF(const std::string& fileName) {
+    GifDecoder::GIF loaded;
+
+    // 在工作线程中抛出的异常会在get()时重新抛出
+    if (!GifDecoder::load(fileName, loaded)) {
         ThrowIfFailed(E_FAIL);
     }
 
+    return loaded;
+}
+
+std::string ComputeShaderGIF::loadShaderBinary(const std::string& fileName) {
+    std::string shaderData;
+    d3dUtil::loadShader(fileName, shaderData);
+
+    return shaderData;
+}
+
+void ComputeShaderGIF::loadGIFAtlas() {
+    gifAtlas = std::make_unique<GifAtlas>(1024, 1024);
+
+    for (const auto& stickerFile : stickerFiles) {
+        if (gifAtlas->add(stickerFile.get()) < 0) {
+            ThrowIfFailed(E_FAIL);
+        }
+    }
+}
+
+void ComputeShaderGIF::loadResources() {
+    // 解析在工作线程中进行，这里只等待结果
+    gif = gifFile.get();
+
+    gifPlayer = std::make_unique<GifPlayer>(gif);
+
     //----------------------------------------------------------------------------------------------------------
     // 创建Computer Shader 需要的背景 RWTexture2D 资源
     DXGI_FORMAT RWTextureFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -1043,8 +1174,7 @@ void ComputeShaderGIF::loadResources() {
 
     D3D12_CPU_DESCRIPTOR_HANDLE computeCBVCPUDescriptorHandle(computeCBVDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 
-    computeCBVCPUDescriptorHandle.ptr += CBVSRVUAVDescriptorSize * frameResourcesCount;
-    computeCBVCPUDescriptorHandle.ptr += CBVSRVUAVDescriptorSize;
+    computeCBVCPUDescriptorHandle.ptr += CBVSRVUAVDescriptorSize * (frameResourcesCount + maxGIFFrameSlots);
 
     // Compute Shader UAV
     // RWTexture2D<float4> paint	: register(u0);
@@ -1056,6 +1186,87 @@ void ComputeShaderGIF::loadResources() {
 
     device->CreateUnorderedAccessView(RWTexture.Get(), nullptr, &computeUAVDesc, computeCBVCPUDescriptorHandle);
 
+    // Compute Shader读取的GIF画面，每个槽位一张整个画布大小的纹理，每帧只更新变化的部分。
+    // 槽位数量不超过GIF的帧数，帧数不多的GIF所有画面都只需要上传一次
+    D3D12_RESOURCE_DESC gifTextureDesc = RWTextureDesc;
+    gifTextureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    uint32_t gifFrameSlotCount = gif.frameCount < maxGIFFrameSlots ? gif.frameCount : maxGIFFrameSlots;
+
+    // 替换槽位时要跳过正在读取的那个，所以至少需要两个
+    if (gifFrameSlotCount < 2) {
+        gifFrameSlotCount = 2;
+    }
+    gifFrameSlots.resize(gifFrameSlotCount);
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC gifShaderResourceViewDesc = {};
+
+    gifShaderResourceViewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    gifShaderResourceViewDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    gifShaderResourceViewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    gifShaderResourceViewDesc.Texture2D.MipLevels = 1;
+
+    for (uint32_t slot = 0; slot < gifFrameSlotCount; slot++) {
+        ThrowIfFailed(device->CreateCommittedResource(
+            &heapProperties,
+            D3D12_HEAP_FLAG_NONE,
+            &gifTextureDesc,
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr,
+            IID_PPV_ARGS(gifFrameSlots[slot].texture.GetAddressOf())));
+
+        D3D12_CPU_DESCRIPTOR_HANDLE gifSRVCPUDescriptorHandle(computeCBVDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+        gifSRVCPUDescriptorHandle.ptr += CBVSRVUAVDescriptorSize * (frameResourcesCount + slot);
+
+        device->CreateShaderResourceView(gifFrameSlots[slot].texture.Get(), &gifShaderResourceViewDesc, gifSRVCPUDescriptorHandle);
+    }
+
+    // 上传堆只创建一次并一直保持映射，每个FrameResource使用其中一段。
+    // 每段按整张画布的footprint分配，这是一帧最多需要上传的数据量(见uploadGIFFrame)
+    textureUploadSegmentSize = d3dUtil::Align(
+        d3dUtil::Align(gif.pixelWidth * sizeof(uint32_t), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT) * gif.pixelHeight,
+        D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+    D3D12_HEAP_PROPERTIES uploadHeapProperties = {D3D12_HEAP_TYPE_UPLOAD};
+
+    D3D12_RESOURCE_DESC uploadBufferDesc = {};
+
+    uploadBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    uploadBufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    uploadBufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    uploadBufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+    uploadBufferDesc.Width = textureUploadSegmentSize * frameResourcesCount;
+    uploadBufferDesc.Height = 1;
+    uploadBufferDesc.DepthOrArraySize = 1;
+    uploadBufferDesc.MipLevels = 1;
+    uploadBufferDesc.SampleDesc.Count = 1;
+    uploadBufferDesc.SampleDesc.Quality = 0;
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &uploadHeapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &uploadBufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(textureUpload.GetAddressOf())));
+
+    ThrowIfFailed(textureUpload->Map(0, nullptr, reinterpret_cast<void**>(&textureUploadData)));
+
+    // GIF贴纸图集，内容在每帧的uploadGIFAtlas中更新
+    D3D12_RESOURCE_DESC gifAtlasTextureDesc = gifTextureDesc;
+    gifAtlasTextureDesc.Width = gifAtlas->getWidth();
+    gifAtlasTextureDesc.Height = gifAtlas->getHeight();
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &gifAtlasTextureDesc,
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(gifAtlasTexture.GetAddressOf())));
+
+    gifAtlasUploadBuffers.resize(frameResourcesCount);
+
     // uint32_t textureWidth = 0;
     // uint32_t textureHeight = 0;
     // uint32_t bpp = 0;
@@ -1235,6 +1446,195 @@ void ComputeShaderGIF::loadResources() {
     // }
 }
 
+uint32_t ComputeShaderGIF::acquireGIFFrameSlot() {
+    for (uint32_t slot = 0; slot < gifFrameSlots.size(); slot++) {
+        if (gifFrameSlots[slot].pixels.empty()) {
+            return slot;
+        }
+    }
+
+    // 槽位都用完了，替换下一个。正在读取的槽位是下一帧计算脏矩形的基准，不能替换。
+    // 槽位纹理只在computeCommandQueue上读写，之前读取它的命令一定在这次复制之前执行完
+    uint32_t slot = gifNextEvictedSlot;
+
+    if (slot == gifCurrentSlot) {
+        slot = (slot + 1) % gifFrameSlots.size();
+    }
+
+    gifNextEvictedSlot = (slot + 1) % gifFrameSlots.size();
+
+    auto candidates = gifFrameSlotsByHash.equal_range(gifFrameSlots[slot].hash);
+
+    for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+        if (candidate->second == slot) {
+            gifFrameSlotsByHash.erase(candidate);
+            break;
+        }
+    }
+
+    gifFrameSlots[slot].pixels.clear();
+
+    return slot;
+}
+
+void ComputeShaderGIF::uploadGIFFrame(FrameDelta::Delta& delta, uint32_t sourceSlot, uint32_t targetSlot) {
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+
+    // 很多零碎的脏矩形因为对齐可能比整张画布还大，这时改为上传整张画布，
+    // 所以每段上传堆的大小就是一帧的上限
+    if (layoutFootprints(delta, footprints) > textureUploadSegmentSize) {
+        FrameDelta::full(reinterpret_cast<const uint8_t*>(gifFrameSlots[targetSlot].pixels.data()),
+                         gif.pixelWidth, gif.pixelHeight, sizeof(uint32_t), delta);
+        layoutFootprints(delta, footprints);
+    }
+
+    // 这一段上一次使用它的帧已经在frameResourceSync中等待完成
+    uint64_t segmentOffset = textureUploadSegmentSize * currentFrameIndex;
+
+    copyToFootprints(delta, footprints, textureUploadData + segmentOffset);
+
+    // CopyTextureRegion的偏移量相对于整个上传堆
+    for (auto& footprint : footprints) {
+        footprint.Offset += segmentOffset;
+    }
+
+    ID3D12Resource* targetTexture = gifFrameSlots[targetSlot].texture.Get();
+
+    D3D12_RESOURCE_BARRIER resourceBarriers[2] = {};
+
+    resourceBarriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    resourceBarriers[0].Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    resourceBarriers[0].Transition.pResource = targetTexture;
+    resourceBarriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
+    resourceBarriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+    resourceBarriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+    // 脏矩形是相对于sourceSlot的画面计算的，目标槽位里是更早的画面，
+    // 除非整张画布都要上传，否则先把sourceSlot复制过来
+    bool bFullCanvas = delta.rects.size() == 1
+                    && delta.rects[0].width == gif.pixelWidth
+                    && delta.rects[0].height == gif.pixelHeight;
+
+    if (sourceSlot != UINT32_MAX && !bFullCanvas) {
+        resourceBarriers[1] = resourceBarriers[0];
+        resourceBarriers[1].Transition.pResource = gifFrameSlots[sourceSlot].texture.Get();
+        resourceBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+
+        computeCommandList->ResourceBarrier(2, resourceBarriers);
+        computeCommandList->CopyResource(targetTexture, gifFrameSlots[sourceSlot].texture.Get());
+
+        resourceBarriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+        resourceBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_COMMON;
+
+        computeCommandList->ResourceBarrier(1, &resourceBarriers[1]);
+    }
+    else {
+        computeCommandList->ResourceBarrier(1, &resourceBarriers[0]);
+    }
+
+    D3D12_TEXTURE_COPY_LOCATION dest = {};
+    dest.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+    dest.pResource = targetTexture;
+    dest.SubresourceIndex = 0;
+
+    D3D12_TEXTURE_COPY_LOCATION src = {};
+    src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+    src.pResource = textureUpload.Get();
+
+    for (size_t rectIndex = 0; rectIndex < delta.rects.size(); rectIndex++) {
+        src.PlacedFootprint = footprints[rectIndex];
+
+        computeCommandList->CopyTextureRegion(&dest, delta.rects[rectIndex].left, delta.rects[rectIndex].top, 0, &src, nullptr);
+    }
+
+    // 复制完成后转换为COMMON状态，供Compute Shader读取
+    resourceBarriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    resourceBarriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COMMON;
+
+    computeCommandList->ResourceBarrier(1, &resourceBarriers[0]);
+}
+
+void ComputeShaderGIF::uploadGIFAtlas() {
+    // 所有贴纸共用一条时间线，变化的部分已经合并成一个批次
+    const FrameDelta::Delta& batch = gifAtlas->update(timer.TotalTime() * 1000.0);
+
+    if (batch.empty()) {
+        return;
+    }
+
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+    uint64_t uploadSize = layoutFootprints(batch, footprints);
+
+    // 这个上传堆上一次使用它的帧已经在frameResourceSync中等待完成，放不下时可以直接替换。
+    // 第一次update()会上传所有贴纸的整个图块，之后的批次一般都更小
+    auto& uploadBuffer = gifAtlasUploadBuffers[currentFrameIndex];
+
+    if (uploadSize > uploadBuffer.size) {
+        D3D12_HEAP_PROPERTIES heapProperties = {D3D12_HEAP_TYPE_UPLOAD};
+
+        D3D12_RESOURCE_DESC uploadBufferDesc = {};
+
+        uploadBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        uploadBufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        uploadBufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+        uploadBufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+        uploadBufferDesc.Width = uploadSize;
+        uploadBufferDesc.Height = 1;
+        uploadBufferDesc.DepthOrArraySize = 1;
+        uploadBufferDesc.MipLevels = 1;
+        uploadBufferDesc.SampleDesc.Count = 1;
+        uploadBufferDesc.SampleDesc.Quality = 0;
+
+        uploadBuffer.resource.Reset();
+
+        ThrowIfFailed(device->CreateCommittedResource(
+            &heapProperties,
+            D3D12_HEAP_FLAG_NONE,
+            &uploadBufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(uploadBuffer.resource.GetAddressOf())));
+
+        ThrowIfFailed(uploadBuffer.resource->Map(0, nullptr, reinterpret_cast<void**>(&uploadBuffer.data)));
+        uploadBuffer.size = uploadSize;
+    }
+
+    copyToFootprints(batch, footprints, uploadBuffer.data);
+
+    // 一次转换、若干CopyTextureRegion，复制完成后转换为COMMON状态，
+    // Pixel Shader读取时隐式提升为PIXEL_SHADER_RESOURCE
+    D3D12_RESOURCE_BARRIER resourceBarrier = {};
+
+    resourceBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    resourceBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    resourceBarrier.Transition.pResource = gifAtlasTexture.Get();
+    resourceBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
+    resourceBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+    resourceBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+    graphicsCommandList->ResourceBarrier(1, &resourceBarrier);
+
+    D3D12_TEXTURE_COPY_LOCATION dest = {};
+    dest.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+    dest.pResource = gifAtlasTexture.Get();
+    dest.SubresourceIndex = 0;
+
+    D3D12_TEXTURE_COPY_LOCATION src = {};
+    src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+    src.pResource = uploadBuffer.resource.Get();
+
+    for (size_t rectIndex = 0; rectIndex < batch.rects.size(); rectIndex++) {
+        src.PlacedFootprint = footprints[rectIndex];
+
+        graphicsCommandList->CopyTextureRegion(&dest, batch.rects[rectIndex].left, batch.rects[rectIndex].top, 0, &src, nullptr);
+    }
+
+    resourceBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    resourceBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COMMON;
+
+    graphicsCommandList->ResourceBarrier(1, &resourceBarrier);
+}
+
 void ComputeShaderGIF::buildShapeGeometry() {
     GeometryGenerator geometryGenerator;
 
@@ -1341,6 +1741,26 @@ void ComputeShaderGIF::buildRenderItems() {
     allRenderItems.push_back(std::move(boxRenderItem));
     allRenderItems.push_back(std::move(gridRenderItem));
 
+    // GIF贴纸平放在地面上，共用一张图集纹理，各自只采样图集中自己的区域
+    for (uint32_t animation = 0; animation < gifAtlas->getStats().animations; animation++) {
+        auto stickerRenderItem = std::make_unique<FrameUtil::RenderItem>();
+
+        XMStoreFloat4x4(&stickerRenderItem->world, XMMatrixScaling(0.15f, 1.0f, 0.15f) * XMMatrixTranslation(-2.0f + 2.0f * animation, -0.99f, -2.5f));
+        stickerRenderItem->objectConstantBufferIndex = static_cast<uint32_t>(allRenderItems.size());
+        stickerRenderItem->geometry = geometries["ShapeGeometry"].get();
+        stickerRenderItem->primitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+        stickerRenderItem->indexCount = stickerRenderItem->geometry->DrawArgs["Grid"].IndexCount;
+        stickerRenderItem->startIndexLocation = stickerRenderItem->geometry->DrawArgs["Grid"].StartIndexLocation;
+        stickerRenderItem->baseVertexLocation = stickerRenderItem->geometry->DrawArgs["Grid"].BaseVertexLocation;
+
+        GifAtlas::UVRect uvRect = gifAtlas->getUVRect(animation);
+
+        stickerRenderItem->uvTransform = XMFLOAT4(uvRect.u1 - uvRect.u0, uvRect.v1 - uvRect.v0, uvRect.u0, uvRect.v0);
+        stickerRenderItem->textureIndex = 1;
+
+        allRenderItems.push_back(std::move(stickerRenderItem));
+    }
+
     // 此演示程序中所有的渲染项都是非透明的
     for (auto& element : allRenderItems) {
         opaqueRenderItems.push_back(element.get());
@@ -1359,6 +1779,8 @@ void ComputeShaderGIF::updateObjectConstantBuffers() {
 
             FrameUtil::ObjectConstants objectConstants;
             XMStoreFloat4x4(&objectConstants.world, XMMatrixTranspose(world));
+            objectConstants.uvTransform = element->uvTransform;
+            objectConstants.textureIndex = element->textureIndex;
 
             currentObjectConstantBuffer->CopyData(element->objectConstantBufferIndex, objectConstants);
 
@@ -1530,6 +1952,43 @@ void ComputeShaderGIF::buildImGuiWidgets()
 			ImGui::Text("counter = %d", counter);
 
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+            if (gifPlayer) {
+                auto stats = gifPlayer->getStats();
+
+                ImGui::Text("GIF presented %llu, dropped %llu, ready %u/%u",
+                    static_cast<unsigned long long>(stats.presentedFrames),
+                    static_cast<unsigned long long>(stats.droppedFrames),
+                    stats.readyFrames, stats.ringSize);
+                ImGui::Text("GIF decode %.3f ms (avg %.3f, max %.3f)", stats.lastDecodeMS, stats.averageDecodeMS, stats.maxDecodeMS);
+
+                if (gifUploadStats.uploadedFrames > 0) {
+                    ImGui::Text("GIF upload %.1f KB/frame, full frame %.1f KB (last %.1f / %.1f KB), reused %llu",
+                        gifUploadStats.totalUploadBytes / 1024.0 / gifUploadStats.uploadedFrames,
+                        gifUploadStats.totalFullBytes / 1024.0 / gifUploadStats.uploadedFrames,
+                        gifUploadStats.lastUploadBytes / 1024.0,
+                        gifUploadStats.lastFullBytes / 1024.0,
+                        static_cast<unsigned long long>(gifUploadStats.aliasedFrames));
+                }
+            }
+
+            if (gifAtlas) {
+                auto atlasStats = gifAtlas->getStats();
+
+                ImGui::Text("GIF atlas %u stickers, %u changed, update %.3f ms, upload %.1f KB in %u rects",
+                    atlasStats.animations, atlasStats.changedAnimations, atlasStats.lastUpdateMS,
+                    atlasStats.lastUploadBytes / 1024.0, atlasStats.lastUploadRects);
+            }
+
+            for (const auto& timing : assetLoader->timings()) {
+                if (timing.finished) {
+                    ImGui::Text("%s: queued %.2f ms, load %.2f ms, total %.2f ms",
+                                timing.name.c_str(), timing.queued, timing.load, timing.total);
+                }
+                else {
+                    ImGui::Text("%s: loading...", timing.name.c_str());
+                }
+            }
 			ImGui::End();
 		}
 	}
@@ -4,6 +4,12 @@
 #include "Common/MathHelper.h"
 #include "Common/UploadBuffer.h"
 #include "Common/WICUtils.h"
+#include "Common/GifDecoder.h"
+#include "Common/GifPlayer.h"
+#include "Common/GifAtlas.h"
+#include "Common/FrameDelta.h"
+#include "Common/Hash.h"
+#include "Common/AssetLoader.h"
 
 #include <windef.h>
 
@@ -12,6 +18,8 @@
 #include <dxcapi.h>
 #include <wrl/client.h>
 
+#include <unordered_map>
+
 using namespace DirectX;
 
 class ComputeShaderGIF : public d3dApp {
@@ -52,7 +60,14 @@ protected:
     void createBoxGeometry();
     void createPipelineStateOjbect();
 
+    void requestAssets();
+    static GifDecoder::GIF loadGIF(const std::string& fileName);
+    static std::string loadShaderBinary(const std::string& fileName);
+    void loadGIFAtlas();
     void loadResources();
+    uint32_t acquireGIFFrameSlot();
+    void uploadGIFFrame(FrameDelta::Delta& delta, uint32_t sourceSlot, uint32_t targetSlot);
+    void uploadGIFAtlas();
 
     void buildShapeGeometry();
     void buildRenderItems();
@@ -89,27 +104,70 @@ private:
     
     std::unique_ptr<MeshGeometry> boxGeometry = nullptr;
 
-    GIF gif = {};
+    GifDecoder::GIF gif;
 
-    uint64_t gifPlayDelay = 0;
+    std::unique_ptr<GifPlayer> gifPlayer;
 
     bool bReDrawFrame = false;
 
-    ComPtr<IWICImagingFactory> factory;
-
     // ComPtr<ID3DBlob> vertexShaderByteCode = nullptr;
     // ComPtr<ID3DBlob> pixelShaderByteCode = nullptr;
 
     ComPtr<IDxcBlob> vertexShaderByteCode = nullptr;
     ComPtr<IDxcBlob> pixelShaderByteCode = nullptr;
 
-    ComPtr<ID3D12Resource> gifTexture;
     ComPtr<ID3D12Resource> RWTexture;
 
     std::vector<ComPtr<ID3D12Resource>> textures;
-    ComPtr<ID3D12Resource> textureUpload;
 
-    GIFFrame gifFrame = {};
+    // 常驻的上传堆，每个FrameResource占一段，每段都能放下整张画布
+    ComPtr<ID3D12Resource> textureUpload;
+    uint8_t* textureUploadData = nullptr;
+    uint64_t textureUploadSegmentSize = 0;
+
+    GifDecoder::GIFFrame gifFrame;
+
+    // 已经上传到GPU的画面，每个槽位一张整个画布大小的纹理，
+    // 按画面的Hash查找，重复出现的画面(比如来回播放的动画)直接使用之前上传的纹理
+    struct GIFFrameSlot {
+        ComPtr<ID3D12Resource> texture;
+        std::vector<uint32_t> pixels;
+        uint64_t hash = 0;
+    };
+
+    static const uint32_t maxGIFFrameSlots = 64;
+
+    std::vector<GIFFrameSlot> gifFrameSlots;
+    std::unordered_multimap<uint64_t, uint32_t> gifFrameSlotsByHash;
+    // Compute Shader现在读取的槽位，新画面的脏矩形相对于它计算
+    uint32_t gifCurrentSlot = UINT32_MAX;
+    // 槽位用完之后按轮转的顺序替换
+    uint32_t gifNextEvictedSlot = 0;
+    FrameDelta::Delta gifFrameDelta;
+
+    struct GIFUploadStats {
+        uint64_t uploadedFrames = 0;
+        // 与之前上传过的某个画面相同而直接复用的帧
+        uint64_t aliasedFrames = 0;
+        uint64_t totalUploadBytes = 0;
+        uint64_t totalFullBytes = 0;
+        size_t lastUploadBytes = 0;
+        size_t lastFullBytes = 0;
+    } gifUploadStats;
+
+    // GIF贴纸：所有贴纸合成在同一张图集纹理中，每帧只上传一个批次，
+    // 每个贴纸的渲染项用uvTransform采样自己的区域
+    std::unique_ptr<GifAtlas> gifAtlas;
+    ComPtr<ID3D12Resource> gifAtlasTexture;
+
+    // 每个FrameResource一个常驻映射的上传堆，批次放不下时重新创建更大的
+    struct GIFAtlasUploadBuffer {
+        ComPtr<ID3D12Resource> resource;
+        uint8_t* data = nullptr;
+        uint64_t size = 0;
+    };
+
+    std::vector<GIFAtlasUploadBuffer> gifAtlasUploadBuffers;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout;
 
@@ -148,4 +206,14 @@ private:
 	ImVec4 clearColor = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
     DXGI_FORMAT textureFormat;
+
+    // 放在最后，保证先于其他成员析构，工作线程不会访问到已经销毁的成员
+    std::unique_ptr<AssetLoader> assetLoader;
+    AssetLoader::Handle<GifDecoder::GIF> gifFile;
+    std::vector<AssetLoader::Handle<GifDecoder::GIF>> stickerFiles;
+    AssetLoader::Handle<ComPtr<IDxcBlob>> compiledVertexShader;
+    AssetLoader::Handle<ComPtr<IDxcBlob>> compiledPixelShader;
+    AssetLoader::Handle<std::string> vertexShaderBinary;
+    AssetLoader::Handle<std::string> pixelShaderBinary;
+    AssetLoader::Handle<std::string> computeShaderBinary;
 };
\ No newline at end of file
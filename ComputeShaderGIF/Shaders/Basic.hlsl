@@ -7,6 +7,9 @@
 cbuffer constantBufferPerObject : register(b0)
 {
 	float4x4 world; 
+	// 纹理坐标的缩放(xy)和偏移(zw)，用来采样图集中的一块区域
+	float4 uvTransform;
+	uint textureIndex;
 };
 
 cbuffer constantBufferPerPass : register(b1)
@@ -89,14 +92,14 @@ VertexOut VS(VertexIn vin)
 	
 	// Just pass vertex color into the pixel shader.
     vout.Color = vin.Color;
-	vout.uv = vin.uv;
+	vout.uv = vin.uv * uvTransform.xy + uvTransform.zw;
     
     return vout;
 }
 
 float4 PS(VertexOut pin) : SV_Target
 {
-    return textures[0].Sample(textureSampler, pin.uv);
+    return textures[textureIndex].Sample(textureSampler, pin.uv);
 }
 
 
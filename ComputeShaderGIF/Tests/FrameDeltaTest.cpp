@@ -0,0 +1,232 @@
+#include "Common/FrameDelta.h"
+#include "TestUtil.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+    std::vector<uint8_t> randomFrame(std::mt19937& random, uint32_t width, uint32_t height, uint32_t bytesPerPixel) {
+        std::vector<uint8_t> frame(size_t(width) * height * bytesPerPixel);
+
+        for (auto& byte : frame) {
+            byte = static_cast<uint8_t>(random());
+        }
+
+        return frame;
+    }
+
+    void setPixel(std::vector<uint8_t>& frame, uint32_t width, uint32_t bytesPerPixel, uint32_t x, uint32_t y) {
+        frame[(size_t(y) * width + x) * bytesPerPixel] ^= 0x5a;
+    }
+
+    bool sameRect(const FrameDelta::Rect& rect, uint32_t left, uint32_t top, uint32_t width, uint32_t height) {
+        return rect.left == left && rect.top == top && rect.width == width && rect.height == height;
+    }
+
+    // 矩形在帧内、互不重叠、覆盖所有变化的像素，像素数据的长度与矩形一致
+    bool validDelta(const FrameDelta::Delta& delta, const std::vector<uint8_t>& previous, const std::vector<uint8_t>& current,
+                    uint32_t width, uint32_t height, uint32_t bytesPerPixel) {
+        std::vector<uint8_t> coverage(size_t(width) * height, 0);
+        size_t rectBytes = 0;
+
+        for (const auto& rect : delta.rects) {
+            if (rect.width == 0 || rect.height == 0 || rect.left + rect.width > width || rect.top + rect.height > height) {
+                return false;
+            }
+
+            for (uint32_t y = rect.top; y < rect.top + rect.height; y++) {
+                for (uint32_t x = rect.left; x < rect.left + rect.width; x++) {
+                    if (coverage[size_t(y) * width + x]++ != 0) {
+                        return false;
+                    }
+                }
+            }
+
+            rectBytes += size_t(rect.width) * rect.height * bytesPerPixel;
+        }
+
+        for (size_t pixel = 0; pixel < coverage.size(); pixel++) {
+            bool changed = memcmp(&previous[pixel * bytesPerPixel], &current[pixel * bytesPerPixel], bytesPerPixel) != 0;
+
+            if (changed && coverage[pixel] == 0) {
+                return false;
+            }
+        }
+
+        return rectBytes == delta.deltaBytes() && delta.fullBytes == current.size();
+    }
+
+    bool roundTrip(const std::vector<uint8_t>& previous, const std::vector<uint8_t>& current,
+                   uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t tileSize, FrameDelta::Delta& delta) {
+        FrameDelta::diff(previous.data(), current.data(), width, height, bytesPerPixel, delta, tileSize);
+
+        auto frame = previous;
+        FrameDelta::apply(delta, frame.data(), width, bytesPerPixel);
+
+        return frame == current && validDelta(delta, previous, current, width, height, bytesPerPixel);
+    }
+
+    void testIdentical() {
+        std::mt19937 random(41);
+        auto frame = randomFrame(random, 37, 29, 4);
+
+        FrameDelta::Delta delta;
+        FrameDelta::diff(frame.data(), frame.data(), 37, 29, 4, delta);
+
+        CHECK(delta.empty() && delta.deltaBytes() == 0 && delta.fullBytes == frame.size());
+    }
+
+    void testFull() {
+        std::mt19937 random(41);
+        auto frame = randomFrame(random, 37, 29, 4);
+
+        FrameDelta::Delta delta;
+        FrameDelta::full(frame.data(), 37, 29, 4, delta);
+
+        CHECK(delta.rects.size() == 1 && sameRect(delta.rects[0], 0, 0, 37, 29));
+        CHECK(delta.pixels == frame && delta.fullBytes == frame.size());
+
+        std::vector<uint8_t> target(frame.size(), 0);
+        FrameDelta::apply(delta, target.data(), 37, 4);
+        CHECK(target == frame);
+    }
+
+    // 宽高不是tileSize倍数时，右边和下边的块只有剩余的像素
+    void testEdgeTiles() {
+        const uint32_t width = 37;
+        const uint32_t height = 29;
+
+        std::mt19937 random(41);
+        auto previous = randomFrame(random, width, height, 4);
+        FrameDelta::Delta delta;
+
+        auto current = previous;
+        setPixel(current, width, 4, 36, 28);
+        CHECK(roundTrip(previous, current, width, height, 4, 16, delta));
+        CHECK(delta.rects.size() == 1 && sameRect(delta.rects[0], 32, 16, 5, 13));
+
+        current = previous;
+        setPixel(current, width, 4, 0, 28);
+        setPixel(current, width, 4, 20, 28);
+        CHECK(roundTrip(previous, current, width, height, 4, 16, delta));
+        CHECK(delta.rects.size() == 1 && sameRect(delta.rects[0], 0, 16, 32, 13));
+
+        // 同一列的脏块上下合并，包括只有一部分行的最后一行块
+        current = previous;
+        setPixel(current, width, 4, 33, 0);
+        setPixel(current, width, 4, 34, 20);
+        CHECK(roundTrip(previous, current, width, height, 4, 16, delta));
+        CHECK(delta.rects.size() == 1 && sameRect(delta.rects[0], 32, 0, 5, 29));
+
+        // 比一个块还小的帧
+        auto small = randomFrame(random, 3, 2, 1);
+        auto smallChanged = small;
+        setPixel(smallChanged, 3, 1, 2, 1);
+        CHECK(roundTrip(small, smallChanged, 3, 2, 1, 16, delta));
+        CHECK(delta.rects.size() == 1 && sameRect(delta.rects[0], 0, 0, 3, 2));
+    }
+
+    // 脏块的面积达到整帧的3/4时整帧一个矩形，差一个块时仍然是增量
+    void testFullFrameFallback() {
+        const uint32_t size = 64;
+        const uint32_t tileSize = 16;
+        const uint32_t tileCount = (size / tileSize) * (size / tileSize);
+        const uint32_t fullTiles = tileCount * FrameDelta::fullFrameRatio[0] / FrameDelta::fullFrameRatio[1];
+
+        std::mt19937 random(41);
+        auto previous = randomFrame(random, size, size, 4);
+        FrameDelta::Delta delta;
+
+        for (uint32_t changedTiles : { fullTiles - 1, fullTiles, tileCount }) {
+            auto current = previous;
+
+            for (uint32_t tile = 0; tile < changedTiles; tile++) {
+                setPixel(current, size, 4, (tile % 4) * tileSize + 3, (tile / 4) * tileSize + 5);
+            }
+
+            CHECK(roundTrip(previous, current, size, size, 4, tileSize, delta));
+
+            bool isFull = delta.rects.size() == 1 && sameRect(delta.rects[0], 0, 0, size, size) && delta.pixels == current;
+            CHECK(isFull == (changedTiles >= fullTiles));
+
+            if (changedTiles < fullTiles) {
+                CHECK(delta.deltaBytes() == size_t(changedTiles) * tileSize * tileSize * 4);
+            }
+        }
+
+        // 边缘块只算实际的像素：70x70中只有边缘块变化，面积不到3/4
+        auto edgePrevious = randomFrame(random, 70, 70, 1);
+        auto edgeCurrent = edgePrevious;
+
+        for (uint32_t i = 0; i < 70; i++) {
+            setPixel(edgeCurrent, 70, 1, 68, i);
+            setPixel(edgeCurrent, 70, 1, i, 68);
+        }
+
+        CHECK(roundTrip(edgePrevious, edgeCurrent, 70, 70, 1, 16, delta));
+        CHECK(delta.rects.size() == 2 && delta.deltaBytes() == 70 * 6 + 64 * 6);
+    }
+
+    // 随机尺寸、像素大小、块大小和变化位置，apply(diff(previous, current))总是得到current
+    void testRandomRoundTrip() {
+        std::mt19937 random(41);
+        FrameDelta::Delta delta;
+        bool allMatch = true;
+
+        for (uint32_t iteration = 0; iteration < 300; iteration++) {
+            uint32_t width = 1 + random() % 70;
+            uint32_t height = 1 + random() % 70;
+            uint32_t bytesPerPixel = (iteration % 2) ? 4 : 1;
+            uint32_t tileSize = 1u << (random() % 6);
+
+            auto previous = randomFrame(random, width, height, bytesPerPixel);
+            auto current = previous;
+
+            uint32_t changes = random() % (width * height / 4 + 2);
+
+            for (uint32_t change = 0; change < changes; change++) {
+                setPixel(current, width, bytesPerPixel, random() % width, random() % height);
+            }
+
+            allMatch = roundTrip(previous, current, width, height, bytesPerPixel, tileSize, delta) && allMatch;
+        }
+
+        CHECK(allMatch);
+    }
+
+    void testPerformance() {
+        const uint32_t size = 500;
+
+        std::mt19937 random(41);
+        auto previous = randomFrame(random, size, size, 4);
+        auto current = previous;
+
+        // 动画中常见的情况：一个角色在画面中间移动
+        for (uint32_t y = 200; y < 300; y++) {
+            for (uint32_t x = 180; x < 320; x++) {
+                setPixel(current, size, 4, x, y);
+            }
+        }
+
+        FrameDelta::Delta delta;
+
+        double milliseconds = TestUtil::timeMilliseconds(50, [&] {
+            FrameDelta::diff(previous.data(), current.data(), size, size, 4, delta);
+        });
+
+        printf("diff 500x500 RGBA: %.3f ms, %zu rects, %zu of %zu bytes\n",
+               milliseconds, delta.rects.size(), delta.deltaBytes(), delta.fullBytes);
+    }
+}
+
+int main() {
+    testIdentical();
+    testFull();
+    testEdgeTiles();
+    testFullFrameFallback();
+    testRandomRoundTrip();
+    testPerformance();
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,280 @@
+#include "Common/GifAtlas.h"
+#include "GifWriter.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+    // width x height的动画，每帧100毫秒。第0帧铺满画布，之后每帧在不同位置画一个带透明像素的小矩形
+    GifDecoder::GIF makeGif(uint32_t width, uint32_t height, uint32_t frameCount, uint32_t seed, int32_t loopCount = 0) {
+        std::mt19937 random(seed);
+        std::vector<uint32_t> palette(16);
+
+        for (auto& color : palette) {
+            color = 0xff000000u | (random() & 0xffffff);
+        }
+
+        std::vector<GifWriter::Frame> frames;
+
+        for (uint32_t frameIndex = 0; frameIndex < frameCount; frameIndex++) {
+            GifWriter::Frame frame;
+            frame.delay = 10;
+            frame.transparentIndex = 15;
+
+            if (frameIndex == 0) {
+                frame.width = width;
+                frame.height = height;
+            }
+            else {
+                frame.width = 1 + random() % width;
+                frame.height = 1 + random() % height;
+                frame.left = random() % (width - frame.width + 1);
+                frame.top = random() % (height - frame.height + 1);
+                frame.disposal = frameIndex % 3 == 2 ? GifDecoder::disposalPrevious : GifDecoder::disposalNone;
+            }
+
+            frame.indices.resize(size_t(frame.width) * frame.height);
+
+            for (auto& index : frame.indices) {
+                index = static_cast<uint8_t>(frameIndex == 0 ? random() % 15 : random() % 16);
+            }
+
+            frames.push_back(frame);
+        }
+
+        auto bytes = GifWriter::write(width, height, palette, 0, frames, loopCount);
+
+        GifDecoder::GIF gif;
+        CHECK(GifDecoder::parse(bytes.data(), bytes.size(), gif));
+        gif.fileData = bytes;
+
+        return gif;
+    }
+
+    // 不经过图集，直接从这一遍的第0帧合成到frameIndex
+    std::vector<uint32_t> expectedCanvas(const GifDecoder::GIF& gif, uint32_t frameIndex) {
+        GifCompositor compositor;
+        compositor.reset(gif);
+
+        std::vector<uint32_t> pixels;
+
+        for (uint32_t index = 0; index <= frameIndex; index++) {
+            GifDecoder::decodeFrameRGBA(gif, index, pixels);
+            compositor.composite(index, gif.frames[index], pixels.data());
+        }
+
+        return compositor.getCanvas();
+    }
+
+    // 图集中动画的矩形等于画布，四周的边框等于最近的边缘像素
+    bool atlasMatches(const std::vector<uint32_t>& atlasImage, uint32_t atlasWidth, const FrameDelta::Rect& rect,
+                      const std::vector<uint32_t>& canvas) {
+        const int32_t padding = static_cast<int32_t>(GifAtlas::padding);
+
+        for (int32_t y = -padding; y < static_cast<int32_t>(rect.height) + padding; y++) {
+            for (int32_t x = -padding; x < static_cast<int32_t>(rect.width) + padding; x++) {
+                int32_t canvasX = std::min(std::max(x, 0), static_cast<int32_t>(rect.width) - 1);
+                int32_t canvasY = std::min(std::max(y, 0), static_cast<int32_t>(rect.height) - 1);
+
+                size_t atlasIndex = size_t(rect.top + y) * atlasWidth + (rect.left + x);
+
+                if (atlasImage[atlasIndex] != canvas[size_t(canvasY) * rect.width + canvasX]) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void applyBatch(const FrameDelta::Delta& batch, std::vector<uint32_t>& atlasImage, uint32_t atlasWidth) {
+        FrameDelta::apply(batch, reinterpret_cast<uint8_t*>(atlasImage.data()), atlasWidth, sizeof(uint32_t));
+    }
+
+    bool overlaps(const FrameDelta::Rect& a, const FrameDelta::Rect& b) {
+        return a.left < b.left + b.width && b.left < a.left + a.width && a.top < b.top + b.height && b.top < a.top + a.height;
+    }
+
+    FrameDelta::Rect padded(const FrameDelta::Rect& rect) {
+        FrameDelta::Rect result = rect;
+        result.left -= GifAtlas::padding;
+        result.top -= GifAtlas::padding;
+        result.width += GifAtlas::padding * 2;
+        result.height += GifAtlas::padding * 2;
+
+        return result;
+    }
+
+    bool sameRect(const FrameDelta::Rect& rect, uint32_t left, uint32_t top, uint32_t width, uint32_t height) {
+        return rect.left == left && rect.top == top && rect.width == width && rect.height == height;
+    }
+
+    // 货架打包：同一货架从左到右排列，高度或者剩余宽度不够时在下面开新货架
+    void testPacking() {
+        GifAtlas atlas(64, 32, 1);
+
+        CHECK(atlas.add(makeGif(10, 8, 1, 1)) == 0);
+        CHECK(atlas.add(makeGif(20, 6, 1, 2)) == 1);
+        CHECK(atlas.add(makeGif(30, 12, 1, 3)) == 2);
+        CHECK(atlas.add(makeGif(40, 5, 1, 4)) == 3);
+        CHECK(atlas.add(makeGif(4, 4, 1, 5)) == 4);
+
+        CHECK(sameRect(atlas.getRect(0), 1, 1, 10, 8));
+        CHECK(sameRect(atlas.getRect(1), 13, 1, 20, 6));
+        CHECK(sameRect(atlas.getRect(2), 1, 11, 30, 12));
+        CHECK(sameRect(atlas.getRect(3), 1, 25, 40, 5));
+        CHECK(sameRect(atlas.getRect(4), 35, 1, 4, 4));
+
+        // 加上边框以后的矩形在图集内且互不重叠
+        bool disjoint = true;
+
+        for (uint32_t i = 0; i < 5; i++) {
+            auto a = padded(atlas.getRect(i));
+            disjoint = disjoint && a.left + a.width <= 64 && a.top + a.height <= 32;
+
+            for (uint32_t j = i + 1; j < 5; j++) {
+                disjoint = disjoint && !overlaps(a, padded(atlas.getRect(j)));
+            }
+        }
+
+        CHECK(disjoint);
+
+        // 太宽、太高(放不进任何货架，下面也没有空间)或者没有帧的GIF
+        CHECK(atlas.add(makeGif(63, 1, 1, 6)) == -1);
+        CHECK(atlas.add(makeGif(2, 20, 1, 7)) == -1);
+        CHECK(atlas.add(GifDecoder::GIF()) == -1);
+        CHECK(atlas.getStats().animations == 5);
+
+        // UV范围是不包括边框的画布
+        auto uv = atlas.getUVRect(2);
+        CHECK(uv.u0 == 1.0f / 64.0f && uv.v0 == 11.0f / 32.0f && uv.u1 == 31.0f / 64.0f && uv.v1 == 23.0f / 32.0f);
+
+        auto first = atlas.getUVRect(0);
+        CHECK(first.u0 == 1.0f / 64.0f && first.v0 == 1.0f / 32.0f && first.u1 == 11.0f / 64.0f && first.v1 == 9.0f / 32.0f);
+    }
+
+    // 把每次update()的批次应用到CPU端的图集图像上，每个动画的区域都要等于直接合成的结果
+    void testPlayback(uint32_t workerCount) {
+        const uint32_t atlasWidth = 96;
+        const uint32_t atlasHeight = 64;
+
+        GifAtlas atlas(atlasWidth, atlasHeight, workerCount);
+
+        std::vector<GifDecoder::GIF> gifs = {
+            makeGif(17, 13, 5, 11), makeGif(9, 21, 4, 12), makeGif(30, 7, 6, 13),
+            // 只播放一遍，之后停在最后一帧
+            makeGif(11, 11, 3, 14, 1)
+        };
+
+        for (const auto& gif : gifs) {
+            CHECK(atlas.add(gif) >= 0);
+        }
+
+        std::vector<uint32_t> atlasImage(size_t(atlasWidth) * atlasHeight, 0);
+        bool allMatch = true;
+        bool framesMatch = true;
+
+        // 动画从第一次update()开始计时：0毫秒显示第0帧，每100毫秒换一帧，跳过一整遍以上时从那一遍的第0帧重新合成
+        for (double timeMS : { 1000.0, 1050.0, 1100.0, 1250.0, 1499.0, 2730.0, 2730.0, 2800.0, 9999.0 }) {
+            const auto& batch = atlas.update(timeMS);
+            applyBatch(batch, atlasImage, atlasWidth);
+
+            for (uint32_t animation = 0; animation < gifs.size(); animation++) {
+                const auto& gif = gifs[animation];
+                uint64_t sequence = static_cast<uint64_t>((timeMS - 1000.0) / 100.0);
+
+                if (gif.hasLoop) {
+                    sequence = std::min<uint64_t>(sequence, uint64_t(gif.totalLoopCount) * gif.frameCount - 1);
+                }
+
+                uint32_t frameIndex = static_cast<uint32_t>(sequence % gif.frameCount);
+
+                framesMatch = framesMatch && atlas.getCurrentFrame(animation) == frameIndex;
+                allMatch = allMatch && atlasMatches(atlasImage, atlasWidth, atlas.getRect(animation), expectedCanvas(gif, frameIndex));
+            }
+        }
+
+        CHECK(framesMatch);
+        CHECK(allMatch);
+        CHECK(atlas.getStats().failedAnimations == 0);
+
+        // 帧号没有变化时批次为空
+        CHECK(atlas.update(9999.0).empty() && atlas.getStats().changedAnimations == 0);
+    }
+
+    // 第一次update()上传整个图块(画布加边框)，之后只上传变化的部分
+    void testFirstUploadIsFull() {
+        GifAtlas atlas(64, 64, 1);
+        auto gif = makeGif(20, 10, 2, 21);
+        atlas.add(gif);
+
+        const auto& first = atlas.update(0.0);
+        CHECK(first.rects.size() == 1 && sameRect(first.rects[0], 0, 0, 22, 12));
+        CHECK(first.deltaBytes() == 22 * 12 * sizeof(uint32_t) && first.fullBytes == 64 * 64 * sizeof(uint32_t));
+
+        CHECK(atlas.update(50.0).empty());
+
+        const auto& second = atlas.update(100.0);
+        CHECK(second.deltaBytes() <= 22 * 12 * sizeof(uint32_t));
+    }
+
+    // 工作线程的个数不影响批次的内容和顺序
+    void testWorkersDeterministic() {
+        GifAtlas single(256, 256, 1);
+        GifAtlas parallel(256, 256, 4);
+
+        for (uint32_t i = 0; i < 24; i++) {
+            auto gif = makeGif(8 + i % 20, 6 + i % 13, 2 + i % 5, 100 + i);
+            CHECK(single.add(gif) == parallel.add(gif));
+        }
+
+        bool same = true;
+
+        for (double timeMS = 0.0; timeMS < 2000.0; timeMS += 37.0) {
+            const auto& a = single.update(timeMS);
+            const auto& b = parallel.update(timeMS);
+
+            same = same && a.pixels == b.pixels && a.rects.size() == b.rects.size();
+
+            for (size_t i = 0; same && i < a.rects.size(); i++) {
+                same = sameRect(a.rects[i], b.rects[i].left, b.rects[i].top, b.rects[i].width, b.rects[i].height);
+            }
+        }
+
+        CHECK(same);
+    }
+
+    void testPerformance() {
+        GifAtlas atlas(2048, 2048);
+
+        for (uint32_t i = 0; i < 400; i++) {
+            CHECK(atlas.add(makeGif(64, 64, 8, 1000 + i)) >= 0);
+        }
+
+        atlas.update(0.0);
+
+        double timeMS = 0.0;
+        size_t uploadBytes = 0;
+
+        double milliseconds = TestUtil::timeMilliseconds(50, [&] {
+            timeMS += 100.0;
+            uploadBytes += atlas.update(timeMS).deltaBytes();
+        });
+
+        printf("400 animations 64x64, %u workers: update %.3f ms, %.1f KB uploaded per frame\n",
+               atlas.getStats().workers, milliseconds, uploadBytes / 50.0 / 1024.0);
+    }
+}
+
+int main() {
+    testPacking();
+    testPlayback(1);
+    testPlayback(4);
+    testFirstUploadIsFull();
+    testWorkersDeterministic();
+    testPerformance();
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,300 @@
+#include "Common/GifCompositor.h"
+#include "TestUtil.h"
+
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+    const uint32_t background = 0xff204060u;
+    // background(0xAARRGGBB)对应的R8G8B8A8
+    const uint32_t backgroundRGBA = 0xff604020u;
+
+    GifDecoder::GIFFrame makeFrame(uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint32_t disposal) {
+        GifDecoder::GIFFrame frame;
+        frame.leftTop[0] = left;
+        frame.leftTop[1] = top;
+        frame.size[0] = width;
+        frame.size[1] = height;
+        frame.disposal = disposal;
+
+        return frame;
+    }
+
+    std::vector<uint32_t> solidPixels(const GifDecoder::GIFFrame& frame, uint32_t color) {
+        return std::vector<uint32_t>(size_t(frame.size[0]) * frame.size[1], color);
+    }
+
+    uint32_t at(const GifCompositor& compositor, uint32_t x, uint32_t y) {
+        return compositor.getCanvas()[size_t(y) * compositor.getWidth() + x];
+    }
+
+    // 逐像素实现的合成规则，与GifCompositor.h中的说明一一对应，用来和SSE2版本比较
+    class ReferenceCompositor {
+    public:
+        void reset(uint32_t inWidth, uint32_t inHeight, uint32_t inBackground) {
+            width = inWidth;
+            height = inHeight;
+            fill = inBackground;
+            canvas.assign(size_t(width) * height, fill);
+            saved.clear();
+        }
+
+        void composite(uint32_t frameIndex, const GifDecoder::GIFFrame& frame, const uint32_t* pixels) {
+            if (frameIndex == 0) {
+                canvas.assign(canvas.size(), fill);
+                saved.clear();
+            }
+
+            for (const auto& pixel : saved) {
+                canvas[pixel.first] = pixel.second;
+            }
+
+            saved.clear();
+
+            for (uint32_t y = 0; y < frame.size[1]; y++) {
+                for (uint32_t x = 0; x < frame.size[0]; x++) {
+                    uint32_t canvasX = frame.leftTop[0] + x;
+                    uint32_t canvasY = frame.leftTop[1] + y;
+
+                    if (canvasX >= width || canvasY >= height) {
+                        continue;
+                    }
+
+                    size_t index = size_t(canvasY) * width + canvasX;
+                    uint32_t source = pixels[size_t(y) * frame.size[0] + x];
+
+                    if (frame.disposal == GifDecoder::disposalPrevious) {
+                        saved.emplace_back(index, canvas[index]);
+                    }
+
+                    if (source >> 24) {
+                        canvas[index] = source;
+                    }
+                    else if (frame.disposal == GifDecoder::disposalBackground) {
+                        canvas[index] = fill;
+                    }
+                }
+            }
+        }
+
+        std::vector<uint32_t> canvas;
+
+    private:
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t fill = 0;
+        std::vector<std::pair<size_t, uint32_t>> saved;
+    };
+
+    void testFirstFrameClears() {
+        GifCompositor compositor;
+        compositor.reset(6, 5, background);
+
+        CHECK(compositor.getWidth() == 6 && compositor.getHeight() == 5);
+        CHECK(at(compositor, 0, 0) == backgroundRGBA && at(compositor, 5, 4) == backgroundRGBA);
+
+        auto frame = makeFrame(0, 0, 6, 5, GifDecoder::disposalNone);
+        auto pixels = solidPixels(frame, 0xff0000ffu);
+        compositor.composite(1, frame, pixels.data());
+        CHECK(at(compositor, 3, 3) == 0xff0000ffu);
+
+        // 第0帧先用背景色清空画布，透明像素露出的是背景色
+        auto transparent = solidPixels(frame, 0);
+        compositor.composite(0, frame, transparent.data());
+        CHECK(at(compositor, 3, 3) == backgroundRGBA);
+
+        // reset(gif)使用像素宽高和背景色
+        GifDecoder::GIF gif;
+        gif.width = 8;
+        gif.height = 4;
+        gif.pixelWidth = 8;
+        gif.pixelHeight = 2;
+        gif.backgroundColor = 0xff112233u;
+        compositor.reset(gif);
+        CHECK(compositor.getWidth() == 8 && compositor.getHeight() == 2 && at(compositor, 7, 1) == 0xff332211u);
+    }
+
+    // 超出画布的部分被裁掉，画布之外的帧不绘制
+    void testClipping() {
+        GifCompositor compositor;
+        compositor.reset(10, 8, background);
+
+        auto frame = makeFrame(7, 5, 6, 6, GifDecoder::disposalNone);
+        std::vector<uint32_t> pixels(36);
+
+        for (uint32_t i = 0; i < 36; i++) {
+            pixels[i] = 0xff000000u | i;
+        }
+
+        compositor.composite(0, frame, pixels.data());
+
+        bool clipped = true;
+
+        for (uint32_t y = 0; y < 8; y++) {
+            for (uint32_t x = 0; x < 10; x++) {
+                uint32_t expected = (x >= 7 && y >= 5) ? pixels[(y - 5) * 6 + (x - 7)] : backgroundRGBA;
+                clipped = clipped && at(compositor, x, y) == expected;
+            }
+        }
+
+        CHECK(clipped);
+
+        auto before = compositor.getCanvas();
+
+        for (auto outside : { makeFrame(10, 0, 4, 4, GifDecoder::disposalNone), makeFrame(0, 8, 4, 4, GifDecoder::disposalBackground),
+                              makeFrame(200, 300, 4, 4, GifDecoder::disposalPrevious) }) {
+            auto outsidePixels = solidPixels(outside, 0xffffffffu);
+            compositor.composite(1, outside, outsidePixels.data());
+            CHECK(compositor.getCanvas() == before);
+        }
+    }
+
+    // disposalPrevious：下一帧合成之前恢复这一帧覆盖的区域(包括被裁剪的帧)
+    void testDisposalPrevious() {
+        GifCompositor compositor;
+        compositor.reset(9, 7, background);
+
+        auto base = makeFrame(0, 0, 9, 7, GifDecoder::disposalNone);
+        std::vector<uint32_t> basePixels(63);
+
+        for (uint32_t i = 0; i < 63; i++) {
+            basePixels[i] = 0xff000000u | (i * 0x010203u);
+        }
+
+        compositor.composite(0, base, basePixels.data());
+        const auto baseCanvas = compositor.getCanvas();
+
+        // 一半透明、右下角超出画布的临时帧
+        auto overlay = makeFrame(5, 4, 6, 5, GifDecoder::disposalPrevious);
+        std::vector<uint32_t> overlayPixels(30);
+
+        for (uint32_t i = 0; i < 30; i++) {
+            overlayPixels[i] = (i % 2) ? 0xffabcdefu : 0;
+        }
+
+        compositor.composite(1, overlay, overlayPixels.data());
+        CHECK(at(compositor, 6, 4) == 0xffabcdefu);
+        CHECK(at(compositor, 5, 4) == baseCanvas[4 * 9 + 5]);
+
+        // 下一帧完全透明，画布恢复成临时帧之前的内容
+        auto empty = makeFrame(0, 0, 2, 2, GifDecoder::disposalNone);
+        auto emptyPixels = solidPixels(empty, 0);
+        compositor.composite(2, empty, emptyPixels.data());
+        CHECK(compositor.getCanvas() == baseCanvas);
+
+        // 恢复只发生一次
+        auto mark = makeFrame(6, 5, 1, 1, GifDecoder::disposalNone);
+        auto markPixels = solidPixels(mark, 0xff00ff00u);
+        compositor.composite(3, mark, markPixels.data());
+        compositor.composite(4, empty, emptyPixels.data());
+        CHECK(at(compositor, 6, 5) == 0xff00ff00u);
+
+        // 第0帧丢弃保存的区域，不会在第1帧时恢复成上一遍的内容
+        compositor.composite(5, overlay, overlayPixels.data());
+        compositor.composite(0, empty, emptyPixels.data());
+        compositor.composite(1, empty, emptyPixels.data());
+        CHECK(at(compositor, 6, 4) == backgroundRGBA);
+    }
+
+    // disposalBackground：不透明的像素覆盖画布，透明的像素填背景色，帧之外的画布不变
+    void testDisposalBackground() {
+        GifCompositor compositor;
+        compositor.reset(8, 6, background);
+
+        auto base = makeFrame(0, 0, 8, 6, GifDecoder::disposalNone);
+        auto basePixels = solidPixels(base, 0xff0000ffu);
+        compositor.composite(0, base, basePixels.data());
+
+        auto frame = makeFrame(1, 1, 5, 3, GifDecoder::disposalBackground);
+        std::vector<uint32_t> pixels(15, 0);
+        pixels[7] = 0xff00ff00u;
+
+        compositor.composite(1, frame, pixels.data());
+
+        CHECK(at(compositor, 0, 0) == 0xff0000ffu && at(compositor, 6, 1) == 0xff0000ffu);
+        CHECK(at(compositor, 1, 1) == backgroundRGBA && at(compositor, 5, 3) == backgroundRGBA);
+        CHECK(at(compositor, 3, 2) == 0xff00ff00u);
+
+        // disposalNone时透明像素保留画布的内容
+        frame.disposal = GifDecoder::disposalNone;
+        auto opaque = solidPixels(frame, 0xffff0000u);
+        compositor.composite(2, frame, opaque.data());
+        compositor.composite(3, frame, pixels.data());
+        CHECK(at(compositor, 1, 1) == 0xffff0000u && at(compositor, 3, 2) == 0xff00ff00u);
+    }
+
+    // 宽度1到13、任意位置和处理方式的随机帧序列，SSE2的4像素一组加上剩余像素的结果必须与逐像素的实现相同
+    void testMatchesReference() {
+        std::mt19937 random(38);
+        std::uniform_int_distribution<uint32_t> sizeDistribution(1, 13);
+        std::uniform_int_distribution<uint32_t> disposalDistribution(0, 3);
+        std::uniform_int_distribution<uint32_t> colorDistribution;
+
+        bool allMatch = true;
+
+        for (uint32_t canvasWidth = 1; canvasWidth <= 13; canvasWidth++) {
+            GifCompositor compositor;
+            ReferenceCompositor reference;
+
+            uint32_t canvasHeight = sizeDistribution(random);
+            compositor.reset(canvasWidth, canvasHeight, background);
+            reference.reset(canvasWidth, canvasHeight, backgroundRGBA);
+
+            for (uint32_t frameIndex = 0; frameIndex < 40; frameIndex++) {
+                uint32_t width = sizeDistribution(random);
+                uint32_t height = sizeDistribution(random);
+                uint32_t left = random() % (canvasWidth + 2);
+                uint32_t top = random() % (canvasHeight + 2);
+
+                auto frame = makeFrame(left, top, width, height, disposalDistribution(random));
+                std::vector<uint32_t> pixels(size_t(width) * height);
+
+                for (auto& pixel : pixels) {
+                    // 大约一半透明，不透明的alpha不一定是255
+                    uint32_t color = colorDistribution(random);
+                    pixel = (color & 1) ? (color | 0x01000000u) : 0;
+                }
+
+                uint32_t sequenceIndex = frameIndex % 10;
+                compositor.composite(sequenceIndex, frame, pixels.data());
+                reference.composite(sequenceIndex, frame, pixels.data());
+
+                allMatch = allMatch && compositor.getCanvas() == reference.canvas;
+            }
+        }
+
+        CHECK(allMatch);
+    }
+
+    void testPerformance() {
+        GifCompositor compositor;
+        compositor.reset(500, 500, background);
+
+        auto frame = makeFrame(0, 0, 500, 500, GifDecoder::disposalNone);
+        std::vector<uint32_t> pixels(500 * 500);
+
+        for (size_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = (i % 3) ? 0xff000000u | static_cast<uint32_t>(i) : 0;
+        }
+
+        uint32_t frameIndex = 1;
+
+        double milliseconds = TestUtil::timeMilliseconds(200, [&] {
+            compositor.composite(frameIndex++, frame, pixels.data());
+        });
+
+        printf("composite 500x500 frame: %.3f ms (%.0f MPix/s)\n", milliseconds, 500 * 500 / milliseconds / 1000.0);
+    }
+}
+
+int main() {
+    testFirstFrameClears();
+    testClipping();
+    testDisposalPrevious();
+    testDisposalBackground();
+    testMatchesReference();
+    testPerformance();
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,365 @@
+#include "Common/GifDecoder.h"
+#include "GifWriter.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+    // GIF89a规范附带的示例图片：10x10，全局调色板为白、红、蓝、黑，
+    // 左上和右下是红色，右上和左下是蓝色，中间4x4是白色
+    const uint8_t sampleGIF[] = {
+        0x47, 0x49, 0x46, 0x38, 0x39, 0x61, 0x0a, 0x00, 0x0a, 0x00, 0x91, 0x00, 0x00,
+        0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00,
+        0x21, 0xf9, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x2c, 0x00, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x0a, 0x00, 0x00,
+        0x02, 0x16, 0x8c, 0x2d, 0x99, 0x87, 0x2a, 0x1c, 0xdc, 0x33, 0xa0, 0x02, 0x75, 0xec, 0x95, 0xfa,
+        0xa8, 0xde, 0x60, 0x8c, 0x04, 0x91, 0x4c, 0x01, 0x00,
+        0x3b
+    };
+
+    // 图像描述中标志字节的位置
+    const size_t sampleImageFlags = 42;
+
+    const uint8_t sampleIndices[10][10] = {
+        { 1, 1, 1, 1, 1, 2, 2, 2, 2, 2 },
+        { 1, 1, 1, 1, 1, 2, 2, 2, 2, 2 },
+        { 1, 1, 1, 1, 1, 2, 2, 2, 2, 2 },
+        { 1, 1, 1, 0, 0, 0, 0, 2, 2, 2 },
+        { 1, 1, 1, 0, 0, 0, 0, 2, 2, 2 },
+        { 2, 2, 2, 0, 0, 0, 0, 1, 1, 1 },
+        { 2, 2, 2, 0, 0, 0, 0, 1, 1, 1 },
+        { 2, 2, 2, 2, 2, 1, 1, 1, 1, 1 },
+        { 2, 2, 2, 2, 2, 1, 1, 1, 1, 1 },
+        { 2, 2, 2, 2, 2, 1, 1, 1, 1, 1 },
+    };
+
+    const uint32_t white = 0xffffffffu;
+    const uint32_t red = 0xff0000ffu;
+    const uint32_t blue = 0xffff0000u;
+
+    bool parseBytes(const std::vector<uint8_t>& bytes, GifDecoder::GIF& gif) {
+        if (!GifDecoder::parse(bytes.data(), bytes.size(), gif)) {
+            return false;
+        }
+
+        gif.fileData = bytes;
+
+        return true;
+    }
+
+    std::vector<uint8_t> patternIndices(uint32_t width, uint32_t height, uint32_t colorCount) {
+        std::vector<uint8_t> indices(size_t(width) * height);
+
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                indices[size_t(y) * width + x] = static_cast<uint8_t>((x * 3 + y * 5) % colorCount);
+            }
+        }
+
+        return indices;
+    }
+
+    void testSample() {
+        std::vector<uint8_t> bytes(sampleGIF, sampleGIF + sizeof(sampleGIF));
+        GifDecoder::GIF gif;
+
+        if (!CHECK(parseBytes(bytes, gif))) {
+            return;
+        }
+
+        CHECK(gif.width == 10 && gif.height == 10 && gif.frameCount == 1);
+        CHECK(gif.hasGlobalPalette && gif.globalPalette.colorCount == 4);
+        // 背景是第0个颜色(白色)，0xAARRGGBB
+        CHECK(gif.backgroundColor == 0xffffffffu);
+        CHECK(!gif.frames[0].interlaced && !gif.frames[0].hasLocalPalette);
+        CHECK(gif.frames[0].delay == 100);
+
+        std::vector<uint8_t> indices;
+        CHECK(GifDecoder::decodeFrameIndices(gif, 0, indices));
+        CHECK(indices == std::vector<uint8_t>(&sampleIndices[0][0], &sampleIndices[0][0] + 100));
+
+        std::vector<uint32_t> pixels;
+        CHECK(GifDecoder::decodeFrameRGBA(gif, 0, pixels) && pixels.size() == 100);
+        CHECK(pixels[0] == red && pixels[9] == blue && pixels[90] == blue && pixels[99] == red && pixels[44] == white);
+    }
+
+    // 同一段数据按交错存储解释：数据中的第k行放到交错行序的第k个位置
+    void testSampleInterlaced() {
+        std::vector<uint8_t> bytes(sampleGIF, sampleGIF + sizeof(sampleGIF));
+        bytes[sampleImageFlags] |= 0x40;
+
+        GifDecoder::GIF gif;
+
+        if (!CHECK(parseBytes(bytes, gif))) {
+            return;
+        }
+
+        CHECK(gif.frames[0].interlaced);
+
+        const uint32_t rowOrder[10] = { 0, 8, 4, 2, 6, 1, 3, 5, 7, 9 };
+
+        std::vector<uint8_t> indices;
+        CHECK(GifDecoder::decodeFrameIndices(gif, 0, indices) && indices.size() == 100);
+
+        bool rowsMatch = true;
+
+        for (uint32_t k = 0; k < 10; k++) {
+            for (uint32_t x = 0; x < 10; x++) {
+                rowsMatch = rowsMatch && indices[rowOrder[k] * 10 + x] == sampleIndices[k][x];
+            }
+        }
+
+        CHECK(rowsMatch);
+    }
+
+    // 加上一个局部调色板(黑、绿、黄、青)，像素改用局部调色板的颜色，全局调色板保持不变
+    void testSampleLocalPalette() {
+        std::vector<uint8_t> bytes(sampleGIF, sampleGIF + sizeof(sampleGIF));
+        bytes[sampleImageFlags] = 0x81;
+
+        const uint8_t localPalette[] = { 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0xff, 0xff, 0x00, 0x00, 0xff, 0xff };
+        bytes.insert(bytes.begin() + sampleImageFlags + 1, localPalette, localPalette + sizeof(localPalette));
+
+        GifDecoder::GIF gif;
+
+        if (!CHECK(parseBytes(bytes, gif))) {
+            return;
+        }
+
+        const auto& frame = gif.frames[0];
+        CHECK(frame.hasLocalPalette && frame.localPalette.colorCount == 4);
+        CHECK(&GifDecoder::framePalette(gif, frame) == &frame.localPalette);
+        CHECK(gif.globalPalette.colors[1] == red);
+
+        std::vector<uint32_t> pixels;
+        CHECK(GifDecoder::decodeFrameRGBA(gif, 0, pixels) && pixels.size() == 100);
+        // 红 -> 绿，蓝 -> 黄，白 -> 黑
+        CHECK(pixels[0] == 0xff00ff00u && pixels[9] == 0xff00ffffu && pixels[44] == 0xff000000u);
+    }
+
+    // 交错存储、局部调色板、透明索引同时出现，高度覆盖交错的4遍
+    void testInterlacedLocalPalette() {
+        const std::vector<uint32_t> globalPalette = { 0xff102030u, 0xff405060u, 0xff708090u, 0xffa0b0c0u };
+        std::vector<uint32_t> localPalette;
+
+        for (uint32_t i = 0; i < 8; i++) {
+            localPalette.push_back(0xff000000u | (i * 0x1f) | ((255 - i * 0x1f) << 8) | ((i * 0x0b) << 16));
+        }
+
+        GifWriter::Frame frame;
+        frame.left = 2;
+        frame.top = 3;
+        frame.width = 7;
+        frame.height = 19;
+        frame.indices = patternIndices(frame.width, frame.height, 8);
+        frame.localPalette = localPalette;
+        frame.interlaced = true;
+        frame.transparentIndex = 5;
+        frame.disposal = GifDecoder::disposalBackground;
+        frame.delay = 7;
+
+        auto bytes = GifWriter::write(12, 24, globalPalette, 2, { frame }, 3);
+
+        GifDecoder::GIF gif;
+
+        if (!CHECK(parseBytes(bytes, gif))) {
+            return;
+        }
+
+        CHECK(gif.width == 12 && gif.height == 24 && gif.frameCount == 1);
+        CHECK(gif.hasLoop && gif.totalLoopCount == 3);
+        // 第2个颜色0xff708090(R8G8B8A8)按0xAARRGGBB排列
+        CHECK(gif.backgroundColor == 0xff908070u);
+
+        const auto& decodedFrame = gif.frames[0];
+        CHECK(decodedFrame.interlaced && decodedFrame.hasLocalPalette && decodedFrame.localPalette.colorCount == 8);
+        CHECK(decodedFrame.leftTop[0] == 2 && decodedFrame.leftTop[1] == 3);
+        CHECK(decodedFrame.size[0] == 7 && decodedFrame.size[1] == 19);
+        CHECK(decodedFrame.disposal == GifDecoder::disposalBackground);
+        CHECK(decodedFrame.delay == 70 && decodedFrame.transparentIndex == 5);
+
+        std::vector<uint8_t> indices;
+        CHECK(GifDecoder::decodeFrameIndices(gif, 0, indices) && indices == frame.indices);
+
+        std::vector<uint32_t> pixels;
+        CHECK(GifDecoder::decodeFrameRGBA(gif, 0, pixels) && pixels.size() == frame.indices.size());
+
+        bool pixelsMatch = true;
+
+        for (size_t i = 0; i < pixels.size(); i++) {
+            uint8_t index = frame.indices[i];
+            pixelsMatch = pixelsMatch && pixels[i] == (index == 5 ? 0u : localPalette[index]);
+        }
+
+        CHECK(pixelsMatch);
+    }
+
+    // 256色的随机像素让码表很快填满，覆盖码长增长到12位和码表满后的清除码；
+    // 长串相同的像素覆盖KwKwK的情况
+    void testLargeFrames() {
+        std::mt19937 random(37);
+
+        for (uint32_t colorCount : { 2u, 4u, 16u, 256u }) {
+            std::vector<uint32_t> palette(colorCount);
+
+            for (uint32_t i = 0; i < colorCount; i++) {
+                palette[i] = 0xff000000u | (i * 0x010101u);
+            }
+
+            GifWriter::Frame noise;
+            noise.width = 300;
+            noise.height = 200;
+            noise.indices.resize(size_t(noise.width) * noise.height);
+
+            std::uniform_int_distribution<uint32_t> distribution(0, colorCount - 1);
+
+            for (auto& index : noise.indices) {
+                index = static_cast<uint8_t>(distribution(random));
+            }
+
+            GifWriter::Frame runs = noise;
+
+            for (size_t i = 0; i < runs.indices.size(); i++) {
+                runs.indices[i] = static_cast<uint8_t>((i / 97) % colorCount);
+            }
+
+            auto bytes = GifWriter::write(300, 200, palette, 0, { noise, runs });
+
+            GifDecoder::GIF gif;
+
+            if (!CHECK(parseBytes(bytes, gif) && gif.frameCount == 2)) {
+                continue;
+            }
+
+            std::vector<uint8_t> indices;
+            CHECK(GifDecoder::decodeFrameIndices(gif, 0, indices) && indices == noise.indices);
+            CHECK(GifDecoder::decodeFrameIndices(gif, 1, indices) && indices == runs.indices);
+        }
+    }
+
+    void testTruncated() {
+        std::vector<uint8_t> bytes(sampleGIF, sampleGIF + sizeof(sampleGIF));
+        GifDecoder::GIF gif;
+
+        // 文件头、全局调色板或者图像数据不完整时解析失败
+        for (size_t size : { size_t(0), size_t(6), size_t(12), size_t(20), size_t(40), size_t(50), size_t(66) }) {
+            CHECK(!GifDecoder::parse(bytes.data(), size, gif));
+        }
+
+        // 缺少结尾的0x3b仍然可以解析
+        CHECK(GifDecoder::parse(bytes.data(), bytes.size() - 1, gif) && gif.frameCount == 1);
+
+        // 签名错误
+        auto badSignature = bytes;
+        badSignature[4] = '8';
+        CHECK(!GifDecoder::parse(badSignature.data(), badSignature.size(), gif));
+
+        // 没有任何帧
+        std::vector<uint8_t> noFrames(sampleGIF, sampleGIF + 25);
+        noFrames.push_back(0x3b);
+        CHECK(!GifDecoder::parse(noFrames.data(), noFrames.size(), gif));
+
+        // 未知的块类型
+        auto unknownBlock = bytes;
+        unknownBlock[33] = 0x2b;
+        CHECK(!GifDecoder::parse(unknownBlock.data(), unknownBlock.size(), gif));
+    }
+
+    void testCorruptData() {
+        // LZW数据提前结束：已经解出的像素正确，其余填0
+        GifWriter::Frame frame;
+        frame.width = 13;
+        frame.height = 9;
+        frame.indices = patternIndices(frame.width, frame.height, 4);
+        frame.encodedPixels = 50;
+
+        // 全局调色板的第0个颜色不是0，确认填充的是索引0而不是某个颜色值
+        auto bytes = GifWriter::write(13, 9, { 0xff0000ffu, 0xff00ff00u, 0xffff0000u, 0xffffffffu }, 0, { frame });
+
+        GifDecoder::GIF gif;
+        std::vector<uint8_t> indices;
+
+        if (CHECK(parseBytes(bytes, gif))) {
+            CHECK(GifDecoder::decodeFrameIndices(gif, 0, indices) && indices.size() == frame.indices.size());
+
+            auto expected = frame.indices;
+            std::fill(expected.begin() + 50, expected.end(), 0);
+            CHECK(indices == expected);
+
+            std::vector<uint32_t> pixels;
+            CHECK(GifDecoder::decodeFrameRGBA(gif, 0, pixels) && pixels.size() == expected.size());
+            CHECK(pixels[49] == gif.globalPalette.colors[expected[49]] && pixels[50] == 0xff0000ffu);
+        }
+
+        // 无效的码：清除码之后是1，然后是还没有定义的7(此时下一个码是6)，解码在这里停止
+        GifWriter::BitWriter writer;
+        writer.write(4, 3);
+        writer.write(1, 3);
+        writer.write(7, 3);
+        writer.write(2, 3);
+        writer.write(5, 3);
+
+        std::vector<uint8_t> invalid(sampleGIF, sampleGIF + 43);
+        invalid.push_back(2);
+        GifWriter::appendSubBlocks(invalid, writer.finish());
+        invalid.push_back(0x3b);
+
+        if (CHECK(parseBytes(invalid, gif))) {
+            CHECK(GifDecoder::decodeFrameIndices(gif, 0, indices) && indices.size() == 100);
+            CHECK(indices[0] == 1 && std::count(indices.begin(), indices.end(), 0) == 99);
+        }
+
+        // 最小码长超出范围
+        for (uint8_t minCodeSize : { 0, 12 }) {
+            std::vector<uint8_t> badCodeSize(sampleGIF, sampleGIF + sizeof(sampleGIF));
+            badCodeSize[43] = minCodeSize;
+
+            if (CHECK(parseBytes(badCodeSize, gif))) {
+                CHECK(!GifDecoder::decodeFrameIndices(gif, 0, indices));
+            }
+        }
+
+        CHECK(!GifDecoder::decodeFrameIndices(gif, 1, indices));
+    }
+
+    void testPerformance() {
+        GifDecoder::GIF gif;
+
+        if (!CHECK(GifDecoder::load("Textures/Kanna0.gif", gif))) {
+            return;
+        }
+
+        std::vector<uint32_t> pixels;
+        size_t pixelCount = 0;
+        bool allDecoded = true;
+
+        double milliseconds = TestUtil::timeMilliseconds(5, [&] {
+            pixelCount = 0;
+
+            for (uint32_t frameIndex = 0; frameIndex < gif.frameCount; frameIndex++) {
+                allDecoded = GifDecoder::decodeFrameRGBA(gif, frameIndex, pixels) && allDecoded;
+                pixelCount += pixels.size();
+            }
+        });
+
+        CHECK(allDecoded);
+
+        printf("Kanna0.gif: %u frames %ux%u, decode all frames %.2f ms (%.1f MPix/s)\n",
+               gif.frameCount, gif.width, gif.height, milliseconds, pixelCount / milliseconds / 1000.0);
+    }
+}
+
+int main() {
+    testSample();
+    testSampleInterlaced();
+    testSampleLocalPalette();
+    testInterlacedLocalPalette();
+    testLargeFrames();
+    testTruncated();
+    testCorruptData();
+    testPerformance();
+
+    return TestUtil::finish();
+}
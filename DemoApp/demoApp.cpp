@@ -36,6 +36,9 @@ LRESULT demoApp::msgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 }
 
 bool demoApp::initialize() {
+    // 先把纹理解码和着色器的编译、读取交给工作线程，与设备和窗口的创建同时进行
+    requestAssets();
+
     if(!d3dApp::initialize()) {
         return false;
     }
@@ -441,8 +444,9 @@ void demoApp::createRootSignature() {
 
 void demoApp::createShadersAndInputLayout() {
 
-    vertexShaderByteCode = d3dUtil::compileShader(L"Shaders/color.hlsl", L"VS", L"vs_6_0");
-    pixelShaderByteCode = d3dUtil::compileShader(L"Shaders/color.hlsl", L"PS", L"ps_6_0");
+    // 编译在requestAssets中就已经交给工作线程，这里通常不需要等待
+    vertexShaderByteCode = compiledVertexShader.get();
+    pixelShaderByteCode = compiledPixelShader.get();
     
     inputLayout = 
     {
@@ -627,16 +631,12 @@ void demoApp::createPipelineStateOjbect() {
     pipelineStateObjectDesc.InputLayout = {inputLayout.data(), (UINT)inputLayout.size()};
     pipelineStateObjectDesc.pRootSignature = rootSignature.Get();
 
-    std::string vertexShader;
-    
-    d3dUtil::loadShader("Shaders/vs.bin", vertexShader);
+    const std::string& vertexShader = vertexShaderBinary.get();
 
     pipelineStateObjectDesc.VS.pShaderBytecode = vertexShader.data();
     pipelineStateObjectDesc.VS.BytecodeLength = vertexShader.size();
 
-    std::string pixelShader;
-
-     d3dUtil::loadShader("Shaders/ps.bin", pixelShader);
+    const std::string& pixelShader = pixelShaderBinary.get();
 
     pipelineStateObjectDesc.PS.pShaderBytecode = pixelShader.data();
     pipelineStateObjectDesc.PS.BytecodeLength = pixelShader.size();
@@ -661,13 +661,53 @@ void demoApp::createPipelineStateOjbect() {
     ThrowIfFailed(device->CreateGraphicsPipelineState(&pipelineStateObjectDesc, IID_PPV_ARGS(pipelineStateObject.GetAddressOf())));
 }
 
-void demoApp::loadResources() {
-    uint32_t textureWidth = 0;
-    uint32_t textureHeight = 0;
+void demoApp::requestAssets() {
+    assetLoader = std::make_unique<AssetLoader>();
+
+    // 纹理的尺寸和格式决定了资源的创建，loadResources中等待它完成
+    textureImage = assetLoader->load("Textures/Kanna.gif", []() { return decodeImage(L"Textures/Kanna.gif"); });
+
+    // PSO要用到着色器，createShadersAndInputLayout和createPipelineStateOjbect中等待
+    compiledVertexShader = assetLoader->load("Shaders/color.hlsl VS", []() { return d3dUtil::compileShader(L"Shaders/color.hlsl", L"VS", L"vs_6_0"); });
+    compiledPixelShader = assetLoader->load("Shaders/color.hlsl PS", []() { return d3dUtil::compileShader(L"Shaders/color.hlsl", L"PS", L"ps_6_0"); });
+    vertexShaderBinary = assetLoader->load("Shaders/vs.bin", []() { return loadShaderBinary("Shaders/vs.bin"); });
+    pixelShaderBinary = assetLoader->load("Shaders/ps.bin", []() { return loadShaderBinary("Shaders/ps.bin"); });
+}
+
+DecodedImage demoApp::decodeImage(const std::wstring& fileName) {
+    DecodedImage decodedImage;
     uint32_t bpp = 0;
-    uint32_t rowPitch = 0;
 
-    ComPtr<IWICBitmapSource> image = WICLoadImage(L"Textures/Kanna.gif", textureWidth, textureHeight, bpp, rowPitch, textureFormat);
+    ComPtr<IWICBitmapSource> image = WICLoadImage(fileName, decodedImage.width, decodedImage.height, bpp, decodedImage.rowPitch, decodedImage.format);
+
+    decodedImage.pixels.resize(static_cast<size_t>(decodedImage.rowPitch) * decodedImage.height);
+
+    // 真正的解码发生在CopyPixels中
+    ThrowIfFailed(image->CopyPixels(
+        nullptr,
+        decodedImage.rowPitch,
+        static_cast<uint32_t>(decodedImage.pixels.size()),
+        decodedImage.pixels.data()));
+
+    return decodedImage;
+}
+
+std::string demoApp::loadShaderBinary(const std::string& fileName) {
+    std::string shaderData;
+    d3dUtil::loadShader(fileName, shaderData);
+
+    return shaderData;
+}
+
+void demoApp::loadResources() {
+    // 解码在工作线程中进行，这里只等待结果
+    const auto& image = textureImage.get();
+
+    uint32_t textureWidth = image.width;
+    uint32_t textureHeight = image.height;
+    uint32_t rowPitch = image.rowPitch;
+
+    textureFormat = image.format;
 
     D3D12_RESOURCE_DESC textureDesc = {};
 
@@ -706,19 +746,8 @@ void demoApp::loadResources() {
         nullptr,
         IID_PPV_ARGS(textureUpload.GetAddressOf())));
 
-    // 按照资源缓冲大小来分配实际图片数据存储的内存大小
-    void* imageData = ::HeapAlloc(::GetProcessHeap(), HEAP_ZERO_MEMORY, uploadBufferSize);
-
-    if (imageData == nullptr) {
-        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-    }
-
-    // 从图片中取出数据
-    ThrowIfFailed(image->CopyPixels(
-        nullptr,
-        rowPitch,
-        static_cast<uint32_t>(rowPitch * textureHeight),    // 注意这里才是图片数据真实的大小，这个值通常小于缓冲的大小
-        reinterpret_cast<byte*>(imageData)));
+    // 图片数据已经在工作线程中解码好了
+    const byte* imageData = image.pixels.data();
 
     // 获取向上传堆拷贝纹理数据的一些纹理转换尺寸信息
     // 对于复杂的DDS纹理这是非常必要的过程
@@ -761,9 +790,6 @@ void demoApp::loadResources() {
     // 让它常驻内存，以提高整体性能，因为每次Map和Unmap是非常耗时的操作
     textureUpload->Unmap(0, nullptr);
 
-    // 释放图片数据，做一个干净的程序员
-    ::HeapFree(::GetProcessHeap(), 0, imageData);
-
     // 重置命令列表为执行初始化命令做好准备工作
     ThrowIfFailed(commandList->Reset(commandAllocator.Get(), nullptr));
 
@@ -935,6 +961,16 @@ void demoApp::buildImGuiWidgets()
 			ImGui::Text("counter = %d", counter);
 
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+            for (const auto& timing : assetLoader->timings()) {
+                if (timing.finished) {
+                    ImGui::Text("%s: queued %.2f ms, load %.2f ms, total %.2f ms",
+                                timing.name.c_str(), timing.queued, timing.load, timing.total);
+                }
+                else {
+                    ImGui::Text("%s: loading...", timing.name.c_str());
+                }
+            }
 			ImGui::End();
 		}
 	}
@@ -3,6 +3,7 @@
 #include "d3dApp.h"
 #include "Common/MathHelper.h"
 #include "Common/UploadBuffer.h"
+#include "Common/AssetLoader.h"
 
 #include <windef.h>
 
@@ -13,6 +14,15 @@
 
 using namespace DirectX;
 
+// 在工作线程中解码好的图片
+struct DecodedImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowPitch = 0;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    std::vector<uint8_t> pixels;
+};
+
 class demoApp : public d3dApp {
 public:
 
@@ -47,6 +57,9 @@ protected:
     void createRenderItems();
     void createPipelineStateOjbect();
 
+    void requestAssets();
+    static DecodedImage decodeImage(const std::wstring& fileName);
+    static std::string loadShaderBinary(const std::string& fileName);
     void loadResources();
 
     void prepareFrameResourceSync();
@@ -108,4 +121,12 @@ private:
 	ImVec4 clearColor = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
     DXGI_FORMAT textureFormat;
+
+    // 放在最后，保证先于其他成员析构，工作线程不会访问到已经销毁的成员
+    std::unique_ptr<AssetLoader> assetLoader;
+    AssetLoader::Handle<DecodedImage> textureImage;
+    AssetLoader::Handle<ComPtr<IDxcBlob>> compiledVertexShader;
+    AssetLoader::Handle<ComPtr<IDxcBlob>> compiledPixelShader;
+    AssetLoader::Handle<std::string> vertexShaderBinary;
+    AssetLoader::Handle<std::string> pixelShaderBinary;
 };
\ No newline at end of file
@@ -0,0 +1,990 @@
+#include "DDSFile.h"
+#include "TextureFootprint.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace DDSFile {
+    namespace {
+        uint32_t makeFourCC(char ch0, char ch1, char ch2, char ch3) {
+            return static_cast<uint32_t>(static_cast<uint8_t>(ch0))
+                | (static_cast<uint32_t>(static_cast<uint8_t>(ch1)) << 8)
+                | (static_cast<uint32_t>(static_cast<uint8_t>(ch2)) << 16)
+                | (static_cast<uint32_t>(static_cast<uint8_t>(ch3)) << 24);
+        }
+
+        bool isBitMask(const PixelFormat& pixelFormat, uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+            return pixelFormat.rBitMask == r && pixelFormat.gBitMask == g && pixelFormat.bBitMask == b && pixelFormat.aBitMask == a;
+        }
+
+        uint32_t fullMipCount(uint32_t size) {
+            uint32_t count = 1;
+
+            while (size > 1) {
+                size >>= 1;
+                count++;
+            }
+
+            return count;
+        }
+
+        uint32_t bitsPerPixel(DXGI_FORMAT format) {
+            switch (format) {
+            case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+            case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            case DXGI_FORMAT_R32G32B32A32_UINT:
+            case DXGI_FORMAT_R32G32B32A32_SINT:
+                return 128;
+
+            case DXGI_FORMAT_R32G32B32_TYPELESS:
+            case DXGI_FORMAT_R32G32B32_FLOAT:
+            case DXGI_FORMAT_R32G32B32_UINT:
+            case DXGI_FORMAT_R32G32B32_SINT:
+                return 96;
+
+            case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+            case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            case DXGI_FORMAT_R16G16B16A16_UNORM:
+            case DXGI_FORMAT_R16G16B16A16_UINT:
+            case DXGI_FORMAT_R16G16B16A16_SNORM:
+            case DXGI_FORMAT_R16G16B16A16_SINT:
+            case DXGI_FORMAT_R32G32_TYPELESS:
+            case DXGI_FORMAT_R32G32_FLOAT:
+            case DXGI_FORMAT_R32G32_UINT:
+            case DXGI_FORMAT_R32G32_SINT:
+            case DXGI_FORMAT_R32G8X24_TYPELESS:
+            case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+            case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+            case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+            case DXGI_FORMAT_Y416:
+            case DXGI_FORMAT_Y210:
+            case DXGI_FORMAT_Y216:
+                return 64;
+
+            case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+            case DXGI_FORMAT_R10G10B10A2_UNORM:
+            case DXGI_FORMAT_R10G10B10A2_UINT:
+            case DXGI_FORMAT_R11G11B10_FLOAT:
+            case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+            case DXGI_FORMAT_R8G8B8A8_UNORM:
+            case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+            case DXGI_FORMAT_R8G8B8A8_UINT:
+            case DXGI_FORMAT_R8G8B8A8_SNORM:
+            case DXGI_FORMAT_R8G8B8A8_SINT:
+            case DXGI_FORMAT_R16G16_TYPELESS:
+            case DXGI_FORMAT_R16G16_FLOAT:
+            case DXGI_FORMAT_R16G16_UNORM:
+            case DXGI_FORMAT_R16G16_UINT:
+            case DXGI_FORMAT_R16G16_SNORM:
+            case DXGI_FORMAT_R16G16_SINT:
+            case DXGI_FORMAT_R32_TYPELESS:
+            case DXGI_FORMAT_D32_FLOAT:
+            case DXGI_FORMAT_R32_FLOAT:
+            case DXGI_FORMAT_R32_UINT:
+            case DXGI_FORMAT_R32_SINT:
+            case DXGI_FORMAT_R24G8_TYPELESS:
+            case DXGI_FORMAT_D24_UNORM_S8_UINT:
+            case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+            case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+            case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+            case DXGI_FORMAT_R8G8_B8G8_UNORM:
+            case DXGI_FORMAT_G8R8_G8B8_UNORM:
+            case DXGI_FORMAT_B8G8R8A8_UNORM:
+            case DXGI_FORMAT_B8G8R8X8_UNORM:
+            case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+            case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+            case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+            case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+            case DXGI_FORMAT_AYUV:
+            case DXGI_FORMAT_Y410:
+            case DXGI_FORMAT_YUY2:
+                return 32;
+
+            case DXGI_FORMAT_P010:
+            case DXGI_FORMAT_P016:
+                return 24;
+
+            case DXGI_FORMAT_R8G8_TYPELESS:
+            case DXGI_FORMAT_R8G8_UNORM:
+            case DXGI_FORMAT_R8G8_UINT:
+            case DXGI_FORMAT_R8G8_SNORM:
+            case DXGI_FORMAT_R8G8_SINT:
+            case DXGI_FORMAT_R16_TYPELESS:
+            case DXGI_FORMAT_R16_FLOAT:
+            case DXGI_FORMAT_D16_UNORM:
+            case DXGI_FORMAT_R16_UNORM:
+            case DXGI_FORMAT_R16_UINT:
+            case DXGI_FORMAT_R16_SNORM:
+            case DXGI_FORMAT_R16_SINT:
+            case DXGI_FORMAT_B5G6R5_UNORM:
+            case DXGI_FORMAT_B5G5R5A1_UNORM:
+            case DXGI_FORMAT_A8P8:
+            case DXGI_FORMAT_B4G4R4A4_UNORM:
+                return 16;
+
+            case DXGI_FORMAT_NV12:
+            case DXGI_FORMAT_420_OPAQUE:
+            case DXGI_FORMAT_NV11:
+                return 12;
+
+            case DXGI_FORMAT_R8_TYPELESS:
+            case DXGI_FORMAT_R8_UNORM:
+            case DXGI_FORMAT_R8_UINT:
+            case DXGI_FORMAT_R8_SNORM:
+            case DXGI_FORMAT_R8_SINT:
+            case DXGI_FORMAT_A8_UNORM:
+            case DXGI_FORMAT_AI44:
+            case DXGI_FORMAT_IA44:
+            case DXGI_FORMAT_P8:
+                return 8;
+
+            case DXGI_FORMAT_R1_UNORM:
+                return 1;
+
+            case DXGI_FORMAT_BC1_TYPELESS:
+            case DXGI_FORMAT_BC1_UNORM:
+            case DXGI_FORMAT_BC1_UNORM_SRGB:
+            case DXGI_FORMAT_BC4_TYPELESS:
+            case DXGI_FORMAT_BC4_UNORM:
+            case DXGI_FORMAT_BC4_SNORM:
+                return 4;
+
+            case DXGI_FORMAT_BC2_TYPELESS:
+            case DXGI_FORMAT_BC2_UNORM:
+            case DXGI_FORMAT_BC2_UNORM_SRGB:
+            case DXGI_FORMAT_BC3_TYPELESS:
+            case DXGI_FORMAT_BC3_UNORM:
+            case DXGI_FORMAT_BC3_UNORM_SRGB:
+            case DXGI_FORMAT_BC5_TYPELESS:
+            case DXGI_FORMAT_BC5_UNORM:
+            case DXGI_FORMAT_BC5_SNORM:
+            case DXGI_FORMAT_BC6H_TYPELESS:
+            case DXGI_FORMAT_BC6H_UF16:
+            case DXGI_FORMAT_BC6H_SF16:
+            case DXGI_FORMAT_BC7_TYPELESS:
+            case DXGI_FORMAT_BC7_UNORM:
+            case DXGI_FORMAT_BC7_UNORM_SRGB:
+                return 8;
+
+            default:
+                return 0;
+            }
+        }
+
+        bool isBlockCompressed(DXGI_FORMAT format) {
+            return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM)
+                || (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+        }
+
+        PixelFormat maskPixelFormat(uint32_t flags, uint32_t bitCount, uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+            PixelFormat pixelFormat = {};
+            pixelFormat.size = sizeof(PixelFormat);
+            pixelFormat.flags = flags;
+            pixelFormat.rgbBitCount = bitCount;
+            pixelFormat.rBitMask = r;
+            pixelFormat.gBitMask = g;
+            pixelFormat.bBitMask = b;
+            pixelFormat.aBitMask = a;
+
+            return pixelFormat;
+        }
+
+        PixelFormat fourCCPixelFormat(uint32_t fourCC) {
+            PixelFormat pixelFormat = {};
+            pixelFormat.size = sizeof(PixelFormat);
+            pixelFormat.flags = pixelFormatFourCC;
+            pixelFormat.fourCC = fourCC;
+
+            return pixelFormat;
+        }
+
+        // 写出时的一段连续数据
+        struct Span {
+            const uint8_t* data;
+            size_t size;
+        };
+
+#ifdef _WIN32
+        bool writeSpans(const std::string& fileName, const std::vector<Span>& spans) {
+            HANDLE file = CreateFileA(fileName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+
+            // WriteFileGather要求每一段都是页对齐的整页，并且只能用于无缓冲的文件，这里逐段写出
+            bool succeeded = true;
+
+            for (const Span& span : spans) {
+                for (size_t offset = 0; succeeded && offset < span.size;) {
+                    DWORD bytes = static_cast<DWORD>(std::min<size_t>(span.size - offset, 1u << 30));
+                    DWORD written = 0;
+
+                    succeeded = WriteFile(file, span.data + offset, bytes, &written, nullptr) && written == bytes;
+                    offset += written;
+                }
+            }
+
+            return CloseHandle(file) && succeeded;
+        }
+#else
+        bool writeSpans(const std::string& fileName, const std::vector<Span>& spans) {
+            int file = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+            if (file < 0) {
+                return false;
+            }
+
+            std::vector<iovec> vectors(spans.size());
+
+            for (size_t i = 0; i < spans.size(); i++) {
+                vectors[i].iov_base = const_cast<uint8_t*>(spans[i].data);
+                vectors[i].iov_len = spans[i].size;
+            }
+
+            // 一次最多IOV_MAX段，写了一部分时跳过已经写完的段，从没写完的段的中间继续
+            bool succeeded = true;
+            size_t first = 0;
+
+            while (succeeded && first < vectors.size()) {
+                int count = static_cast<int>(std::min<size_t>(vectors.size() - first, IOV_MAX));
+                ssize_t written = writev(file, vectors.data() + first, count);
+
+                if (written < 0) {
+                    succeeded = errno == EINTR;
+                    continue;
+                }
+
+                size_t remaining = static_cast<size_t>(written);
+
+                while (first < vectors.size() && remaining >= vectors[first].iov_len) {
+                    remaining -= vectors[first].iov_len;
+                    first++;
+                }
+
+                if (remaining > 0) {
+                    vectors[first].iov_base = static_cast<uint8_t*>(vectors[first].iov_base) + remaining;
+                    vectors[first].iov_len -= remaining;
+                }
+            }
+
+            return ::close(file) == 0 && succeeded;
+        }
+#endif
+
+        uint64_t divideRoundUp(uint64_t value, uint64_t divisor) {
+            return (value + divisor - 1) / divisor;
+        }
+
+        // 按D3D12的硬件限制检查尺寸，不信任超出限制的头部
+        bool checkLimits(const Description& description) {
+            if (description.width == 0 || description.height == 0 || description.depth == 0 || description.arraySize == 0) {
+                return false;
+            }
+
+            if (description.mipLevels > D3D12_REQ_MIP_LEVELS
+                || description.mipLevels > fullMipCount(std::max({ description.width, description.height, description.depth }))) {
+                return false;
+            }
+
+            switch (description.dimension) {
+            case D3D12_RESOURCE_DIMENSION_TEXTURE1D:
+                return description.arraySize <= D3D12_REQ_TEXTURE1D_ARRAY_AXIS_DIMENSION
+                    && description.width <= D3D12_REQ_TEXTURE1D_U_DIMENSION;
+
+            case D3D12_RESOURCE_DIMENSION_TEXTURE2D:
+                if (description.isCubeMap) {
+                    // arraySize已经是面数
+                    return description.arraySize <= D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+                        && description.width <= D3D12_REQ_TEXTURECUBE_DIMENSION
+                        && description.height <= D3D12_REQ_TEXTURECUBE_DIMENSION;
+                }
+
+                return description.arraySize <= D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+                    && description.width <= D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION
+                    && description.height <= D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+
+            case D3D12_RESOURCE_DIMENSION_TEXTURE3D:
+                return description.arraySize == 1
+                    && description.width <= D3D12_REQ_TEXTURE3D_U_V_OR_W_DIMENSION
+                    && description.height <= D3D12_REQ_TEXTURE3D_U_V_OR_W_DIMENSION
+                    && description.depth <= D3D12_REQ_TEXTURE3D_U_V_OR_W_DIMENSION;
+
+            default:
+                return false;
+            }
+        }
+    }
+
+    DXGI_FORMAT formatFromPixelFormat(const PixelFormat& pixelFormat) {
+        // sRGB、BC6H、BC7等格式只能用DX10扩展头表示
+        if (pixelFormat.flags & pixelFormatRGB) {
+            switch (pixelFormat.rgbBitCount) {
+            case 32:
+                if (isBitMask(pixelFormat, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) {
+                    return DXGI_FORMAT_R8G8B8A8_UNORM;
+                }
+
+                if (isBitMask(pixelFormat, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000)) {
+                    return DXGI_FORMAT_B8G8R8A8_UNORM;
+                }
+
+                if (isBitMask(pixelFormat, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000)) {
+                    return DXGI_FORMAT_B8G8R8X8_UNORM;
+                }
+
+                // D3DX写出的10:10:10:2交换了R和B的掩码，这里与DDSTextureLoader一样按D3DX的写法识别
+                if (isBitMask(pixelFormat, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000)) {
+                    return DXGI_FORMAT_R10G10B10A2_UNORM;
+                }
+
+                if (isBitMask(pixelFormat, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000)) {
+                    return DXGI_FORMAT_R16G16_UNORM;
+                }
+
+                if (isBitMask(pixelFormat, 0xffffffff, 0x00000000, 0x00000000, 0x00000000)) {
+                    return DXGI_FORMAT_R32_FLOAT;
+                }
+                break;
+
+            case 16:
+                if (isBitMask(pixelFormat, 0x7c00, 0x03e0, 0x001f, 0x8000)) {
+                    return DXGI_FORMAT_B5G5R5A1_UNORM;
+                }
+
+                if (isBitMask(pixelFormat, 0xf800, 0x07e0, 0x001f, 0x0000)) {
+                    return DXGI_FORMAT_B5G6R5_UNORM;
+                }
+
+                if (isBitMask(pixelFormat, 0x0f00, 0x00f0, 0x000f, 0xf000)) {
+                    return DXGI_FORMAT_B4G4R4A4_UNORM;
+                }
+                break;
+            }
+        }
+        else if (pixelFormat.flags & pixelFormatLuminance) {
+            if (pixelFormat.rgbBitCount == 8 && isBitMask(pixelFormat, 0x000000ff, 0x00000000, 0x00000000, 0x00000000)) {
+                return DXGI_FORMAT_R8_UNORM;
+            }
+
+            if (pixelFormat.rgbBitCount == 16) {
+                if (isBitMask(pixelFormat, 0x0000ffff, 0x00000000, 0x00000000, 0x00000000)) {
+                    return DXGI_FORMAT_R16_UNORM;
+                }
+
+                if (isBitMask(pixelFormat, 0x000000ff, 0x00000000, 0x00000000, 0x0000ff00)) {
+                    return DXGI_FORMAT_R8G8_UNORM;
+                }
+            }
+        }
+        else if (pixelFormat.flags & pixelFormatAlpha) {
+            if (pixelFormat.rgbBitCount == 8) {
+                return DXGI_FORMAT_A8_UNORM;
+            }
+        }
+        else if (pixelFormat.flags & pixelFormatFourCC) {
+            uint32_t fourCC = pixelFormat.fourCC;
+
+            // DXT2和DXT4是预乘Alpha的DXT3和DXT5，数据布局相同
+            if (fourCC == makeFourCC('D', 'X', 'T', '1')) {
+                return DXGI_FORMAT_BC1_UNORM;
+            }
+
+            if (fourCC == makeFourCC('D', 'X', 'T', '2') || fourCC == makeFourCC('D', 'X', 'T', '3')) {
+                return DXGI_FORMAT_BC2_UNORM;
+            }
+
+            if (fourCC == makeFourCC('D', 'X', 'T', '4') || fourCC == makeFourCC('D', 'X', 'T', '5')) {
+                return DXGI_FORMAT_BC3_UNORM;
+            }
+
+            if (fourCC == makeFourCC('A', 'T', 'I', '1') || fourCC == makeFourCC('B', 'C', '4', 'U')) {
+                return DXGI_FORMAT_BC4_UNORM;
+            }
+
+            if (fourCC == makeFourCC('B', 'C', '4', 'S')) {
+                return DXGI_FORMAT_BC4_SNORM;
+            }
+
+            if (fourCC == makeFourCC('A', 'T', 'I', '2') || fourCC == makeFourCC('B', 'C', '5', 'U')) {
+                return DXGI_FORMAT_BC5_UNORM;
+            }
+
+            if (fourCC == makeFourCC('B', 'C', '5', 'S')) {
+                return DXGI_FORMAT_BC5_SNORM;
+            }
+
+            if (fourCC == makeFourCC('R', 'G', 'B', 'G')) {
+                return DXGI_FORMAT_R8G8_B8G8_UNORM;
+            }
+
+            if (fourCC == makeFourCC('G', 'R', 'G', 'B')) {
+                return DXGI_FORMAT_G8R8_G8B8_UNORM;
+            }
+
+            if (fourCC == makeFourCC('Y', 'U', 'Y', '2')) {
+                return DXGI_FORMAT_YUY2;
+            }
+
+            // D3DFORMAT的枚举值
+            switch (fourCC) {
+            case 36:    // D3DFMT_A16B16G16R16
+                return DXGI_FORMAT_R16G16B16A16_UNORM;
+
+            case 110:   // D3DFMT_Q16W16V16U16
+                return DXGI_FORMAT_R16G16B16A16_SNORM;
+
+            case 111:   // D3DFMT_R16F
+                return DXGI_FORMAT_R16_FLOAT;
+
+            case 112:   // D3DFMT_G16R16F
+                return DXGI_FORMAT_R16G16_FLOAT;
+
+            case 113:   // D3DFMT_A16B16G16R16F
+                return DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+            case 114:   // D3DFMT_R32F
+                return DXGI_FORMAT_R32_FLOAT;
+
+            case 115:   // D3DFMT_G32R32F
+                return DXGI_FORMAT_R32G32_FLOAT;
+
+            case 116:   // D3DFMT_A32B32G32R32F
+                return DXGI_FORMAT_R32G32B32A32_FLOAT;
+            }
+        }
+
+        return DXGI_FORMAT_UNKNOWN;
+    }
+
+    bool pixelFormatFromFormat(DXGI_FORMAT format, PixelFormat& pixelFormat) {
+        // R10G10B10A2的掩码在不同的写出程序中不一致，与DirectXTex一样总是用DX10扩展头
+        switch (format) {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatRGB | pixelFormatAlphaPixels, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+            return true;
+
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatRGB | pixelFormatAlphaPixels, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+            return true;
+
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatRGB, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000);
+            return true;
+
+        case DXGI_FORMAT_R16G16_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatRGB, 32, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000);
+            return true;
+
+        case DXGI_FORMAT_B5G5R5A1_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatRGB | pixelFormatAlphaPixels, 16, 0x7c00, 0x03e0, 0x001f, 0x8000);
+            return true;
+
+        case DXGI_FORMAT_B5G6R5_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatRGB, 16, 0xf800, 0x07e0, 0x001f, 0x0000);
+            return true;
+
+        case DXGI_FORMAT_B4G4R4A4_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatRGB | pixelFormatAlphaPixels, 16, 0x0f00, 0x00f0, 0x000f, 0xf000);
+            return true;
+
+        case DXGI_FORMAT_R8_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatLuminance, 8, 0x000000ff, 0x00000000, 0x00000000, 0x00000000);
+            return true;
+
+        case DXGI_FORMAT_R16_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatLuminance, 16, 0x0000ffff, 0x00000000, 0x00000000, 0x00000000);
+            return true;
+
+        case DXGI_FORMAT_R8G8_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatLuminance | pixelFormatAlphaPixels, 16, 0x000000ff, 0x00000000, 0x00000000, 0x0000ff00);
+            return true;
+
+        case DXGI_FORMAT_A8_UNORM:
+            pixelFormat = maskPixelFormat(pixelFormatAlpha, 8, 0x00000000, 0x00000000, 0x00000000, 0x000000ff);
+            return true;
+
+        case DXGI_FORMAT_BC1_UNORM:
+            pixelFormat = fourCCPixelFormat(makeFourCC('D', 'X', 'T', '1'));
+            return true;
+
+        case DXGI_FORMAT_BC2_UNORM:
+            pixelFormat = fourCCPixelFormat(makeFourCC('D', 'X', 'T', '3'));
+            return true;
+
+        case DXGI_FORMAT_BC3_UNORM:
+            pixelFormat = fourCCPixelFormat(makeFourCC('D', 'X', 'T', '5'));
+            return true;
+
+        case DXGI_FORMAT_BC4_UNORM:
+            pixelFormat = fourCCPixelFormat(makeFourCC('B', 'C', '4', 'U'));
+            return true;
+
+        case DXGI_FORMAT_BC4_SNORM:
+            pixelFormat = fourCCPixelFormat(makeFourCC('B', 'C', '4', 'S'));
+            return true;
+
+        case DXGI_FORMAT_BC5_UNORM:
+            pixelFormat = fourCCPixelFormat(makeFourCC('B', 'C', '5', 'U'));
+            return true;
+
+        case DXGI_FORMAT_BC5_SNORM:
+            pixelFormat = fourCCPixelFormat(makeFourCC('B', 'C', '5', 'S'));
+            return true;
+
+        case DXGI_FORMAT_R8G8_B8G8_UNORM:
+            pixelFormat = fourCCPixelFormat(makeFourCC('R', 'G', 'B', 'G'));
+            return true;
+
+        case DXGI_FORMAT_G8R8_G8B8_UNORM:
+            pixelFormat = fourCCPixelFormat(makeFourCC('G', 'R', 'G', 'B'));
+            return true;
+
+        case DXGI_FORMAT_YUY2:
+            pixelFormat = fourCCPixelFormat(makeFourCC('Y', 'U', 'Y', '2'));
+            return true;
+
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+            pixelFormat = fourCCPixelFormat(36);
+            return true;
+
+        case DXGI_FORMAT_R16G16B16A16_SNORM:
+            pixelFormat = fourCCPixelFormat(110);
+            return true;
+
+        case DXGI_FORMAT_R16_FLOAT:
+            pixelFormat = fourCCPixelFormat(111);
+            return true;
+
+        case DXGI_FORMAT_R16G16_FLOAT:
+            pixelFormat = fourCCPixelFormat(112);
+            return true;
+
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            pixelFormat = fourCCPixelFormat(113);
+            return true;
+
+        case DXGI_FORMAT_R32_FLOAT:
+            pixelFormat = fourCCPixelFormat(114);
+            return true;
+
+        case DXGI_FORMAT_R32G32_FLOAT:
+            pixelFormat = fourCCPixelFormat(115);
+            return true;
+
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            pixelFormat = fourCCPixelFormat(116);
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    bool getSurfaceInfo(DXGI_FORMAT format, uint32_t width, uint32_t height, uint64_t& rowBytes, uint64_t& numRows, uint64_t& slicePitch) {
+        rowBytes = 0;
+        numRows = 0;
+        slicePitch = 0;
+
+        uint32_t bitCount = bitsPerPixel(format);
+
+        if (bitCount == 0) {
+            return false;
+        }
+
+        switch (format) {
+        case DXGI_FORMAT_R8G8_B8G8_UNORM:
+        case DXGI_FORMAT_G8R8_G8B8_UNORM:
+        case DXGI_FORMAT_YUY2:
+        case DXGI_FORMAT_Y210:
+        case DXGI_FORMAT_Y216:
+            // 打包格式两个像素一组
+            rowBytes = ((static_cast<uint64_t>(width) + 1) >> 1) * (bitCount / 8);
+            numRows = height;
+            slicePitch = rowBytes * numRows;
+            return true;
+
+        case DXGI_FORMAT_NV11:
+            // 与Direct3D的简化相同，按4:2:2计算，比实际的4:1:1数据稍大
+            rowBytes = ((static_cast<uint64_t>(width) + 3) >> 2) * 4;
+            numRows = static_cast<uint64_t>(height) * 2;
+            slicePitch = rowBytes * numRows;
+            return true;
+
+        case DXGI_FORMAT_NV12:
+        case DXGI_FORMAT_420_OPAQUE:
+        case DXGI_FORMAT_P010:
+        case DXGI_FORMAT_P016:
+            // 亮度平面之后是一半高度的色度平面
+            rowBytes = ((static_cast<uint64_t>(width) + 1) >> 1) * (bitCount == 12 ? 2 : 4);
+            numRows = height + ((static_cast<uint64_t>(height) + 1) >> 1);
+            slicePitch = rowBytes * height + ((rowBytes * height + 1) >> 1);
+            return true;
+
+        default:
+            break;
+        }
+
+        if (isBlockCompressed(format)) {
+            // 每4 x 4个像素一个块，BC1和BC4每块8字节，其他16字节
+            rowBytes = divideRoundUp(width, 4) * bitCount * 2;
+            numRows = divideRoundUp(height, 4);
+        }
+        else {
+            rowBytes = divideRoundUp(static_cast<uint64_t>(width) * bitCount, 8);
+            numRows = height;
+        }
+
+        slicePitch = rowBytes * numRows;
+
+        return true;
+    }
+
+    bool parse(const uint8_t* data, size_t size, Description& description, std::vector<Subresource>& subresources) {
+        description = Description();
+        subresources.clear();
+
+        if (data == nullptr || size < sizeof(uint32_t) + sizeof(Header)) {
+            return false;
+        }
+
+        // 文件中的头部只保证4字节对齐，先复制出来再读
+        uint32_t fileMagic = 0;
+        Header header;
+
+        memcpy(&fileMagic, data, sizeof(fileMagic));
+        memcpy(&header, data + sizeof(uint32_t), sizeof(Header));
+
+        if (fileMagic != magic || header.size != sizeof(Header) || header.pixelFormat.size != sizeof(PixelFormat)) {
+            return false;
+        }
+
+        size_t offset = sizeof(uint32_t) + sizeof(Header);
+
+        Description result;
+        result.width = header.width;
+        result.height = header.height;
+        result.depth = header.depth;
+        result.mipLevels = std::max(1u, header.mipMapCount);
+
+        if ((header.pixelFormat.flags & pixelFormatFourCC) && header.pixelFormat.fourCC == makeFourCC('D', 'X', '1', '0')) {
+            if (size < offset + sizeof(HeaderDXT10)) {
+                return false;
+            }
+
+            HeaderDXT10 extension;
+            memcpy(&extension, data + offset, sizeof(HeaderDXT10));
+            offset += sizeof(HeaderDXT10);
+
+            result.format = static_cast<DXGI_FORMAT>(extension.dxgiFormat);
+            result.arraySize = extension.arraySize;
+
+            switch (extension.resourceDimension) {
+            case D3D12_RESOURCE_DIMENSION_TEXTURE1D:
+                if ((header.flags & headerFlagsHeight) && result.height != 1) {
+                    return false;
+                }
+
+                result.height = 1;
+                result.depth = 1;
+                break;
+
+            case D3D12_RESOURCE_DIMENSION_TEXTURE2D:
+                if (extension.miscFlag & miscTextureCube) {
+                    if (result.arraySize > D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION / 6) {
+                        return false;
+                    }
+
+                    result.arraySize *= 6;
+                    result.isCubeMap = true;
+                }
+
+                result.depth = 1;
+                break;
+
+            case D3D12_RESOURCE_DIMENSION_TEXTURE3D:
+                if (!(header.flags & headerFlagsVolume)) {
+                    return false;
+                }
+                break;
+
+            default:
+                return false;
+            }
+
+            result.dimension = static_cast<D3D12_RESOURCE_DIMENSION>(extension.resourceDimension);
+        }
+        else {
+            result.format = formatFromPixelFormat(header.pixelFormat);
+
+            if (header.flags & headerFlagsVolume) {
+                result.dimension = D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+            }
+            else {
+                if (header.caps2 & caps2CubeMap) {
+                    // 遗留头部不支持只有部分面的立方体贴图
+                    if ((header.caps2 & caps2CubeMapAllFaces) != caps2CubeMapAllFaces) {
+                        return false;
+                    }
+
+                    result.arraySize = 6;
+                    result.isCubeMap = true;
+                }
+
+                result.depth = 1;
+                result.dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+            }
+        }
+
+        if (bitsPerPixel(result.format) == 0 || !checkLimits(result)) {
+            return false;
+        }
+
+        // 数据按数组元素、mip、深度的顺序紧密排列。checkLimits之后每一项都不会让64位的计算溢出
+        uint64_t available = size - offset;
+        uint64_t position = 0;
+
+        subresources.reserve(static_cast<size_t>(result.mipLevels) * result.arraySize);
+
+        for (uint32_t arraySlice = 0; arraySlice < result.arraySize; arraySlice++) {
+            for (uint32_t mip = 0; mip < result.mipLevels; mip++) {
+                Subresource subresource;
+                subresource.width = std::max(1u, result.width >> mip);
+                subresource.height = std::max(1u, result.height >> mip);
+                subresource.depth = std::max(1u, result.depth >> mip);
+
+                uint64_t rowPitch = 0;
+                uint64_t numRows = 0;
+                uint64_t slicePitch = 0;
+
+                getSurfaceInfo(result.format, subresource.width, subresource.height, rowPitch, numRows, slicePitch);
+
+                uint64_t bytes = slicePitch * subresource.depth;
+
+                if (bytes > available - position) {
+                    subresources.clear();
+                    return false;
+                }
+
+                subresource.data = data + offset + static_cast<size_t>(position);
+                subresource.rowPitch = static_cast<size_t>(rowPitch);
+                subresource.slicePitch = static_cast<size_t>(slicePitch);
+                subresource.numRows = static_cast<uint32_t>(numRows);
+
+                subresources.push_back(subresource);
+
+                position += bytes;
+            }
+        }
+
+        description = result;
+
+        return true;
+    }
+
+    bool write(const std::string& fileName, const Description& description, const Subresource* subresources, bool forceDX10Header) {
+        if (subresources == nullptr || bitsPerPixel(description.format) == 0 || !checkLimits(description)) {
+            return false;
+        }
+
+        if ((description.dimension != D3D12_RESOURCE_DIMENSION_TEXTURE3D && description.depth != 1)
+            || (description.dimension == D3D12_RESOURCE_DIMENSION_TEXTURE1D && description.height != 1)
+            || (description.isCubeMap && (description.dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || description.arraySize % 6 != 0))) {
+            return false;
+        }
+
+        bool volume = description.dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+
+        PixelFormat legacyPixelFormat = {};
+        bool legacyHeader = !forceDX10Header
+            && pixelFormatFromFormat(description.format, legacyPixelFormat)
+            && (volume || (description.dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && description.arraySize == (description.isCubeMap ? 6u : 1u)));
+
+        uint64_t rowBytes = 0;
+        uint64_t numRows = 0;
+        uint64_t slicePitch = 0;
+
+        getSurfaceInfo(description.format, description.width, description.height, rowBytes, numRows, slicePitch);
+
+        Header header = {};
+        header.size = sizeof(Header);
+        header.flags = headerFlagsCaps | headerFlagsHeight | headerFlagsWidth | headerFlagsPixelFormat;
+        header.width = description.width;
+        header.height = description.height;
+        header.mipMapCount = description.mipLevels;
+        header.caps = capsTexture;
+
+        // 压缩格式记录第0级的总大小，其他格式记录行大小
+        if (isBlockCompressed(description.format)) {
+            header.flags |= headerFlagsLinearSize;
+            header.pitchOrLinearSize = static_cast<uint32_t>(std::min<uint64_t>(slicePitch, UINT32_MAX));
+        }
+        else {
+            header.flags |= headerFlagsPitch;
+            header.pitchOrLinearSize = static_cast<uint32_t>(std::min<uint64_t>(rowBytes, UINT32_MAX));
+        }
+
+        if (description.mipLevels > 1) {
+            header.flags |= headerFlagsMipMapCount;
+            header.caps |= capsComplex | capsMipMap;
+        }
+
+        if (volume) {
+            header.flags |= headerFlagsVolume;
+            header.depth = description.depth;
+            header.caps |= capsComplex;
+            header.caps2 |= caps2Volume;
+        }
+
+        if (description.isCubeMap) {
+            header.caps |= capsComplex;
+            header.caps2 |= caps2CubeMap | caps2CubeMapAllFaces;
+        }
+
+        HeaderDXT10 extension = {};
+
+        if (legacyHeader) {
+            header.pixelFormat = legacyPixelFormat;
+        }
+        else {
+            header.pixelFormat = fourCCPixelFormat(makeFourCC('D', 'X', '1', '0'));
+
+            extension.dxgiFormat = static_cast<uint32_t>(description.format);
+            extension.resourceDimension = static_cast<uint32_t>(description.dimension);
+            extension.miscFlag = description.isCubeMap ? miscTextureCube : 0;
+            extension.arraySize = description.isCubeMap ? description.arraySize / 6 : description.arraySize;
+        }
+
+        uint8_t headerData[sizeof(uint32_t) + sizeof(Header) + sizeof(HeaderDXT10)];
+        size_t headerSize = sizeof(uint32_t) + sizeof(Header) + (legacyHeader ? 0 : sizeof(HeaderDXT10));
+
+        memcpy(headerData, &magic, sizeof(uint32_t));
+        memcpy(headerData + sizeof(uint32_t), &header, sizeof(Header));
+        memcpy(headerData + sizeof(uint32_t) + sizeof(Header), &extension, sizeof(HeaderDXT10));
+
+        // 紧密排列的子资源是一段，有行填充时每行一段；地址相接的段合并
+        std::vector<Span> spans;
+        spans.push_back({ headerData, headerSize });
+
+        auto append = [&spans](const uint8_t* data, size_t size) {
+            Span& last = spans.back();
+
+            if (last.data + last.size == data) {
+                last.size += size;
+            }
+            else {
+                spans.push_back({ data, size });
+            }
+        };
+
+        for (uint32_t arraySlice = 0; arraySlice < description.arraySize; arraySlice++) {
+            for (uint32_t mip = 0; mip < description.mipLevels; mip++) {
+                const Subresource& subresource = subresources[mip + arraySlice * description.mipLevels];
+
+                uint32_t depth = std::max(1u, description.depth >> mip);
+
+                getSurfaceInfo(description.format, std::max(1u, description.width >> mip), std::max(1u, description.height >> mip),
+                               rowBytes, numRows, slicePitch);
+
+                size_t srcRowPitch = subresource.rowPitch != 0 ? subresource.rowPitch : static_cast<size_t>(rowBytes);
+                size_t srcSlicePitch = subresource.slicePitch != 0 ? subresource.slicePitch
+                    : (srcRowPitch == rowBytes ? static_cast<size_t>(slicePitch) : srcRowPitch * static_cast<size_t>(numRows));
+
+                if (subresource.data == nullptr || srcRowPitch < rowBytes) {
+                    return false;
+                }
+
+                if (srcRowPitch == rowBytes && srcSlicePitch == slicePitch) {
+                    append(subresource.data, static_cast<size_t>(slicePitch * depth));
+                    continue;
+                }
+
+                // 多平面格式的切片不是整数行，只能紧密排列
+                if (slicePitch != rowBytes * numRows || srcSlicePitch < srcRowPitch * numRows) {
+                    return false;
+                }
+
+                for (uint32_t slice = 0; slice < depth; slice++) {
+                    for (uint64_t row = 0; row < numRows; row++) {
+                        append(subresource.data + srcSlicePitch * slice + srcRowPitch * row, static_cast<size_t>(rowBytes));
+                    }
+                }
+            }
+        }
+
+        std::string temporaryFileName = fileName + ".tmp";
+
+        if (!writeSpans(temporaryFileName, spans)) {
+            std::remove(temporaryFileName.c_str());
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporaryFileName, fileName, error);
+
+        if (error) {
+            std::filesystem::remove(temporaryFileName, error);
+            return false;
+        }
+
+        return true;
+    }
+
+    D3D12_RESOURCE_DESC resourceDesc(const Description& description) {
+        D3D12_RESOURCE_DESC desc = {};
+        desc.Dimension = description.dimension;
+        desc.Alignment = 0;
+        desc.Width = description.width;
+        desc.Height = description.height;
+        desc.DepthOrArraySize = static_cast<uint16_t>(description.dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? description.depth : description.arraySize);
+        desc.MipLevels = static_cast<uint16_t>(description.mipLevels);
+        desc.Format = description.format;
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+        desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+        return desc;
+    }
+
+    bool View::open(const std::string& fileName) {
+        close();
+
+        if (!file.open(fileName) || !parse(file.getData(), file.getSize(), desc, subresources)) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void View::close() {
+        file.close();
+        desc = Description();
+        subresources.clear();
+    }
+
+    void View::copyToUpload(uint8_t* mappedData, uint32_t firstSubresource, uint32_t numSubresources,
+                            const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, const uint32_t* numRows, const uint64_t* rowSizeInBytes) const {
+        for (uint32_t i = 0; i < numSubresources; i++) {
+            const Subresource& subresource = subresources[firstSubresource + i];
+
+            TextureFootprint::copySubresource(mappedData, layouts[i], numRows[i], rowSizeInBytes[i],
+                                              subresource.data, subresource.rowPitch, subresource.slicePitch);
+        }
+    }
+}
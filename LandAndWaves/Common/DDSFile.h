@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <d3d12.h>
+
+#include "MappedFile.h"
+
+// DDS文件的读取(内存映射)和写出
+//
+// DDSTextureLoader先把整个文件ReadFile到堆上，再从堆上的副本复制到上传堆；
+// 这里直接映射文件，每个子资源的数据指针都指向映射的内存，
+// 再用TextureFootprint::copySubresource复制到上传堆，从磁盘到上传堆只复制一次。
+//
+// 头部(DDS_HEADER和DX10扩展头)的所有字段都做范围检查，尺寸的计算都在64位下进行并检查溢出，
+// 任何一个子资源超出文件末尾都视为无效文件，不会读到映射之外的内存。
+// 支持1D/2D/3D纹理、纹理数组、立方体贴图(数组)和mip，格式支持范围与DDSTextureLoader的BitsPerPixel相同
+// (多平面格式可以读写，但getCopyableFootprints不支持，不能用copyToUpload上传)。
+// 子资源编号 = mip + arraySlice * mipLevels，与D3D12相同，立方体贴图的每个面是一个arraySlice
+namespace DDSFile {
+    const uint32_t magic = 0x20534444; // "DDS "
+
+#pragma pack(push, 1)
+    struct PixelFormat {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t rBitMask;
+        uint32_t gBitMask;
+        uint32_t bBitMask;
+        uint32_t aBitMask;
+    };
+
+    struct Header {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;                 // 只有flags中有headerFlagsVolume时有效
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        PixelFormat pixelFormat;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    struct HeaderDXT10 {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;     // D3D10/11的资源维度，数值与D3D12_RESOURCE_DIMENSION相同
+        uint32_t miscFlag;
+        uint32_t arraySize;             // 立方体贴图时是立方体的个数
+        uint32_t miscFlags2;
+    };
+#pragma pack(pop)
+
+    static_assert(sizeof(PixelFormat) == 32, "DDS_PIXELFORMAT must be 32 bytes");
+    static_assert(sizeof(Header) == 124, "DDS_HEADER must be 124 bytes");
+    static_assert(sizeof(HeaderDXT10) == 20, "DDS_HEADER_DXT10 must be 20 bytes");
+
+    // PixelFormat::flags
+    const uint32_t pixelFormatAlphaPixels = 0x00000001;
+    const uint32_t pixelFormatAlpha = 0x00000002;
+    const uint32_t pixelFormatFourCC = 0x00000004;
+    const uint32_t pixelFormatRGB = 0x00000040;
+    const uint32_t pixelFormatLuminance = 0x00020000;
+
+    // Header::flags
+    const uint32_t headerFlagsCaps = 0x00000001;
+    const uint32_t headerFlagsHeight = 0x00000002;
+    const uint32_t headerFlagsWidth = 0x00000004;
+    const uint32_t headerFlagsPitch = 0x00000008;
+    const uint32_t headerFlagsPixelFormat = 0x00001000;
+    const uint32_t headerFlagsMipMapCount = 0x00020000;
+    const uint32_t headerFlagsLinearSize = 0x00080000;
+    const uint32_t headerFlagsVolume = 0x00800000;
+
+    // Header::caps
+    const uint32_t capsComplex = 0x00000008;
+    const uint32_t capsTexture = 0x00001000;
+    const uint32_t capsMipMap = 0x00400000;
+
+    // Header::caps2
+    const uint32_t caps2CubeMap = 0x00000200;
+    const uint32_t caps2CubeMapAllFaces = 0x0000fe00;
+    const uint32_t caps2Volume = 0x00200000;
+
+    // HeaderDXT10::miscFlag
+    const uint32_t miscTextureCube = 0x4;
+
+    struct Description {
+        D3D12_RESOURCE_DIMENSION dimension = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+        DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        // 3D纹理的深度，其他为1
+        uint32_t depth = 1;
+        uint32_t mipLevels = 1;
+        // 立方体贴图时是面数(立方体个数 * 6)
+        uint32_t arraySize = 1;
+        bool isCubeMap = false;
+    };
+
+    struct Subresource {
+        const uint8_t* data = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t depth = 1;
+        // 行距，DDS中行之间没有填充，parse得到的就是一行像素或一行块的字节数
+        size_t rowPitch = 0;
+        size_t slicePitch = 0;
+        uint32_t numRows = 0;
+    };
+
+    // 遗留头部中的像素格式转换为DXGI格式，无法表示时返回DXGI_FORMAT_UNKNOWN
+    DXGI_FORMAT formatFromPixelFormat(const PixelFormat& pixelFormat);
+
+    // formatFromPixelFormat的反向转换，只能用DX10扩展头表示的格式(sRGB、BC6H、BC7等)返回false
+    bool pixelFormatFromFormat(DXGI_FORMAT format, PixelFormat& pixelFormat);
+
+    // 一个mip(3D纹理为其中一个深度切片)在DDS中的行大小、行数和总大小，与DDSTextureLoader的GetSurfaceInfo相同。
+    // 多平面格式的slicePitch不一定等于rowBytes * numRows。不认识的格式返回false
+    bool getSurfaceInfo(DXGI_FORMAT format, uint32_t width, uint32_t height, uint64_t& rowBytes, uint64_t& numRows, uint64_t& slicePitch);
+
+    // 校验data(整个DDS文件)的头部，并计算每个子资源在data中的位置。
+    // 子资源的指针指向data内部，data必须在使用子资源期间保持有效
+    bool parse(const uint8_t* data, size_t size, Description& description, std::vector<Subresource>& subresources);
+
+    // 把description描述的纹理写成DDS文件，先写到临时文件再改名，失败时不会留下不完整的文件。
+    // subresources按子资源编号排列，共mipLevels * arraySize个，只使用其中的data、rowPitch和slicePitch：
+    // 行距和切片距可以大于DDS中紧密排列的大小(比如回读堆中按256字节对齐的行)，为0时表示紧密排列，多平面格式必须紧密排列。
+    // 能用遗留头部表示的纹理(单个2D纹理、单个立方体贴图或3D纹理，格式有对应的像素格式)默认写遗留头部，其他写DX10扩展头。
+    // 所有数据(头部和每个子资源或每一行)组成一个列表，用一次writev(Windows上逐段WriteFile)写出，不在内存中拼接
+    bool write(const std::string& fileName, const Description& description, const Subresource* subresources, bool forceDX10Header = false);
+
+    // 对应的D3D12_RESOURCE_DESC，可以直接用于CreateCommittedResource和TextureFootprint::getCopyableFootprints
+    D3D12_RESOURCE_DESC resourceDesc(const Description& description);
+
+    class View {
+    public:
+        // 文件不存在或者不是有效的DDS文件时返回false
+        bool open(const std::string& fileName);
+        void close();
+
+        bool isOpen() const { return file.isOpen(); }
+
+        const Description& description() const { return desc; }
+
+        uint32_t subresourceCount() const { return static_cast<uint32_t>(subresources.size()); }
+        const Subresource& subresource(uint32_t index) const { return subresources[index]; }
+        const Subresource& subresource(uint32_t mip, uint32_t arraySlice) const { return subresources[mip + arraySlice * desc.mipLevels]; }
+
+        // 把子资源[firstSubresource, firstSubresource + numSubresources)从映射复制到Map之后的上传堆。
+        // layouts、numRows、rowSizeInBytes由getCopyableFootprints(resourceDesc(description()), firstSubresource, numSubresources, ...)得到
+        void copyToUpload(uint8_t* mappedData, uint32_t firstSubresource, uint32_t numSubresources,
+                          const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, const uint32_t* numRows, const uint64_t* rowSizeInBytes) const;
+
+    private:
+        MappedFile file;
+        Description desc;
+        std::vector<Subresource> subresources;
+    };
+}
@@ -0,0 +1,189 @@
+#include "DerivedDataCache.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace {
+    const uint32_t entryMagic = 0x31434444;   // "DDC1"
+    const uint32_t entryVersion = 1;
+    const char* entryExtension = ".ddc";
+
+    struct EntryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint64_t payloadSize;
+        // payload的Hash::hash64
+        uint64_t checksum;
+    };
+
+    struct EntryInfo {
+        std::filesystem::path path;
+        std::filesystem::file_time_type lastUsed;
+        uint64_t size;
+    };
+}
+
+DerivedDataCache::DerivedDataCache(const std::string& inDirectory, uint64_t inMaxSize)
+: directory(inDirectory), maxSize(inMaxSize) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+}
+
+uint64_t DerivedDataCache::makeKey(const void* sourceData, size_t sourceSize, const std::string& parameters) {
+    uint64_t sourceHash = Hash::hash64(sourceData, sourceSize);
+
+    return Hash::hash64(parameters.data(), parameters.size(), sourceHash);
+}
+
+bool DerivedDataCache::makeFileKey(const std::string& sourceFileName, const std::string& parameters, uint64_t& key) {
+    MappedFile file;
+
+    if (!file.open(sourceFileName)) {
+        return false;
+    }
+
+    key = makeKey(file.getData(), file.getSize(), parameters);
+
+    return true;
+}
+
+bool DerivedDataCache::get(uint64_t key, std::vector<uint8_t>& payload) const {
+    std::string fileName = entryFileName(key);
+
+    {
+        MappedFile file;
+
+        if (!file.open(fileName) || file.getSize() < sizeof(EntryHeader)) {
+            return false;
+        }
+
+        EntryHeader header;
+        memcpy(&header, file.getData(), sizeof(header));
+
+        if (header.magic != entryMagic || header.version != entryVersion || header.key != key
+            || header.payloadSize != file.getSize() - sizeof(EntryHeader)) {
+            return false;
+        }
+
+        const uint8_t* data = file.getData() + sizeof(EntryHeader);
+
+        if (Hash::hash64(data, static_cast<size_t>(header.payloadSize)) != header.checksum) {
+            return false;
+        }
+
+        payload.assign(data, data + header.payloadSize);
+    }
+
+    // 命中时更新最近使用时间，失败了也不影响结果
+    std::error_code error;
+    std::filesystem::last_write_time(fileName, std::filesystem::file_time_type::clock::now(), error);
+
+    return true;
+}
+
+bool DerivedDataCache::put(uint64_t key, const void* payload, size_t size) {
+    EntryHeader header = {};
+    header.magic = entryMagic;
+    header.version = entryVersion;
+    header.key = key;
+    header.payloadSize = size;
+    header.checksum = Hash::hash64(payload, size);
+
+    std::string fileName = entryFileName(key);
+
+    // 临时文件名带上线程id，多个线程同时写同一个键时互不干扰
+    std::string temporaryFileName = fileName + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+    {
+        std::ofstream file(temporaryFileName, std::ios::binary | std::ios::trunc);
+
+        if (!file) {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(payload), size);
+
+        if (!file) {
+            file.close();
+            std::remove(temporaryFileName.c_str());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryFileName, fileName, error);
+
+    if (error) {
+        std::filesystem::remove(temporaryFileName, error);
+        return false;
+    }
+
+    trim();
+
+    return true;
+}
+
+void DerivedDataCache::trim() {
+    std::vector<EntryInfo> entries;
+    uint64_t totalSize = 0;
+
+    std::error_code error;
+
+    for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        // 单个条目的错误(比如其他线程刚好删除了它)只跳过这个条目，不能结束整个遍历
+        std::error_code entryError;
+
+        if (!it->is_regular_file(entryError) || it->path().extension() != entryExtension) {
+            continue;
+        }
+
+        EntryInfo entry;
+        entry.path = it->path();
+        entry.size = it->file_size(entryError);
+
+        if (entryError) {
+            continue;
+        }
+
+        entry.lastUsed = it->last_write_time(entryError);
+
+        if (!entryError) {
+            entries.push_back(entry);
+            totalSize += entry.size;
+        }
+    }
+
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const EntryInfo& a, const EntryInfo& b) {
+        return a.lastUsed < b.lastUsed;
+    });
+
+    // 其他线程可能刚好删除或者替换了同一个文件，删除失败时忽略
+    for (const auto& entry : entries) {
+        if (totalSize <= maxSize) {
+            break;
+        }
+
+        if (std::filesystem::remove(entry.path, error)) {
+            totalSize -= entry.size;
+        }
+    }
+}
+
+std::string DerivedDataCache::entryFileName(uint64_t key) const {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+
+    return (std::filesystem::path(directory) / (std::string(name) + entryExtension)).string();
+}
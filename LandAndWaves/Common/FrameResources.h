@@ -4,6 +4,7 @@
 #include <wrl/client.h>
 #include <d3d12.h>
 #include <memory>
+#include <vector>
 
 #include "MathHelper.h"
 #include "UploadBuffer.h"
@@ -16,6 +17,8 @@ namespace FrameUtil {
         XMFLOAT3 position;
         XMFLOAT4 color;
         XMFLOAT2 uv;
+        // DXGI_FORMAT_R10G10B10A2_UNORM：xyz为切线，w为手性(见MeshProcessing::packTangent)
+        uint32_t tangent;
     };
 
     struct RenderItem {
@@ -46,6 +49,12 @@ namespace FrameUtil {
         uint32_t indexCount = 0;
         uint32_t startIndexLocation = 0;
         int32_t baseVertexLocation = 0;
+
+        // 顶点数超过65536的网格拆分成多个16位索引子网格后，其余子网格的绘制参数
+        std::vector<SubmeshGeometry> extraSubmeshes;
+
+        // 是否用调色板格式的帧纹理着色。调色板纹理加载完成之后这类渲染项改用opaque_palettized
+        bool palettized = false;
     };
 
     // 单个物体的物体常量数据(不变的)
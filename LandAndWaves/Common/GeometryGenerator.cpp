@@ -663,3 +663,92 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
 
     return meshData;
 }
+
+GeometryGenerator::MeshData GeometryGenerator::SplitForIndices16(const MeshData& meshData, std::vector<Submesh16>& submeshes, std::vector<uint32>* sourceVertices)
+{
+	submeshes.clear();
+
+	if(sourceVertices != nullptr)
+		sourceVertices->clear();
+
+	if(meshData.Vertices.size() <= MaxVertices16)
+	{
+		Submesh16 submesh;
+		submesh.IndexCount = (uint32)meshData.Indices32.size();
+		submesh.VertexCount = (uint32)meshData.Vertices.size();
+		submeshes.push_back(submesh);
+
+		if(sourceVertices != nullptr)
+		{
+			sourceVertices->resize(meshData.Vertices.size());
+			for(uint32 i = 0; i < (uint32)meshData.Vertices.size(); ++i)
+				(*sourceVertices)[i] = i;
+		}
+
+		MeshData result;
+		result.Vertices = meshData.Vertices;
+		result.Indices32 = meshData.Indices32;
+		return result;
+	}
+
+	MeshData result;
+	result.Vertices.reserve(meshData.Vertices.size() + meshData.Vertices.size() / 8);
+	result.Indices32.reserve(meshData.Indices32.size());
+
+	// Maps a source vertex to its index inside the submesh being built.
+	const uint32 invalidIndex = 0xffffffff;
+	std::vector<uint32> localIndex(meshData.Vertices.size(), invalidIndex);
+	std::vector<uint32> usedVertices;
+	usedVertices.reserve(MaxVertices16);
+
+	Submesh16 submesh;
+
+	auto closeSubmesh = [&]()
+	{
+		submesh.IndexCount = (uint32)result.Indices32.size() - submesh.StartIndexLocation;
+		submesh.VertexCount = (uint32)usedVertices.size();
+		submeshes.push_back(submesh);
+
+		for(uint32 vertex : usedVertices)
+			localIndex[vertex] = invalidIndex;
+		usedVertices.clear();
+
+		submesh.StartIndexLocation = (uint32)result.Indices32.size();
+		submesh.BaseVertexLocation = (uint32)result.Vertices.size();
+	};
+
+	for(size_t i = 0; i + 2 < meshData.Indices32.size(); i += 3)
+	{
+		uint32 i0 = meshData.Indices32[i];
+		uint32 i1 = meshData.Indices32[i + 1];
+		uint32 i2 = meshData.Indices32[i + 2];
+
+		// Count the corners this triangle would add (degenerate triangles may repeat one).
+		uint32 newVertices = (localIndex[i0] == invalidIndex ? 1 : 0) +
+			(localIndex[i1] == invalidIndex && i1 != i0 ? 1 : 0) +
+			(localIndex[i2] == invalidIndex && i2 != i0 && i2 != i1 ? 1 : 0);
+
+		if(usedVertices.size() + newVertices > MaxVertices16)
+			closeSubmesh();
+
+		for(uint32 vertex : { i0, i1, i2 })
+		{
+			if(localIndex[vertex] == invalidIndex)
+			{
+				localIndex[vertex] = (uint32)usedVertices.size();
+				usedVertices.push_back(vertex);
+				result.Vertices.push_back(meshData.Vertices[vertex]);
+
+				if(sourceVertices != nullptr)
+					sourceVertices->push_back(vertex);
+			}
+
+			result.Indices32.push_back(localIndex[vertex]);
+		}
+	}
+
+	if(result.Indices32.size() > submesh.StartIndexLocation)
+		closeSubmesh();
+
+	return result;
+}
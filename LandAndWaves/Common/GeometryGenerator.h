@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <cassert>
 #include <cstdint>
 #include <DirectXMath.h>
 #include <vector>
@@ -58,13 +59,18 @@ public:
 		std::vector<Vertex> Vertices;
         std::vector<uint32> Indices32;
 
+        // Only valid while every index fits in 16 bits.  Meshes with more than
+        // 65536 vertices must go through SplitForIndices16 first.
         std::vector<uint16>& GetIndices16()
         {
 			if(mIndices16.empty())
 			{
 				mIndices16.resize(Indices32.size());
 				for(size_t i = 0; i < Indices32.size(); ++i)
+				{
+					assert(Indices32[i] < MaxVertices16);
 					mIndices16[i] = static_cast<uint16>(Indices32[i]);
+				}
 			}
 
 			return mIndices16;
@@ -74,6 +80,18 @@ public:
 		std::vector<uint16> mIndices16;
 	};
 
+	static const uint32 MaxVertices16 = 65536;
+
+	// A range of a split mesh whose indices are rebased to BaseVertexLocation,
+	// so that it can be drawn with DXGI_FORMAT_R16_UINT.
+	struct Submesh16
+	{
+		uint32 IndexCount = 0;
+		uint32 StartIndexLocation = 0;
+		uint32 BaseVertexLocation = 0;
+		uint32 VertexCount = 0;
+	};
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
@@ -110,6 +128,17 @@ public:
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	///<summary>
+	/// Partitions the triangles of a mesh into submeshes that each reference at most
+	/// MaxVertices16 unique vertices.  The returned mesh stores the vertices of every
+	/// submesh contiguously (vertices shared across a split are duplicated) and its
+	/// Indices32 are local to each submesh, so GetIndices16 is valid on it.  Meshes
+	/// that already fit are returned unchanged as a single submesh.  If sourceVertices
+	/// is not null it receives, for every returned vertex, the index of the input
+	/// vertex it was copied from (for carrying per-vertex side data through the split).
+	///</summary>
+    MeshData SplitForIndices16(const MeshData& meshData, std::vector<Submesh16>& submeshes, std::vector<uint32>* sourceVertices = nullptr);
+
 private:
 	void Subdivide(MeshData& meshData);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
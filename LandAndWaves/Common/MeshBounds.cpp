@@ -0,0 +1,370 @@
+#include "MeshBounds.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <immintrin.h>
+#define MESH_BOUNDS_SSE 1
+
+// AVX只在运行时检测到支持时才会调用，默认的编译选项下也能使用8路的版本。
+// GCC/Clang需要给使用AVX指令的函数单独指定target，MSVC可以直接使用
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MESH_BOUNDS_TARGET(isa)
+#else
+#define MESH_BOUNDS_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+using namespace DirectX;
+
+namespace MeshBounds {
+    namespace {
+        const XMFLOAT3& positionAt(const uint8_t* positions, size_t index, size_t stride) {
+            return *reinterpret_cast<const XMFLOAT3*>(positions + index * stride);
+        }
+
+        float distanceSquared(const XMFLOAT3& a, const XMFLOAT3& b) {
+            float x = a.x - b.x;
+            float y = a.y - b.y;
+            float z = a.z - b.z;
+
+            return x * x + y * y + z * z;
+        }
+
+        // 每个顶点读取16字节(xyz和下一个成员的4字节)，第4个分量最后被丢弃。
+        // 顶点小于16字节时(比如紧密排列的XMFLOAT3)，最后一个顶点会越界，所以留给标量处理
+        size_t vectorCountFor(size_t count, size_t stride) {
+            return stride >= 16 ? count : (count > 0 ? count - 1 : 0);
+        }
+
+        // 动态网格每帧归约的结果：y的范围和到固定球心的最大距离的平方
+        struct HeightBounds {
+            float minimumY;
+            float maximumY;
+            float radiusSquared;
+        };
+
+#ifdef MESH_BOUNDS_SSE
+        bool detectAVX() {
+#if defined(_MSC_VER)
+            int info[4] = {};
+            __cpuid(info, 1);
+
+            // 还需要操作系统保存YMM寄存器(OSXSAVE + XCR0)
+            return (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx") != 0;
+#endif
+        }
+
+        bool hasAVX() {
+            static const bool avx = detectAVX();
+            return avx;
+        }
+
+        __m128 loadPosition(const uint8_t* positions, size_t index, size_t stride) {
+            return _mm_loadu_ps(reinterpret_cast<const float*>(positions + index * stride));
+        }
+
+        float horizontalMin(__m128 value) {
+            value = _mm_min_ps(value, _mm_movehl_ps(value, value));
+            value = _mm_min_ss(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 1, 1, 1)));
+            return _mm_cvtss_f32(value);
+        }
+
+        float horizontalMax(__m128 value) {
+            value = _mm_max_ps(value, _mm_movehl_ps(value, value));
+            value = _mm_max_ss(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 1, 1, 1)));
+            return _mm_cvtss_f32(value);
+        }
+
+        // 以下SIMD函数从第i个顶点开始处理整批，返回第一个没有处理的顶点，剩下的由标量代码处理。
+        // 每批顶点先转置成x, y, z三个寄存器(SoA)，所有通道都是有效数据
+
+        size_t minMaxSSE(const uint8_t* positions, size_t i, size_t vectorCount, size_t stride, XMFLOAT3& minimum, XMFLOAT3& maximum) {
+            __m128 minimumX = _mm_set1_ps(minimum.x), minimumY = _mm_set1_ps(minimum.y), minimumZ = _mm_set1_ps(minimum.z);
+            __m128 maximumX = _mm_set1_ps(maximum.x), maximumY = _mm_set1_ps(maximum.y), maximumZ = _mm_set1_ps(maximum.z);
+
+            for (; i + 4 <= vectorCount; i += 4) {
+                __m128 x = loadPosition(positions, i, stride);
+                __m128 y = loadPosition(positions, i + 1, stride);
+                __m128 z = loadPosition(positions, i + 2, stride);
+                __m128 w = loadPosition(positions, i + 3, stride);
+
+                _MM_TRANSPOSE4_PS(x, y, z, w);
+
+                minimumX = _mm_min_ps(minimumX, x);
+                minimumY = _mm_min_ps(minimumY, y);
+                minimumZ = _mm_min_ps(minimumZ, z);
+                maximumX = _mm_max_ps(maximumX, x);
+                maximumY = _mm_max_ps(maximumY, y);
+                maximumZ = _mm_max_ps(maximumZ, z);
+            }
+
+            minimum = XMFLOAT3(horizontalMin(minimumX), horizontalMin(minimumY), horizontalMin(minimumZ));
+            maximum = XMFLOAT3(horizontalMax(maximumX), horizontalMax(maximumY), horizontalMax(maximumZ));
+
+            return i;
+        }
+
+        size_t heightBoundsSSE(const uint8_t* positions, size_t i, size_t vectorCount, size_t stride, const XMFLOAT3& center, HeightBounds& bounds) {
+            __m128 minimumY = _mm_set1_ps(bounds.minimumY);
+            __m128 maximumY = _mm_set1_ps(bounds.maximumY);
+            __m128 radiusSquared = _mm_set1_ps(bounds.radiusSquared);
+            __m128 centerX = _mm_set1_ps(center.x), centerY = _mm_set1_ps(center.y), centerZ = _mm_set1_ps(center.z);
+
+            for (; i + 4 <= vectorCount; i += 4) {
+                __m128 x = loadPosition(positions, i, stride);
+                __m128 y = loadPosition(positions, i + 1, stride);
+                __m128 z = loadPosition(positions, i + 2, stride);
+                __m128 w = loadPosition(positions, i + 3, stride);
+
+                _MM_TRANSPOSE4_PS(x, y, z, w);
+
+                minimumY = _mm_min_ps(minimumY, y);
+                maximumY = _mm_max_ps(maximumY, y);
+
+                __m128 dx = _mm_sub_ps(x, centerX);
+                __m128 dy = _mm_sub_ps(y, centerY);
+                __m128 dz = _mm_sub_ps(z, centerZ);
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+                radiusSquared = _mm_max_ps(radiusSquared, distance);
+            }
+
+            bounds.minimumY = horizontalMin(minimumY);
+            bounds.maximumY = horizontalMax(maximumY);
+            bounds.radiusSquared = horizontalMax(radiusSquared);
+
+            return i;
+        }
+
+        // 每个128位通道各转置4个顶点：低半部分是顶点i~i+3，高半部分是i+4~i+7
+        MESH_BOUNDS_TARGET("avx")
+        void loadTransposedAVX(const uint8_t* positions, size_t i, size_t stride, __m256& x, __m256& y, __m256& z) {
+            __m256 p0 = _mm256_insertf128_ps(_mm256_castps128_ps256(loadPosition(positions, i, stride)), loadPosition(positions, i + 4, stride), 1);
+            __m256 p1 = _mm256_insertf128_ps(_mm256_castps128_ps256(loadPosition(positions, i + 1, stride)), loadPosition(positions, i + 5, stride), 1);
+            __m256 p2 = _mm256_insertf128_ps(_mm256_castps128_ps256(loadPosition(positions, i + 2, stride)), loadPosition(positions, i + 6, stride), 1);
+            __m256 p3 = _mm256_insertf128_ps(_mm256_castps128_ps256(loadPosition(positions, i + 3, stride)), loadPosition(positions, i + 7, stride), 1);
+
+            // (x0 x1 y0 y1), (z0 z1 w0 w1), (x2 x3 y2 y3), (z2 z3 w2 w3)
+            __m256 xy01 = _mm256_unpacklo_ps(p0, p1);
+            __m256 zw01 = _mm256_unpackhi_ps(p0, p1);
+            __m256 xy23 = _mm256_unpacklo_ps(p2, p3);
+            __m256 zw23 = _mm256_unpackhi_ps(p2, p3);
+
+            x = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(1, 0, 1, 0));
+            y = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+            z = _mm256_shuffle_ps(zw01, zw23, _MM_SHUFFLE(1, 0, 1, 0));
+        }
+
+        MESH_BOUNDS_TARGET("avx")
+        __m128 lowHighMin(__m256 value) {
+            return _mm_min_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+        }
+
+        MESH_BOUNDS_TARGET("avx")
+        __m128 lowHighMax(__m256 value) {
+            return _mm_max_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+        }
+
+        MESH_BOUNDS_TARGET("avx")
+        size_t minMaxAVX(const uint8_t* positions, size_t i, size_t vectorCount, size_t stride, XMFLOAT3& minimum, XMFLOAT3& maximum) {
+            __m256 minimumX = _mm256_set1_ps(minimum.x), minimumY = _mm256_set1_ps(minimum.y), minimumZ = _mm256_set1_ps(minimum.z);
+            __m256 maximumX = _mm256_set1_ps(maximum.x), maximumY = _mm256_set1_ps(maximum.y), maximumZ = _mm256_set1_ps(maximum.z);
+
+            for (; i + 8 <= vectorCount; i += 8) {
+                __m256 x, y, z;
+                loadTransposedAVX(positions, i, stride, x, y, z);
+
+                minimumX = _mm256_min_ps(minimumX, x);
+                minimumY = _mm256_min_ps(minimumY, y);
+                minimumZ = _mm256_min_ps(minimumZ, z);
+                maximumX = _mm256_max_ps(maximumX, x);
+                maximumY = _mm256_max_ps(maximumY, y);
+                maximumZ = _mm256_max_ps(maximumZ, z);
+            }
+
+            minimum = XMFLOAT3(horizontalMin(lowHighMin(minimumX)), horizontalMin(lowHighMin(minimumY)), horizontalMin(lowHighMin(minimumZ)));
+            maximum = XMFLOAT3(horizontalMax(lowHighMax(maximumX)), horizontalMax(lowHighMax(maximumY)), horizontalMax(lowHighMax(maximumZ)));
+
+            return i;
+        }
+
+        MESH_BOUNDS_TARGET("avx")
+        size_t heightBoundsAVX(const uint8_t* positions, size_t i, size_t vectorCount, size_t stride, const XMFLOAT3& center, HeightBounds& bounds) {
+            __m256 minimumY = _mm256_set1_ps(bounds.minimumY);
+            __m256 maximumY = _mm256_set1_ps(bounds.maximumY);
+            __m256 radiusSquared = _mm256_set1_ps(bounds.radiusSquared);
+            __m256 centerX = _mm256_set1_ps(center.x), centerY = _mm256_set1_ps(center.y), centerZ = _mm256_set1_ps(center.z);
+
+            for (; i + 8 <= vectorCount; i += 8) {
+                __m256 x, y, z;
+                loadTransposedAVX(positions, i, stride, x, y, z);
+
+                minimumY = _mm256_min_ps(minimumY, y);
+                maximumY = _mm256_max_ps(maximumY, y);
+
+                __m256 dx = _mm256_sub_ps(x, centerX);
+                __m256 dy = _mm256_sub_ps(y, centerY);
+                __m256 dz = _mm256_sub_ps(z, centerZ);
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+                radiusSquared = _mm256_max_ps(radiusSquared, distance);
+            }
+
+            bounds.minimumY = horizontalMin(lowHighMin(minimumY));
+            bounds.maximumY = horizontalMax(lowHighMax(maximumY));
+            bounds.radiusSquared = horizontalMax(lowHighMax(radiusSquared));
+
+            return i;
+        }
+#endif
+
+        void computeMinMax(const uint8_t* positions, size_t count, size_t stride, XMFLOAT3& minimum, XMFLOAT3& maximum) {
+            minimum = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+            maximum = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+            size_t i = 0;
+
+#ifdef MESH_BOUNDS_SSE
+            size_t vectorCount = vectorCountFor(count, stride);
+
+            if (hasAVX()) {
+                i = minMaxAVX(positions, i, vectorCount, stride, minimum, maximum);
+            }
+
+            i = minMaxSSE(positions, i, vectorCount, stride, minimum, maximum);
+#endif
+
+            for (; i < count; i++) {
+                const XMFLOAT3& position = positionAt(positions, i, stride);
+
+                minimum.x = std::min(minimum.x, position.x);
+                minimum.y = std::min(minimum.y, position.y);
+                minimum.z = std::min(minimum.z, position.z);
+                maximum.x = std::max(maximum.x, position.x);
+                maximum.y = std::max(maximum.y, position.y);
+                maximum.z = std::max(maximum.z, position.z);
+            }
+        }
+
+        BoundingBox boxFromMinMax(const XMFLOAT3& minimum, const XMFLOAT3& maximum) {
+            return BoundingBox(
+                XMFLOAT3(0.5f * (minimum.x + maximum.x), 0.5f * (minimum.y + maximum.y), 0.5f * (minimum.z + maximum.z)),
+                XMFLOAT3(0.5f * (maximum.x - minimum.x), 0.5f * (maximum.y - minimum.y), 0.5f * (maximum.z - minimum.z)));
+        }
+
+        size_t farthestFrom(const uint8_t* positions, size_t count, size_t stride, const XMFLOAT3& point) {
+            size_t farthest = 0;
+            float farthestDistance = -1.0f;
+
+            for (size_t i = 0; i < count; i++) {
+                float distance = distanceSquared(point, positionAt(positions, i, stride));
+
+                if (distance > farthestDistance) {
+                    farthestDistance = distance;
+                    farthest = i;
+                }
+            }
+
+            return farthest;
+        }
+    }
+
+    BoundingBox computeBox(const void* positions, size_t count, size_t stride) {
+        if (count == 0) {
+            return BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+        }
+
+        XMFLOAT3 minimum;
+        XMFLOAT3 maximum;
+        computeMinMax(reinterpret_cast<const uint8_t*>(positions), count, stride, minimum, maximum);
+
+        return boxFromMinMax(minimum, maximum);
+    }
+
+    BoundingSphere computeSphere(const void* positions, size_t count, size_t stride) {
+        if (count == 0) {
+            return BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f);
+        }
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(positions);
+
+        // Ritter：从任意一点出发找到最远点a，再找到离a最远的点b，以ab为直径得到初始球
+        size_t a = farthestFrom(bytes, count, stride, positionAt(bytes, 0, stride));
+        size_t b = farthestFrom(bytes, count, stride, positionAt(bytes, a, stride));
+
+        const XMFLOAT3& pa = positionAt(bytes, a, stride);
+        const XMFLOAT3& pb = positionAt(bytes, b, stride);
+
+        XMFLOAT3 center(0.5f * (pa.x + pb.x), 0.5f * (pa.y + pb.y), 0.5f * (pa.z + pb.z));
+        float radius = 0.5f * std::sqrt(distanceSquared(pa, pb));
+
+        // 遇到球外的点就把球扩大到刚好包含它
+        for (size_t i = 0; i < count; i++) {
+            const XMFLOAT3& p = positionAt(bytes, i, stride);
+            float distance = std::sqrt(distanceSquared(center, p));
+
+            if (distance > radius) {
+                float newRadius = 0.5f * (radius + distance);
+                float shift = (newRadius - radius) / distance;
+
+                center.x += (p.x - center.x) * shift;
+                center.y += (p.y - center.y) * shift;
+                center.z += (p.z - center.z) * shift;
+                radius = newRadius;
+            }
+        }
+
+        // 以包围盒中心为球心的包围球有时更紧
+        BoundingBox box = computeBox(positions, count, stride);
+        float boxRadius = std::sqrt(distanceSquared(box.Center, positionAt(bytes, farthestFrom(bytes, count, stride, box.Center), stride)));
+
+        if (boxRadius < radius) {
+            return BoundingSphere(box.Center, boxRadius);
+        }
+
+        return BoundingSphere(center, radius);
+    }
+
+    void updateDynamicBounds(const void* positions, size_t count, size_t stride,
+                             BoundingBox& box, BoundingSphere& sphere) {
+        if (count == 0) {
+            return;
+        }
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(positions);
+        HeightBounds bounds = { FLT_MAX, -FLT_MAX, 0.0f };
+        size_t i = 0;
+
+#ifdef MESH_BOUNDS_SSE
+        size_t vectorCount = vectorCountFor(count, stride);
+
+        if (hasAVX()) {
+            i = heightBoundsAVX(bytes, i, vectorCount, stride, sphere.Center, bounds);
+        }
+
+        i = heightBoundsSSE(bytes, i, vectorCount, stride, sphere.Center, bounds);
+#endif
+
+        for (; i < count; i++) {
+            const XMFLOAT3& position = positionAt(bytes, i, stride);
+
+            bounds.minimumY = std::min(bounds.minimumY, position.y);
+            bounds.maximumY = std::max(bounds.maximumY, position.y);
+            bounds.radiusSquared = std::max(bounds.radiusSquared, distanceSquared(sphere.Center, position));
+        }
+
+        // x和z不变，只更新包围盒的y范围
+        box.Center.y = 0.5f * (bounds.minimumY + bounds.maximumY);
+        box.Extents.y = 0.5f * (bounds.maximumY - bounds.minimumY);
+
+        sphere.Radius = std::sqrt(bounds.radiusSquared);
+    }
+}
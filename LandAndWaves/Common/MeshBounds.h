@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <DirectXCollision.h>
+
+// 子网格包围体的计算
+// positions指向第一个顶点的位置(必须是顶点结构体的第一个成员)，stride为顶点的字节大小
+namespace MeshBounds {
+    // 轴对齐包围盒。每批4个顶点(SSE)或8个顶点(运行时检测到AVX时)先转置成x, y, z三个寄存器再归约
+    DirectX::BoundingBox computeBox(const void* positions, size_t count, size_t stride);
+
+    // 先用Ritter算法求出近似最小包围球，再与包围盒中心的包围球比较取较小者
+    DirectX::BoundingSphere computeSphere(const void* positions, size_t count, size_t stride);
+
+    // 动态网格(如波浪)只有高度会变化，box和sphere必须先用computeBox/computeSphere初始化：
+    // 包围盒只重新归约y的范围，x和z的范围保持不变；
+    // 包围球保持初始的球心，在同一遍归约中求出到球心的最大距离作为新的半径
+    void updateDynamicBounds(const void* positions, size_t count, size_t stride,
+                             DirectX::BoundingBox& box, DirectX::BoundingSphere& sphere);
+}
@@ -0,0 +1,210 @@
+#include "MeshCache.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace MeshCache {
+    namespace {
+        bool getSourceStamp(const std::string& sourceFileName, uint64_t& size, int64_t& timestamp) {
+            std::error_code error;
+
+            size = std::filesystem::file_size(sourceFileName, error);
+
+            if (error) {
+                return false;
+            }
+
+            timestamp = static_cast<int64_t>(std::filesystem::last_write_time(sourceFileName, error).time_since_epoch().count());
+
+            return !error;
+        }
+
+        uint64_t alignUp(uint64_t value, uint64_t alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    std::string cacheFileNameFor(const std::string& sourceFileName) {
+        return std::filesystem::path(sourceFileName).replace_extension(".meshcache").string();
+    }
+
+    SubmeshRecord makeSubmeshRecord(const std::string& name, uint32_t indexCount, uint32_t startIndexLocation,
+                                    uint32_t baseVertexLocation, uint32_t vertexCount,
+                                    const DirectX::BoundingBox& box, const DirectX::BoundingSphere& sphere) {
+        SubmeshRecord record = {};
+
+        strncpy(record.name, name.c_str(), sizeof(record.name) - 1);
+        record.indexCount = indexCount;
+        record.startIndexLocation = startIndexLocation;
+        record.baseVertexLocation = baseVertexLocation;
+        record.vertexCount = vertexCount;
+
+        memcpy(record.boxCenter, &box.Center, sizeof(record.boxCenter));
+        memcpy(record.boxExtents, &box.Extents, sizeof(record.boxExtents));
+        memcpy(record.sphereCenter, &sphere.Center, sizeof(record.sphereCenter));
+        record.sphereRadius = sphere.Radius;
+
+        return record;
+    }
+
+    DirectX::BoundingBox boxOf(const SubmeshRecord& record) {
+        DirectX::BoundingBox box;
+        memcpy(&box.Center, record.boxCenter, sizeof(record.boxCenter));
+        memcpy(&box.Extents, record.boxExtents, sizeof(record.boxExtents));
+
+        return box;
+    }
+
+    DirectX::BoundingSphere sphereOf(const SubmeshRecord& record) {
+        DirectX::BoundingSphere sphere;
+        memcpy(&sphere.Center, record.sphereCenter, sizeof(record.sphereCenter));
+        sphere.Radius = record.sphereRadius;
+
+        return sphere;
+    }
+
+    bool write(const std::string& cacheFileName, const std::string& sourceFileName,
+               const void* vertices, uint32_t vertexCount, uint32_t vertexStride,
+               const void* indices, uint32_t indexCount, uint32_t indexStride,
+               const std::vector<SubmeshRecord>& submeshes) {
+        if (vertexStride == 0 || (indexStride != sizeof(uint16_t) && indexStride != sizeof(uint32_t))) {
+            return false;
+        }
+
+        Header header = {};
+        header.magic = cacheMagic;
+        header.version = cacheVersion;
+        header.headerSize = sizeof(Header);
+        header.vertexStride = vertexStride;
+        header.vertexCount = vertexCount;
+        header.indexCount = indexCount;
+        header.submeshCount = static_cast<uint32_t>(submeshes.size());
+        header.indexStride = indexStride;
+
+        if (!getSourceStamp(sourceFileName, header.sourceSize, header.sourceTimestamp)) {
+            return false;
+        }
+
+        uint64_t vertexBytes = static_cast<uint64_t>(vertexCount) * vertexStride;
+        uint64_t indexBytes = static_cast<uint64_t>(indexCount) * indexStride;
+
+        header.submeshOffset = sizeof(Header);
+        header.vertexOffset = alignUp(header.submeshOffset + submeshes.size() * sizeof(SubmeshRecord), blobAlignment);
+        header.indexOffset = alignUp(header.vertexOffset + vertexBytes, blobAlignment);
+        header.fileSize = header.indexOffset + indexBytes;
+
+        // 先在内存中拼好头部之后的全部数据，计算校验和之后一次写出
+        std::vector<uint8_t> payload(static_cast<size_t>(header.fileSize - sizeof(Header)), 0);
+
+        if (!submeshes.empty()) {
+            memcpy(payload.data() + (header.submeshOffset - sizeof(Header)), submeshes.data(), submeshes.size() * sizeof(SubmeshRecord));
+        }
+
+        if (vertexBytes > 0) {
+            memcpy(payload.data() + (header.vertexOffset - sizeof(Header)), vertices, static_cast<size_t>(vertexBytes));
+        }
+
+        if (indexBytes > 0) {
+            memcpy(payload.data() + (header.indexOffset - sizeof(Header)), indices, static_cast<size_t>(indexBytes));
+        }
+
+        header.checksum = Hash::hash64(payload.data(), payload.size());
+
+        // 先写临时文件再改名，避免中途失败留下半个缓存文件
+        std::string temporaryFileName = cacheFileName + ".tmp";
+
+        {
+            std::ofstream file(temporaryFileName, std::ios::binary | std::ios::trunc);
+
+            if (!file) {
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+            if (!file) {
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporaryFileName, cacheFileName, error);
+
+        return !error;
+    }
+
+    bool View::open(const std::string& cacheFileName, const std::string& sourceFileName,
+                    uint32_t vertexStride, uint32_t indexStride, MissingSource missingSource) {
+        close();
+
+        if (!file.open(cacheFileName) || file.getSize() < sizeof(Header)) {
+            close();
+            return false;
+        }
+
+        const Header* candidate = reinterpret_cast<const Header*>(file.getData());
+
+        // 各段依次排列且都在文件内。每一步比较的都是前一步已经确认过范围的值，
+        // 偏移量和数量都来自文件本身，先检查下界再做减法或加法，不会溢出
+        bool valid = candidate->magic == cacheMagic
+            && candidate->version == cacheVersion
+            && candidate->headerSize == sizeof(Header)
+            && candidate->vertexStride == vertexStride
+            && candidate->indexStride == indexStride
+            && candidate->fileSize == file.getSize()
+            && candidate->submeshOffset >= sizeof(Header)
+            && candidate->submeshOffset <= candidate->vertexOffset
+            && candidate->vertexOffset <= candidate->indexOffset
+            && candidate->indexOffset <= candidate->fileSize
+            && candidate->vertexOffset % blobAlignment == 0
+            && candidate->indexOffset % blobAlignment == 0
+            && static_cast<uint64_t>(candidate->submeshCount) * sizeof(SubmeshRecord) <= candidate->vertexOffset - candidate->submeshOffset
+            && static_cast<uint64_t>(candidate->vertexCount) * candidate->vertexStride <= candidate->indexOffset - candidate->vertexOffset
+            && static_cast<uint64_t>(candidate->indexCount) * candidate->indexStride <= candidate->fileSize - candidate->indexOffset;
+
+        if (valid) {
+            uint64_t sourceSize = 0;
+            int64_t sourceTimestamp = 0;
+
+            if (getSourceStamp(sourceFileName, sourceSize, sourceTimestamp)) {
+                valid = candidate->sourceSize == sourceSize && candidate->sourceTimestamp == sourceTimestamp;
+            } else {
+                // 源文件不存在时无法判断缓存是否过期，只有调用者明确允许时才使用
+                valid = missingSource == MissingSource::Accept;
+            }
+        }
+
+        if (valid) {
+            valid = Hash::hash64(file.getData() + sizeof(Header), file.getSize() - sizeof(Header)) == candidate->checksum;
+        }
+
+        if (!valid) {
+            close();
+            return false;
+        }
+
+        header = candidate;
+
+        return true;
+    }
+
+    void View::close() {
+        file.close();
+        header = nullptr;
+    }
+
+    const void* View::vertexData() const {
+        return file.getData() + header->vertexOffset;
+    }
+
+    const void* View::indexData() const {
+        return file.getData() + header->indexOffset;
+    }
+
+    const SubmeshRecord* View::submeshes() const {
+        return reinterpret_cast<const SubmeshRecord*>(file.getData() + header->submeshOffset);
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <DirectXCollision.h>
+
+#include "MappedFile.h"
+
+// 由模型文件生成的二进制网格缓存
+//
+// 文件布局：
+//   Header
+//   SubmeshRecord[submeshCount]
+//   顶点数据(调用者的GPU顶点格式，按blobAlignment对齐)
+//   索引数据(16位或32位，按blobAlignment对齐)
+//
+// 缓存里存的就是要上传到GPU的顶点和索引，通过内存映射打开后直接从映射的内存上传，
+// 子网格的包围体也已经算好，不需要解析和复制。
+// 头部记录了源文件的大小和修改时间以及数据的校验和，任何一项不匹配都视为过期缓存
+namespace MeshCache {
+    const uint32_t cacheMagic = 0x4e49424d;   // "MBIN"
+    const uint32_t cacheVersion = 3;
+    const uint64_t blobAlignment = 64;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t headerSize;
+        uint32_t vertexStride;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t submeshCount;
+        uint32_t indexStride;
+        uint64_t sourceSize;
+        int64_t  sourceTimestamp;
+        uint64_t submeshOffset;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t fileSize;
+        // 头部之后所有数据的Hash::hash64
+        uint64_t checksum;
+    };
+
+    struct SubmeshRecord {
+        char name[32];
+        uint32_t indexCount;
+        uint32_t startIndexLocation;
+        uint32_t baseVertexLocation;
+        uint32_t vertexCount;
+        float boxCenter[3];
+        float boxExtents[3];
+        float sphereCenter[3];
+        float sphereRadius;
+    };
+
+    // 源文件不存在时如何处理已有的缓存
+    enum class MissingSource {
+        // 视为过期缓存，这是默认行为
+        Reject,
+        // 无法校验时间戳，但仍然使用缓存(比如只发布了缓存而没有源文件)
+        Accept,
+    };
+
+    // Models/skull.txt -> Models/skull.meshcache
+    std::string cacheFileNameFor(const std::string& sourceFileName);
+
+    SubmeshRecord makeSubmeshRecord(const std::string& name, uint32_t indexCount, uint32_t startIndexLocation,
+                                    uint32_t baseVertexLocation, uint32_t vertexCount,
+                                    const DirectX::BoundingBox& box, const DirectX::BoundingSphere& sphere);
+
+    DirectX::BoundingBox boxOf(const SubmeshRecord& record);
+    DirectX::BoundingSphere sphereOf(const SubmeshRecord& record);
+
+    // vertices为vertexCount个vertexStride字节的顶点，indices为indexCount个indexStride(2或4)字节的索引
+    bool write(const std::string& cacheFileName, const std::string& sourceFileName,
+               const void* vertices, uint32_t vertexCount, uint32_t vertexStride,
+               const void* indices, uint32_t indexCount, uint32_t indexStride,
+               const std::vector<SubmeshRecord>& submeshes);
+
+    class View {
+    public:
+        // 校验失败(格式、版本、顶点或索引格式、校验和、源文件已修改或不存在)时返回false，
+        // 调用者应重新生成缓存
+        bool open(const std::string& cacheFileName, const std::string& sourceFileName,
+                  uint32_t vertexStride, uint32_t indexStride,
+                  MissingSource missingSource = MissingSource::Reject);
+        void close();
+
+        const void* vertexData() const;
+        uint32_t vertexCount() const { return header->vertexCount; }
+        uint64_t vertexBytes() const { return static_cast<uint64_t>(header->vertexCount) * header->vertexStride; }
+
+        const void* indexData() const;
+        uint32_t indexCount() const { return header->indexCount; }
+        uint64_t indexBytes() const { return static_cast<uint64_t>(header->indexCount) * header->indexStride; }
+
+        const SubmeshRecord* submeshes() const;
+        uint32_t submeshCount() const { return header->submeshCount; }
+
+    private:
+        MappedFile file;
+        const Header* header = nullptr;
+    };
+}
@@ -0,0 +1,499 @@
+#include "MeshCodec.h"
+
+#include <cstring>
+#include <memory>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MESH_CODEC_SSE2 1
+#endif
+
+namespace MeshCodec {
+    namespace {
+        void writeUInt32(std::vector<uint8_t>& output, uint32_t value) {
+            uint8_t bytes[4] = {
+                static_cast<uint8_t>(value),
+                static_cast<uint8_t>(value >> 8),
+                static_cast<uint8_t>(value >> 16),
+                static_cast<uint8_t>(value >> 24)
+            };
+
+            output.insert(output.end(), bytes, bytes + 4);
+        }
+
+        bool readUInt32(const uint8_t*& data, const uint8_t* end, uint32_t& value) {
+            if (end - data < 4) {
+                return false;
+            }
+
+            value = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+            data += 4;
+
+            return true;
+        }
+
+        void writeVarint(std::vector<uint8_t>& output, uint32_t value) {
+            while (value >= 0x80) {
+                output.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+
+            output.push_back(static_cast<uint8_t>(value));
+        }
+
+        bool readVarint(const uint8_t*& data, const uint8_t* end, uint32_t& value) {
+            value = 0;
+
+            for (uint32_t shift = 0; shift < 35; shift += 7) {
+                if (data == end) {
+                    return false;
+                }
+
+                uint8_t byte = *data++;
+                value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+
+                if ((byte & 0x80) == 0) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        uint32_t zigzag(int32_t value) {
+            return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+        }
+
+        int32_t unzigzag(uint32_t value) {
+            return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+        }
+
+        // 字节差分的前缀和，即差分的逆运算
+        void prefixSumBytes(uint8_t* bytes, size_t count) {
+            size_t i = 0;
+            uint8_t previous = 0;
+
+#ifdef MESH_CODEC_SSE2
+            __m128i carry = _mm_setzero_si128();
+
+            for (; i + 16 <= count; i += 16) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+
+                // 16个字节的块内前缀和：log2(16) = 4步移位相加
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+                x = _mm_add_epi8(x, carry);
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i), x);
+
+                // 把最后一个字节广播为下一块的进位
+                carry = _mm_set1_epi8(static_cast<char>(_mm_extract_epi16(x, 7) >> 8));
+            }
+
+            if (i > 0) {
+                previous = bytes[i - 1];
+            }
+#endif
+
+            for (; i < count; i++) {
+                previous = static_cast<uint8_t>(previous + bytes[i]);
+                bytes[i] = previous;
+            }
+        }
+
+        // 零值游程编码：(零的个数, 字面量个数, 字面量...)，更长的零串拆成多个记号
+        void encodeZeroRuns(const uint8_t* bytes, size_t count, std::vector<uint8_t>& output) {
+            size_t i = 0;
+
+            while (i < count) {
+                size_t zeroStart = i;
+
+                while (i < count && bytes[i] == 0 && i - zeroStart < maxZeroRun) {
+                    i++;
+                }
+
+                size_t literalStart = i;
+
+                // 字面量中夹杂的短零串不值得单独拆成一个记号
+                while (i < count) {
+                    if (bytes[i] == 0) {
+                        size_t zeroEnd = i;
+
+                        while (zeroEnd < count && bytes[zeroEnd] == 0 && zeroEnd - i < 3) {
+                            zeroEnd++;
+                        }
+
+                        if (zeroEnd - i >= 3 || zeroEnd == count) {
+                            break;
+                        }
+
+                        i = zeroEnd;
+                    }
+                    else {
+                        i++;
+                    }
+                }
+
+                writeVarint(output, static_cast<uint32_t>(literalStart - zeroStart));
+                writeVarint(output, static_cast<uint32_t>(i - literalStart));
+                output.insert(output.end(), bytes + literalStart, bytes + i);
+            }
+        }
+
+        bool decodeZeroRuns(const uint8_t*& data, const uint8_t* end, uint8_t* bytes, size_t count) {
+            size_t i = 0;
+
+            while (i < count) {
+                uint32_t zeroCount = 0;
+                uint32_t literalCount = 0;
+
+                if (!readVarint(data, end, zeroCount) || !readVarint(data, end, literalCount)) {
+                    return false;
+                }
+
+                if (zeroCount > maxZeroRun || zeroCount > count - i || literalCount > count - i - zeroCount
+                    || literalCount > static_cast<size_t>(end - data)) {
+                    return false;
+                }
+
+                memset(bytes + i, 0, zeroCount);
+                i += zeroCount;
+
+                memcpy(bytes + i, data, literalCount);
+                data += literalCount;
+                i += literalCount;
+            }
+
+            return true;
+        }
+
+        // 只走一遍游程记号，核对它们正好描述count个字节，不写出数据
+        bool skipZeroRuns(const uint8_t*& data, const uint8_t* end, size_t count) {
+            size_t i = 0;
+
+            while (i < count) {
+                uint32_t zeroCount = 0;
+                uint32_t literalCount = 0;
+
+                if (!readVarint(data, end, zeroCount) || !readVarint(data, end, literalCount)) {
+                    return false;
+                }
+
+                if (zeroCount > maxZeroRun || zeroCount > count - i || literalCount > count - i - zeroCount
+                    || literalCount > static_cast<size_t>(end - data)) {
+                    return false;
+                }
+
+                data += literalCount;
+                i += zeroCount + literalCount;
+            }
+
+            return true;
+        }
+    }
+
+    void encodeIndices(const uint32_t* indices, size_t indexCount, std::vector<uint8_t>& output) {
+        size_t triangleCount = indexCount / 3;
+
+        // 每个三角形一个标记字节，每个角占2位：0~2表示复用上一个三角形的第几个顶点，3表示新索引
+        size_t tagStart = output.size();
+        output.resize(tagStart + triangleCount);
+
+        uint32_t previous[3] = { 0, 0, 0 };
+        uint32_t lastLiteral = 0;
+
+        for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+            const uint32_t* corners = indices + triangle * 3;
+            uint8_t tag = 0;
+
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                uint32_t code = 3;
+
+                for (uint32_t slot = 0; slot < 3; slot++) {
+                    if (corners[corner] == previous[slot]) {
+                        code = slot;
+                        break;
+                    }
+                }
+
+                if (code == 3) {
+                    writeVarint(output, zigzag(static_cast<int32_t>(corners[corner] - lastLiteral)));
+                    lastLiteral = corners[corner];
+                }
+
+                tag |= static_cast<uint8_t>(code << (corner * 2));
+            }
+
+            output[tagStart + triangle] = tag;
+
+            previous[0] = corners[0];
+            previous[1] = corners[1];
+            previous[2] = corners[2];
+        }
+
+        // 不足一个三角形的剩余索引直接按新索引编码
+        for (size_t i = triangleCount * 3; i < indexCount; i++) {
+            writeVarint(output, zigzag(static_cast<int32_t>(indices[i] - lastLiteral)));
+            lastLiteral = indices[i];
+        }
+    }
+
+    bool decodeIndices(const uint8_t* data, size_t size, uint32_t* indices, size_t indexCount) {
+        size_t triangleCount = indexCount / 3;
+
+        if (size < triangleCount) {
+            return false;
+        }
+
+        const uint8_t* tags = data;
+        const uint8_t* literals = data + triangleCount;
+        const uint8_t* end = data + size;
+
+        // 分两遍解码：先把所有varint解成绝对索引，再逐三角形按标记选择复用的顶点或下一个新索引。
+        // 标记基本是随机的，这样两遍都没有依赖标记的分支，依赖链也只剩一次加法
+        size_t literalCount = indexCount - triangleCount * 3;
+
+        for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+            // 两位都为1的角是新索引
+            uint32_t newCorners = tags[triangle] & (tags[triangle] >> 1);
+            literalCount += (newCorners & 1) + ((newCorners >> 2) & 1) + ((newCorners >> 4) & 1);
+        }
+
+        // 每个varint至少一个字节，先检查再分配
+        if (literalCount > static_cast<size_t>(end - literals)) {
+            return false;
+        }
+
+        // 多一个元素，最后一个三角形不是新索引时也可以无条件读取values[next]
+        std::unique_ptr<uint32_t[]> values(new uint32_t[literalCount + 1]);
+        uint32_t lastLiteral = 0;
+
+        for (size_t i = 0; i < literalCount; i++) {
+            uint32_t delta = 0;
+
+            if (literals < end && *literals < 0x80) {
+                delta = *literals++;
+            }
+            else if (!readVarint(literals, end, delta)) {
+                return false;
+            }
+
+            lastLiteral += static_cast<uint32_t>(unzigzag(delta));
+            values[i] = lastLiteral;
+        }
+
+        values[literalCount] = 0;
+
+        // 前三项是上一个三角形的三个顶点，最后一项是下一个新索引
+        uint32_t candidates[4] = { 0, 0, 0, 0 };
+        size_t next = 0;
+
+        for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+            uint8_t tag = tags[triangle];
+            uint32_t* corners = indices + triangle * 3;
+
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                uint32_t code = (tag >> (corner * 2)) & 3;
+
+                // 用查表代替条件选择，编译器会把三目运算符编成分支
+                candidates[3] = values[next];
+                corners[corner] = candidates[code];
+                next += code == 3 ? 1 : 0;
+            }
+
+            candidates[0] = corners[0];
+            candidates[1] = corners[1];
+            candidates[2] = corners[2];
+        }
+
+        for (size_t i = triangleCount * 3; i < indexCount; i++) {
+            indices[i] = values[next++];
+        }
+
+        return literals == end;
+    }
+
+    void encodeVertices(const void* vertices, size_t vertexCount, size_t vertexStride, std::vector<uint8_t>& output) {
+        const uint8_t* source = reinterpret_cast<const uint8_t*>(vertices);
+        std::vector<uint8_t> plane(vertexCount);
+
+        for (size_t byteIndex = 0; byteIndex < vertexStride; byteIndex++) {
+            uint8_t previous = 0;
+
+            for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+                uint8_t value = source[vertex * vertexStride + byteIndex];
+                plane[vertex] = static_cast<uint8_t>(value - previous);
+                previous = value;
+            }
+
+            encodeZeroRuns(plane.data(), vertexCount, output);
+        }
+    }
+
+    bool decodeVertices(const uint8_t* data, size_t size, void* vertices, size_t vertexCount, size_t vertexStride) {
+        const uint8_t* end = data + size;
+        uint8_t* destination = reinterpret_cast<uint8_t*>(vertices);
+
+        // 先解出所有字节平面，再分块转置回交错的顶点布局。平面会被完整写入，不需要先清零
+        std::unique_ptr<uint8_t[]> planes(new uint8_t[vertexCount * vertexStride]);
+
+        for (size_t byteIndex = 0; byteIndex < vertexStride; byteIndex++) {
+            uint8_t* plane = planes.get() + byteIndex * vertexCount;
+
+            if (!decodeZeroRuns(data, end, plane, vertexCount)) {
+                return false;
+            }
+
+            prefixSumBytes(plane, vertexCount);
+        }
+
+        // 转置回交错的顶点布局：每次取16个顶点的4个字节平面，两轮unpack交织成
+        // 16个4字节的小段，每段正好是一个顶点中连续的4个字节
+        size_t vertex = 0;
+
+#ifdef MESH_CODEC_SSE2
+        for (; vertex + 16 <= vertexCount; vertex += 16) {
+            uint8_t* output = destination + vertex * vertexStride;
+            size_t byteIndex = 0;
+
+            for (; byteIndex + 4 <= vertexStride; byteIndex += 4) {
+                const uint8_t* plane = planes.get() + byteIndex * vertexCount + vertex;
+
+                __m128i plane0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane));
+                __m128i plane1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + vertexCount));
+                __m128i plane2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + vertexCount * 2));
+                __m128i plane3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + vertexCount * 3));
+
+                __m128i low01 = _mm_unpacklo_epi8(plane0, plane1);
+                __m128i high01 = _mm_unpackhi_epi8(plane0, plane1);
+                __m128i low23 = _mm_unpacklo_epi8(plane2, plane3);
+                __m128i high23 = _mm_unpackhi_epi8(plane2, plane3);
+
+                // 依次是顶点0~3、4~7、8~11、12~15
+                __m128i groups[4] = {
+                    _mm_unpacklo_epi16(low01, low23),
+                    _mm_unpackhi_epi16(low01, low23),
+                    _mm_unpacklo_epi16(high01, high23),
+                    _mm_unpackhi_epi16(high01, high23)
+                };
+
+                for (size_t group = 0; group < 4; group++) {
+                    uint8_t* groupOutput = output + group * 4 * vertexStride + byteIndex;
+                    __m128i values = groups[group];
+
+                    for (size_t lane = 0; lane < 4; lane++) {
+                        int32_t value = _mm_cvtsi128_si32(values);
+                        memcpy(groupOutput + lane * vertexStride, &value, sizeof(value));
+                        values = _mm_srli_si128(values, 4);
+                    }
+                }
+            }
+
+            // 顶点大小不是4的倍数时剩下的几个平面
+            for (; byteIndex < vertexStride; byteIndex++) {
+                const uint8_t* plane = planes.get() + byteIndex * vertexCount + vertex;
+
+                for (size_t lane = 0; lane < 16; lane++) {
+                    output[lane * vertexStride + byteIndex] = plane[lane];
+                }
+            }
+        }
+#endif
+
+        for (; vertex < vertexCount; vertex++) {
+            for (size_t byteIndex = 0; byteIndex < vertexStride; byteIndex++) {
+                destination[vertex * vertexStride + byteIndex] = planes[byteIndex * vertexCount + vertex];
+            }
+        }
+
+        return data == end;
+    }
+
+    std::vector<uint8_t> encodeMesh(const GeometryGenerator::MeshData& meshData) {
+        std::vector<uint8_t> vertexStream;
+        std::vector<uint8_t> indexStream;
+
+        encodeVertices(meshData.Vertices.data(), meshData.Vertices.size(), sizeof(GeometryGenerator::Vertex), vertexStream);
+        encodeIndices(meshData.Indices32.data(), meshData.Indices32.size(), indexStream);
+
+        std::vector<uint8_t> output;
+        output.reserve(28 + vertexStream.size() + indexStream.size());
+
+        writeUInt32(output, meshMagic);
+        writeUInt32(output, meshVersion);
+        writeUInt32(output, static_cast<uint32_t>(meshData.Vertices.size()));
+        writeUInt32(output, static_cast<uint32_t>(meshData.Indices32.size()));
+        writeUInt32(output, static_cast<uint32_t>(sizeof(GeometryGenerator::Vertex)));
+        writeUInt32(output, static_cast<uint32_t>(vertexStream.size()));
+        writeUInt32(output, static_cast<uint32_t>(indexStream.size()));
+
+        output.insert(output.end(), vertexStream.begin(), vertexStream.end());
+        output.insert(output.end(), indexStream.begin(), indexStream.end());
+
+        return output;
+    }
+
+    bool decodeMesh(const uint8_t* data, size_t size, GeometryGenerator::MeshData& meshData) {
+        const uint8_t* end = data + size;
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0;
+        uint32_t vertexStride = 0;
+        uint32_t vertexBytes = 0;
+        uint32_t indexBytes = 0;
+
+        if (!readUInt32(data, end, magic) || magic != meshMagic
+            || !readUInt32(data, end, version) || version != meshVersion
+            || !readUInt32(data, end, vertexCount)
+            || !readUInt32(data, end, indexCount)
+            || !readUInt32(data, end, vertexStride) || vertexStride != sizeof(GeometryGenerator::Vertex)
+            || !readUInt32(data, end, vertexBytes)
+            || !readUInt32(data, end, indexBytes)) {
+            return false;
+        }
+
+        if (static_cast<uint64_t>(vertexBytes) + indexBytes != static_cast<uint64_t>(end - data)) {
+            return false;
+        }
+
+        // 分配之前先核对头部的数量，损坏或伪造的头部不能让我们分配任意大的内存：
+        // 每个平面的游程记号至少占2个字节、最多表示maxZeroRun个零，顶点数不能超过顶点流能描述的上限；
+        // 顶点流的游程记号还必须正好覆盖每个平面；索引流每个三角形至少一个标记字节，剩余的每个索引至少一个字节
+        if (static_cast<uint64_t>(vertexCount) * vertexStride * 2 > static_cast<uint64_t>(vertexBytes) * maxZeroRun) {
+            return false;
+        }
+
+        const uint8_t* vertexData = data;
+        const uint8_t* vertexEnd = data + vertexBytes;
+
+        for (uint32_t byteIndex = 0; byteIndex < vertexStride; byteIndex++) {
+            if (!skipZeroRuns(vertexData, vertexEnd, vertexCount)) {
+                return false;
+            }
+        }
+
+        if (vertexData != vertexEnd || indexCount / 3 + indexCount % 3 > indexBytes) {
+            return false;
+        }
+
+        meshData.Vertices.resize(vertexCount);
+        meshData.Indices32.resize(indexCount);
+
+        if (!decodeVertices(data, vertexBytes, meshData.Vertices.data(), vertexCount, vertexStride)
+            || !decodeIndices(data + vertexBytes, indexBytes, meshData.Indices32.data(), indexCount)) {
+            return false;
+        }
+
+        for (uint32_t index : meshData.Indices32) {
+            if (index >= vertexCount) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
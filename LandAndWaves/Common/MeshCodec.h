@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+// 网格数据的无损压缩编解码
+// 索引：逐三角形记录每个角是否复用上一个三角形的顶点(条带感知)，
+//       其余的索引与上一个新索引做差值，再用zigzag + varint编码
+// 顶点：把顶点数组按字节平面转置，平面内做字节差分，再对零值做游程编码
+//       解码时字节差分的前缀和使用SIMD完成
+namespace MeshCodec {
+    // 编码结果以该标识开头，方便校验
+    const uint32_t meshMagic = 0x4348534d;   // "MSHC"
+    const uint32_t meshVersion = 2;
+
+    // 顶点平面中一个零值游程记号最多表示的字节数。每个记号至少占2个字节，
+    // 所以头部的顶点数最多是顶点流大小的maxZeroRun / 2倍，伪造的头部不能让解码分配任意大的内存
+    const uint32_t maxZeroRun = 256;
+
+    void encodeIndices(const uint32_t* indices, size_t indexCount, std::vector<uint8_t>& output);
+    bool decodeIndices(const uint8_t* data, size_t size, uint32_t* indices, size_t indexCount);
+
+    void encodeVertices(const void* vertices, size_t vertexCount, size_t vertexStride, std::vector<uint8_t>& output);
+    bool decodeVertices(const uint8_t* data, size_t size, void* vertices, size_t vertexCount, size_t vertexStride);
+
+    std::vector<uint8_t> encodeMesh(const GeometryGenerator::MeshData& meshData);
+    bool decodeMesh(const uint8_t* data, size_t size, GeometryGenerator::MeshData& meshData);
+}
@@ -0,0 +1,313 @@
+#include "MeshLoader.h"
+#include "MeshCodec.h"
+#include "ObjLoader.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace DirectX;
+
+namespace MeshLoader {
+    namespace {
+        void skipWhitespace(const char*& p, const char* end) {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+                p++;
+            }
+        }
+
+        // 跳到关键字之后
+        bool skipPast(const char*& p, const char* end, const char* keyword) {
+            size_t length = strlen(keyword);
+
+            for (; p + length <= end; p++) {
+                if (memcmp(p, keyword, length) == 0) {
+                    p += length;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        bool parseFloat(const char*& p, const char* end, float& value) {
+            skipWhitespace(p, end);
+
+            auto result = std::from_chars(p, end, value);
+            p = result.ptr;
+
+            return result.ec == std::errc();
+        }
+
+        bool parseUInt32(const char*& p, const char* end, uint32_t& value) {
+            skipWhitespace(p, end);
+
+            auto result = std::from_chars(p, end, value);
+            p = result.ptr;
+
+            return result.ec == std::errc();
+        }
+
+        bool parseVertex(const char*& p, const char* end, GeometryGenerator::Vertex& vertex) {
+            vertex.TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            vertex.TexC = XMFLOAT2(0.0f, 0.0f);
+
+            return parseFloat(p, end, vertex.Position.x)
+                && parseFloat(p, end, vertex.Position.y)
+                && parseFloat(p, end, vertex.Position.z)
+                && parseFloat(p, end, vertex.Normal.x)
+                && parseFloat(p, end, vertex.Normal.y)
+                && parseFloat(p, end, vertex.Normal.z);
+        }
+
+        bool parseHeader(const char*& p, const char* end, uint32_t& vertexCount, uint32_t& triangleCount) {
+            return skipPast(p, end, "VertexCount:") && parseUInt32(p, end, vertexCount)
+                && skipPast(p, end, "TriangleCount:") && parseUInt32(p, end, triangleCount);
+        }
+
+        // keyword之后"{"和"}"之间的内容，p移动到"}"之后
+        bool findSection(const char*& p, const char* end, const char* keyword, const char*& sectionBegin, const char*& sectionEnd) {
+            if (!skipPast(p, end, keyword) || !skipPast(p, end, "{")) {
+                return false;
+            }
+
+            const char* closing = reinterpret_cast<const char*>(memchr(p, '}', end - p));
+
+            if (closing == nullptr) {
+                return false;
+            }
+
+            sectionBegin = p;
+            sectionEnd = closing;
+            p = closing + 1;
+
+            return true;
+        }
+
+        // 把[begin, end)按换行切成chunkCount块，返回chunkCount + 1个边界
+        std::vector<const char*> splitAtLines(const char* begin, const char* end, uint32_t chunkCount) {
+            std::vector<const char*> bounds(chunkCount + 1, end);
+            bounds[0] = begin;
+
+            size_t step = (end - begin) / chunkCount;
+
+            for (uint32_t chunk = 1; chunk < chunkCount; chunk++) {
+                const char* p = std::max(bounds[chunk - 1], begin + chunk * step);
+                const char* newline = reinterpret_cast<const char*>(memchr(p, '\n', end - p));
+
+                bounds[chunk] = newline != nullptr ? newline + 1 : end;
+            }
+
+            return bounds;
+        }
+
+        // 非空行的数量，每一行是一条记录(一个顶点或者一个三角形)
+        size_t countLines(const char* begin, const char* end) {
+            size_t count = 0;
+            bool blank = true;
+
+            for (const char* p = begin; p < end; p++) {
+                if (*p == '\n') {
+                    count += blank ? 0 : 1;
+                    blank = true;
+                }
+                else if (*p != ' ' && *p != '\t' && *p != '\r') {
+                    blank = false;
+                }
+            }
+
+            return count + (blank ? 0 : 1);
+        }
+
+        // 每块先数出自己的记录数，前缀和得到在输出数组中的起始位置，再各自解析到自己的区间。
+        // 写入位置与分块方式无关，所以结果和串行解析完全一致。
+        // 块内的数值数量不正好等于记录数 * valuesPerRecord时(比如一行写了多条记录)返回false
+        template<typename ParseRecord>
+        bool parseSectionParallel(const char* begin, const char* end, size_t recordCount, uint32_t workers, ParseRecord&& parseRecord) {
+            auto bounds = splitAtLines(begin, end, workers);
+
+            std::vector<size_t> offsets(workers + 1, 0);
+
+            Parallel::forEachRange(workers, workers, [&](size_t chunkBegin, size_t chunkEnd, uint32_t) {
+                for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+                    offsets[chunk + 1] = countLines(bounds[chunk], bounds[chunk + 1]);
+                }
+            });
+
+            for (uint32_t chunk = 0; chunk < workers; chunk++) {
+                offsets[chunk + 1] += offsets[chunk];
+            }
+
+            if (offsets[workers] != recordCount) {
+                return false;
+            }
+
+            std::vector<uint8_t> succeeded(workers, 0);
+
+            Parallel::forEachRange(workers, workers, [&](size_t chunkBegin, size_t chunkEnd, uint32_t) {
+                for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+                    const char* p = bounds[chunk];
+                    const char* chunkEndPtr = bounds[chunk + 1];
+                    bool ok = true;
+
+                    for (size_t record = offsets[chunk]; ok && record < offsets[chunk + 1]; record++) {
+                        ok = parseRecord(p, chunkEndPtr, record);
+                    }
+
+                    skipWhitespace(p, chunkEndPtr);
+                    succeeded[chunk] = ok && p == chunkEndPtr;
+                }
+            });
+
+            return std::all_of(succeeded.begin(), succeeded.end(), [](uint8_t ok) { return ok != 0; });
+        }
+    }
+
+    bool parseSkullText(const char* begin, const char* end, GeometryGenerator::MeshData& meshData) {
+        const char* p = begin;
+
+        uint32_t vertexCount = 0;
+        uint32_t triangleCount = 0;
+
+        if (!parseHeader(p, end, vertexCount, triangleCount)) {
+            return false;
+        }
+
+        meshData.Vertices.resize(vertexCount);
+        meshData.Indices32.resize(static_cast<size_t>(triangleCount) * 3);
+
+        if (!skipPast(p, end, "VertexList") || !skipPast(p, end, "{")) {
+            return false;
+        }
+
+        for (auto& vertex : meshData.Vertices) {
+            if (!parseVertex(p, end, vertex)) {
+                return false;
+            }
+        }
+
+        if (!skipPast(p, end, "TriangleList") || !skipPast(p, end, "{")) {
+            return false;
+        }
+
+        for (auto& index : meshData.Indices32) {
+            if (!parseUInt32(p, end, index) || index >= vertexCount) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool parseSkullTextParallel(const char* begin, const char* end, GeometryGenerator::MeshData& meshData, uint32_t workers) {
+        const char* p = begin;
+
+        uint32_t vertexCount = 0;
+        uint32_t triangleCount = 0;
+
+        const char* vertexBegin = nullptr;
+        const char* vertexEnd = nullptr;
+        const char* triangleBegin = nullptr;
+        const char* triangleEnd = nullptr;
+
+        if (!parseHeader(p, end, vertexCount, triangleCount)
+            || !findSection(p, end, "VertexList", vertexBegin, vertexEnd)
+            || !findSection(p, end, "TriangleList", triangleBegin, triangleEnd)) {
+            return false;
+        }
+
+        if (workers == 0) {
+            workers = Parallel::workerCount(end - begin, parallelMinBytesPerWorker);
+        }
+
+        if (workers <= 1) {
+            return parseSkullText(begin, end, meshData);
+        }
+
+        meshData.Vertices.resize(vertexCount);
+        meshData.Indices32.resize(static_cast<size_t>(triangleCount) * 3);
+
+        auto* vertices = meshData.Vertices.data();
+        auto* indices = meshData.Indices32.data();
+
+        bool parsed = parseSectionParallel(vertexBegin, vertexEnd, vertexCount, workers,
+            [vertices](const char*& p, const char* end, size_t record) {
+                return parseVertex(p, end, vertices[record]);
+            })
+            && parseSectionParallel(triangleBegin, triangleEnd, triangleCount, workers,
+            [indices, vertexCount](const char*& p, const char* end, size_t record) {
+                uint32_t* triangle = indices + record * 3;
+
+                return parseUInt32(p, end, triangle[0]) && triangle[0] < vertexCount
+                    && parseUInt32(p, end, triangle[1]) && triangle[1] < vertexCount
+                    && parseUInt32(p, end, triangle[2]) && triangle[2] < vertexCount;
+            });
+
+        // 不是一行一条记录的排版无法按行定位，交给串行解析
+        return parsed || parseSkullText(begin, end, meshData);
+    }
+
+    namespace {
+        bool readFile(const std::string& fileName, std::vector<char>& buffer) {
+            std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+
+            if (!file) {
+                return false;
+            }
+
+            std::streamsize size = file.tellg();
+            file.seekg(0, std::ios::beg);
+
+            buffer.resize(static_cast<size_t>(size));
+
+            return static_cast<bool>(file.read(buffer.data(), size));
+        }
+
+        bool hasExtension(const std::string& fileName, const char* extension) {
+            size_t length = strlen(extension);
+
+            if (fileName.size() < length) {
+                return false;
+            }
+
+            return std::equal(fileName.end() - length, fileName.end(), extension, [](char a, char b) {
+                return tolower(static_cast<unsigned char>(a)) == b;
+            });
+        }
+    }
+
+    bool loadSkullText(const std::string& fileName, GeometryGenerator::MeshData& meshData) {
+        std::vector<char> buffer;
+
+        if (!readFile(fileName, buffer)) {
+            return false;
+        }
+
+        // 小文件时parseSkullTextParallel会自己退回单线程
+        return parseSkullTextParallel(buffer.data(), buffer.data() + buffer.size(), meshData);
+    }
+
+    bool loadMeshFile(const std::string& fileName, GeometryGenerator::MeshData& meshData) {
+        // 按材质划分的范围在这里用不到，整个模型作为一个网格
+        if (hasExtension(fileName, ".obj")) {
+            std::vector<ObjLoader::Submesh> submeshes;
+            return ObjLoader::load(fileName, meshData, submeshes);
+        }
+
+        if (!hasExtension(fileName, ".mshc")) {
+            return loadSkullText(fileName, meshData);
+        }
+
+        std::vector<char> buffer;
+
+        if (!readFile(fileName, buffer)) {
+            return false;
+        }
+
+        return MeshCodec::decodeMesh(reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size(), meshData);
+    }
+}
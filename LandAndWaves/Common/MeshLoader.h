@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "GeometryGenerator.h"
+
+// 文本网格(Models/skull.txt格式)的加载
+//
+// VertexCount: 31076
+// TriangleCount: 60339
+// VertexList (pos, normal)
+// {
+//     px py pz nx ny nz
+//     ...
+// }
+// TriangleList
+// {
+//     i0 i1 i2
+//     ...
+// }
+namespace MeshLoader {
+    // 直接在内存中扫描文本，用std::from_chars解析数值并写入预先分配好的顶点/索引数组，
+    // 整个过程除了这两个数组之外没有任何堆分配
+    bool parseSkullText(const char* begin, const char* end, GeometryGenerator::MeshData& meshData);
+
+    // 每个线程至少分到这么多字节才值得并行
+    const size_t parallelMinBytesPerWorker = 1 << 20;
+
+    // 并行解析：VertexList和TriangleList按换行切块，每个线程解析一块并直接写入
+    // 由头部VertexCount/TriangleCount预先分配好的数组中属于自己的区间。
+    // 结果与parseSkullText完全相同，与线程数无关。workers为0时按文件大小自动决定
+    bool parseSkullTextParallel(const char* begin, const char* end, GeometryGenerator::MeshData& meshData, uint32_t workers = 0);
+
+    // 一次性把文件读入一块缓冲区后解析
+    bool loadSkullText(const std::string& fileName, GeometryGenerator::MeshData& meshData);
+
+    // 按扩展名选择格式：.mshc是MeshCodec压缩过的二进制网格，.obj由ObjLoader导入，其余按上面的文本格式解析
+    bool loadMeshFile(const std::string& fileName, GeometryGenerator::MeshData& meshData);
+}
@@ -0,0 +1,530 @@
+#include "MeshProcessing.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace MeshProcessing {
+    namespace {
+        // 格子边长是positionEpsilon的倍数。格子比epsilon大得多时，大部分顶点离格子边界都超过epsilon，
+        // 只需要查本格；离边界不超过epsilon的那个轴才需要再查那一侧的相邻格子，最多2x2x2个格子
+        const double cellSizeInEpsilons = 8.0;
+
+        // 位置所在的空间哈希格子
+        struct WeldCell {
+            int64_t coordinates[3];
+            // 每个轴上需要探测的相邻格子的方向：-1或+1，离两侧边界都超过epsilon时为0
+            int8_t nearSide[3];
+            // 坐标不是有限值或者量化后超出范围时为false，这样的顶点不参与焊接
+            bool valid;
+        };
+
+        // 量化后的格子坐标必须能被double精确表示，远大于任何实际场景的范围
+        const double maxCellCoordinate = 4503599627370496.0;   // 2^52
+
+        bool quantize(float value, double inverseCellSize, int64_t& coordinate, int8_t& nearSide) {
+            double scaled = static_cast<double>(value) * inverseCellSize;
+
+            // 同时拒绝NaN和无穷大
+            if (!(std::fabs(scaled) < maxCellCoordinate)) {
+                return false;
+            }
+
+            double cell = std::floor(scaled);
+            double fraction = (scaled - cell) * cellSizeInEpsilons;
+            coordinate = static_cast<int64_t>(cell);
+            nearSide = fraction <= 1.0 ? -1 : (fraction >= cellSizeInEpsilons - 1.0 ? 1 : 0);
+
+            return true;
+        }
+
+        WeldCell makeWeldCell(const XMFLOAT3& position, double inverseCellSize) {
+            WeldCell cell = {};
+            cell.valid = quantize(position.x, inverseCellSize, cell.coordinates[0], cell.nearSide[0])
+                && quantize(position.y, inverseCellSize, cell.coordinates[1], cell.nearSide[1])
+                && quantize(position.z, inverseCellSize, cell.coordinates[2], cell.nearSide[2]);
+
+            return cell;
+        }
+
+        uint64_t hashCell(int64_t x, int64_t y, int64_t z) {
+            uint64_t hash = static_cast<uint64_t>(x) * 0x9e3779b97f4a7c15ull
+                ^ static_cast<uint64_t>(y) * 0xc2b2ae3d27d4eb4full
+                ^ static_cast<uint64_t>(z) * 0x165667b19e3779f9ull;
+
+            return hash ^ (hash >> 32);
+        }
+
+        bool nearlyEqual(float a, float b, float epsilon) {
+            return std::fabs(a - b) <= epsilon;
+        }
+
+        // 切线不参与比较，导入的网格往往没有填充切线
+        bool isDuplicate(const GeometryGenerator::Vertex& a, const GeometryGenerator::Vertex& b, const WeldOptions& options) {
+            if (!nearlyEqual(a.Position.x, b.Position.x, options.positionEpsilon)
+                || !nearlyEqual(a.Position.y, b.Position.y, options.positionEpsilon)
+                || !nearlyEqual(a.Position.z, b.Position.z, options.positionEpsilon)) {
+                return false;
+            }
+
+            if (!options.compareAttributes) {
+                return true;
+            }
+
+            return nearlyEqual(a.Normal.x, b.Normal.x, options.attributeEpsilon)
+                && nearlyEqual(a.Normal.y, b.Normal.y, options.attributeEpsilon)
+                && nearlyEqual(a.Normal.z, b.Normal.z, options.attributeEpsilon)
+                && nearlyEqual(a.TexC.x, b.TexC.x, options.attributeEpsilon)
+                && nearlyEqual(a.TexC.y, b.TexC.y, options.attributeEpsilon);
+        }
+
+        // 与硬件线程数无关的分片数，保证浮点累加顺序(也就是结果)在任何机器上都一致
+        size_t sliceCount(size_t triangleCount) {
+            const size_t trianglesPerSlice = 8192;
+            const size_t maxSlices = 16;
+
+            return std::min(maxSlices, triangleCount / trianglesPerSlice + 1);
+        }
+
+        struct TangentSum {
+            XMFLOAT3 tangent;
+            XMFLOAT3 bitangent;
+        };
+
+        float angleBetween(float ax, float ay, float az, float bx, float by, float bz) {
+            float lengths = std::sqrt((ax * ax + ay * ay + az * az) * (bx * bx + by * by + bz * bz));
+
+            if (lengths <= 0.0f) {
+                return 0.0f;
+            }
+
+            float cosine = (ax * bx + ay * by + az * bz) / lengths;
+
+            return std::acos(std::max(-1.0f, std::min(1.0f, cosine)));
+        }
+
+        // 没有有效纹理坐标时，取一个与法线垂直的任意方向作为切线
+        XMFLOAT3 anyPerpendicular(const XMFLOAT3& normal) {
+            XMFLOAT3 axis = std::fabs(normal.x) < 0.9f ? XMFLOAT3(1.0f, 0.0f, 0.0f) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+
+            float d = axis.x * normal.x + axis.y * normal.y + axis.z * normal.z;
+            float x = axis.x - normal.x * d;
+            float y = axis.y - normal.y * d;
+            float z = axis.z - normal.z * d;
+            float length = std::sqrt(x * x + y * y + z * z);
+
+            return XMFLOAT3(x / length, y / length, z / length);
+        }
+
+        // 纹理坐标在三角形上的朝向：镜像UV的三角形行列式为负
+        int uvWinding(const GeometryGenerator::Vertex& v0, const GeometryGenerator::Vertex& v1, const GeometryGenerator::Vertex& v2) {
+            float du1 = v1.TexC.x - v0.TexC.x, dv1 = v1.TexC.y - v0.TexC.y;
+            float du2 = v2.TexC.x - v0.TexC.x, dv2 = v2.TexC.y - v0.TexC.y;
+            float determinant = du1 * dv2 - du2 * dv1;
+
+            if (std::fabs(determinant) < 1.0e-12f) {
+                return 0;
+            }
+
+            return determinant < 0.0f ? -1 : 1;
+        }
+
+        // 被朝向相反的三角形共用的顶点(镜像UV的接缝)复制一份给朝向为负的三角形，
+        // 这样每个顶点只属于一种手性，切线和副切线不会在接缝处互相抵消
+        size_t splitMirroredVertices(GeometryGenerator::MeshData& meshData) {
+            auto& vertices = meshData.Vertices;
+            auto& indices = meshData.Indices32;
+
+            size_t vertexCount = vertices.size();
+            size_t triangleCount = indices.size() / 3;
+
+            // 第0位：被朝向为正的三角形使用，第1位：被朝向为负的三角形使用
+            std::vector<uint8_t> windings(vertexCount, 0);
+            std::vector<int8_t> triangleWindings(triangleCount);
+
+            for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+                const uint32_t* corners = &indices[triangle * 3];
+                int winding = uvWinding(vertices[corners[0]], vertices[corners[1]], vertices[corners[2]]);
+
+                triangleWindings[triangle] = static_cast<int8_t>(winding);
+
+                if (winding != 0) {
+                    for (uint32_t corner = 0; corner < 3; corner++) {
+                        windings[corners[corner]] |= winding > 0 ? 1 : 2;
+                    }
+                }
+            }
+
+            const uint32_t noMirror = UINT32_MAX;
+            std::vector<uint32_t> mirrors(vertexCount, noMirror);
+
+            for (size_t i = 0; i < vertexCount; i++) {
+                if (windings[i] == 3) {
+                    mirrors[i] = static_cast<uint32_t>(vertices.size());
+                    vertices.push_back(vertices[i]);
+                }
+            }
+
+            for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+                if (triangleWindings[triangle] >= 0) {
+                    continue;
+                }
+
+                for (uint32_t corner = 0; corner < 3; corner++) {
+                    uint32_t& index = indices[triangle * 3 + corner];
+
+                    if (mirrors[index] != noMirror) {
+                        index = mirrors[index];
+                    }
+                }
+            }
+
+            return vertices.size() - vertexCount;
+        }
+
+        uint32_t packUnorm10(float value) {
+            float clamped = std::max(0.0f, std::min(1.0f, value * 0.5f + 0.5f));
+
+            return static_cast<uint32_t>(clamped * 1023.0f + 0.5f);
+        }
+    }
+
+    void weldVertices(const std::vector<GeometryGenerator::Vertex>& vertices,
+                      const WeldOptions& options,
+                      std::vector<uint32_t>& remap,
+                      std::vector<GeometryGenerator::Vertex>& weldedVertices) {
+        size_t vertexCount = vertices.size();
+        double inverseCellSize = 1.0 / (cellSizeInEpsilons * options.positionEpsilon);
+
+        size_t bucketCount = 1;
+
+        while (bucketCount < vertexCount) {
+            bucketCount <<= 1;
+        }
+
+        auto bucketOf = [bucketCount](int64_t x, int64_t y, int64_t z) {
+            return static_cast<uint32_t>(hashCell(x, y, z) & (bucketCount - 1));
+        };
+
+        // 第一步：并行计算每个顶点所在格子的哈希桶，不参与焊接的顶点记为invalidBucket
+        const uint32_t invalidBucket = UINT32_MAX;
+        std::vector<uint32_t> buckets(vertexCount);
+
+        uint32_t workers = Parallel::workerCount(vertexCount, 4096);
+
+        Parallel::forEachRange(vertexCount, workers, [&](size_t begin, size_t end, uint32_t) {
+            for (size_t i = begin; i < end; i++) {
+                WeldCell cell = makeWeldCell(vertices[i].Position, inverseCellSize);
+                buckets[i] = cell.valid ? bucketOf(cell.coordinates[0], cell.coordinates[1], cell.coordinates[2]) : invalidBucket;
+            }
+        });
+
+        // 第二步：把顶点计数排序到桶里，只遍历一次。
+        // 每个桶内的顶点保持原来的顺序，bucketStart[b]到bucketStart[b + 1]是桶b的顶点
+        std::vector<uint32_t> bucketStart(bucketCount + 1, 0);
+        std::vector<uint32_t> bucketVertices(vertexCount);
+
+        for (size_t i = 0; i < vertexCount; i++) {
+            if (buckets[i] != invalidBucket) {
+                bucketStart[buckets[i] + 1]++;
+            }
+        }
+
+        for (size_t bucket = 0; bucket < bucketCount; bucket++) {
+            bucketStart[bucket + 1] += bucketStart[bucket];
+        }
+
+        {
+            std::vector<uint32_t> cursor(bucketStart.begin(), bucketStart.end() - 1);
+
+            for (size_t i = 0; i < vertexCount; i++) {
+                if (buckets[i] != invalidBucket) {
+                    bucketVertices[cursor[buckets[i]]++] = static_cast<uint32_t>(i);
+                }
+            }
+        }
+
+        // 第三步：并行地为每个顶点在本格和需要探测的相邻格子里找下标最小的重复顶点。
+        // 桶里可能混有哈希冲突的其他格子的顶点，但只要与当前顶点重复就是合法的结果，不需要再比较格子坐标。
+        // 只读共享数据，结果与线程数无关
+        std::vector<uint32_t> representative(vertexCount);
+
+        Parallel::forEachRange(vertexCount, workers, [&](size_t begin, size_t end, uint32_t) {
+            for (size_t i = begin; i < end; i++) {
+                uint32_t best = static_cast<uint32_t>(i);
+                WeldCell cell = makeWeldCell(vertices[i].Position, inverseCellSize);
+
+                for (uint32_t probe = 0; cell.valid && probe < 8; probe++) {
+                    // 不需要探测的轴上只保留偏移为0的组合
+                    if (((probe & 1) && cell.nearSide[0] == 0) || ((probe & 2) && cell.nearSide[1] == 0) || ((probe & 4) && cell.nearSide[2] == 0)) {
+                        continue;
+                    }
+
+                    uint32_t bucket = bucketOf(
+                        cell.coordinates[0] + ((probe & 1) ? cell.nearSide[0] : 0),
+                        cell.coordinates[1] + ((probe & 2) ? cell.nearSide[1] : 0),
+                        cell.coordinates[2] + ((probe & 4) ? cell.nearSide[2] : 0));
+
+                    // 桶内按下标递增，遇到第一个重复顶点或者不小于当前最优的下标就可以停止
+                    for (uint32_t k = bucketStart[bucket]; k < bucketStart[bucket + 1]; k++) {
+                        uint32_t j = bucketVertices[k];
+
+                        if (j >= best) {
+                            break;
+                        }
+
+                        if (isDuplicate(vertices[i], vertices[j], options)) {
+                            best = j;
+                            break;
+                        }
+                    }
+                }
+
+                representative[i] = best;
+            }
+        });
+
+        // 第四步：按首次出现的顺序压缩顶点缓冲区。representative[i] <= i，
+        // 顺着它走到的第一个顶点已经处理过，所以相互重复的一串顶点会合并到其中最早的一个
+        remap.resize(vertexCount);
+        weldedVertices.clear();
+        weldedVertices.reserve(vertexCount);
+
+        for (size_t i = 0; i < vertexCount; i++) {
+            if (representative[i] == i) {
+                remap[i] = static_cast<uint32_t>(weldedVertices.size());
+                weldedVertices.push_back(vertices[i]);
+            }
+            else {
+                remap[i] = remap[representative[i]];
+            }
+        }
+    }
+
+    void remapIndices(std::vector<uint32_t>& indices, const std::vector<uint32_t>& remap) {
+        for (auto& index : indices) {
+            index = remap[index];
+        }
+    }
+
+    size_t weldMesh(GeometryGenerator::MeshData& meshData, const WeldOptions& options) {
+        std::vector<uint32_t> remap;
+        std::vector<GeometryGenerator::Vertex> weldedVertices;
+
+        weldVertices(meshData.Vertices, options, remap, weldedVertices);
+        remapIndices(meshData.Indices32, remap);
+
+        size_t removedCount = meshData.Vertices.size() - weldedVertices.size();
+        meshData.Vertices = std::move(weldedVertices);
+
+        return removedCount;
+    }
+
+    bool hasNormals(const GeometryGenerator::MeshData& meshData) {
+        for (const auto& vertex : meshData.Vertices) {
+            if (vertex.Normal.x != 0.0f || vertex.Normal.y != 0.0f || vertex.Normal.z != 0.0f) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void computeNormals(GeometryGenerator::MeshData& meshData) {
+        auto& vertices = meshData.Vertices;
+        const auto& indices = meshData.Indices32;
+
+        size_t vertexCount = vertices.size();
+        size_t triangleCount = indices.size() / 3;
+        size_t slices = sliceCount(triangleCount);
+
+        // 每个分片一份累加缓冲区，三角形之间不需要任何同步
+        std::vector<std::vector<XMFLOAT3>> sums(slices, std::vector<XMFLOAT3>(vertexCount, XMFLOAT3(0.0f, 0.0f, 0.0f)));
+
+        Parallel::forEachRange(slices, Parallel::workerCount(slices, 1), [&](size_t sliceBegin, size_t sliceEnd, uint32_t) {
+            for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+                size_t begin = triangleCount * slice / slices;
+                size_t end = triangleCount * (slice + 1) / slices;
+                auto& sum = sums[slice];
+
+                for (size_t triangle = begin; triangle < end; triangle++) {
+                    uint32_t i0 = indices[triangle * 3];
+                    uint32_t i1 = indices[triangle * 3 + 1];
+                    uint32_t i2 = indices[triangle * 3 + 2];
+
+                    const XMFLOAT3& p0 = vertices[i0].Position;
+                    const XMFLOAT3& p1 = vertices[i1].Position;
+                    const XMFLOAT3& p2 = vertices[i2].Position;
+
+                    float e0x = p1.x - p0.x, e0y = p1.y - p0.y, e0z = p1.z - p0.z;
+                    float e1x = p2.x - p0.x, e1y = p2.y - p0.y, e1z = p2.z - p0.z;
+
+                    // 叉积的长度是三角形面积的两倍，不归一化直接累加即为面积加权
+                    float nx = e0y * e1z - e0z * e1y;
+                    float ny = e0z * e1x - e0x * e1z;
+                    float nz = e0x * e1y - e0y * e1x;
+
+                    for (uint32_t index : { i0, i1, i2 }) {
+                        sum[index].x += nx;
+                        sum[index].y += ny;
+                        sum[index].z += nz;
+                    }
+                }
+            }
+        });
+
+        // 归约：按分片顺序相加后归一化
+        Parallel::forEachRange(vertexCount, Parallel::workerCount(vertexCount, 4096), [&](size_t begin, size_t end, uint32_t) {
+            for (size_t i = begin; i < end; i++) {
+                float x = 0.0f, y = 0.0f, z = 0.0f;
+
+                for (size_t slice = 0; slice < slices; slice++) {
+                    x += sums[slice][i].x;
+                    y += sums[slice][i].y;
+                    z += sums[slice][i].z;
+                }
+
+                float length = std::sqrt(x * x + y * y + z * z);
+
+                if (length > 0.0f) {
+                    vertices[i].Normal = XMFLOAT3(x / length, y / length, z / length);
+                }
+                else {
+                    vertices[i].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+                }
+            }
+        });
+    }
+
+    uint32_t packTangent(const XMFLOAT3& tangent, float handedness) {
+        return packUnorm10(tangent.x)
+            | (packUnorm10(tangent.y) << 10)
+            | (packUnorm10(tangent.z) << 20)
+            | ((handedness < 0.0f ? 0u : 1u) << 30);
+    }
+
+    void unpackTangent(uint32_t packedTangent, XMFLOAT3& tangent, float& handedness) {
+        tangent.x = (packedTangent & 0x3ff) / 1023.0f * 2.0f - 1.0f;
+        tangent.y = ((packedTangent >> 10) & 0x3ff) / 1023.0f * 2.0f - 1.0f;
+        tangent.z = ((packedTangent >> 20) & 0x3ff) / 1023.0f * 2.0f - 1.0f;
+        handedness = ((packedTangent >> 30) & 0x3) ? 1.0f : -1.0f;
+    }
+
+    size_t computeTangents(GeometryGenerator::MeshData& meshData, std::vector<uint32_t>* packedTangents) {
+        size_t splitCount = splitMirroredVertices(meshData);
+
+        auto& vertices = meshData.Vertices;
+        const auto& indices = meshData.Indices32;
+
+        size_t vertexCount = vertices.size();
+        size_t triangleCount = indices.size() / 3;
+        size_t slices = sliceCount(triangleCount);
+
+        TangentSum zero = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) };
+        std::vector<std::vector<TangentSum>> sums(slices, std::vector<TangentSum>(vertexCount, zero));
+
+        Parallel::forEachRange(slices, Parallel::workerCount(slices, 1), [&](size_t sliceBegin, size_t sliceEnd, uint32_t) {
+            for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+                size_t begin = triangleCount * slice / slices;
+                size_t end = triangleCount * (slice + 1) / slices;
+                auto& sum = sums[slice];
+
+                for (size_t triangle = begin; triangle < end; triangle++) {
+                    uint32_t corners[3] = { indices[triangle * 3], indices[triangle * 3 + 1], indices[triangle * 3 + 2] };
+
+                    const auto& v0 = vertices[corners[0]];
+                    const auto& v1 = vertices[corners[1]];
+                    const auto& v2 = vertices[corners[2]];
+
+                    float e1x = v1.Position.x - v0.Position.x, e1y = v1.Position.y - v0.Position.y, e1z = v1.Position.z - v0.Position.z;
+                    float e2x = v2.Position.x - v0.Position.x, e2y = v2.Position.y - v0.Position.y, e2z = v2.Position.z - v0.Position.z;
+
+                    float du1 = v1.TexC.x - v0.TexC.x, dv1 = v1.TexC.y - v0.TexC.y;
+                    float du2 = v2.TexC.x - v0.TexC.x, dv2 = v2.TexC.y - v0.TexC.y;
+
+                    float determinant = du1 * dv2 - du2 * dv1;
+
+                    // 纹理坐标退化的三角形不贡献切线
+                    if (std::fabs(determinant) < 1.0e-12f) {
+                        continue;
+                    }
+
+                    float r = 1.0f / determinant;
+
+                    XMFLOAT3 tangent((e1x * dv2 - e2x * dv1) * r, (e1y * dv2 - e2y * dv1) * r, (e1z * dv2 - e2z * dv1) * r);
+                    XMFLOAT3 bitangent((e2x * du1 - e1x * du2) * r, (e2y * du1 - e1y * du2) * r, (e2z * du1 - e1z * du2) * r);
+
+                    // 每个角按其内角加权，和MikkTSpace一致
+                    for (uint32_t corner = 0; corner < 3; corner++) {
+                        const auto& p = vertices[corners[corner]].Position;
+                        const auto& a = vertices[corners[(corner + 1) % 3]].Position;
+                        const auto& b = vertices[corners[(corner + 2) % 3]].Position;
+
+                        float weight = angleBetween(a.x - p.x, a.y - p.y, a.z - p.z, b.x - p.x, b.y - p.y, b.z - p.z);
+
+                        auto& target = sum[corners[corner]];
+                        target.tangent.x += tangent.x * weight;
+                        target.tangent.y += tangent.y * weight;
+                        target.tangent.z += tangent.z * weight;
+                        target.bitangent.x += bitangent.x * weight;
+                        target.bitangent.y += bitangent.y * weight;
+                        target.bitangent.z += bitangent.z * weight;
+                    }
+                }
+            }
+        });
+
+        if (packedTangents != nullptr) {
+            packedTangents->resize(vertexCount);
+        }
+
+        Parallel::forEachRange(vertexCount, Parallel::workerCount(vertexCount, 4096), [&](size_t begin, size_t end, uint32_t) {
+            for (size_t i = begin; i < end; i++) {
+                XMFLOAT3 t(0.0f, 0.0f, 0.0f);
+                XMFLOAT3 b(0.0f, 0.0f, 0.0f);
+
+                for (size_t slice = 0; slice < slices; slice++) {
+                    t.x += sums[slice][i].tangent.x;
+                    t.y += sums[slice][i].tangent.y;
+                    t.z += sums[slice][i].tangent.z;
+                    b.x += sums[slice][i].bitangent.x;
+                    b.y += sums[slice][i].bitangent.y;
+                    b.z += sums[slice][i].bitangent.z;
+                }
+
+                const XMFLOAT3& n = vertices[i].Normal;
+
+                // Gram-Schmidt：去掉切线在法线方向上的分量
+                float d = n.x * t.x + n.y * t.y + n.z * t.z;
+                t.x -= n.x * d;
+                t.y -= n.y * d;
+                t.z -= n.z * d;
+
+                float length = std::sqrt(t.x * t.x + t.y * t.y + t.z * t.z);
+
+                if (length > 1.0e-8f) {
+                    t = XMFLOAT3(t.x / length, t.y / length, t.z / length);
+                }
+                else {
+                    t = anyPerpendicular(n);
+                }
+
+                // cross(n, t)与累加的副切线同向为右手系
+                float cx = n.y * t.z - n.z * t.y;
+                float cy = n.z * t.x - n.x * t.z;
+                float cz = n.x * t.y - n.y * t.x;
+                float handedness = (cx * b.x + cy * b.y + cz * b.z) < 0.0f ? -1.0f : 1.0f;
+
+                vertices[i].TangentU = t;
+
+                if (packedTangents != nullptr) {
+                    (*packedTangents)[i] = packTangent(t, handedness);
+                }
+            }
+        });
+
+        return splitCount;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+// 导入网格的后处理：顶点焊接、法线重建
+namespace MeshProcessing {
+    struct WeldOptions {
+        // 位置的每个分量相差不超过positionEpsilon，且法线和纹理坐标的每个分量
+        // 相差不超过attributeEpsilon的顶点被视为重复顶点
+        float positionEpsilon = 1.0e-5f;
+        float attributeEpsilon = 1.0e-3f;
+
+        // 为false时只比较位置(用于随后要重建法线的网格)
+        bool compareAttributes = true;
+    };
+
+    // 使用空间哈希并行地合并重复顶点，会探测相邻的格子，跨越格子边界的重复顶点也能合并。
+    // 坐标不是有限值或者大到无法量化的顶点保持原样，不参与焊接
+    // remap[i]是原顶点i在weldedVertices中的索引，weldedVertices保持首次出现的顺序
+    void weldVertices(const std::vector<GeometryGenerator::Vertex>& vertices,
+                      const WeldOptions& options,
+                      std::vector<uint32_t>& remap,
+                      std::vector<GeometryGenerator::Vertex>& weldedVertices);
+
+    void remapIndices(std::vector<uint32_t>& indices, const std::vector<uint32_t>& remap);
+
+    // 对网格执行焊接并重写索引，返回被合并掉的顶点数
+    size_t weldMesh(GeometryGenerator::MeshData& meshData, const WeldOptions& options = WeldOptions());
+
+    // 所有法线都是零向量时视为缺失法线
+    bool hasNormals(const GeometryGenerator::MeshData& meshData);
+
+    // 按面积加权重建顶点法线：每个线程累加自己负责的三角形，最后按固定顺序归约
+    void computeNormals(GeometryGenerator::MeshData& meshData);
+
+    // 把单位切线和手性打包成一个R10G10B10A2_UNORM：xyz映射到[0, 1]，w为1表示+1，0表示-1
+    uint32_t packTangent(const DirectX::XMFLOAT3& tangent, float handedness);
+    void unpackTangent(uint32_t packedTangent, DirectX::XMFLOAT3& tangent, float& handedness);
+
+    // 按MikkTSpace的做法由纹理坐标生成切线：先在镜像UV的接缝处按纹理坐标的朝向拆分顶点，
+    // 保证每个顶点只有一种手性；再逐三角形计算切线和副切线，按角度加权累加，
+    // 最后对法线做Gram-Schmidt正交化，手性由副切线方向决定。
+    // MikkTSpace还会按切线夹角进一步拆分顶点，这里没有做，所以平滑组内切线变化剧烈时结果会略有不同。
+    // 拆分会在Vertices末尾追加顶点并改写Indices32，返回追加的顶点数。
+    // 结果写入TangentU，packedTangents不为空时同时输出打包后的切线和手性
+    size_t computeTangents(GeometryGenerator::MeshData& meshData, std::vector<uint32_t>* packedTangents = nullptr);
+}
@@ -0,0 +1,332 @@
+#include "ObjLoader.h"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace ObjLoader {
+    namespace {
+        // 已经转换成从0开始的索引，缺失的分量为UINT32_MAX
+        struct VertexKey {
+            uint32_t position;
+            uint32_t texC;
+            uint32_t normal;
+
+            bool operator==(const VertexKey& other) const {
+                return position == other.position && texC == other.texC && normal == other.normal;
+            }
+        };
+
+        struct VertexKeyHash {
+            size_t operator()(const VertexKey& key) const {
+                uint64_t hash = 14695981039346656037ull;
+
+                hash = (hash ^ key.position) * 1099511628211ull;
+                hash = (hash ^ key.texC) * 1099511628211ull;
+                hash = (hash ^ key.normal) * 1099511628211ull;
+
+                return static_cast<size_t>(hash ^ (hash >> 32));
+            }
+        };
+
+        const uint32_t missingIndex = UINT32_MAX;
+
+        bool isSpace(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        void skipSpaces(const char*& p, const char* end) {
+            while (p < end && isSpace(*p)) {
+                p++;
+            }
+        }
+
+        bool parseFloat(const char*& p, const char* end, float& value) {
+            skipSpaces(p, end);
+
+            auto result = std::from_chars(p, end, value);
+            p = result.ptr;
+
+            return result.ec == std::errc();
+        }
+
+        // OBJ的索引从1开始，负数表示相对于当前已读取元素的末尾
+        bool resolveIndex(const char*& p, const char* end, size_t elementCount, uint32_t& index) {
+            int64_t value = 0;
+            auto result = std::from_chars(p, end, value);
+
+            if (result.ec != std::errc() || value == 0) {
+                return false;
+            }
+
+            p = result.ptr;
+
+            int64_t resolved = value > 0 ? value - 1 : static_cast<int64_t>(elementCount) + value;
+
+            if (resolved < 0 || resolved >= static_cast<int64_t>(elementCount)) {
+                return false;
+            }
+
+            index = static_cast<uint32_t>(resolved);
+
+            return true;
+        }
+
+        // v、v/vt、v//vn、v/vt/vn
+        bool parseFaceVertex(const char*& p, const char* end, size_t positionCount, size_t texCCount, size_t normalCount, VertexKey& key) {
+            key = { missingIndex, missingIndex, missingIndex };
+
+            if (!resolveIndex(p, end, positionCount, key.position)) {
+                return false;
+            }
+
+            if (p < end && *p == '/') {
+                p++;
+
+                if (p < end && *p != '/' && !resolveIndex(p, end, texCCount, key.texC)) {
+                    return false;
+                }
+
+                if (p < end && *p == '/') {
+                    p++;
+
+                    if (!resolveIndex(p, end, normalCount, key.normal)) {
+                        return false;
+                    }
+                }
+            }
+
+            return p == end || isSpace(*p);
+        }
+
+        class Parser {
+        public:
+            explicit Parser(GeometryGenerator::MeshData& meshData) : meshData(meshData) {
+                useMaterial("");
+            }
+
+            bool parseLine(const char* p, const char* end) {
+                skipSpaces(p, end);
+
+                if (p == end || *p == '#') {
+                    return true;
+                }
+
+                const char* keyword = p;
+
+                while (p < end && !isSpace(*p)) {
+                    p++;
+                }
+
+                size_t keywordLength = p - keyword;
+
+                if (keywordLength == 1 && keyword[0] == 'v') {
+                    XMFLOAT3 position;
+
+                    if (!parseFloat(p, end, position.x) || !parseFloat(p, end, position.y) || !parseFloat(p, end, position.z)) {
+                        return false;
+                    }
+
+                    positions.push_back(position);
+                }
+                else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 't') {
+                    XMFLOAT2 texC(0.0f, 0.0f);
+
+                    if (!parseFloat(p, end, texC.x)) {
+                        return false;
+                    }
+
+                    // v和w是可选的，省略的v按0处理
+                    skipSpaces(p, end);
+
+                    if (p < end && !parseFloat(p, end, texC.y)) {
+                        return false;
+                    }
+
+                    texC.y = 1.0f - texC.y;
+                    texCs.push_back(texC);
+                }
+                else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 'n') {
+                    XMFLOAT3 normal;
+
+                    if (!parseFloat(p, end, normal.x) || !parseFloat(p, end, normal.y) || !parseFloat(p, end, normal.z)) {
+                        return false;
+                    }
+
+                    normals.push_back(normal);
+                }
+                else if (keywordLength == 1 && keyword[0] == 'f') {
+                    return parseFace(p, end);
+                }
+                else if (keywordLength == 6 && memcmp(keyword, "usemtl", 6) == 0) {
+                    skipSpaces(p, end);
+
+                    while (end > p && isSpace(end[-1])) {
+                        end--;
+                    }
+
+                    useMaterial(std::string(p, end));
+                }
+
+                return true;
+            }
+
+            void finish(std::vector<Submesh>& result) {
+                closeSubmesh();
+
+                if (submeshes.back().indexCount == 0) {
+                    submeshes.pop_back();
+                }
+
+                result = std::move(submeshes);
+            }
+
+        private:
+            // 三角形按文件中的顺序直接追加到唯一的索引数组中，切换材质时开始一个新的范围
+            void useMaterial(const std::string& name) {
+                if (!submeshes.empty()) {
+                    closeSubmesh();
+
+                    // 没有三角形的范围直接丢掉，相同材质连续出现时沿用上一个范围
+                    if (submeshes.back().indexCount == 0) {
+                        submeshes.pop_back();
+                    }
+
+                    if (!submeshes.empty() && submeshes.back().material == name) {
+                        return;
+                    }
+                }
+
+                Submesh submesh;
+                submesh.material = name;
+                submesh.startIndexLocation = static_cast<uint32_t>(meshData.Indices32.size());
+                submeshes.push_back(submesh);
+            }
+
+            void closeSubmesh() {
+                submeshes.back().indexCount = static_cast<uint32_t>(meshData.Indices32.size()) - submeshes.back().startIndexLocation;
+            }
+
+            uint32_t findOrAddVertex(const VertexKey& key) {
+                auto result = vertexLookup.emplace(key, static_cast<uint32_t>(meshData.Vertices.size()));
+
+                if (result.second) {
+                    GeometryGenerator::Vertex vertex;
+                    vertex.Position = positions[key.position];
+                    vertex.Normal = key.normal != missingIndex ? normals[key.normal] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+                    vertex.TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+                    vertex.TexC = key.texC != missingIndex ? texCs[key.texC] : XMFLOAT2(0.0f, 0.0f);
+
+                    meshData.Vertices.push_back(vertex);
+                }
+
+                return result.first->second;
+            }
+
+            // 扇形三角化：(0, 1, 2), (0, 2, 3), ...
+            bool parseFace(const char* p, const char* end) {
+                uint32_t first = 0;
+                uint32_t previous = 0;
+                uint32_t cornerCount = 0;
+
+                for (skipSpaces(p, end); p < end; skipSpaces(p, end)) {
+                    VertexKey key;
+
+                    if (!parseFaceVertex(p, end, positions.size(), texCs.size(), normals.size(), key)) {
+                        return false;
+                    }
+
+                    uint32_t index = findOrAddVertex(key);
+
+                    if (cornerCount == 0) {
+                        first = index;
+                    }
+                    else if (cornerCount >= 2) {
+                        meshData.Indices32.push_back(first);
+                        meshData.Indices32.push_back(previous);
+                        meshData.Indices32.push_back(index);
+                    }
+
+                    previous = index;
+                    cornerCount++;
+                }
+
+                return cornerCount >= 3;
+            }
+
+            GeometryGenerator::MeshData& meshData;
+
+            std::vector<XMFLOAT3> positions;
+            std::vector<XMFLOAT2> texCs;
+            std::vector<XMFLOAT3> normals;
+
+            std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexLookup;
+
+            std::vector<Submesh> submeshes;
+        };
+    }
+
+    bool load(const std::string& fileName, GeometryGenerator::MeshData& meshData, std::vector<Submesh>& submeshes) {
+        std::ifstream file(fileName, std::ios::binary);
+
+        if (!file) {
+            return false;
+        }
+
+        meshData.Vertices.clear();
+        meshData.Indices32.clear();
+
+        Parser parser(meshData);
+
+        // buffer中[0, pending)是上一块末尾不完整的一行，新数据接在它后面读入
+        std::vector<char> buffer(blockSize);
+        size_t pending = 0;
+
+        while (true) {
+            // 单行比整个缓冲区还长时才扩大缓冲区
+            if (pending == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+
+            file.read(buffer.data() + pending, buffer.size() - pending);
+            size_t available = pending + static_cast<size_t>(file.gcount());
+            bool endOfFile = available < buffer.size();
+
+            const char* p = buffer.data();
+            const char* end = buffer.data() + available;
+
+            while (true) {
+                const char* newline = reinterpret_cast<const char*>(memchr(p, '\n', end - p));
+
+                if (newline == nullptr) {
+                    break;
+                }
+
+                if (!parser.parseLine(p, newline)) {
+                    return false;
+                }
+
+                p = newline + 1;
+            }
+
+            if (endOfFile) {
+                // 最后一行可能没有换行符
+                if (p < end && !parser.parseLine(p, end)) {
+                    return false;
+                }
+
+                break;
+            }
+
+            pending = end - p;
+            memmove(buffer.data(), p, pending);
+        }
+
+        parser.finish(submeshes);
+
+        return true;
+    }
+}
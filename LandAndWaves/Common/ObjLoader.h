@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+// Wavefront OBJ导入
+//
+// 文件按固定大小的块流式读取，逐行解析，不会把整个文件读入内存。
+// 支持v/vt/vn/f/usemtl，其他语句(o/g/s/mtllib等)忽略。
+// 多边形按扇形三角化，相同的(位置, 纹理坐标, 法线)索引组合只生成一个顶点。
+namespace ObjLoader {
+    // 所有三角形按文件中的顺序放在同一个索引数组中，每次usemtl切换材质开始一个新的范围，
+    // 同一材质在文件中分几段出现时就有几个范围。
+    // 所有范围共用同一个顶点数组，绘制时BaseVertexLocation为0
+    struct Submesh {
+        std::string material;
+        uint32_t indexCount = 0;
+        uint32_t startIndexLocation = 0;
+    };
+
+    // 每次从文件读取的字节数
+    const size_t blockSize = 1 << 20;
+
+    // 文件中没有法线时Normal为零向量，可以随后调用MeshProcessing::computeNormals。
+    // 纹理坐标的v翻转为1 - v，与D3D左上角为原点的约定一致，只有u的vt按v = 0处理
+    bool load(const std::string& fileName, GeometryGenerator::MeshData& meshData, std::vector<Submesh>& submeshes);
+}
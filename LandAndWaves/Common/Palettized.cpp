@@ -0,0 +1,149 @@
+#include "Palettized.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Palettized {
+    namespace {
+        // 开放寻址的颜色 -> 索引表，容量是paletteSize的两倍以上
+        const uint32_t colorTableSize = 1024;
+
+        uint32_t hashColor(uint32_t color) {
+            return (color * 0x9E3779B1u) >> 22;
+        }
+
+        uint32_t wrap(float coordinate, uint32_t size) {
+            int32_t texel = static_cast<int32_t>(std::floor(coordinate * static_cast<float>(size)));
+            int32_t wrapped = texel % static_cast<int32_t>(size);
+
+            return static_cast<uint32_t>(wrapped < 0 ? wrapped + static_cast<int32_t>(size) : wrapped);
+        }
+    }
+
+    bool fromGIF(const GifDecoder::GIF& gif, uint32_t frameIndex, std::vector<uint8_t>& indices, uint32_t palette[paletteSize]) {
+        if (frameIndex >= gif.frames.size()) {
+            return false;
+        }
+
+        const GifDecoder::GIFFrame& frame = gif.frames[frameIndex];
+        const GifDecoder::Palette& framePalette = GifDecoder::framePalette(gif, frame);
+
+        memset(palette, 0, paletteSize * sizeof(uint32_t));
+        memcpy(palette, framePalette.colors, framePalette.colorCount * sizeof(uint32_t));
+
+        if (frame.transparentIndex != GifDecoder::noTransparency) {
+            palette[frame.transparentIndex] = 0;
+        }
+
+        std::vector<uint8_t> frameIndices;
+
+        if (!GifDecoder::decodeFrameIndices(gif, frameIndex, frameIndices)) {
+            return false;
+        }
+
+        uint32_t width = gif.width;
+        uint32_t height = gif.height;
+
+        bool coversCanvas = frame.leftTop[0] == 0 && frame.leftTop[1] == 0 && frame.size[0] == width && frame.size[1] == height;
+
+        if (coversCanvas) {
+            indices.swap(frameIndices);
+            return true;
+        }
+
+        // 帧矩形之外用透明索引填充，没有透明索引时用调色板之外的第一个索引
+        uint32_t fillIndex = 0;
+
+        if (frame.transparentIndex != GifDecoder::noTransparency) {
+            fillIndex = static_cast<uint32_t>(frame.transparentIndex);
+        }
+        else if (framePalette.colorCount < paletteSize) {
+            fillIndex = framePalette.colorCount;
+        }
+        else {
+            return false;
+        }
+
+        indices.assign(static_cast<size_t>(width) * height, static_cast<uint8_t>(fillIndex));
+
+        for (uint32_t row = 0; row < frame.size[1]; row++) {
+            uint32_t y = frame.leftTop[1] + row;
+
+            if (y >= height || frame.leftTop[0] >= width) {
+                break;
+            }
+
+            uint32_t count = std::min(frame.size[0], width - frame.leftTop[0]);
+
+            memcpy(indices.data() + static_cast<size_t>(y) * width + frame.leftTop[0],
+                   frameIndices.data() + static_cast<size_t>(row) * frame.size[0],
+                   count);
+        }
+
+        return true;
+    }
+
+    bool fromRGBA(const uint32_t* pixels, size_t count, std::vector<uint8_t>& indices, uint32_t palette[paletteSize], uint32_t& colorCount) {
+        // 表项的高位标记是否已经使用，低8位是索引
+        uint32_t colors[colorTableSize];
+        uint16_t slots[colorTableSize];
+        memset(slots, 0, sizeof(slots));
+        memset(palette, 0, paletteSize * sizeof(uint32_t));
+
+        colorCount = 0;
+        indices.resize(count);
+
+        // 相邻像素颜色相同的情况很常见，记住上一个像素的结果
+        uint32_t lastColor = 0;
+        uint8_t lastIndex = 0;
+        bool hasLast = false;
+
+        for (size_t i = 0; i < count; i++) {
+            uint32_t color = pixels[i];
+
+            if (hasLast && color == lastColor) {
+                indices[i] = lastIndex;
+                continue;
+            }
+
+            uint32_t slot = hashColor(color) & (colorTableSize - 1);
+
+            while (slots[slot] != 0 && colors[slot] != color) {
+                slot = (slot + 1) & (colorTableSize - 1);
+            }
+
+            if (slots[slot] == 0) {
+                if (colorCount == paletteSize) {
+                    return false;
+                }
+
+                colors[slot] = color;
+                slots[slot] = static_cast<uint16_t>(0x100 | colorCount);
+                palette[colorCount] = color;
+                colorCount++;
+            }
+
+            lastColor = color;
+            lastIndex = static_cast<uint8_t>(slots[slot] & 0xff);
+            hasLast = true;
+
+            indices[i] = lastIndex;
+        }
+
+        return true;
+    }
+
+    void expand(const uint8_t* indices, size_t count, const uint32_t palette[paletteSize], uint32_t* pixels) {
+        for (size_t i = 0; i < count; i++) {
+            pixels[i] = palette[indices[i]];
+        }
+    }
+
+    uint32_t sample(const uint8_t* indices, uint32_t width, uint32_t height, const uint32_t palette[paletteSize], float u, float v) {
+        uint32_t x = wrap(u, width);
+        uint32_t y = wrap(v, height);
+
+        return palette[indices[static_cast<size_t>(y) * width + x]];
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "GifDecoder.h"
+
+// 调色板格式的图片：每个像素一个字节的索引(DXGI_FORMAT_R8_UINT)加一个256项的R8G8B8A8调色板，
+// 占用的显存大约是R8G8B8A8的四分之一。颜色在Shader采样时查表得到，见Shaders/color.hlsl中的samplePalettized。
+//
+// 多帧图片每一帧一张索引纹理，所有帧的调色板放在一张256 x frameCount的纹理中，第i行是第i帧的调色板。
+// 调色板中不存在的颜色(索引超出colorCount)都是0，即完全透明。
+namespace Palettized {
+    const uint32_t paletteSize = 256;
+
+    // 把GIF的第frameIndex帧转换为width * height(逻辑屏幕大小)的索引，帧矩形之外填透明的索引。
+    // 与WICLoadImage得到的帧一样不做帧之间的合成。
+    // 帧没有覆盖整个画面又找不到可以用作透明的索引时返回false
+    bool fromGIF(const GifDecoder::GIF& gif, uint32_t frameIndex, std::vector<uint8_t>& indices, uint32_t palette[paletteSize]);
+
+    // 把R8G8B8A8像素转换为索引和调色板，颜色多于256种时返回false
+    bool fromRGBA(const uint32_t* pixels, size_t count, std::vector<uint8_t>& indices, uint32_t palette[paletteSize], uint32_t& colorCount);
+
+    // 查表展开为R8G8B8A8
+    void expand(const uint8_t* indices, size_t count, const uint32_t palette[paletteSize], uint32_t* pixels);
+
+    // 参考采样器，与samplePalettized相同：点采样，Wrap寻址，用来校验Shader的结果
+    uint32_t sample(const uint8_t* indices, uint32_t width, uint32_t height, const uint32_t palette[paletteSize], float u, float v);
+}
@@ -0,0 +1,1076 @@
+#include "PngWriter.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PNG_WRITER_SSE2 1
+#endif
+
+namespace PngWriter {
+    namespace {
+        const uint32_t bytesPerPixel = 4;
+        const uint32_t windowSize = 32768;
+        const uint32_t windowMask = windowSize - 1;
+        const uint32_t hashBits = 15;
+        const uint32_t minMatch = 4;            // 按4字节计算哈希，RGBA数据中3字节的匹配很少有收益
+        const uint32_t maxMatch = 258;
+        const size_t maxBlockSymbols = 1 << 15;
+        const uint32_t adlerBase = 65521;
+
+        struct LevelSettings {
+            uint32_t maxChain;
+            uint32_t niceLength;
+            bool lazy;
+        };
+
+        // 与zlib的级别大致对应：链越长、匹配越够长才停止、延迟匹配，压缩率越高也越慢
+        const LevelSettings levelSettings[10] = {
+            { 0, 0, false },
+            { 2, 16, false },
+            { 4, 32, false },
+            { 8, 64, false },
+            { 8, 32, true },
+            { 16, 64, true },
+            { 32, 128, true },
+            { 64, 258, true },
+            { 256, 258, true },
+            { 1024, 258, true }
+        };
+
+        // deflate和PNG用到的常量表，第一次使用时初始化
+        struct Tables {
+            uint16_t lengthSymbol[maxMatch + 1];
+            uint8_t distanceCode[windowSize + 1];
+            uint32_t crc[256];
+
+            static const uint16_t lengthBase[29];
+            static const uint8_t lengthExtra[29];
+            static const uint16_t distanceBase[30];
+            static const uint8_t distanceExtra[30];
+
+            Tables() {
+                for (uint32_t code = 0; code < 29; code++) {
+                    uint32_t end = code == 28 ? maxMatch + 1 : lengthBase[code + 1];
+
+                    for (uint32_t length = lengthBase[code]; length < end; length++) {
+                        lengthSymbol[length] = static_cast<uint16_t>(code);
+                    }
+                }
+
+                for (uint32_t code = 0; code < 30; code++) {
+                    uint32_t end = code == 29 ? windowSize + 1 : distanceBase[code + 1];
+
+                    for (uint32_t distance = distanceBase[code]; distance < end; distance++) {
+                        distanceCode[distance] = static_cast<uint8_t>(code);
+                    }
+                }
+
+                for (uint32_t i = 0; i < 256; i++) {
+                    uint32_t value = i;
+
+                    for (int bit = 0; bit < 8; bit++) {
+                        value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+                    }
+
+                    crc[i] = value;
+                }
+            }
+        };
+
+        const uint16_t Tables::lengthBase[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+        };
+
+        const uint8_t Tables::lengthExtra[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+        };
+
+        const uint16_t Tables::distanceBase[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+            1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+        };
+
+        const uint8_t Tables::distanceExtra[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+        };
+
+        const Tables& tables() {
+            static const Tables instance;
+            return instance;
+        }
+
+        uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+            const uint32_t* table = tables().crc;
+
+            crc = ~crc;
+
+            for (size_t i = 0; i < size; i++) {
+                crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            }
+
+            return ~crc;
+        }
+
+        uint32_t adler32(const uint8_t* data, size_t size) {
+            // 5552是保证sum2不溢出32位的最大字节数
+            uint32_t sum1 = 1;
+            uint32_t sum2 = 0;
+
+            while (size > 0) {
+                size_t count = std::min<size_t>(size, 5552);
+
+                for (size_t i = 0; i < count; i++) {
+                    sum1 += data[i];
+                    sum2 += sum1;
+                }
+
+                sum1 %= adlerBase;
+                sum2 %= adlerBase;
+                data += count;
+                size -= count;
+            }
+
+            return sum1 | (sum2 << 16);
+        }
+
+        // 第二段数据(长度为size2)的Adler-32接在第一段之后，与zlib的adler32_combine相同
+        uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2) {
+            uint32_t remainder = static_cast<uint32_t>(size2 % adlerBase);
+            uint32_t sum1 = adler1 & 0xffff;
+            uint32_t sum2 = (remainder * sum1) % adlerBase;
+
+            sum1 += (adler2 & 0xffff) + adlerBase - 1;
+            sum2 += (adler1 >> 16) + (adler2 >> 16) + adlerBase - remainder;
+
+            if (sum1 >= adlerBase) {
+                sum1 -= adlerBase;
+            }
+
+            if (sum1 >= adlerBase) {
+                sum1 -= adlerBase;
+            }
+
+            if (sum2 >= adlerBase * 2) {
+                sum2 -= adlerBase * 2;
+            }
+
+            if (sum2 >= adlerBase) {
+                sum2 -= adlerBase;
+            }
+
+            return sum1 | (sum2 << 16);
+        }
+
+        void writeBigEndian(uint8_t* output, uint32_t value) {
+            output[0] = static_cast<uint8_t>(value >> 24);
+            output[1] = static_cast<uint8_t>(value >> 16);
+            output[2] = static_cast<uint8_t>(value >> 8);
+            output[3] = static_cast<uint8_t>(value);
+        }
+
+        // 长度(4字节) + 类型 + 数据 + CRC
+        void appendChunk(std::vector<uint8_t>& output, const char* type, const uint8_t* data, size_t size) {
+            size_t offset = output.size();
+
+            output.resize(offset + 12 + size);
+
+            writeBigEndian(&output[offset], static_cast<uint32_t>(size));
+            memcpy(&output[offset + 4], type, 4);
+
+            if (size > 0) {
+                memcpy(&output[offset + 8], data, size);
+            }
+
+            writeBigEndian(&output[offset + 8 + size], crc32(0, &output[offset + 4], size + 4));
+        }
+
+        // ---------------------------------------------------------------------
+        // 滤波
+
+        uint8_t paethPredictor(int a, int b, int c) {
+            int pa = std::abs(b - c);
+            int pb = std::abs(a - c);
+            int pc = std::abs(a + b - 2 * c);
+
+            if (pa <= pb && pa <= pc) {
+                return static_cast<uint8_t>(a);
+            }
+
+            return static_cast<uint8_t>(pb <= pc ? b : c);
+        }
+
+        uint8_t filterByte(Filter filter, const uint8_t* current, const uint8_t* previous, size_t i) {
+            int x = current[i];
+            int a = i >= bytesPerPixel ? current[i - bytesPerPixel] : 0;
+            int b = previous[i];
+            int c = i >= bytesPerPixel ? previous[i - bytesPerPixel] : 0;
+
+            switch (filter) {
+            case Filter::Sub:
+                return static_cast<uint8_t>(x - a);
+            case Filter::Up:
+                return static_cast<uint8_t>(x - b);
+            case Filter::Average:
+                return static_cast<uint8_t>(x - ((a + b) >> 1));
+            case Filter::Paeth:
+                return static_cast<uint8_t>(x - paethPredictor(a, b, c));
+            default:
+                return static_cast<uint8_t>(x);
+            }
+        }
+
+#if defined(PNG_WRITER_SSE2)
+        // 16个字节的滤波结果。滤波只依赖原始像素，所以每个字节都可以独立计算
+        __m128i filter16(Filter filter, const uint8_t* current, const uint8_t* previous, size_t i) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + i));
+
+            if (filter == Filter::None) {
+                return x;
+            }
+
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i));
+
+            if (filter == Filter::Up) {
+                return _mm_sub_epi8(x, b);
+            }
+
+            // 第一个像素的左边是0
+            __m128i a = i >= bytesPerPixel ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + i - bytesPerPixel)) : _mm_slli_si128(x, 4);
+
+            if (filter == Filter::Sub) {
+                return _mm_sub_epi8(x, a);
+            }
+
+            if (filter == Filter::Average) {
+                // _mm_avg_epu8向上取整，PNG要求向下取整
+                __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+                return _mm_sub_epi8(x, average);
+            }
+
+            __m128i c = i >= bytesPerPixel ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i - bytesPerPixel)) : _mm_slli_si128(b, 4);
+
+            // Paeth在16位下计算：pa = |b - c|，pb = |a - c|，pc = |a + b - 2c|
+            __m128i zero = _mm_setzero_si128();
+            __m128i predictor[2];
+
+            for (int half = 0; half < 2; half++) {
+                __m128i a16 = half == 0 ? _mm_unpacklo_epi8(a, zero) : _mm_unpackhi_epi8(a, zero);
+                __m128i b16 = half == 0 ? _mm_unpacklo_epi8(b, zero) : _mm_unpackhi_epi8(b, zero);
+                __m128i c16 = half == 0 ? _mm_unpacklo_epi8(c, zero) : _mm_unpackhi_epi8(c, zero);
+
+                __m128i bc = _mm_sub_epi16(b16, c16);
+                __m128i ac = _mm_sub_epi16(a16, c16);
+                __m128i abc = _mm_add_epi16(bc, ac);
+
+                __m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+                __m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+                __m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+
+                __m128i useA = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)), _mm_set1_epi16(-1));
+                __m128i useB = _mm_andnot_si128(useA, _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1)));
+                __m128i useC = _mm_andnot_si128(_mm_or_si128(useA, useB), _mm_set1_epi16(-1));
+
+                predictor[half] = _mm_or_si128(_mm_or_si128(_mm_and_si128(useA, a16), _mm_and_si128(useB, b16)), _mm_and_si128(useC, c16));
+            }
+
+            return _mm_sub_epi8(x, _mm_packus_epi16(predictor[0], predictor[1]));
+        }
+#endif
+
+        void filterRow(Filter filter, const uint8_t* current, const uint8_t* previous, uint8_t* output, size_t rowBytes) {
+            size_t i = 0;
+
+#if defined(PNG_WRITER_SSE2)
+            for (; i + 16 <= rowBytes; i += 16) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), filter16(filter, current, previous, i));
+            }
+#endif
+
+            for (; i < rowBytes; i++) {
+                output[i] = filterByte(filter, current, previous, i);
+            }
+        }
+
+        // 滤波结果看作有符号数的绝对值之和
+        uint64_t filterCost(Filter filter, const uint8_t* current, const uint8_t* previous, size_t rowBytes) {
+            uint64_t cost = 0;
+            size_t i = 0;
+
+#if defined(PNG_WRITER_SSE2)
+            __m128i zero = _mm_setzero_si128();
+            __m128i sum = zero;
+
+            for (; i + 16 <= rowBytes; i += 16) {
+                __m128i filtered = filter16(filter, current, previous, i);
+                __m128i absolute = _mm_min_epu8(filtered, _mm_sub_epi8(zero, filtered));
+
+                sum = _mm_add_epi64(sum, _mm_sad_epu8(absolute, zero));
+            }
+
+            cost = static_cast<uint64_t>(_mm_cvtsi128_si32(sum)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#endif
+
+            for (; i < rowBytes; i++) {
+                uint8_t filtered = filterByte(filter, current, previous, i);
+                cost += std::min<uint32_t>(filtered, 256 - filtered);
+            }
+
+            return cost;
+        }
+
+        Filter chooseFilter(const uint8_t* current, const uint8_t* previous, size_t rowBytes) {
+            Filter best = Filter::None;
+            uint64_t bestCost = filterCost(Filter::None, current, previous, rowBytes);
+
+            for (Filter filter : { Filter::Sub, Filter::Up, Filter::Average, Filter::Paeth }) {
+                uint64_t cost = filterCost(filter, current, previous, rowBytes);
+
+                if (cost < bestCost) {
+                    best = filter;
+                    bestCost = cost;
+                }
+            }
+
+            return best;
+        }
+
+        // ---------------------------------------------------------------------
+        // deflate
+
+        class BitWriter {
+        public:
+            explicit BitWriter(std::vector<uint8_t>& inOutput) : output(inOutput) {}
+
+            // count不超过32
+            void put(uint32_t value, uint32_t count) {
+                bits |= static_cast<uint64_t>(value) << bitCount;
+                bitCount += count;
+
+                while (bitCount >= 8) {
+                    output.push_back(static_cast<uint8_t>(bits));
+                    bits >>= 8;
+                    bitCount -= 8;
+                }
+            }
+
+            void alignToByte() {
+                if (bitCount > 0) {
+                    put(0, 8 - bitCount);
+                }
+            }
+
+            void putBytes(const uint8_t* data, size_t size) {
+                output.insert(output.end(), data, data + size);
+            }
+
+        private:
+            std::vector<uint8_t>& output;
+            uint64_t bits = 0;
+            uint32_t bitCount = 0;
+        };
+
+        // 按频率生成不超过maxLength位的Huffman码长(Moffat的原地算法，再把超长的码压到maxLength)
+        void buildLengths(const uint32_t* frequencies, uint32_t symbolCount, uint32_t maxLength, uint8_t* lengths) {
+            struct Symbol {
+                uint32_t frequency;
+                uint32_t index;
+            };
+
+            std::vector<Symbol> symbols;
+
+            memset(lengths, 0, symbolCount);
+
+            for (uint32_t i = 0; i < symbolCount; i++) {
+                if (frequencies[i] > 0) {
+                    symbols.push_back({ frequencies[i], i });
+                }
+            }
+
+            // 只有0个或1个符号时也生成完整的码，部分解码器不接受不完整的码
+            if (symbols.size() < 2) {
+                uint32_t first = symbols.empty() ? 0 : symbols[0].index;
+
+                lengths[first] = 1;
+                lengths[first == 0 ? 1 : 0] = 1;
+                return;
+            }
+
+            std::sort(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) {
+                return a.frequency < b.frequency;
+            });
+
+            int n = static_cast<int>(symbols.size());
+            std::vector<uint32_t> a(n);
+
+            for (int i = 0; i < n; i++) {
+                a[i] = symbols[i].frequency;
+            }
+
+            a[0] += a[1];
+
+            int root = 0;
+            int leaf = 2;
+
+            for (int next = 1; next < n - 1; next++) {
+                if (leaf >= n || a[root] < a[leaf]) {
+                    a[next] = a[root];
+                    a[root++] = next;
+                }
+                else {
+                    a[next] = a[leaf++];
+                }
+
+                if (leaf >= n || (root < next && a[root] < a[leaf])) {
+                    a[next] += a[root];
+                    a[root++] = next;
+                }
+                else {
+                    a[next] += a[leaf++];
+                }
+            }
+
+            a[n - 2] = 0;
+
+            for (int next = n - 3; next >= 0; next--) {
+                a[next] = a[a[next]] + 1;
+            }
+
+            int available = 1;
+            int used = 0;
+            uint32_t depth = 0;
+            root = n - 2;
+            int next = n - 1;
+
+            while (available > 0) {
+                while (root >= 0 && a[root] == depth) {
+                    used++;
+                    root--;
+                }
+
+                while (available > used) {
+                    a[next--] = depth;
+                    available--;
+                }
+
+                available = 2 * used;
+                depth++;
+                used = 0;
+            }
+
+            // 每种码长的个数，超过maxLength的并入maxLength，再调整到满足Kraft不等式
+            uint32_t counts[33] = {};
+
+            for (int i = 0; i < n; i++) {
+                counts[std::min<uint32_t>(a[i], 32)]++;
+            }
+
+            for (uint32_t length = maxLength + 1; length <= 32; length++) {
+                counts[maxLength] += counts[length];
+                counts[length] = 0;
+            }
+
+            uint32_t total = 0;
+
+            for (uint32_t length = maxLength; length > 0; length--) {
+                total += counts[length] << (maxLength - length);
+            }
+
+            while (total != (1u << maxLength)) {
+                counts[maxLength]--;
+
+                for (uint32_t length = maxLength - 1; length > 0; length--) {
+                    if (counts[length] > 0) {
+                        counts[length]--;
+                        counts[length + 1] += 2;
+                        break;
+                    }
+                }
+
+                total--;
+            }
+
+            // 频率最高的符号用最短的码
+            int symbol = n;
+
+            for (uint32_t length = 1; length <= maxLength; length++) {
+                for (uint32_t count = counts[length]; count > 0; count--) {
+                    lengths[symbols[--symbol].index] = static_cast<uint8_t>(length);
+                }
+            }
+        }
+
+        // 规范Huffman码，deflate从低位开始写，所以每个码按位反转
+        void buildCodes(const uint8_t* lengths, uint32_t symbolCount, uint16_t* codes) {
+            uint32_t counts[16] = {};
+            uint32_t nextCode[16] = {};
+
+            for (uint32_t i = 0; i < symbolCount; i++) {
+                counts[lengths[i]]++;
+            }
+
+            counts[0] = 0;
+
+            for (uint32_t length = 1, code = 0; length < 16; length++) {
+                code = (code + counts[length - 1]) << 1;
+                nextCode[length] = code;
+            }
+
+            for (uint32_t i = 0; i < symbolCount; i++) {
+                uint32_t length = lengths[i];
+
+                if (length == 0) {
+                    codes[i] = 0;
+                    continue;
+                }
+
+                uint32_t code = nextCode[length]++;
+                uint32_t reversed = 0;
+
+                for (uint32_t bit = 0; bit < length; bit++) {
+                    reversed = (reversed << 1) | ((code >> bit) & 1);
+                }
+
+                codes[i] = static_cast<uint16_t>(reversed);
+            }
+        }
+
+        struct Symbol {
+            uint16_t literalOrLength;   // distance为0时是字面字节，否则是匹配长度
+            uint16_t distance;
+        };
+
+        class DeflateEncoder {
+        public:
+            DeflateEncoder(std::vector<uint8_t>& output, int level) : writer(output), settings(levelSettings[std::min(std::max(level, 0), 9)]) {}
+
+            // data[windowStart, begin)是前一段的数据，可以被匹配引用但不输出；final为true时是zlib流的最后一段
+            void compress(const uint8_t* data, size_t windowStart, size_t begin, size_t end, bool final) {
+                // 空的段(行数比线程数少时)也要输出一个块，最后一段必须带BFINAL
+                if (settings.maxChain == 0 || begin == end) {
+                    writeStored(data + begin, end - begin, final);
+                }
+                else {
+                    compressMatches(data, windowStart, begin, end, final);
+                }
+
+                if (!final) {
+                    // 空的存储块，把这一段的结尾对齐到字节，下一段的块可以直接拼接在后面
+                    writer.put(0, 3);
+                    writer.alignToByte();
+                    writer.put(0x0000, 16);
+                    writer.put(0xffff, 16);
+                }
+                else {
+                    writer.alignToByte();
+                }
+            }
+
+        private:
+            uint32_t hash(const uint8_t* data) const {
+                uint32_t value;
+                memcpy(&value, data, sizeof(value));
+                return (value * 2654435761u) >> (32 - hashBits);
+            }
+
+            void insert(const uint8_t* data, size_t position) {
+                uint32_t h = hash(data + position);
+                previous[position & windowMask] = head[h];
+                head[h] = static_cast<int64_t>(position);
+            }
+
+            uint32_t matchLength(const uint8_t* a, const uint8_t* b, uint32_t limit) const {
+                uint32_t length = 0;
+
+                while (length + 8 <= limit) {
+                    uint64_t x;
+                    uint64_t y;
+                    memcpy(&x, a + length, sizeof(x));
+                    memcpy(&y, b + length, sizeof(y));
+
+                    if (x != y) {
+                        break;
+                    }
+
+                    length += 8;
+                }
+
+                while (length < limit && a[length] == b[length]) {
+                    length++;
+                }
+
+                return length;
+            }
+
+            // 返回最长匹配的长度(小于minMatch时为0)
+            uint32_t findMatch(const uint8_t* data, size_t position, size_t windowStart, size_t end, uint32_t& distance) const {
+                uint32_t limit = static_cast<uint32_t>(std::min<size_t>(maxMatch, end - position));
+
+                if (limit < minMatch) {
+                    return 0;
+                }
+
+                size_t lowest = std::max(windowStart, position > windowSize - 1 ? position - (windowSize - 1) : 0);
+                int64_t candidate = head[hash(data + position)];
+                uint32_t bestLength = minMatch - 1;
+                uint32_t chain = settings.maxChain;
+
+                while (candidate >= static_cast<int64_t>(lowest) && chain-- > 0) {
+                    const uint8_t* match = data + candidate;
+
+                    // 先比较当前最长长度处的字节，大部分候选在这里就被排除
+                    if (match[bestLength] == data[position + bestLength]) {
+                        uint32_t length = matchLength(match, data + position, limit);
+
+                        if (length > bestLength) {
+                            bestLength = length;
+                            distance = static_cast<uint32_t>(position - candidate);
+
+                            if (length >= settings.niceLength || length == limit) {
+                                break;
+                            }
+                        }
+                    }
+
+                    int64_t next = previous[candidate & windowMask];
+
+                    // 环形数组中的旧位置被覆盖后可能指向更新的位置
+                    if (next >= candidate) {
+                        break;
+                    }
+
+                    candidate = next;
+                }
+
+                return bestLength >= minMatch ? bestLength : 0;
+            }
+
+            void compressMatches(const uint8_t* data, size_t windowStart, size_t begin, size_t end, bool final) {
+                head.assign(size_t(1) << hashBits, -1);
+                previous.assign(windowSize, -1);
+                symbols.clear();
+                symbols.reserve(maxBlockSymbols);
+
+                for (size_t position = windowStart; position + minMatch <= begin; position++) {
+                    insert(data, position);
+                }
+
+                size_t blockStart = begin;
+                size_t position = begin;
+
+                while (position < end) {
+                    uint32_t distance = 0;
+                    uint32_t length = findMatch(data, position, windowStart, end, distance);
+
+                    // 延迟匹配：下一个位置的匹配更长时，当前位置输出字面字节
+                    if (length > 0 && settings.lazy && length < settings.niceLength && position + 1 < end) {
+                        if (position + minMatch <= end) {
+                            insert(data, position);
+                        }
+
+                        uint32_t nextDistance = 0;
+                        uint32_t nextLength = findMatch(data, position + 1, windowStart, end, nextDistance);
+
+                        size_t insertStart = position + 1;
+
+                        if (nextLength > length) {
+                            symbols.push_back({ data[position], 0 });
+                            position++;
+                            length = nextLength;
+                            distance = nextDistance;
+                        }
+
+                        symbols.push_back({ static_cast<uint16_t>(length), static_cast<uint16_t>(distance) });
+
+                        for (size_t i = insertStart; i < position + length && i + minMatch <= end; i++) {
+                            insert(data, i);
+                        }
+
+                        position += length;
+                    }
+                    else if (length > 0) {
+                        symbols.push_back({ static_cast<uint16_t>(length), static_cast<uint16_t>(distance) });
+
+                        for (size_t i = position; i < position + length && i + minMatch <= end; i++) {
+                            insert(data, i);
+                        }
+
+                        position += length;
+                    }
+                    else {
+                        if (position + minMatch <= end) {
+                            insert(data, position);
+                        }
+
+                        symbols.push_back({ data[position], 0 });
+                        position++;
+                    }
+
+                    if (symbols.size() >= maxBlockSymbols - 1) {
+                        writeBlock(data + blockStart, position - blockStart, final && position >= end);
+                        symbols.clear();
+                        blockStart = position;
+                    }
+                }
+
+                if (!symbols.empty()) {
+                    writeBlock(data + blockStart, position - blockStart, final);
+                    symbols.clear();
+                }
+            }
+
+            void writeStored(const uint8_t* data, size_t size, bool final) {
+                // 每个存储块最多65535字节，final只设在最后一块上
+                size_t offset = 0;
+
+                do {
+                    size_t count = std::min<size_t>(size - offset, 65535);
+                    bool last = offset + count == size;
+
+                    writer.put(final && last ? 1 : 0, 1);
+                    writer.put(0, 2);
+                    writer.alignToByte();
+                    writer.put(static_cast<uint32_t>(count), 16);
+                    writer.put(static_cast<uint32_t>(~count & 0xffff), 16);
+                    writer.putBytes(data + offset, count);
+
+                    offset += count;
+                } while (offset < size);
+            }
+
+            // 动态Huffman块，编码后比存储块还大时改为存储块(比如噪声图片)
+            void writeBlock(const uint8_t* raw, size_t rawSize, bool final) {
+                const Tables& table = tables();
+
+                uint32_t literalFrequencies[286] = {};
+                uint32_t distanceFrequencies[30] = {};
+
+                for (const Symbol& symbol : symbols) {
+                    if (symbol.distance == 0) {
+                        literalFrequencies[symbol.literalOrLength]++;
+                    }
+                    else {
+                        literalFrequencies[257 + table.lengthSymbol[symbol.literalOrLength]]++;
+                        distanceFrequencies[table.distanceCode[symbol.distance]]++;
+                    }
+                }
+
+                literalFrequencies[256] = 1;
+
+                uint8_t literalLengths[286];
+                uint8_t distanceLengths[30];
+                uint16_t literalCodes[286];
+                uint16_t distanceCodes[30];
+
+                buildLengths(literalFrequencies, 286, 15, literalLengths);
+                buildLengths(distanceFrequencies, 30, 15, distanceLengths);
+                buildCodes(literalLengths, 286, literalCodes);
+                buildCodes(distanceLengths, 30, distanceCodes);
+
+                uint32_t literalCount = 286;
+                uint32_t distanceCount = 30;
+
+                while (literalCount > 257 && literalLengths[literalCount - 1] == 0) {
+                    literalCount--;
+                }
+
+                while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) {
+                    distanceCount--;
+                }
+
+                // 两个码长表连在一起做游程编码：16重复前一个3~6次，17重复0 3~10次，18重复0 11~138次
+                uint8_t allLengths[286 + 30];
+                memcpy(allLengths, literalLengths, literalCount);
+                memcpy(allLengths + literalCount, distanceLengths, distanceCount);
+
+                uint32_t totalLengths = literalCount + distanceCount;
+                std::vector<uint8_t> runSymbols;
+                std::vector<uint8_t> runExtras;
+                uint32_t codeLengthFrequencies[19] = {};
+
+                for (uint32_t i = 0; i < totalLengths;) {
+                    uint8_t length = allLengths[i];
+                    uint32_t run = 1;
+
+                    while (i + run < totalLengths && allLengths[i + run] == length) {
+                        run++;
+                    }
+
+                    i += run;
+
+                    if (length == 0) {
+                        while (run >= 11) {
+                            uint32_t count = std::min<uint32_t>(run, 138);
+                            runSymbols.push_back(18);
+                            runExtras.push_back(static_cast<uint8_t>(count - 11));
+                            run -= count;
+                        }
+
+                        if (run >= 3) {
+                            runSymbols.push_back(17);
+                            runExtras.push_back(static_cast<uint8_t>(run - 3));
+                            run = 0;
+                        }
+                    }
+                    else {
+                        runSymbols.push_back(length);
+                        runExtras.push_back(0);
+                        run--;
+
+                        while (run >= 3) {
+                            uint32_t count = std::min<uint32_t>(run, 6);
+                            runSymbols.push_back(16);
+                            runExtras.push_back(static_cast<uint8_t>(count - 3));
+                            run -= count;
+                        }
+                    }
+
+                    while (run > 0) {
+                        runSymbols.push_back(length);
+                        runExtras.push_back(0);
+                        run--;
+                    }
+                }
+
+                for (uint8_t symbol : runSymbols) {
+                    codeLengthFrequencies[symbol]++;
+                }
+
+                uint8_t codeLengthLengths[19];
+                uint16_t codeLengthCodes[19];
+
+                buildLengths(codeLengthFrequencies, 19, 7, codeLengthLengths);
+                buildCodes(codeLengthLengths, 19, codeLengthCodes);
+
+                static const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+                uint32_t codeLengthCount = 19;
+
+                while (codeLengthCount > 4 && codeLengthLengths[codeLengthOrder[codeLengthCount - 1]] == 0) {
+                    codeLengthCount--;
+                }
+
+                // 估算动态块的位数，与存储块比较
+                uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * codeLengthCount;
+
+                for (size_t i = 0; i < runSymbols.size(); i++) {
+                    uint8_t symbol = runSymbols[i];
+                    dynamicBits += codeLengthLengths[symbol] + (symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0);
+                }
+
+                for (uint32_t i = 0; i < 286; i++) {
+                    dynamicBits += static_cast<uint64_t>(literalFrequencies[i]) * literalLengths[i];
+
+                    if (i >= 257) {
+                        dynamicBits += static_cast<uint64_t>(literalFrequencies[i]) * Tables::lengthExtra[i - 257];
+                    }
+                }
+
+                for (uint32_t i = 0; i < 30; i++) {
+                    dynamicBits += static_cast<uint64_t>(distanceFrequencies[i]) * (distanceLengths[i] + Tables::distanceExtra[i]);
+                }
+
+                uint64_t storedBits = (rawSize + 5 * (rawSize / 65535 + 1)) * 8 + 7;
+
+                if (storedBits <= dynamicBits) {
+                    writeStored(raw, rawSize, final);
+                    return;
+                }
+
+                writer.put(final ? 1 : 0, 1);
+                writer.put(2, 2);
+                writer.put(literalCount - 257, 5);
+                writer.put(distanceCount - 1, 5);
+                writer.put(codeLengthCount - 4, 4);
+
+                for (uint32_t i = 0; i < codeLengthCount; i++) {
+                    writer.put(codeLengthLengths[codeLengthOrder[i]], 3);
+                }
+
+                for (size_t i = 0; i < runSymbols.size(); i++) {
+                    uint8_t symbol = runSymbols[i];
+
+                    writer.put(codeLengthCodes[symbol], codeLengthLengths[symbol]);
+
+                    if (symbol == 16) {
+                        writer.put(runExtras[i], 2);
+                    }
+                    else if (symbol == 17) {
+                        writer.put(runExtras[i], 3);
+                    }
+                    else if (symbol == 18) {
+                        writer.put(runExtras[i], 7);
+                    }
+                }
+
+                for (const Symbol& symbol : symbols) {
+                    if (symbol.distance == 0) {
+                        writer.put(literalCodes[symbol.literalOrLength], literalLengths[symbol.literalOrLength]);
+                        continue;
+                    }
+
+                    uint32_t lengthCode = table.lengthSymbol[symbol.literalOrLength];
+                    uint32_t distanceCode = table.distanceCode[symbol.distance];
+
+                    writer.put(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+                    writer.put(symbol.literalOrLength - Tables::lengthBase[lengthCode], Tables::lengthExtra[lengthCode]);
+                    writer.put(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+                    writer.put(symbol.distance - Tables::distanceBase[distanceCode], Tables::distanceExtra[distanceCode]);
+                }
+
+                writer.put(literalCodes[256], literalLengths[256]);
+            }
+
+            BitWriter writer;
+            LevelSettings settings;
+            std::vector<int64_t> head;
+            std::vector<int64_t> previous;
+            std::vector<Symbol> symbols;
+        };
+    }
+
+    bool encode(const uint8_t* rgba, size_t rowPitch, uint32_t width, uint32_t height,
+                std::vector<uint8_t>& png, const Options& options) {
+        png.clear();
+
+        if (rgba == nullptr || width == 0 || height == 0 || width > 0x7fffffff / bytesPerPixel || height > 0x7fffffff) {
+            return false;
+        }
+
+        size_t rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+
+        if (rowPitch == 0) {
+            rowPitch = rowBytes;
+        }
+
+        if (rowPitch < rowBytes) {
+            return false;
+        }
+
+        // 每一行前面是一个字节的滤波器类型
+        size_t filteredRowBytes = rowBytes + 1;
+        std::vector<uint8_t> filtered(filteredRowBytes * height);
+        std::vector<uint8_t> zeroRow(rowBytes, 0);
+
+        uint32_t workers = Parallel::workerCount(height, std::max(1u, options.minRowsPerBand));
+
+        Parallel::forEachRange(height, workers, [&](size_t begin, size_t end, uint32_t) {
+            for (size_t y = begin; y < end; y++) {
+                const uint8_t* current = rgba + rowPitch * y;
+                const uint8_t* previous = y > 0 ? current - rowPitch : zeroRow.data();
+                uint8_t* output = &filtered[filteredRowBytes * y];
+
+                Filter filter = options.filter == Filter::Adaptive ? chooseFilter(current, previous, rowBytes) : options.filter;
+
+                output[0] = static_cast<uint8_t>(filter);
+                filterRow(filter, current, previous, output + 1, rowBytes);
+            }
+        });
+
+        // 按同样的划分压缩，每段一个IDAT块
+        std::vector<std::vector<uint8_t>> chunks(workers);
+        std::vector<uint32_t> adlers(workers, 1);
+        std::vector<size_t> bandBytes(workers, 0);
+
+        Parallel::forEachRange(height, workers, [&](size_t begin, size_t end, uint32_t worker) {
+            size_t byteBegin = filteredRowBytes * begin;
+            size_t byteEnd = filteredRowBytes * end;
+            size_t windowStart = byteBegin > windowSize ? byteBegin - windowSize : 0;
+
+            std::vector<uint8_t>& chunk = chunks[worker];
+
+            // 预留长度和类型，压缩完再填
+            chunk.reserve((byteEnd - byteBegin) / 2 + 64);
+            chunk.resize(8);
+            memcpy(&chunk[4], "IDAT", 4);
+
+            if (worker == 0) {
+                // zlib头：deflate，32KB窗口，FLEVEL按压缩级别填写，FCHECK使头部能被31整除
+                uint32_t level = std::min(std::max(options.level, 0), 9);
+                uint32_t compressionFlag = level <= 1 ? 0 : level <= 5 ? 1 : level == 6 ? 2 : 3;
+                uint32_t header = (0x78 << 8) | (compressionFlag << 6);
+
+                header += 31 - header % 31;
+
+                chunk.push_back(static_cast<uint8_t>(header >> 8));
+                chunk.push_back(static_cast<uint8_t>(header));
+            }
+
+            DeflateEncoder encoder(chunk, options.level);
+            encoder.compress(filtered.data(), windowStart, byteBegin, byteEnd, worker == workers - 1);
+
+            writeBigEndian(&chunk[0], static_cast<uint32_t>(chunk.size() - 8));
+            uint32_t crc = crc32(0, &chunk[4], chunk.size() - 4);
+
+            chunk.resize(chunk.size() + 4);
+            writeBigEndian(&chunk[chunk.size() - 4], crc);
+
+            adlers[worker] = adler32(filtered.data() + byteBegin, byteEnd - byteBegin);
+            bandBytes[worker] = byteEnd - byteBegin;
+        });
+
+        uint32_t adler = adlers[0];
+
+        for (uint32_t worker = 1; worker < workers; worker++) {
+            adler = adler32Combine(adler, adlers[worker], bandBytes[worker]);
+        }
+
+        size_t totalSize = 8 + 25 + 16 + 12;
+
+        for (const auto& chunk : chunks) {
+            totalSize += chunk.size();
+        }
+
+        png.reserve(totalSize);
+
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        png.insert(png.end(), signature, signature + 8);
+
+        // 8位RGBA，标准压缩和滤波方式，不隔行
+        uint8_t header[13];
+        writeBigEndian(header, width);
+        writeBigEndian(header + 4, height);
+        header[8] = 8;
+        header[9] = 6;
+        header[10] = 0;
+        header[11] = 0;
+        header[12] = 0;
+
+        appendChunk(png, "IHDR", header, sizeof(header));
+
+        for (const auto& chunk : chunks) {
+            png.insert(png.end(), chunk.begin(), chunk.end());
+        }
+
+        // zlib流末尾的Adler-32单独放在最后一个IDAT块中
+        uint8_t trailer[4];
+        writeBigEndian(trailer, adler);
+
+        appendChunk(png, "IDAT", trailer, sizeof(trailer));
+        appendChunk(png, "IEND", nullptr, 0);
+
+        return true;
+    }
+
+    bool save(const std::string& fileName, const uint8_t* rgba, size_t rowPitch, uint32_t width, uint32_t height,
+              const Options& options) {
+        std::vector<uint8_t> png;
+
+        if (!encode(rgba, rowPitch, width, height, png, options)) {
+            return false;
+        }
+
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+
+        if (!file) {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(png.data()), png.size());
+
+        return static_cast<bool>(file);
+    }
+}
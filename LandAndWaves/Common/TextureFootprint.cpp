@@ -0,0 +1,320 @@
+#include "TextureFootprint.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TEXTURE_FOOTPRINT_SSE2 1
+#endif
+
+namespace TextureFootprint {
+    namespace {
+        // 小于这个大小的复制直接在调用线程中用memcpy完成
+        const size_t minParallelBytes = 1 << 20;
+        const size_t minBytesPerWorker = 1 << 19;
+        const size_t minStreamBytes = 1 << 16;
+
+        uint64_t align(uint64_t value, uint64_t alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        uint32_t mipSize(uint64_t size, uint32_t mip) {
+            return static_cast<uint32_t>(std::max<uint64_t>(1, size >> mip));
+        }
+
+        void copyRow(uint8_t* dest, const uint8_t* src, size_t rowBytes, bool stream) {
+#if defined(TEXTURE_FOOTPRINT_SSE2)
+            if (stream) {
+                // 先用memcpy把目标地址对齐到16字节，中间部分用_mm_stream_si128，剩下不足16字节的部分再用memcpy
+                size_t head = std::min(rowBytes, static_cast<size_t>((16 - (reinterpret_cast<uintptr_t>(dest) & 15)) & 15));
+
+                memcpy(dest, src, head);
+
+                size_t offset = head;
+
+                for (; offset + 64 <= rowBytes; offset += 64) {
+                    __m128i data0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + offset));
+                    __m128i data1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + offset + 16));
+                    __m128i data2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + offset + 32));
+                    __m128i data3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + offset + 48));
+
+                    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + offset), data0);
+                    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + offset + 16), data1);
+                    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + offset + 32), data2);
+                    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + offset + 48), data3);
+                }
+
+                for (; offset + 16 <= rowBytes; offset += 16) {
+                    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + offset), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + offset)));
+                }
+
+                memcpy(dest + offset, src + offset, rowBytes - offset);
+                return;
+            }
+#endif
+
+            memcpy(dest, src, rowBytes);
+        }
+    }
+
+    bool getFormatInfo(DXGI_FORMAT format, FormatInfo& info) {
+        info = FormatInfo();
+
+        switch (format) {
+        case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R32G32B32A32_UINT:
+        case DXGI_FORMAT_R32G32B32A32_SINT:
+            info.bytesPerBlock = 16;
+            return true;
+
+        case DXGI_FORMAT_R32G32B32_TYPELESS:
+        case DXGI_FORMAT_R32G32B32_FLOAT:
+        case DXGI_FORMAT_R32G32B32_UINT:
+        case DXGI_FORMAT_R32G32B32_SINT:
+            info.bytesPerBlock = 12;
+            return true;
+
+        case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R16G16B16A16_UINT:
+        case DXGI_FORMAT_R16G16B16A16_SNORM:
+        case DXGI_FORMAT_R16G16B16A16_SINT:
+        case DXGI_FORMAT_R32G32_TYPELESS:
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_R32G32_UINT:
+        case DXGI_FORMAT_R32G32_SINT:
+        case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+        case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+        case DXGI_FORMAT_Y416:
+            info.bytesPerBlock = 8;
+            return true;
+
+        case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+        case DXGI_FORMAT_R10G10B10A2_UNORM:
+        case DXGI_FORMAT_R10G10B10A2_UINT:
+        case DXGI_FORMAT_R11G11B10_FLOAT:
+        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_R8G8B8A8_UINT:
+        case DXGI_FORMAT_R8G8B8A8_SNORM:
+        case DXGI_FORMAT_R8G8B8A8_SINT:
+        case DXGI_FORMAT_R16G16_TYPELESS:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R16G16_UNORM:
+        case DXGI_FORMAT_R16G16_UINT:
+        case DXGI_FORMAT_R16G16_SNORM:
+        case DXGI_FORMAT_R16G16_SINT:
+        case DXGI_FORMAT_R32_TYPELESS:
+        case DXGI_FORMAT_D32_FLOAT:
+        case DXGI_FORMAT_R32_FLOAT:
+        case DXGI_FORMAT_R32_UINT:
+        case DXGI_FORMAT_R32_SINT:
+        case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+        case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+        case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        case DXGI_FORMAT_AYUV:
+        case DXGI_FORMAT_Y410:
+            info.bytesPerBlock = 4;
+            return true;
+
+        case DXGI_FORMAT_R8G8_TYPELESS:
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R8G8_UINT:
+        case DXGI_FORMAT_R8G8_SNORM:
+        case DXGI_FORMAT_R8G8_SINT:
+        case DXGI_FORMAT_R16_TYPELESS:
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_D16_UNORM:
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_R16_UINT:
+        case DXGI_FORMAT_R16_SNORM:
+        case DXGI_FORMAT_R16_SINT:
+        case DXGI_FORMAT_B5G6R5_UNORM:
+        case DXGI_FORMAT_B5G5R5A1_UNORM:
+        case DXGI_FORMAT_B4G4R4A4_UNORM:
+        case DXGI_FORMAT_A8P8:
+            info.bytesPerBlock = 2;
+            return true;
+
+        case DXGI_FORMAT_R8_TYPELESS:
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_R8_UINT:
+        case DXGI_FORMAT_R8_SNORM:
+        case DXGI_FORMAT_R8_SINT:
+        case DXGI_FORMAT_A8_UNORM:
+        case DXGI_FORMAT_AI44:
+        case DXGI_FORMAT_IA44:
+        case DXGI_FORMAT_P8:
+            info.bytesPerBlock = 1;
+            return true;
+
+        // 两个像素共用一个块(4:2:2)
+        case DXGI_FORMAT_R8G8_B8G8_UNORM:
+        case DXGI_FORMAT_G8R8_G8B8_UNORM:
+        case DXGI_FORMAT_YUY2:
+            info.blockWidth = 2;
+            info.bytesPerBlock = 4;
+            return true;
+
+        case DXGI_FORMAT_Y210:
+        case DXGI_FORMAT_Y216:
+            info.blockWidth = 2;
+            info.bytesPerBlock = 8;
+            return true;
+
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            info.blockWidth = 4;
+            info.blockHeight = 4;
+            info.bytesPerBlock = 8;
+            return true;
+
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            info.blockWidth = 4;
+            info.blockHeight = 4;
+            info.bytesPerBlock = 16;
+            return true;
+
+        default:
+            // DXGI_FORMAT_UNKNOWN、R1_UNORM，以及D24_UNORM_S8_UINT、R24G8_TYPELESS、D32_FLOAT_S8X24_UINT、
+            // R32G8X24_TYPELESS、NV12、P010、P016、420_OPAQUE、NV11、P208、V208、V408等多平面格式
+            return false;
+        }
+    }
+
+    bool getCopyableFootprints(const D3D12_RESOURCE_DESC& desc,
+                               uint32_t firstSubresource,
+                               uint32_t numSubresources,
+                               uint64_t baseOffset,
+                               D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts,
+                               uint32_t* numRows,
+                               uint64_t* rowSizeInBytes,
+                               uint64_t* totalBytes) {
+        FormatInfo info;
+
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER || desc.Dimension == D3D12_RESOURCE_DIMENSION_UNKNOWN ||
+            !getFormatInfo(desc.Format, info)) {
+            return false;
+        }
+
+        bool is3D = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+        uint32_t mipLevels = std::max<uint32_t>(desc.MipLevels, 1);
+        uint32_t arraySize = is3D ? 1 : std::max<uint32_t>(desc.DepthOrArraySize, 1);
+        uint32_t height = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE1D ? 1 : desc.Height;
+
+        if (static_cast<uint64_t>(firstSubresource) + numSubresources > static_cast<uint64_t>(mipLevels) * arraySize) {
+            return false;
+        }
+
+        uint64_t offset = align(baseOffset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        uint64_t total = 0;
+
+        for (uint32_t index = 0; index < numSubresources; index++) {
+            uint32_t subresource = firstSubresource + index;
+            uint32_t mip = subresource % mipLevels;
+
+            uint32_t mipWidth = static_cast<uint32_t>(align(mipSize(desc.Width, mip), info.blockWidth));
+            uint32_t mipHeight = static_cast<uint32_t>(align(mipSize(height, mip), info.blockHeight));
+            uint32_t mipDepth = is3D ? mipSize(desc.DepthOrArraySize, mip) : 1;
+
+            uint32_t rows = mipHeight / info.blockHeight;
+            uint64_t rowSize = static_cast<uint64_t>(mipWidth / info.blockWidth) * info.bytesPerBlock;
+            uint64_t rowPitch = align(rowSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+
+            offset = align(offset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+            if (layouts != nullptr) {
+                layouts[index].Offset = offset;
+                layouts[index].Footprint.Format = desc.Format;
+                layouts[index].Footprint.Width = mipWidth;
+                layouts[index].Footprint.Height = mipHeight;
+                layouts[index].Footprint.Depth = mipDepth;
+                layouts[index].Footprint.RowPitch = static_cast<uint32_t>(rowPitch);
+            }
+
+            if (numRows != nullptr) {
+                numRows[index] = rows;
+            }
+
+            if (rowSizeInBytes != nullptr) {
+                rowSizeInBytes[index] = rowSize;
+            }
+
+            // 最后一行只需要rowSize个字节，不需要对齐到rowPitch
+            total = offset + rowPitch * (static_cast<uint64_t>(rows) * mipDepth - 1) + rowSize - align(baseOffset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+            offset += rowPitch * rows * mipDepth;
+        }
+
+        if (totalBytes != nullptr) {
+            *totalBytes = total;
+        }
+
+        return true;
+    }
+
+    void copyRows(uint8_t* dest, size_t destRowPitch, const uint8_t* src, size_t srcRowPitch, size_t rowBytes, uint32_t numRows) {
+        size_t totalBytes = rowBytes * numRows;
+        bool stream = totalBytes >= minStreamBytes;
+
+        uint32_t workers = 1;
+
+        if (totalBytes >= minParallelBytes) {
+            size_t minRowsPerWorker = std::max<size_t>(1, minBytesPerWorker / std::max<size_t>(rowBytes, 1));
+            workers = Parallel::workerCount(numRows, minRowsPerWorker);
+        }
+
+        Parallel::forEachRange(numRows, workers, [&](size_t begin, size_t end, uint32_t) {
+            for (size_t row = begin; row < end; row++) {
+                copyRow(dest + destRowPitch * row, src + srcRowPitch * row, rowBytes, stream);
+            }
+
+#if defined(TEXTURE_FOOTPRINT_SSE2)
+            // non-temporal store是弱序的，线程结束前要保证它们对其他线程(和之后的Unmap)可见
+            if (stream) {
+                _mm_sfence();
+            }
+#endif
+        });
+    }
+
+    void copySubresource(uint8_t* mappedData, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout, uint32_t numRows, uint64_t rowSizeInBytes,
+                         const void* src, size_t srcRowPitch, size_t srcSlicePitch) {
+        size_t destSlicePitch = static_cast<size_t>(layout.Footprint.RowPitch) * numRows;
+
+        for (uint32_t slice = 0; slice < layout.Footprint.Depth; slice++) {
+            copyRows(mappedData + layout.Offset + destSlicePitch * slice, layout.Footprint.RowPitch,
+                     static_cast<const uint8_t*>(src) + srcSlicePitch * slice, srcRowPitch,
+                     static_cast<size_t>(rowSizeInBytes), numRows);
+        }
+    }
+}
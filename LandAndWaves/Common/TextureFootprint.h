@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <d3d12.h>
+
+// 不依赖设备的纹理内存布局计算和按行复制
+//
+// getCopyableFootprints与ID3D12Device::GetCopyableFootprints的结果相同：
+//   每个子资源的Offset按D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT(512)对齐
+//   RowPitch按D3D12_TEXTURE_DATA_PITCH_ALIGNMENT(256)对齐
+//   压缩格式(BC1~BC7)和打包格式(R8G8_B8G8等)按块计算，一行是一行块，Width/Height向上对齐到块的大小
+//   子资源编号 = mip + arraySlice * MipLevels
+//   totalBytes不包含最后一行的对齐填充，与GetRequiredIntermediateSize相同
+// 支持所有单平面(single-plane)的纹理格式和1D/2D/3D纹理、纹理数组和mip。
+// 多平面格式(NV12、P010、D24_UNORM_S8_UINT等)以及Buffer返回false。
+namespace TextureFootprint {
+    struct FormatInfo {
+        // 压缩格式的块是4 x 4，打包格式是2 x 1，其他格式是1 x 1
+        uint32_t blockWidth = 1;
+        uint32_t blockHeight = 1;
+        uint32_t bytesPerBlock = 0;
+    };
+
+    // 不支持的格式返回false
+    bool getFormatInfo(DXGI_FORMAT format, FormatInfo& info);
+
+    // 参数与ID3D12Device::GetCopyableFootprints相同，输出参数都可以为nullptr
+    bool getCopyableFootprints(const D3D12_RESOURCE_DESC& desc,
+                               uint32_t firstSubresource,
+                               uint32_t numSubresources,
+                               uint64_t baseOffset,
+                               D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts,
+                               uint32_t* numRows,
+                               uint64_t* rowSizeInBytes,
+                               uint64_t* totalBytes);
+
+    // 把numRows行、每行rowBytes字节从src复制到dest，两边的行大小可以不同。
+    // 数据量大时按行分给多个线程，并且使用不经过缓存的写入(non-temporal store)：
+    // 上传堆是写合并(write-combined)内存，写进去的数据CPU不会再读
+    void copyRows(uint8_t* dest, size_t destRowPitch, const uint8_t* src, size_t srcRowPitch, size_t rowBytes, uint32_t numRows);
+
+    // 把一个子资源复制到Map之后的上传堆中，layout等由getCopyableFootprints得到
+    void copySubresource(uint8_t* mappedData, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout, uint32_t numRows, uint64_t rowSizeInBytes,
+                         const void* src, size_t srcRowPitch, size_t srcSlicePitch);
+}
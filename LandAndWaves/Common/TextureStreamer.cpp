@@ -0,0 +1,366 @@
+#include "TextureStreamer.h"
+#include "TextureFootprint.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+TextureStreamer::TextureStreamer(const Options& inOptions, Executor inExecutor) : options(inOptions), executor(std::move(inExecutor)) {
+}
+
+TextureStreamer::~TextureStreamer() {
+    // load函数可能引用调用者的对象，必须等它们都返回
+    for (auto& texture : textures) {
+        if (isLoading(texture)) {
+            texture.loading.wait();
+        }
+    }
+}
+
+TextureStreamer::TextureId TextureStreamer::add(const D3D12_RESOURCE_DESC& desc, LoadFunction load) {
+    if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE1D
+        && desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D
+        && desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE3D) {
+        return invalidId;
+    }
+
+    Texture texture;
+    texture.load = std::move(load);
+    texture.width = static_cast<uint32_t>(desc.Width);
+    texture.height = desc.Height;
+
+    // MipLevels为0时表示完整的mip链
+    D3D12_RESOURCE_DESC fullDesc = desc;
+
+    if (fullDesc.MipLevels == 0) {
+        uint64_t size = std::max<uint64_t>({ desc.Width, desc.Height, desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? desc.DepthOrArraySize : 1u });
+
+        while (size > 0) {
+            fullDesc.MipLevels++;
+            size >>= 1;
+        }
+    }
+
+    texture.mipLevels = fullDesc.MipLevels;
+    texture.mipBytes.resize(texture.mipLevels);
+
+    uint32_t arraySize = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+
+    for (uint32_t mip = 0; mip < texture.mipLevels; mip++) {
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+        uint32_t numRows = 0;
+        uint64_t rowSizeInBytes = 0;
+
+        if (!TextureFootprint::getCopyableFootprints(fullDesc, mip, 1, 0, &layout, &numRows, &rowSizeInBytes, nullptr)) {
+            return invalidId;
+        }
+
+        // 按紧密排列计算，上传堆中的对齐填充不算驻留内存
+        texture.mipBytes[mip] = rowSizeInBytes * numRows * layout.Footprint.Depth * arraySize;
+    }
+
+    texture.tailMip = 0;
+
+    while (texture.tailMip + 1 < texture.mipLevels
+           && (std::max(1u, texture.width >> texture.tailMip) > options.mipTailSize
+               || std::max(1u, texture.height >> texture.tailMip) > options.mipTailSize)) {
+        texture.tailMip++;
+    }
+
+    texture.residentMip = texture.mipLevels;
+    texture.desiredMip = texture.tailMip;
+    texture.lastRequestFrame = frame;
+    texture.active = true;
+
+    TextureId id;
+
+    if (freeIds.empty()) {
+        id = static_cast<TextureId>(textures.size());
+        textures.push_back(std::move(texture));
+    }
+    else {
+        id = freeIds.back();
+        freeIds.pop_back();
+        textures[id] = std::move(texture);
+    }
+
+    // mip尾不受每帧预算的限制，超出内存预算的部分在下一次update()中淘汰其他纹理
+    startLoad(id, textures[id].tailMip, textures[id].mipLevels - textures[id].tailMip);
+
+    return id;
+}
+
+void TextureStreamer::remove(TextureId id) {
+    Texture& texture = textures[id];
+
+    if (!texture.active) {
+        return;
+    }
+
+    for (uint32_t mip = texture.residentMip; mip < texture.mipLevels; mip++) {
+        statistics.residentBytes -= texture.mipBytes[mip];
+    }
+
+    texture.active = false;
+    texture.load = nullptr;
+
+    // 加载中的槽位在加载完成之后才能复用
+    if (!isLoading(texture)) {
+        texture = Texture();
+        freeIds.push_back(id);
+    }
+}
+
+void TextureStreamer::request(TextureId id, float screenSize) {
+    Texture& texture = textures[id];
+
+    texture.requestedSize = texture.requestedThisFrame ? std::max(texture.requestedSize, screenSize) : screenSize;
+    texture.requestedThisFrame = true;
+}
+
+float TextureStreamer::screenSize(float radius, float distance, float viewportHeight, float fovY) {
+    // 相机在包围球内部时纹理可能铺满整个屏幕
+    if (distance <= radius) {
+        return viewportHeight;
+    }
+
+    return radius / (distance * std::tan(fovY * 0.5f)) * viewportHeight;
+}
+
+std::vector<TextureStreamer::Event> TextureStreamer::update() {
+    std::vector<Event> events;
+
+    finishLoads(events);
+
+    statistics.frameBytes = 0;
+    statistics.deferredLoads = 0;
+
+    struct Candidate {
+        TextureId id;
+        float priority;
+    };
+
+    std::vector<Candidate> candidates;
+
+    for (TextureId id = 0; id < static_cast<TextureId>(textures.size()); id++) {
+        Texture& texture = textures[id];
+
+        if (!texture.active) {
+            continue;
+        }
+
+        texture.desiredMip = computeDesiredMip(texture);
+
+        if (texture.requestedThisFrame) {
+            texture.lastRequestFrame = frame;
+        }
+
+        if (isLoading(texture)) {
+            continue;
+        }
+
+        // mip尾加载失败时重新请求
+        if (texture.residentMip > texture.tailMip) {
+            startLoad(id, texture.tailMip, texture.mipLevels - texture.tailMip);
+            continue;
+        }
+
+        // 优先级是驻留的最细一级在屏幕上被放大的倍数
+        if (texture.residentMip > texture.desiredMip) {
+            float residentSize = static_cast<float>(std::max(texture.width, texture.height) >> texture.residentMip);
+            candidates.push_back({ id, texture.requestedSize / std::max(1.0f, residentSize) });
+        }
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.priority > b.priority;
+    });
+
+    // 预算调小之后先淘汰超出的部分
+    makeRoom(0, invalidId, events);
+
+    for (const auto& candidate : candidates) {
+        Texture& texture = textures[candidate.id];
+        uint32_t mip = texture.residentMip - 1;
+        uint64_t bytes = texture.mipBytes[mip];
+
+        // 放不下的大mip让给后面小的mip，但一帧至少提交一个，避免大mip永远等不到
+        if (statistics.frameBytes > 0 && statistics.frameBytes + bytes > options.frameBudget) {
+            statistics.deferredLoads++;
+            continue;
+        }
+
+        if (!makeRoom(bytes, candidate.id, events)) {
+            statistics.deferredLoads++;
+            continue;
+        }
+
+        startLoad(candidate.id, mip, 1);
+        statistics.frameBytes += bytes;
+    }
+
+    for (auto& texture : textures) {
+        texture.requestedThisFrame = false;
+        texture.requestedSize = 0.0f;
+    }
+
+    frame++;
+
+    return events;
+}
+
+uint32_t TextureStreamer::residentMip(TextureId id) const {
+    return textures[id].residentMip;
+}
+
+uint32_t TextureStreamer::desiredMip(TextureId id) const {
+    return textures[id].desiredMip;
+}
+
+uint32_t TextureStreamer::tailMip(TextureId id) const {
+    return textures[id].tailMip;
+}
+
+bool TextureStreamer::isReady(TextureId id) const {
+    return textures[id].residentMip <= textures[id].tailMip;
+}
+
+uint64_t TextureStreamer::mipBytes(TextureId id, uint32_t mip) const {
+    return textures[id].mipBytes[mip];
+}
+
+uint32_t TextureStreamer::computeDesiredMip(const Texture& texture) const {
+    if (!texture.requestedThisFrame || texture.requestedSize <= 0.0f) {
+        return texture.tailMip;
+    }
+
+    // 最粗的、大小仍然不小于屏幕上大小的一级
+    float mip = std::log2(static_cast<float>(std::max(texture.width, texture.height)) / texture.requestedSize) + options.mipBias;
+
+    if (mip <= 0.0f) {
+        return 0;
+    }
+
+    return std::min(texture.tailMip, static_cast<uint32_t>(mip));
+}
+
+void TextureStreamer::startLoad(TextureId id, uint32_t firstMip, uint32_t mipCount) {
+    Texture& texture = textures[id];
+
+    uint64_t bytes = 0;
+
+    for (uint32_t mip = firstMip; mip < firstMip + mipCount; mip++) {
+        bytes += texture.mipBytes[mip];
+    }
+
+    // 复制一份load，textures扩容时任务中的引用不会失效
+    auto task = std::make_shared<std::packaged_task<bool()>>([load = texture.load, firstMip, mipCount]() {
+        return load(firstMip, mipCount);
+    });
+
+    texture.loading = task->get_future();
+    texture.loadFirstMip = firstMip;
+    texture.loadMipCount = mipCount;
+    texture.loadBytes = bytes;
+
+    statistics.loadingBytes += bytes;
+    statistics.loadsInFlight++;
+
+    if (executor) {
+        executor([task]() { (*task)(); });
+    }
+    else {
+        (*task)();
+    }
+}
+
+void TextureStreamer::finishLoads(std::vector<Event>& events) {
+    for (TextureId id = 0; id < static_cast<TextureId>(textures.size()); id++) {
+        Texture& texture = textures[id];
+
+        if (!isLoading(texture) || texture.loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            continue;
+        }
+
+        bool succeeded = false;
+
+        try {
+            succeeded = texture.loading.get();
+        }
+        catch (...) {
+            succeeded = false;
+        }
+
+        uint32_t firstMip = texture.loadFirstMip;
+        uint32_t mipCount = texture.loadMipCount;
+        uint64_t bytes = texture.loadBytes;
+
+        texture.loadFirstMip = noLoad;
+        texture.loadMipCount = 0;
+        texture.loadBytes = 0;
+
+        statistics.loadingBytes -= bytes;
+        statistics.loadsInFlight--;
+
+        if (!texture.active) {
+            texture = Texture();
+            freeIds.push_back(id);
+            continue;
+        }
+
+        if (succeeded) {
+            texture.residentMip = firstMip;
+
+            statistics.residentBytes += bytes;
+            statistics.totalLoadedBytes += bytes;
+
+            events.push_back({ Event::Type::Loaded, id, firstMip, mipCount, texture.residentMip });
+        }
+    }
+}
+
+bool TextureStreamer::makeRoom(uint64_t bytes, TextureId exclude, std::vector<Event>& events) {
+    while (statistics.residentBytes + statistics.loadingBytes + bytes > options.memoryBudget) {
+        // 只淘汰超过需要的mip(没有被请求的纹理需要的就是mip尾)，其中最久没有被请求的先淘汰，
+        // 同一帧的按这一级的大小，大的先淘汰
+        TextureId victim = invalidId;
+
+        for (TextureId id = 0; id < static_cast<TextureId>(textures.size()); id++) {
+            const Texture& texture = textures[id];
+
+            if (!texture.active || id == exclude || isLoading(texture) || texture.residentMip >= texture.desiredMip) {
+                continue;
+            }
+
+            if (victim == invalidId) {
+                victim = id;
+                continue;
+            }
+
+            const Texture& current = textures[victim];
+
+            if (texture.lastRequestFrame < current.lastRequestFrame
+                || (texture.lastRequestFrame == current.lastRequestFrame
+                    && texture.mipBytes[texture.residentMip] > current.mipBytes[current.residentMip])) {
+                victim = id;
+            }
+        }
+
+        if (victim == invalidId) {
+            return false;
+        }
+
+        Texture& texture = textures[victim];
+        uint64_t evictedBytes = texture.mipBytes[texture.residentMip];
+
+        texture.residentMip++;
+
+        statistics.residentBytes -= evictedBytes;
+        statistics.totalEvictedBytes += evictedBytes;
+
+        events.push_back({ Event::Type::Evicted, victim, texture.residentMip - 1, 1, texture.residentMip });
+    }
+
+    return true;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <vector>
+
+#include <d3d12.h>
+
+// 纹理流送：按优先级异步加载mip，限制每帧的加载量和驻留的总内存
+//
+// 每个纹理的mip尾(宽高都不超过Options::mipTailSize的各级)在add()时立即请求，之后一直驻留。
+// 更高的mip由渲染项每帧调用request()给出纹理在屏幕上的大小，update()时算出需要的mip，
+// 按驻留的mip被放大的程度排优先级，在每帧的字节预算内提交异步加载。
+// 驻留的mip总是连续的一段[residentMip, mipLevels)：加载时从粗到细一级一级进行，淘汰时从最细的一级开始。
+// 驻留和加载中的总字节数超过memoryBudget时，按最后一次被request的帧(LRU)淘汰其他纹理的mip，
+// 本帧请求过的纹理只淘汰超过需要的部分，mip尾不淘汰。
+//
+// 驻留状态和内存统计完全在CPU上维护，不依赖设备：load函数负责读出数据(比如从DDSFile::View复制到上传堆)，
+// 渲染线程根据update()返回的事件记录上传命令、调整SRV的ResourceMinLODClamp，等GPU用完后再释放被淘汰的mip。
+// executor为空时load在提交时同步执行，结果在下一次update()生效，方便在没有设备的情况下测试。
+class TextureStreamer {
+public:
+    using TextureId = uint32_t;
+    static const TextureId invalidId = UINT32_MAX;
+
+    // 在工作线程中加载[firstMip, firstMip + mipCount)的所有数组元素，失败时返回false，之后会重新请求
+    using LoadFunction = std::function<bool(uint32_t firstMip, uint32_t mipCount)>;
+    // 把任务交给工作线程，比如[loader](std::function<void()> task) { loader->run(std::move(task)); }
+    using Executor = std::function<void(std::function<void()>)>;
+
+    struct Options {
+        // 驻留和加载中的mip的总字节数上限
+        uint64_t memoryBudget = 256ull << 20;
+        // 每帧最多提交的加载字节数，一级mip超过预算时在没有其他加载的帧单独提交
+        uint64_t frameBudget = 8ull << 20;
+        // 宽高都不超过这个大小的mip属于mip尾
+        uint32_t mipTailSize = 64;
+        // 大于0时需要的mip更粗，用于整体降低质量
+        float mipBias = 0.0f;
+    };
+
+    struct Event {
+        enum class Type {
+            Loaded,
+            Evicted
+        };
+
+        Type type;
+        TextureId texture;
+        uint32_t firstMip;
+        uint32_t mipCount;
+        // 事件之后的residentMip
+        uint32_t residentMip;
+    };
+
+    struct Stats {
+        uint64_t residentBytes = 0;
+        uint64_t loadingBytes = 0;
+        // 最近一次update()提交的加载字节数
+        uint64_t frameBytes = 0;
+        uint32_t loadsInFlight = 0;
+        // 最近一次update()中想加载但因为预算没有提交的mip数
+        uint32_t deferredLoads = 0;
+        uint64_t totalLoadedBytes = 0;
+        uint64_t totalEvictedBytes = 0;
+    };
+
+    TextureStreamer() : TextureStreamer(Options()) {}
+    explicit TextureStreamer(const Options& options, Executor executor = Executor());
+    // 等待所有加载中的load函数返回
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer& rhs) = delete;
+    TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+
+    // desc与创建纹理时相同，格式不被TextureFootprint支持时返回invalidId
+    TextureId add(const D3D12_RESOURCE_DESC& desc, LoadFunction load);
+    // 加载中的mip完成后直接丢弃
+    void remove(TextureId texture);
+
+    // screenSize为纹理在屏幕上覆盖的像素数(沿较长的一边)，同一帧多次调用时取最大值
+    void request(TextureId texture, float screenSize);
+
+    // 半径为radius、距离为distance的包围球在屏幕上的直径(像素)，fovY为垂直视角(弧度)
+    static float screenSize(float radius, float distance, float viewportHeight, float fovY);
+
+    // 每帧在渲染线程调用一次：处理完成的加载，按需淘汰，提交新的加载
+    std::vector<Event> update();
+
+    void setOptions(const Options& newOptions) { options = newOptions; }
+    const Options& getOptions() const { return options; }
+
+    // 没有任何mip驻留时返回mipLevels
+    uint32_t residentMip(TextureId texture) const;
+    // 最近一次update()算出的需要的mip
+    uint32_t desiredMip(TextureId texture) const;
+    uint32_t tailMip(TextureId texture) const;
+    // mip尾已经驻留，可以开始使用
+    bool isReady(TextureId texture) const;
+    // 一级mip所有数组元素的字节数
+    uint64_t mipBytes(TextureId texture, uint32_t mip) const;
+
+    const Stats& stats() const { return statistics; }
+
+private:
+    static const uint32_t noLoad = UINT32_MAX;
+
+    struct Texture {
+        bool active = false;
+        LoadFunction load;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipLevels = 0;
+        uint32_t tailMip = 0;
+        std::vector<uint64_t> mipBytes;
+
+        uint32_t residentMip = 0;
+        uint32_t desiredMip = 0;
+        float requestedSize = 0.0f;
+        uint64_t lastRequestFrame = 0;
+        bool requestedThisFrame = false;
+
+        std::future<bool> loading;
+        uint32_t loadFirstMip = noLoad;
+        uint32_t loadMipCount = 0;
+        uint64_t loadBytes = 0;
+    };
+
+    bool isLoading(const Texture& texture) const { return texture.loadFirstMip != noLoad; }
+    uint32_t computeDesiredMip(const Texture& texture) const;
+    void startLoad(TextureId id, uint32_t firstMip, uint32_t mipCount);
+    void finishLoads(std::vector<Event>& events);
+    // 淘汰直到还能放下bytes，exclude不会被淘汰
+    bool makeRoom(uint64_t bytes, TextureId exclude, std::vector<Event>& events);
+
+    Options options;
+    Executor executor;
+    std::vector<Texture> textures;
+    std::vector<TextureId> freeIds;
+    uint64_t frame = 0;
+    Stats statistics;
+};
@@ -4,6 +4,7 @@
 #include <wincodec.h>
 #include "d3dUtil.h"
 #include "lodepng.h"
+#include "PngWriter.h"
 
 struct WICTranslate
 {
@@ -770,28 +771,14 @@ static  std::vector<ComPtr<IWICBitmapSource>> WICLoadImage(const std::wstring& f
     return bmps;
 }
 
-static void saveImage(const std::string& path, byte* pixels, int width, int height)
+// 编码或写文件失败时输出到调试器并返回false
+static bool saveImage(const std::string& path, byte* pixels, int width, int height)
 {
-	std::vector<unsigned char> pixelBuffer;
-
-	int pixelCount = width * height;
-
-	byte* pixelPtr = pixels;
-
-	for (int i = 0; i < pixelCount; i++) {
-		// pixelBuffer.push_back((unsigned char)pixelPtr[i * 4]);
-		// pixelBuffer.push_back((unsigned char)pixelPtr[i * 4 + 1]);
-		// pixelBuffer.push_back((unsigned char)pixelPtr[i * 4 + 2]);
-		// pixelBuffer.push_back((unsigned char)pixelPtr[i * 4 + 3]);
-		pixelBuffer.push_back((unsigned char)pixelPtr[0]);
-		pixelBuffer.push_back((unsigned char)pixelPtr[1]);
-		pixelBuffer.push_back((unsigned char)pixelPtr[2]);
-		pixelBuffer.push_back((unsigned char)pixelPtr[3]);
-		pixelPtr += 4;
+	// 直接从回读的像素编码，不再逐字节复制到临时的vector
+	if (!PngWriter::save(path, pixels, static_cast<size_t>(width) * 4, width, height)) {
+		::OutputDebugStringA(("saveImage: failed to write " + path + "\n").c_str());
+		return false;
 	}
 
-	//Encode the image
-	unsigned error = lodepng::encode(path, pixelBuffer, width, height);
-
-	pixelBuffer.clear();
+	return true;
 }
\ No newline at end of file
@@ -169,6 +169,9 @@ struct SubmeshGeometry
     // Bounding box of the geometry defined by this submesh. 
     // This is used in later chapters of the book.
 	DirectX::BoundingBox Bounds;
+
+    // Bounding sphere of the same geometry, see MeshBounds.
+	DirectX::BoundingSphere SphereBounds;
 };
 
 struct MeshGeometry
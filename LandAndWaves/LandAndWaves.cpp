@@ -1,7 +1,15 @@
 ﻿#include "LandAndWaves.h"
 #include "Common/d3dUtil.h"
+#include "Common/FrameDelta.h"
+#include "Common/Hash.h"
 #include "Common/WICUtils.h"
 #include "Common/MathHelper.h"
+#include "Common/MeshBounds.h"
+#include "Common/MeshCodec.h"
+#include "Common/MeshLoader.h"
+#include "Common/MeshProcessing.h"
+#include "Common/Palettized.h"
+#include "Common/TextureFootprint.h"
 #include <DirectXColors.h>
 
 #include "imgui/imgui_impl_win32.h"
@@ -9,7 +17,79 @@
 
 #include "Waves.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <unordered_map>
+
+namespace {
+    // DecodedImages在派生数据缓存中的布局：头部之后依次是每一帧的像素，最后是调色板
+    struct DecodedImagesHeader {
+        uint32_t width;
+        uint32_t height;
+        uint32_t rowPitch;
+        uint32_t format;
+        uint32_t frameCount;
+        uint32_t paletteColorCount;
+    };
+
+    std::vector<uint8_t> packDecodedImages(const DecodedImages& images) {
+        DecodedImagesHeader header = { images.width, images.height, images.rowPitch, static_cast<uint32_t>(images.format),
+                                       static_cast<uint32_t>(images.frames.size()), static_cast<uint32_t>(images.palettes.size()) };
+
+        size_t frameSize = static_cast<size_t>(images.rowPitch) * images.height;
+        size_t paletteOffset = sizeof(header) + frameSize * images.frames.size();
+
+        std::vector<uint8_t> payload(paletteOffset + images.palettes.size() * sizeof(uint32_t));
+        memcpy(payload.data(), &header, sizeof(header));
+
+        for (size_t frameIndex = 0; frameIndex < images.frames.size(); frameIndex++) {
+            memcpy(payload.data() + sizeof(header) + frameSize * frameIndex, images.frames[frameIndex].data(), frameSize);
+        }
+
+        if (!images.palettes.empty()) {
+            memcpy(payload.data() + paletteOffset, images.palettes.data(), images.palettes.size() * sizeof(uint32_t));
+        }
+
+        return payload;
+    }
+
+    bool unpackDecodedImages(const std::vector<uint8_t>& payload, DecodedImages& images) {
+        DecodedImagesHeader header;
+
+        if (payload.size() < sizeof(header)) {
+            return false;
+        }
+
+        memcpy(&header, payload.data(), sizeof(header));
+
+        size_t frameSize = static_cast<size_t>(header.rowPitch) * header.height;
+        size_t paletteOffset = sizeof(header) + frameSize * header.frameCount;
+
+        if (payload.size() != paletteOffset + static_cast<size_t>(header.paletteColorCount) * sizeof(uint32_t)) {
+            return false;
+        }
+
+        images.width = header.width;
+        images.height = header.height;
+        images.rowPitch = header.rowPitch;
+        images.format = static_cast<DXGI_FORMAT>(header.format);
+        images.frames.resize(header.frameCount);
+
+        for (uint32_t frameIndex = 0; frameIndex < header.frameCount; frameIndex++) {
+            const uint8_t* frame = payload.data() + sizeof(header) + frameSize * frameIndex;
+            images.frames[frameIndex].assign(frame, frame + frameSize);
+        }
+
+        images.palettes.resize(header.paletteColorCount);
+
+        if (header.paletteColorCount > 0) {
+            memcpy(images.palettes.data(), payload.data() + paletteOffset, images.palettes.size() * sizeof(uint32_t));
+        }
+
+        return true;
+    }
+}
 
 LandAndWaves::LandAndWaves(HINSTANCE inInstance, const uint32_t inWindowWidth, const uint32_t inWindowHeight)
 : d3dApp(inInstance, inWindowWidth, inWindowHeight) {
@@ -47,6 +127,9 @@ LRESULT LandAndWaves::msgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 }
 
 bool LandAndWaves::initialize() {
+    // 先把纹理解码、模型解析和着色器编译交给工作线程，与设备和窗口的创建同时进行
+    requestAssets();
+
     if(!d3dApp::initialize()) {
         return false;
     }
@@ -59,14 +142,13 @@ bool LandAndWaves::initialize() {
     buildShapeGeometry();
     buildWavesGeometryBuffers();
     buildRenderItems();
-    loadResources();
 
     executeCommandList();
 
     createCBVSRVDescriptorHeaps();
     createFrameResources();
     createConstantBufferViews();
-    createShaderResourceView();
+    createNullShaderResourceViews();
     createSampler();
     createRootSignature();
     createShadersAndInputLayout();
@@ -127,6 +209,9 @@ void LandAndWaves::draw(float delta) {
         ThrowIfFailed(commandList->Reset(commandAllocator.Get(), graphicsPSOs["opaque"].Get()));
     }
 
+    // 异步加载完成的资源的上传命令和本帧的绘制命令一起提交
+    assetLoader->processUploads();
+
     // 对资源的状态进行转换，将资源从呈现状态转换为渲染目标状态
     commandList->ResourceBarrier(
         1, &CD3DX12_RESOURCE_BARRIER::Transition(
@@ -296,7 +381,8 @@ void LandAndWaves::createCBVSRVDescriptorHeaps() {
     D3D12_DESCRIPTOR_HEAP_DESC CBVDescriptorHeapDesc;
     // objectCount * frameBackBufferCount + CRV(1) + SRV(1)
     objectCount = static_cast<uint32_t>(allRenderItems.size());
-    CBVDescriptorHeapDesc.NumDescriptors = (objectCount + 1 + 1) * frameBackBufferCount + static_cast<uint32_t>(textures.size());
+    // 帧纹理的maxFrameTextures个位置之后紧跟调色板纹理
+    CBVDescriptorHeapDesc.NumDescriptors = (objectCount + 1 + 1) * frameBackBufferCount + maxFrameTextures + 1;
     CBVDescriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     CBVDescriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     CBVDescriptorHeapDesc.NodeMask = 0;
@@ -419,6 +505,29 @@ void LandAndWaves::createConstantBufferViews() {
     // }
 }
 
+void LandAndWaves::createNullShaderResourceViews() {
+    // 纹理加载完成之前所有帧纹理和调色板的位置都是空描述符，
+    // 资源绑定层级1的硬件要求描述符表中的描述符都已经初始化
+    D3D12_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc = {};
+
+    shaderResourceViewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    shaderResourceViewDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    shaderResourceViewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    shaderResourceViewDesc.Texture2D.MipLevels = 1;
+
+    uint32_t descriptorHeapIndex = (objectCount + 2) * frameBackBufferCount;
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE CBVDescriptorHeapHanle(CBVDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+
+    CBVDescriptorHeapHanle.Offset(descriptorHeapIndex, CBVSRVUAVDescriptorSize);
+
+    for (uint32_t textureIndex = 0; textureIndex < maxFrameTextures + 1; textureIndex++) {
+        device->CreateShaderResourceView(nullptr, &shaderResourceViewDesc, CBVDescriptorHeapHanle);
+
+        CBVDescriptorHeapHanle.Offset(CBVSRVUAVDescriptorSize);
+    }
+}
+
 void LandAndWaves::createShaderResourceView() {
     // 最终创建SRV描述符
     D3D12_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc = {};
@@ -439,6 +548,14 @@ void LandAndWaves::createShaderResourceView() {
 
         CBVDescriptorHeapHanle.Offset(CBVSRVUAVDescriptorSize);
     }
+
+    // 调色板固定在maxFrameTextures个帧纹理位置之后
+    if (paletteTexture) {
+        CBVDescriptorHeapHanle.InitOffsetted(CBVDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), descriptorHeapIndex + maxFrameTextures, CBVSRVUAVDescriptorSize);
+
+        shaderResourceViewDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        device->CreateShaderResourceView(paletteTexture.Get(), &shaderResourceViewDesc, CBVDescriptorHeapHanle);
+    }
 }
 
 void LandAndWaves::createSampler() {
@@ -486,7 +603,7 @@ void LandAndWaves::createRootSignature() {
     //
     // 定义大小为 10 个 SRV 数组
     // ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 10, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
-    CD3DX12_DESCRIPTOR_RANGE1 CBVDescriptorTable[4];
+    CD3DX12_DESCRIPTOR_RANGE1 CBVDescriptorTable[6];
     // 这里的baseShaderRegister如果和Shader代码中的对应不上，就会报错
     // 比如这里填的baseSahderRegister如果设为1，而实际上Shader中的为：
 
@@ -518,11 +635,29 @@ void LandAndWaves::createRootSignature() {
                                                              0,     // registerSpace
                       D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
 
+    // 帧纹理在第一帧之后才加载完成，描述符在命令列表记录之后、执行之前还会被写入，
+    // 所以标记为DESCRIPTORS_VOLATILE
     CBVDescriptorTable[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV,      // rangeType
-                        static_cast<uint32_t>(textures.size()),      // numDescriptors
+                                              maxFrameTextures,      // numDescriptors
                                                              0,      // baseShaderRegister
                                                              0,      // registerSpace
-                      D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
+                      D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE | D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+
+    // 调色板纹理紧跟在帧纹理之后，对应Shader中的register(t0, space1)
+    CBVDescriptorTable[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV,      // rangeType
+                                                             1,      // numDescriptors
+                                                             0,      // baseShaderRegister
+                                                             1,      // registerSpace
+                      D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE | D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+
+    // 调色板格式的帧纹理，对应Shader中的frameIndices : register(t0, space2)。
+    // 与第一段指向同一段描述符(从表头开始)，不需要在描述符堆中再复制一份
+    CBVDescriptorTable[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV,      // rangeType
+                                              maxFrameTextures,      // numDescriptors
+                                                             0,      // baseShaderRegister
+                                                             2,      // registerSpace
+                      D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE | D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE,
+                                                             0);     // offsetInDescriptorsFromTableStart
 
     slotRootParameter[0].InitAsDescriptorTable(1, 
                                                &CBVDescriptorTable[0],
@@ -536,7 +671,7 @@ void LandAndWaves::createRootSignature() {
                                                &CBVDescriptorTable[2],
                                                D3D12_SHADER_VISIBILITY_PIXEL);
 
-    slotRootParameter[3].InitAsDescriptorTable(1,                                       // numDescriptorRanges
+    slotRootParameter[3].InitAsDescriptorTable(3,                                       // numDescriptorRanges
                                                &CBVDescriptorTable[3],                  // pDescriptorRanges
                                                D3D12_SHADER_VISIBILITY_PIXEL            // visibility, visibility to all stages allows sharing binding tables
                                                );
@@ -548,7 +683,7 @@ void LandAndWaves::createRootSignature() {
     // D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE
     // 表示描述符和纹理数据都是静态的, 设置后不会被修改, 能够获得驱动优化
     CD3DX12_DESCRIPTOR_RANGE1 SRVDescriptorTable;
-    SRVDescriptorTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, static_cast<uint32_t>(textures.size()), 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+    SRVDescriptorTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, maxFrameTextures, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
     slotRootParameter[4].InitAsDescriptorTable(1, &SRVDescriptorTable, D3D12_SHADER_VISIBILITY_PIXEL);
 
     CD3DX12_DESCRIPTOR_RANGE1 samplerDescriptorTable;
@@ -601,14 +736,17 @@ void LandAndWaves::createRootSignature() {
 
 void LandAndWaves::createShadersAndInputLayout() {
 
-    vertexShaderByteCode = d3dUtil::compileShader(L"Shaders/color.hlsl", L"VS", L"vs_6_0");
-    pixelShaderByteCode = d3dUtil::compileShader(L"Shaders/color.hlsl", L"PS", L"ps_6_0");
+    // 编译在requestAssets中就已经交给工作线程，这里通常不需要等待
+    vertexShaderByteCode = compiledVertexShader.get();
+    pixelShaderByteCode = compiledPixelShader.get();
+    palettizedPixelShaderByteCode = compiledPalettizedPixelShader.get();
     
     inputLayout = 
     {
         {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
         {"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
         {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"TANGENT", 0, DXGI_FORMAT_R10G10B10A2_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
     };
 }
 
@@ -700,6 +838,7 @@ void LandAndWaves::createBoxGeometry() {
     for (size_t i = 0; i < box.Vertices.size(); i++) {
         vertices[i].position = box.Vertices[i].Position;
         vertices[i].uv = box.Vertices[i].TexC;
+        vertices[i].tangent = MeshProcessing::packTangent(box.Vertices[i].TangentU, 1.0f);
     }
 
     boxGeometry->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device.Get(), commandList.Get(),
@@ -776,16 +915,143 @@ void LandAndWaves::createPipelineStateOjbect() {
     ThrowIfFailed(device->CreateGraphicsPipelineState(&pipelineStateObjectDesc, IID_PPV_ARGS(opaqueWireframePipelineStateObject.GetAddressOf())));
 
     graphicsPSOs["opaque_wireframe"] = opaqueWireframePipelineStateObject;
+
+    // 调色板格式的帧纹理使用PSPalettized，它只有运行时编译的版本
+    pipelineStateObjectDesc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+    pipelineStateObjectDesc.PS = CD3DX12_SHADER_BYTECODE(palettizedPixelShaderByteCode->GetBufferPointer(), palettizedPixelShaderByteCode->GetBufferSize());
+
+    ComPtr<ID3D12PipelineState> opaquePalettizedPipelineStateObject = nullptr;
+
+    ThrowIfFailed(device->CreateGraphicsPipelineState(&pipelineStateObjectDesc, IID_PPV_ARGS(opaquePalettizedPipelineStateObject.GetAddressOf())));
+
+    graphicsPSOs["opaque_palettized"] = opaquePalettizedPipelineStateObject;
 }
 
-void LandAndWaves::loadResources() {
-    uint32_t textureWidth = 0;
-    uint32_t textureHeight = 0;
+void LandAndWaves::requestAssets() {
+    derivedDataCache = std::make_unique<DerivedDataCache>("DerivedDataCache");
+    assetLoader = std::make_unique<AssetLoader>();
+
+    auto cache = derivedDataCache.get();
+
+    // PSO要用到着色器，createShadersAndInputLayout中等待编译完成
+    compiledVertexShader = assetLoader->load("Shaders/color.hlsl VS", []() { return d3dUtil::compileShader(L"Shaders/color.hlsl", L"VS", L"vs_6_0"); });
+    compiledPixelShader = assetLoader->load("Shaders/color.hlsl PS", []() { return d3dUtil::compileShader(L"Shaders/color.hlsl", L"PS", L"ps_6_0"); });
+    compiledPalettizedPixelShader = assetLoader->load("Shaders/color.hlsl PSPalettized", []() { return d3dUtil::compileShader(L"Shaders/color.hlsl", L"PSPalettized", L"ps_6_0"); });
+
+    // 帧纹理也不阻塞第一帧，解码完成后在draw中创建纹理、上传并填写描述符
+    // textureImages = assetLoader->load("Textures/Kanna.gif", [cache]() { return decodeImages("Textures/Kanna.gif", cache); });
+    textureImages = assetLoader->load("Textures/Kanna0.gif", [cache]() { return decodeImages("Textures/Kanna0.gif", cache); });
+
+    assetLoader->whenReady(textureImages, [this](const DecodedImages& images) {
+        buildFrameTextures(images);
+        createShaderResourceView();
+    });
+
+    // 骷髅不阻塞第一帧，加载完成后在draw中上传
+    skullMeshData = assetLoader->load("Models/skull.txt", [cache]() { return loadSkullMeshData(cache); });
+
+    assetLoader->whenReady(skullMeshData, [this](const LoadedMesh& skull) {
+        buildSkullGeometry(skull);
+    });
+}
+
+DecodedImages LandAndWaves::decodeImages(const std::string& fileName, DerivedDataCache* cache) {
+    DecodedImages decodedImages;
+
+    // GIF本身就是8位索引格式，保持索引加调色板，显存只需要R8G8B8A8的四分之一
+    std::string extension = std::filesystem::path(fileName).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+    bool isGIF = extension == ".gif";
+
+    // 键包含解码方式，解码或者格式转换规则改变时要修改这里的版本号
+    uint64_t key = 0;
+    bool hasKey = cache != nullptr && DerivedDataCache::makeFileKey(fileName, isGIF ? "GifDecoder:R8Palette:v1" : "WICLoadImage:v2", key);
+
+    std::vector<uint8_t> payload;
+
+    if (hasKey && cache->get(key, payload) && unpackDecodedImages(payload, decodedImages)) {
+        return decodedImages;
+    }
+
+    if (isGIF && decodePalettizedImages(fileName, decodedImages)) {
+        if (hasKey) {
+            payload = packDecodedImages(decodedImages);
+            cache->put(key, payload.data(), payload.size());
+        }
+
+        return decodedImages;
+    }
+
+    // 无法转换为调色板格式的GIF也走WIC，但是不能用调色板格式的键缓存
+    if (isGIF) {
+        hasKey = cache != nullptr && DerivedDataCache::makeFileKey(fileName, "WICLoadImage:v2", key);
+    }
+
+    decodedImages = DecodedImages();
+
     uint32_t bpp = 0;
-    uint32_t rowPitch = 0;
 
-    // auto images = WICLoadImage(L"Textures/Kanna.gif", textureWidth, textureHeight, bpp, rowPitch, textureFormat);
-    auto images = WICLoadImage(L"Textures/Kanna0.gif", textureWidth, textureHeight, bpp, rowPitch, textureFormat);
+    auto images = WICLoadImage(AnsiToWString(fileName), decodedImages.width, decodedImages.height, bpp, decodedImages.rowPitch, decodedImages.format);
+
+    decodedImages.frames.resize(images.size());
+
+    for (size_t imageIndex = 0; imageIndex < images.size(); imageIndex++) {
+        auto& pixels = decodedImages.frames[imageIndex];
+        pixels.resize(static_cast<size_t>(decodedImages.rowPitch) * decodedImages.height);
+
+        // 真正的解码发生在CopyPixels中
+        ThrowIfFailed(images[imageIndex]->CopyPixels(
+            nullptr,
+            decodedImages.rowPitch,
+            static_cast<uint32_t>(pixels.size()),
+            pixels.data()));
+    }
+
+    if (hasKey) {
+        payload = packDecodedImages(decodedImages);
+        cache->put(key, payload.data(), payload.size());
+    }
+
+    return decodedImages;
+}
+
+bool LandAndWaves::decodePalettizedImages(const std::string& fileName, DecodedImages& decodedImages) {
+    GifDecoder::GIF gif;
+
+    if (!GifDecoder::load(fileName, gif) || gif.frames.empty()) {
+        return false;
+    }
+
+    decodedImages.width = gif.width;
+    decodedImages.height = gif.height;
+    decodedImages.rowPitch = gif.width;
+    decodedImages.format = DXGI_FORMAT_R8_UINT;
+    decodedImages.frames.resize(gif.frames.size());
+    decodedImages.palettes.resize(gif.frames.size() * Palettized::paletteSize);
+
+    for (uint32_t frameIndex = 0; frameIndex < gif.frames.size(); frameIndex++) {
+        if (!Palettized::fromGIF(gif, frameIndex, decodedImages.frames[frameIndex],
+                                 decodedImages.palettes.data() + static_cast<size_t>(frameIndex) * Palettized::paletteSize)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void LandAndWaves::buildFrameTextures(const DecodedImages& images) {
+    // 描述符堆中只预留了maxFrameTextures个位置
+    if (images.frames.empty() || images.frames.size() > maxFrameTextures) {
+        ::OutputDebugStringA(("Frame textures: " + std::to_string(images.frames.size()) + " frames, expected 1 to " + std::to_string(maxFrameTextures) + "\n").c_str());
+        return;
+    }
+
+    uint32_t textureWidth = images.width;
+    uint32_t textureHeight = images.height;
+    uint32_t rowPitch = images.rowPitch;
+
+    textureFormat = images.format;
 
     D3D12_RESOURCE_DESC textureDesc = {};
 
@@ -801,9 +1067,34 @@ void LandAndWaves::loadResources() {
     textureDesc.SampleDesc.Count = 1;
     textureDesc.SampleDesc.Quality = 0;
 
-    textures.resize(images.size());
+    textures.resize(images.frames.size());
+
+    // 与前面某一帧完全相同的帧直接共用那一帧的纹理，不再创建和上传
+    std::vector<int32_t> aliasOf(images.frames.size(), -1);
+    std::unordered_map<uint64_t, std::vector<size_t>> frameHashes;
+
+    for (size_t imageIndex = 0; imageIndex < images.frames.size(); imageIndex++) {
+        const auto& frame = images.frames[imageIndex];
+        auto& sameHashFrames = frameHashes[Hash::hash64(frame.data(), frame.size())];
+
+        for (size_t sameHashFrame : sameHashFrames) {
+            if (images.frames[sameHashFrame] == frame) {
+                aliasOf[imageIndex] = static_cast<int32_t>(sameHashFrame);
+                break;
+            }
+        }
+
+        if (aliasOf[imageIndex] < 0) {
+            sameHashFrames.push_back(imageIndex);
+        }
+    }
+
+    for (size_t imageIndex = 0; imageIndex < images.frames.size(); imageIndex++) {
+        if (aliasOf[imageIndex] >= 0) {
+            textures[imageIndex] = textures[aliasOf[imageIndex]];
+            continue;
+        }
 
-    for (size_t imageIndex = 0; imageIndex < images.size(); imageIndex++) {
         // 创建默认堆上的资源,类型是Texture2D,GPU对默认堆资源的访问速度是最快的
         // 因为纹理资源一般是不易变的资源,所以我们通常使用上传堆复制到默认堆中
         ThrowIfFailed(device->CreateCommittedResource(
@@ -815,29 +1106,79 @@ void LandAndWaves::loadResources() {
             IID_PPV_ARGS(textures[imageIndex].GetAddressOf())));   
     }
 
-    // 获取上传堆资源缓冲的大小,这个尺寸通常大于实际图片的尺寸
-    // 注意：这里要将上传堆的尺寸大小对齐到D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT，
-    // 因为后面调用UpdateSubresources的时候，里面的CopyTextureRegion期望传入的
-    // Offset是512的倍数，否则就会报以下的错误：
+    // 动画的相邻帧之间通常只有一小块在变化，每一帧先在GPU上从上一帧的纹理整体复制，
+    // 再只上传变化的脏矩形(见FrameDelta)。变化太多时FrameDelta给出整帧一个矩形，这时就不需要先复制上一帧
+    const uint32_t bytesPerPixel = rowPitch / textureWidth;
+
+    std::vector<FrameDelta::Delta> deltas(images.frames.size());
+    // 作为增量基准的上一帧，-1表示整帧上传
+    std::vector<int32_t> baseFrames(images.frames.size(), -1);
+    int32_t previousFrame = -1;
+
+    for (size_t imageIndex = 0; imageIndex < images.frames.size(); imageIndex++) {
+        if (aliasOf[imageIndex] >= 0) {
+            continue;
+        }
+
+        const uint8_t* current = images.frames[imageIndex].data();
+
+        if (previousFrame < 0) {
+            FrameDelta::full(current, textureWidth, textureHeight, bytesPerPixel, deltas[imageIndex]);
+        }
+        else {
+            FrameDelta::diff(images.frames[previousFrame].data(), current, textureWidth, textureHeight, bytesPerPixel, deltas[imageIndex]);
+
+            if (deltas[imageIndex].deltaBytes() < deltas[imageIndex].fullBytes) {
+                baseFrames[imageIndex] = previousFrame;
+            }
+        }
+
+        previousFrame = static_cast<int32_t>(imageIndex);
+    }
+
+    // 每个脏矩形在上传堆中的位置
+    // 注意：这里要将每一段的起始位置对齐到D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT，
+    // 因为CopyTextureRegion期望传入的Offset是512的倍数，否则就会报以下的错误：
     // D3D12 ERROR: ID3D12CommandList::CopyTextureRegion: 
     // D3D12_PLACED_SUBRESOURCE_FOOTPRINT::Offset must be a multiple of 512, 
     // aka. D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT. Offset is 1023952.
     // [ RESOURCE_MANIPULATION ERROR #864: COPYTEXTUREREGION_INVALIDSRCOFFSET]
-    // 官方示例中直接用的GetRequiredIntermediateSize获取到的地址不会有问题
-    // 因为它使用的纹理尺寸是2的N次方，通过GetRequiredIntermediateSize获取
-    // 到的尺寸就是满足要求的。搞了一晚上终于搞定了纹理数组的创建和使用，泪奔~~
-    // 纹理尺寸是32 x 32，GetRequiredIntermediateSize返回8064(比纹理大小32 x 32 x 4(4096)多了几乎一倍)
-    // 纹理尺寸是64 x 64，GetRequiredIntermediateSize返回10384(和纹理大小一样, 64 x 64 x 4)
-    // 纹理尺寸是128 x 128，GetRequiredIntermediateSize返回65536(和纹理大小一样, 128 x 128 x 4)
-    //              Default	Small
-    // Buffer	    64 KB	 
-    // Texture	    64 KB	4 KB
-    // MSAA texture	4 MB	64 KB
-    const uint64_t uploadBufferStep = d3dUtil::Align(GetRequiredIntermediateSize(textures[0].Get(), 0, 1), D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
-    // const uint64_t uploadBufferStep = GetRequiredIntermediateSize(textures[0].Get(), 0, 1);
-    const uint64_t uploadBufferSize = uploadBufferStep * textures.size();
-
-    device->GetResourceAllocationInfo(0, 1, &textureDesc);
+    // 行大小则要对齐到D3D12_TEXTURE_DATA_PITCH_ALIGNMENT，
+    // 例如，纹理的宽度为32，每像素4个字节，实际的行大小为128，而RowPitch的值则是256
+    // 这些规则都由TextureFootprint按矩形大小的纹理计算，结果与GetCopyableFootprints相同
+    std::vector<std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT>> footprints(images.frames.size());
+    uint64_t uploadBufferSize = 0;
+    size_t fullBytes = 0;
+    size_t uploadBytes = 0;
+
+    for (size_t imageIndex = 0; imageIndex < images.frames.size(); imageIndex++) {
+        const auto& delta = deltas[imageIndex];
+
+        fullBytes += static_cast<size_t>(rowPitch) * textureHeight;
+        uploadBytes += delta.deltaBytes();
+
+        footprints[imageIndex].resize(delta.rects.size());
+
+        for (size_t rectIndex = 0; rectIndex < delta.rects.size(); rectIndex++) {
+            const auto& rect = delta.rects[rectIndex];
+            auto& footprint = footprints[imageIndex][rectIndex];
+
+            D3D12_RESOURCE_DESC rectDesc = textureDesc;
+            rectDesc.Alignment = 0;
+            rectDesc.Width = rect.width;
+            rectDesc.Height = rect.height;
+
+            uint64_t rectBytes = 0;
+
+            if (!TextureFootprint::getCopyableFootprints(rectDesc, 0, 1, uploadBufferSize, &footprint, nullptr, nullptr, &rectBytes)) {
+                ThrowIfFailed(E_FAIL);
+            }
+
+            uploadBufferSize = footprint.Offset + rectBytes;
+        }
+    }
+
+    ::OutputDebugStringA(("Texture upload: " + std::to_string(uploadBytes) + " of " + std::to_string(fullBytes) + " bytes\n").c_str());
 
     // 创建用于上传纹理的资源，注意其类型是Buffer。上传堆对于GPU访问来说性能是很差的
     // 所以对于几乎不变的数据尤其像纹理都是通过它来上传至GPU访问更高效的默认堆中
@@ -849,103 +1190,64 @@ void LandAndWaves::loadResources() {
         nullptr,
         IID_PPV_ARGS(textureUpload.GetAddressOf())));
 
+    // 因为上传堆实际就是CPU传递数据到GPU的中介，所以我们可以使用
+    // 熟悉的Map方法将它先映射到CPU内存地址中，然后我们按行将数据复制
+    // 到上传堆中。需要注意的是之所以按行拷贝是因为GPU资源的行大小
+    // 与实际图片的行大小是有差异的，二者的内存边界对齐要求是不一样的
+    byte* data = nullptr;
+
+    ThrowIfFailed(textureUpload->Map(0, nullptr, reinterpret_cast<void**>(&data)));
+
     for (size_t textureIndex = 0; textureIndex < textures.size(); textureIndex++) {
-        // 按照资源缓冲大小来分配实际图片数据存储的内存大小
-        void* imageData = ::HeapAlloc(::GetProcessHeap(), HEAP_ZERO_MEMORY, uploadBufferStep);
+        const auto& delta = deltas[textureIndex];
+        const byte* sourceSlice = delta.pixels.data();
 
-        if (imageData == nullptr) {
-            ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-        }
+        for (size_t rectIndex = 0; rectIndex < delta.rects.size(); rectIndex++) {
+            const auto& footprint = footprints[textureIndex][rectIndex];
+            uint32_t rectRowPitch = delta.rects[rectIndex].width * bytesPerPixel;
 
-        auto image = images[textureIndex];
+            // textureUpload已经经过了对齐操作，所以这里的偏移需要使用D3D12_SUBRESOURCE_FOOTPRINT的RowPitch字段，
+            // 而拷贝的时候就需要矩形原始的行大小了，搞混了两者会导致渲染结果出错
+            TextureFootprint::copyRows(data + footprint.Offset, footprint.Footprint.RowPitch,
+                                       sourceSlice, rectRowPitch, rectRowPitch, footprint.Footprint.Height);
 
-        // 从图片中取出数据
-        HRESULT hr = image->CopyPixels(
-            nullptr,
-            rowPitch,
-            static_cast<uint32_t>(rowPitch * textureHeight),    // 注意这里才是图片数据真实的大小，这个值通常小于缓冲的大小
-            reinterpret_cast<byte*>(imageData));
-
-        ThrowIfFailed(hr);
-
-        std::string fileName = "test" + std::to_string(textureIndex) + ".png"; 
-
-        // saveImage(fileName, reinterpret_cast<byte*>(imageData), textureWidth, textureHeight);
-
-        // 获取向上传堆拷贝纹理数据的一些纹理转换尺寸信息
-        // 对于复杂的DDS纹理这是非常必要的过程
-        uint64_t requiredSize = 0;
-        uint32_t numSubresources = 1;   // 我们只有一副图片，即子资源个数为1
-        D3D12_PLACED_SUBRESOURCE_FOOTPRINT textureLayouts;
-        uint64_t textureRowSizes = 0;
-        uint32_t textureRowNum = 0;
-
-        D3D12_RESOURCE_DESC resourceDesc = textures[textureIndex]->GetDesc();
-
-        // 不要把pRowSizeInBytes和D3D12_SUBRESOURCE_FOOTPRINT的RowPitch搞混，
-        // 因为RowPitch是对齐到D3D12_TEXTURE_DATA_PITCH_ALIGNMENT的值
-        // 例如，纹理的宽度为32，每像素4个字节，pRowSizeInBytes的值为128
-        // 而RowPitch的值则是256
-        device->GetCopyableFootprints(
-            &resourceDesc,
-            0,
-            numSubresources,
-            uploadBufferStep * textureIndex,
-            &textureLayouts,
-            &textureRowNum,
-            &textureRowSizes,
-            &requiredSize);
-
-        // 因为上传堆实际就是CPU传递数据到GPU的中介，所以我们可以使用
-        // 熟悉的Map方法将它先映射到CPU内存地址中，然后我们按行将数据复制
-        // 到上传堆中。需要注意的是之所以按行拷贝是因为GPU资源的行大小
-        // 与实际图片的行大小是有差异的，二者的内存边界对齐要求是不一样的
-        byte* data = nullptr;
-
-        ThrowIfFailed(textureUpload->Map(0, nullptr, reinterpret_cast<void**>(&data)));
-
-        byte* destSlice = reinterpret_cast<byte*>(data) + textureLayouts.Offset;
-
-        const byte* sourceSlice = reinterpret_cast<const byte*>(imageData);
-        // textureUpload已经经过了对齐操作，所以这里的偏移需要使用D3D12_SUBRESOURCE_FOOTPRINT的RowPitch字段，
-        // 因为经过GetCopyableFootprints函数的填充，RowPitch是按D3D12_TEXTURE_DATA_PITCH_ALIGNMENT对齐的
-        // 而拷贝的时候就需要图片的原始的rowPitch了，之前就是搞混了两者，导致对UpdateSubresources函数的调用
-        // 要么崩溃，要么渲染结果出错
-        for (uint32_t row = 0; row < textureRowNum; row++) {
-            memcpy_s(destSlice + static_cast<SIZE_T>(textureLayouts.Footprint.RowPitch) * row, rowPitch,
-                     sourceSlice + static_cast<SIZE_T>(rowPitch) * row, rowPitch);
+            sourceSlice += static_cast<size_t>(rectRowPitch) * footprint.Footprint.Height;
         }
+    }
 
-        // 取消映射，对于易变的数据如每帧的变换矩阵等数据，可以先不Unmap
-        // 让它常驻内存，以提高整体性能，因为每次Map和Unmap是非常耗时的操作
-        textureUpload->Unmap(0, nullptr);
+    // 取消映射，对于易变的数据如每帧的变换矩阵等数据，可以先不Unmap
+    // 让它常驻内存，以提高整体性能，因为每次Map和Unmap是非常耗时的操作
+    textureUpload->Unmap(0, nullptr);
 
-        // {
-        //     // Copy data to the intermediate upload heap and then schedule
-        //     // a copy from the upload heap to the appropriate texture
-        //     // const UINT D3D12_TEXTURE_DATA_PITCH_ALIGNMENT = 256;        纹理行按256字节对齐
-        //     // const UINT D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT = 512;    纹理整体按512字节
-        //     // 照着官方示例抄代码抄出问题来了，示例中纹理的尺寸大小本身就是对齐的
-        //     D3D12_SUBRESOURCE_DATA  textureData = {};
-        //     textureData.pData = imageData;
-        //     uint32_t channels = bpp / 8;
-        //     textureData.RowPitch =  rowPitch;
-        //     textureData.SlicePitch = rowPitch * textureDesc.Height;
+    for (size_t textureIndex = 0; textureIndex < textures.size(); textureIndex++) {
+        if (aliasOf[textureIndex] >= 0) {
+            continue;
+        }
 
-        //     D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &resourceDesc);
+        // 先从上一帧复制整张纹理，上一帧此时已经是PIXEL_SHADER_RESOURCE状态
+        if (baseFrames[textureIndex] >= 0) {
+            ID3D12Resource* baseTexture = textures[baseFrames[textureIndex]].Get();
 
-        //     UpdateSubresources(commandList.Get(), textures[textureIndex].Get(), textureUpload.Get(), textureIndex * uploadBufferStep, 0, 1, &textureData);
-        // }
+            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
+                baseTexture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
 
-        // 释放图片数据，做一个干净的程序员
-        ::HeapFree(::GetProcessHeap(), 0, imageData);
+            commandList->CopyResource(textures[textureIndex].Get(), baseTexture);
+
+            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
+                baseTexture, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+        }
 
         // 向命令队列发出从上传堆复制纹理数据到默认堆的命令
-        // textureLayouts中包含了在textureUpload中的偏移
+        // footprint中包含了在textureUpload中的偏移
         // (D3D12_PLACED_SUBRESOURCE_FOOTPRINT::Offset字段) 
         CD3DX12_TEXTURE_COPY_LOCATION dest(textures[textureIndex].Get(), 0);
-        CD3DX12_TEXTURE_COPY_LOCATION source(textureUpload.Get(), textureLayouts);
-        commandList->CopyTextureRegion(&dest, 0, 0, 0, &source, nullptr);
+
+        for (size_t rectIndex = 0; rectIndex < deltas[textureIndex].rects.size(); rectIndex++) {
+            const auto& rect = deltas[textureIndex].rects[rectIndex];
+            CD3DX12_TEXTURE_COPY_LOCATION source(textureUpload.Get(), footprints[textureIndex][rectIndex]);
+
+            commandList->CopyTextureRegion(&dest, rect.left, rect.top, 0, &source, nullptr);
+        }
 
         // 设置一个资源屏障，同步并确认复制操作完成
         D3D12_RESOURCE_BARRIER resourceBarrier;
@@ -958,138 +1260,171 @@ void LandAndWaves::loadResources() {
 
         commandList->ResourceBarrier(1, &resourceBarrier);
     }
+
+    if (!images.palettes.empty()) {
+        loadPaletteTexture(images);
+    }
 }
 
-void split(const std::string& inString, const std::string& pattern, std::vector<std::string>& result) {
-    std::string source = inString;
+void LandAndWaves::loadPaletteTexture(const DecodedImages& images) {
+    uint32_t frameCount = static_cast<uint32_t>(images.frames.size());
+    uint32_t paletteRowPitch = Palettized::paletteSize * sizeof(uint32_t);
 
-    // 当最后一次find时会找到末尾的pattern，方便退出循环
-    source += pattern;
+    // 每一行是一帧的调色板，Shader中用palette.Load(int3(index, frame, 0))查表
+    CD3DX12_RESOURCE_DESC paletteDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, Palettized::paletteSize, frameCount, 1, 1);
 
-    size_t size = source.size();
+    ThrowIfFailed(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &paletteDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(paletteTexture.GetAddressOf())));
 
-    for (size_t i = 0; i < size; i++) {
-        size_t position = source.find(pattern, i);
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT paletteLayout;
+    uint64_t paletteRowSize = 0;
+    uint64_t uploadBufferSize = 0;
+    uint32_t paletteRowNum = 0;
 
-        // 找到位于末尾的pattern时，position = size - 1
-        // 正好可以处理最后一个字符串子串，就不用对它
-        // 进行特殊处理了
-        if (position < size) {
-            // 截取find起始位置和pattern出现位置之间的字符串(注意和下面的注释配合理解)
-            std::string slice = source.substr(i, position - i);
-            result.push_back(slice);
-            // 将i跳到上一次pattern出现的位置，
-            // 下次循环i++之后正好位于pattern后字符串的首位
-            i = position + pattern.size() - 1;
-        }
+    if (!TextureFootprint::getCopyableFootprints(paletteDesc, 0, 1, 0, &paletteLayout, &paletteRowNum, &paletteRowSize, &uploadBufferSize)) {
+        ThrowIfFailed(E_FAIL);
     }
-}
 
-GeometryGenerator::Vertex createVertex(const std::vector<std::string>& vertexString) {
-    GeometryGenerator::Vertex vertex;
+    ThrowIfFailed(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(paletteUpload.GetAddressOf())));
 
-    vertex.Position.x = static_cast<float>(atof(vertexString[0].c_str()));
-    vertex.Position.y = static_cast<float>(atof(vertexString[1].c_str()));
-    vertex.Position.z = static_cast<float>(atof(vertexString[2].c_str()));
-    vertex.Normal.x =static_cast<float>(atof(vertexString[3].c_str()));
-    vertex.Normal.y =static_cast<float>(atof(vertexString[4].c_str()));
-    vertex.Normal.z =static_cast<float>(atof(vertexString[5].c_str()));
+    byte* data = nullptr;
 
-    return vertex;
-}
+    ThrowIfFailed(paletteUpload->Map(0, nullptr, reinterpret_cast<void**>(&data)));
 
-GeometryGenerator::MeshData LandAndWaves::loadSkullMeshData() {
-    std::ifstream file("Models/skull.txt");
+    const byte* sourceSlice = reinterpret_cast<const byte*>(images.palettes.data());
 
-    const size_t lineLength = 256;
+    TextureFootprint::copySubresource(data, paletteLayout, paletteRowNum, paletteRowSize, sourceSlice, paletteRowPitch, static_cast<size_t>(paletteRowPitch) * frameCount);
 
-    std::string line;
+    paletteUpload->Unmap(0, nullptr);
 
-    std::string vertexCountPattern = "VertexCount: ";
-    std::string triangleCountPattern = "TriangleCount: ";
+    CD3DX12_TEXTURE_COPY_LOCATION dest(paletteTexture.Get(), 0);
+    CD3DX12_TEXTURE_COPY_LOCATION source(paletteUpload.Get(), paletteLayout);
+    commandList->CopyTextureRegion(&dest, 0, 0, 0, &source, nullptr);
 
-    std::vector<GeometryGenerator::Vertex> vertices;
-    std::vector<uint32_t> indices;
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
+        paletteTexture.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+}
 
-    if (!file.eof()) {
-        uint32_t vertexCount = 0;
-        uint32_t triangleCount = 0;
+LoadedMesh LandAndWaves::loadSkullMeshData(DerivedDataCache* derivedDataCache) {
+    // skull.txt是唯一的源文件，其他都是由它生成的缓存
+    const std::string sourceFileName = "Models/skull.txt";
+    const std::string cacheFileName = MeshCache::cacheFileNameFor(sourceFileName);
 
-        // 获得顶点数:VertexCount: 31076
-        std::getline(file, line);
+    LoadedMesh mesh;
 
-        size_t position = line.find(vertexCountPattern);
+    // 缓存里是处理好的GPU顶点、16位索引和子网格包围体，命中时只保留映射，上传时直接读映射的内存。
+    // 缓存记录了skull.txt的大小和修改时间，修改过skull.txt后重新生成。
+    // 源文件不存在时没有办法重新生成，只发布了缓存的情况下也使用缓存
+    auto cache = std::make_shared<MeshCache::View>();
 
-        if (position != std::string::npos) {
-            std::string vertexCountString = line.substr(vertexCountPattern.size(), lineLength - vertexCountPattern.size());
-            vertexCount = atoi(vertexCountString.c_str());
-        }
+    if (cache->open(cacheFileName, sourceFileName, sizeof(FrameUtil::Vertex), sizeof(uint16_t), MeshCache::MissingSource::Accept)) {
+        mesh.cache = std::move(cache);
+        return mesh;
+    }
 
-        std::getline(file, line);
+    GeometryGenerator::MeshData meshData;
 
-        // 获得三角形数:TriangleCount: 60339
-        position = line.find(triangleCountPattern);
+    // 解析结果用MeshCodec压缩后放在派生数据缓存中，键是skull.txt内容的哈希。
+    // 网格处理或顶点格式改变导致MeshCache过期时不需要重新解析文本，解码比解析快得多
+    uint64_t key = 0;
+    bool hasKey = derivedDataCache != nullptr && DerivedDataCache::makeFileKey(sourceFileName, "MeshCodec:v" + std::to_string(MeshCodec::meshVersion), key);
 
-        if (position != std::string::npos) {
-            std::string triangleCountString = line.substr(triangleCountPattern.size(), lineLength - triangleCountPattern.size());
-            triangleCount = atoi(triangleCountString.c_str());
+    std::vector<uint8_t> payload;
+
+    if (!hasKey || !derivedDataCache->get(key, payload) || !MeshCodec::decodeMesh(payload.data(), payload.size(), meshData)) {
+        // 整个文件读入一块缓冲区后直接扫描解析，不再逐行getline和split
+        meshData = GeometryGenerator::MeshData();
+
+        if (!MeshLoader::loadMeshFile(sourceFileName, meshData)) {
+            ThrowIfFailed(E_FAIL);
         }
 
-        // VertexList (pos, normal)
-        std::getline(file, line);
+        if (hasKey) {
+            payload = MeshCodec::encodeMesh(meshData);
+            derivedDataCache->put(key, payload.data(), payload.size());
+        }
+    }
 
-        // {
-        std::getline(file, line);
+    // 合并重复的顶点，模型文件中没有法线时重新生成
+    MeshProcessing::weldMesh(meshData);
 
-        uint32_t counter = 0;
+    if (!MeshProcessing::hasNormals(meshData)) {
+        MeshProcessing::computeNormals(meshData);
+    }
 
-        std::vector<std::string> vertexString;
+    // 模型文件中没有切线，由法线和纹理坐标生成。镜像UV接缝处的顶点会按手性拆分
+    std::vector<uint32_t> packedTangents;
+    MeshProcessing::computeTangents(meshData, &packedTangents);
 
-        while (counter < vertexCount) {
-            std::getline(file, line);
+    // 拆分成16位索引的子网格，被复制的顶点通过sourceVertices找到原来的切线
+    GeometryGenerator geometryGenerator;
+    std::vector<GeometryGenerator::Submesh16> parts;
+    std::vector<uint32_t> sourceVertices;
+    auto skull = geometryGenerator.SplitForIndices16(meshData, parts, &sourceVertices);
 
-            // 删除开头的\t制表符
-            line.erase(line.begin());            
-            split(line, " ", vertexString);
-            vertices.emplace_back(createVertex(vertexString));
-            vertexString.clear();
-            counter++;
-        }
+    mesh.vertices.resize(skull.Vertices.size());
 
-        // }
-        std::getline(file, line);
+    for (size_t i = 0; i < skull.Vertices.size(); ++i) {
+        mesh.vertices[i].position = skull.Vertices[i].Position;
+        XMFLOAT3 normal = skull.Vertices[i].Normal;
+        mesh.vertices[i].color = XMFLOAT4(normal.x, normal.y, normal.z, 1.0f);
+        mesh.vertices[i].uv = skull.Vertices[i].TexC;
+        mesh.vertices[i].tangent = packedTangents[sourceVertices[i]];
+    }
 
-        // TriangleList
-        std::getline(file, line);
+    mesh.indices = skull.GetIndices16();
 
-        // {
-        std::getline(file, line);
-        
-        counter = 0;
+    // 第一个子网格使用原名，拆分出来的其余子网格依次命名为Skull_1, Skull_2...
+    for (size_t partIndex = 0; partIndex < parts.size(); partIndex++) {
+        const auto& part = parts[partIndex];
+        const FrameUtil::Vertex* firstVertex = mesh.vertices.data() + part.BaseVertexLocation;
 
-        std::vector<std::string> indexString;
+        mesh.submeshes.push_back(MeshCache::makeSubmeshRecord(
+            partIndex == 0 ? "Skull" : "Skull_" + std::to_string(partIndex),
+            part.IndexCount, part.StartIndexLocation, part.BaseVertexLocation, part.VertexCount,
+            MeshBounds::computeBox(&firstVertex->position, part.VertexCount, sizeof(FrameUtil::Vertex)),
+            MeshBounds::computeSphere(&firstVertex->position, part.VertexCount, sizeof(FrameUtil::Vertex))));
+    }
 
-        while (counter < triangleCount) {
-            std::getline(file, line);
+    // 缓存写入失败不影响本次运行，下次启动会再尝试
+    MeshCache::write(cacheFileName, sourceFileName,
+                     mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()), sizeof(FrameUtil::Vertex),
+                     mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), sizeof(uint16_t),
+                     mesh.submeshes);
 
-            // 删除开头的\t制表符
-            line.erase(line.begin());
-            
-            split(line, " ", indexString);
-            indices.emplace_back(atoi(indexString[0].c_str()));
-            indices.emplace_back(atoi(indexString[1].c_str()));
-            indices.emplace_back(atoi(indexString[2].c_str()));
-            indexString.clear();
-            counter++;
-        }
+    return mesh;
+}
 
-    }
+void LandAndWaves::addSubmeshes(MeshGeometry* geometry, const std::string& name, const std::vector<GeometryGenerator::Submesh16>& parts, uint32_t vertexOffset, uint32_t indexOffset, const std::vector<FrameUtil::Vertex>& vertices) {
+    // 第一个子网格使用原名，拆分出来的其余子网格依次命名为name_1, name_2...
+    for (size_t partIndex = 0; partIndex < parts.size(); partIndex++) {
+        SubmeshGeometry submesh;
+        submesh.IndexCount = parts[partIndex].IndexCount;
+        submesh.StartIndexLocation = indexOffset + parts[partIndex].StartIndexLocation;
+        submesh.BaseVertexLocation = vertexOffset + parts[partIndex].BaseVertexLocation;
 
-    GeometryGenerator::MeshData meshData;
-    meshData.Vertices = vertices;
-    meshData.Indices32 = indices;
+        // 每个子网格的顶点在顶点缓冲区中是连续的，直接对这段顶点计算包围体
+        const FrameUtil::Vertex* firstVertex = vertices.data() + submesh.BaseVertexLocation;
+        submesh.Bounds = MeshBounds::computeBox(&firstVertex->position, parts[partIndex].VertexCount, sizeof(FrameUtil::Vertex));
+        submesh.SphereBounds = MeshBounds::computeSphere(&firstVertex->position, parts[partIndex].VertexCount, sizeof(FrameUtil::Vertex));
 
-    return meshData;
+        std::string submeshName = partIndex == 0 ? name : name + "_" + std::to_string(partIndex);
+
+        geometry->DrawArgs[submeshName] = submesh;
+    }
 }
 
 void LandAndWaves::buildShapeGeometry() {
@@ -1099,7 +1434,15 @@ void LandAndWaves::buildShapeGeometry() {
     auto grid = geometryGenerator.CreateGrid(160.0f, 160.0f, 50, 50);
     auto geometrySphere = geometryGenerator.CreateGeosphere(5.0f, 3);
 
-    auto skull = loadSkullMeshData();
+    // 顶点数超过65536的网格会被拆分成多个子网格，每个子网格的索引都重新以
+    // 子网格的起始顶点为基准，这样整个索引缓冲区都可以使用16位索引
+    std::vector<GeometryGenerator::Submesh16> boxParts;
+    std::vector<GeometryGenerator::Submesh16> gridParts;
+    std::vector<GeometryGenerator::Submesh16> geometrySphereParts;
+
+    box = geometryGenerator.SplitForIndices16(box, boxParts);
+    grid = geometryGenerator.SplitForIndices16(grid, gridParts);
+    geometrySphere = geometryGenerator.SplitForIndices16(geometrySphere, geometrySphereParts);
 
     // 将所有的结合体数据都合并到一对大的顶点/索引缓冲区中
     // 以此来定义每个子网格数据在缓冲区中所占的范围
@@ -1108,45 +1451,24 @@ void LandAndWaves::buildShapeGeometry() {
     uint32_t boxVertexOffset = 0;
     uint32_t gridVertexOffset = boxVertexOffset + static_cast<uint32_t>(box.Vertices.size());
     uint32_t geometrySphereVertexOffset = gridVertexOffset + static_cast<uint32_t>(grid.Vertices.size());
-    uint32_t skullVertexOffset = geometrySphereVertexOffset + static_cast<uint32_t>(geometrySphere.Vertices.size());
 
     // 对合并索引缓冲区中的每个物体的起始索引进行缓存
     uint32_t boxIndexOffset = 0;
     uint32_t gridIndexOffset = boxIndexOffset + static_cast<uint32_t>(box.Indices32.size());
     uint32_t geometrySphereIndexOffset = gridIndexOffset + static_cast<uint32_t>(grid.Indices32.size());
-    uint32_t skullIndexOffset = geometrySphereIndexOffset + static_cast<uint32_t>(geometrySphere.Indices32.size());
-
-    // 定义多个SubmeshGeometry结构体中包含了顶点/索引缓冲区内不同几何体的子网格数据
-    SubmeshGeometry boxSubmesh;
-    boxSubmesh.IndexCount = static_cast<uint32_t>(box.Indices32.size());
-    boxSubmesh.StartIndexLocation = boxIndexOffset;
-    boxSubmesh.BaseVertexLocation = boxVertexOffset;
-
-    SubmeshGeometry gridSubmesh;
-    gridSubmesh.IndexCount = static_cast<uint32_t>(grid.Indices32.size());
-    gridSubmesh.StartIndexLocation = gridIndexOffset;
-    gridSubmesh.BaseVertexLocation = gridVertexOffset;
-
-    SubmeshGeometry geometrySphereMesh;
-    geometrySphereMesh.IndexCount = static_cast<uint32_t>(geometrySphere.Indices32.size());
-    geometrySphereMesh.StartIndexLocation = geometrySphereIndexOffset;
-    geometrySphereMesh.BaseVertexLocation = geometrySphereVertexOffset;
-
-    SubmeshGeometry skullMesh;
-    skullMesh.IndexCount = static_cast<uint32_t>(skull.Indices32.size());
-    skullMesh.StartIndexLocation = skullIndexOffset;
-    skullMesh.BaseVertexLocation = skullVertexOffset;
 
     // 提取出所需的顶点元素，再将所有网格的顶点装进一个顶点缓冲区
-    auto totalVertexCount = box.Vertices.size() + grid.Vertices.size() + geometrySphere.Vertices.size() + skull.Vertices.size();
+    auto totalVertexCount = box.Vertices.size() + grid.Vertices.size() + geometrySphere.Vertices.size();
 
     std::vector<FrameUtil::Vertex> vertices(totalVertexCount);
 
     uint32_t k = 0;
 
+    // GeometryGenerator生成的切线都是右手系的
     for (size_t i = 0; i < box.Vertices.size(); ++i, ++k) {
         vertices[k].position = box.Vertices[i].Position;
         vertices[k].uv = box.Vertices[i].TexC;
+        vertices[k].tangent = MeshProcessing::packTangent(box.Vertices[i].TangentU, 1.0f);
     }
 
     for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k) {
@@ -1176,6 +1498,7 @@ void LandAndWaves::buildShapeGeometry() {
         }
 
         vertices[k].uv = grid.Vertices[i].TexC;
+        vertices[k].tangent = MeshProcessing::packTangent(grid.Vertices[i].TangentU, 1.0f);
     }
 
     for (size_t i = 0; i < geometrySphere.Vertices.size(); ++i, ++k) {
@@ -1183,24 +1506,17 @@ void LandAndWaves::buildShapeGeometry() {
         XMFLOAT3 normal = geometrySphere.Vertices[i].Normal;
         vertices[k].color = XMFLOAT4(normal.x, normal.y, normal.z, 1.0f);
         vertices[k].uv = geometrySphere.Vertices[i].TexC;
+        vertices[k].tangent = MeshProcessing::packTangent(geometrySphere.Vertices[i].TangentU, 1.0f);
     }
 
-    for (size_t i = 0; i < skull.Vertices.size(); ++i, ++k) {
-        vertices[k].position = skull.Vertices[i].Position;
-        XMFLOAT3 normal = skull.Vertices[i].Normal;
-        vertices[k].color = XMFLOAT4(normal.x, normal.y, normal.z, 1.0f);
-        vertices[k].uv = skull.Vertices[i].TexC;
-    }
-
-    std::vector<std::uint32_t> indices;
+    std::vector<std::uint16_t> indices;
 
-    indices.insert(indices.end(), box.Indices32.begin(), box.Indices32.end());
-    indices.insert(indices.end(), grid.Indices32.begin(), grid.Indices32.end());
-    indices.insert(indices.end(), geometrySphere.Indices32.begin(), geometrySphere.Indices32.end());
-    indices.insert(indices.end(), skull.Indices32.begin(), skull.Indices32.end());
+    indices.insert(indices.end(), box.GetIndices16().begin(), box.GetIndices16().end());
+    indices.insert(indices.end(), grid.GetIndices16().begin(), grid.GetIndices16().end());
+    indices.insert(indices.end(), geometrySphere.GetIndices16().begin(), geometrySphere.GetIndices16().end());
 
     const uint32_t vertexBufferByteSize = (uint32_t)vertices.size() * sizeof(FrameUtil::Vertex);
-    const uint32_t indexBufferByteSize = (uint32_t)indices.size() * sizeof(std::uint32_t);
+    const uint32_t indexBufferByteSize = (uint32_t)indices.size() * sizeof(std::uint16_t);
 
     auto geometry = std::make_unique<MeshGeometry>();
 
@@ -1220,13 +1536,56 @@ void LandAndWaves::buildShapeGeometry() {
 
     geometry->VertexByteStride = sizeof(FrameUtil::Vertex);
     geometry->VertexBufferByteSize = vertexBufferByteSize;
-    geometry->IndexFormat = DXGI_FORMAT_R32_UINT;
+    geometry->IndexFormat = DXGI_FORMAT_R16_UINT;
+    geometry->IndexBufferByteSize = indexBufferByteSize;
+
+    addSubmeshes(geometry.get(), "Box", boxParts, boxVertexOffset, boxIndexOffset, vertices);
+    addSubmeshes(geometry.get(), "Land", gridParts, gridVertexOffset, gridIndexOffset, vertices);
+    addSubmeshes(geometry.get(), "Sphere", geometrySphereParts, geometrySphereVertexOffset, geometrySphereIndexOffset, vertices);
+
+    geometries[geometry->Name] = std::move(geometry);
+}
+
+void LandAndWaves::buildSkullGeometry(const LoadedMesh& mesh) {
+    const uint32_t vertexBufferByteSize = mesh.vertexBytes();
+    const uint32_t indexBufferByteSize = mesh.indexBytes();
+
+    auto geometry = std::make_unique<MeshGeometry>();
+
+    geometry->Name = "SkullGeometry";
+
+    // 顶点和索引直接从缓存的映射(或者刚处理好的数据)复制到上传堆，不再经过CPU端的副本。
+    // 复制命令记录在当前帧的命令列表中，上传堆由MeshGeometry持有直到程序退出
+    geometry->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device.Get(),
+    commandList.Get(), mesh.vertexData(), vertexBufferByteSize, geometry->VertexBufferUploader);
+
+    geometry->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(device.Get(),
+    commandList.Get(), mesh.indexData(), indexBufferByteSize, geometry->IndexBufferUploader);
+
+    geometry->VertexByteStride = sizeof(FrameUtil::Vertex);
+    geometry->VertexBufferByteSize = vertexBufferByteSize;
+    geometry->IndexFormat = DXGI_FORMAT_R16_UINT;
     geometry->IndexBufferByteSize = indexBufferByteSize;
 
-    geometry->DrawArgs["Box"] = boxSubmesh;
-    geometry->DrawArgs["Land"] = gridSubmesh;
-    geometry->DrawArgs["Sphere"] = geometrySphereMesh;
-    geometry->DrawArgs["Skull"] = skullMesh;
+    // 子网格的包围体在生成缓存时已经算好
+    const MeshCache::SubmeshRecord* records = mesh.submeshData();
+
+    for (size_t i = 0; i < mesh.submeshCount(); i++) {
+        SubmeshGeometry submesh;
+        submesh.IndexCount = records[i].indexCount;
+        submesh.StartIndexLocation = records[i].startIndexLocation;
+        submesh.BaseVertexLocation = records[i].baseVertexLocation;
+        submesh.Bounds = MeshCache::boxOf(records[i]);
+        submesh.SphereBounds = MeshCache::sphereOf(records[i]);
+
+        geometry->DrawArgs[std::string(records[i].name, strnlen(records[i].name, sizeof(records[i].name)))] = submesh;
+    }
+
+    // 渲染项在buildRenderItems中已经占好了常量缓冲区的位置，这里补全几何信息后加入绘制
+    auto renderItem = createRenderItem(XMLoadFloat4x4(&skullRenderItemCopy->world), skullRenderItemCopy->objectConstantBufferIndex, geometry.get(), "Skull");
+    *skullRenderItemCopy = std::move(*renderItem);
+
+    renderItemLayer[(int)RenderLayer::Opaque].push_back(skullRenderItemCopy);
 
     geometries[geometry->Name] = std::move(geometry);
 }
@@ -1278,6 +1637,10 @@ void LandAndWaves::buildWavesGeometryBuffers() {
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
 
+    // 波浪的x和z不会变化，这里求出的包围盒x/z范围和包围球球心在updateWaves中一直沿用
+    submesh.Bounds = MeshBounds::computeBox(&waves->Position(0), waves->VertexCount(), sizeof(XMFLOAT3));
+    submesh.SphereBounds = MeshBounds::computeSphere(&waves->Position(0), waves->VertexCount(), sizeof(XMFLOAT3));
+
     geometry->DrawArgs["Waves"] = submesh;
     geometries["WaterGeometry"] = std::move(geometry);
 }
@@ -1292,6 +1655,17 @@ std::unique_ptr<FrameUtil::RenderItem> LandAndWaves::createRenderItem(const XMMA
     renderItem->startIndexLocation = geometry->DrawArgs[name].StartIndexLocation;
     renderItem->baseVertexLocation = geometry->DrawArgs[name].BaseVertexLocation;
 
+    // 被拆分成多个16位索引子网格的几何体，其余子网格跟随同一个渲染项一起绘制
+    for (uint32_t partIndex = 1; ; partIndex++) {
+        auto part = geometry->DrawArgs.find(name + "_" + std::to_string(partIndex));
+
+        if (part == geometry->DrawArgs.end()) {
+            break;
+        }
+
+        renderItem->extraSubmeshes.push_back(part->second);
+    }
+
     return renderItem;
 }
 
@@ -1302,17 +1676,12 @@ void LandAndWaves::buildRenderItems() {
 
     boxRenderItem = createRenderItem(XMMatrixIdentity(), 0, shapeGeometry, "Box");
 
-    renderItemLayer[(int)RenderLayer::Opaque].push_back(boxRenderItem.get());
+    // 帧纹理贴在盒子上
+    boxRenderItem->palettized = true;
 
-    auto landRenderItem = std::make_unique<FrameUtil::RenderItem>();
+    renderItemLayer[(int)RenderLayer::Opaque].push_back(boxRenderItem.get());
 
-    XMStoreFloat4x4(&landRenderItem->world, XMMatrixScaling(1.1f, 1.1f, 1.1f) * XMMatrixTranslation(0.0f, -1.0f, 0.0f));
-    landRenderItem->objectConstantBufferIndex = 1;
-    landRenderItem->geometry = geometries["ShapeGeometry"].get();
-    landRenderItem->primitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-    landRenderItem->indexCount = landRenderItem->geometry->DrawArgs["Land"].IndexCount;
-    landRenderItem->startIndexLocation = landRenderItem->geometry->DrawArgs["Land"].StartIndexLocation;
-    landRenderItem->baseVertexLocation = landRenderItem->geometry->DrawArgs["Land"].BaseVertexLocation;
+    auto landRenderItem = createRenderItem(XMMatrixScaling(1.1f, 1.1f, 1.1f) * XMMatrixTranslation(0.0f, -1.0f, 0.0f), 1, shapeGeometry, "Land");
 
     renderItemLayer[(int)RenderLayer::Opaque].push_back(landRenderItem.get());
 
@@ -1329,21 +1698,16 @@ void LandAndWaves::buildRenderItems() {
 
     renderItemLayer[(int)RenderLayer::Opaque].push_back(wavesRenderItem.get());
 
-    auto geometrySphereRenderItem = std::make_unique<FrameUtil::RenderItem>();
-
-    geometrySphereRenderItem->world = MathHelper::Identity4x4();
-    geometrySphereRenderItem->objectConstantBufferIndex = 3;
-    geometrySphereRenderItem->geometry = geometries["ShapeGeometry"].get();
-    geometrySphereRenderItem->primitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-    geometrySphereRenderItem->indexCount = geometrySphereRenderItem->geometry->DrawArgs["Sphere"].IndexCount;
-    geometrySphereRenderItem->startIndexLocation = geometrySphereRenderItem->geometry->DrawArgs["Sphere"].StartIndexLocation;
-    geometrySphereRenderItem->baseVertexLocation = geometrySphereRenderItem->geometry->DrawArgs["Sphere"].BaseVertexLocation;
+    auto geometrySphereRenderItem = createRenderItem(XMMatrixIdentity(), 3, shapeGeometry, "Sphere");
 
     renderItemLayer[(int)RenderLayer::Opaque].push_back(geometrySphereRenderItem.get());
 
-    auto skullRenderItem = createRenderItem(XMMatrixTranslation(0.0f, 5.0f, 0.0f), 4, geometries["ShapeGeometry"].get(), "Skull");
+    // 骷髅的几何体还在异步加载，先创建渲染项占住常量缓冲区的位置，上传完成后才加入renderItemLayer
+    auto skullRenderItem = std::make_unique<FrameUtil::RenderItem>();
+    XMStoreFloat4x4(&skullRenderItem->world, XMMatrixTranslation(0.0f, 5.0f, 0.0f));
+    skullRenderItem->objectConstantBufferIndex = 4;
 
-    renderItemLayer[(int)RenderLayer::Opaque].push_back(skullRenderItem.get());
+    skullRenderItemCopy = skullRenderItem.get();
 
     allRenderItems.push_back(std::move(boxRenderItem));
     allRenderItems.push_back(std::move(landRenderItem));
@@ -1446,7 +1810,8 @@ void LandAndWaves::updatePassConstantBuffers() {
     currentFrameResource->passConstantBuffer->CopyData(0, passConstants);
 
     FrameUtil::MaterialConstants materialConstants;
-    materialConstants.materialIndex = (uint32_t)(timer.TotalTime() * 15.0f) % textures.size();
+    // 帧纹理加载完成之前textures为空
+    materialConstants.materialIndex = textures.empty() ? 0 : (uint32_t)(timer.TotalTime() * 15.0f) % textures.size();
 
     currentFrameResource->materialConstantBuffer->CopyData(0, materialConstants); 
 }
@@ -1469,14 +1834,22 @@ void LandAndWaves::updateWaves() {
     // 更新波浪模拟
     waves->Update(timer.DeltaTime());
 
+    // 波浪的高度每帧都在变化，用新的高度更新包围体
+    auto& wavesSubmesh = wavesRenderItemCopy->geometry->DrawArgs["Waves"];
+    MeshBounds::updateDynamicBounds(&waves->Position(0), waves->VertexCount(), sizeof(XMFLOAT3), wavesSubmesh.Bounds, wavesSubmesh.SphereBounds);
+
     // 使用新的位置来更新顶点缓冲
     auto currentWaveVertexBuffer = currentFrameResource->wavesVertexBuffer.get();
 
+    // 波浪网格是xz平面上的网格，切线沿x轴
+    uint32_t wavesTangent = MeshProcessing::packTangent(XMFLOAT3(1.0f, 0.0f, 0.0f), 1.0f);
+
     for (int i = 0; i < waves->VertexCount(); ++i) {
-        FrameUtil::Vertex vertex;
+        FrameUtil::Vertex vertex = {};
 
         vertex.position = waves->Position(i);
         vertex.color = XMFLOAT4(Colors::Blue);
+        vertex.tangent = wavesTangent;
 
         currentWaveVertexBuffer->CopyData(i, vertex);
     }
@@ -1580,6 +1953,16 @@ void LandAndWaves::buildImGuiWidgets()
 			ImGui::Text("counter = %d", counter);
 
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+            for (const auto& timing : assetLoader->timings()) {
+                if (timing.finished) {
+                    ImGui::Text("%s: queued %.2f ms, load %.2f ms, upload %.2f ms, total %.2f ms",
+                                timing.name.c_str(), timing.queued, timing.load, timing.upload, timing.total);
+                }
+                else {
+                    ImGui::Text("%s: loading...", timing.name.c_str());
+                }
+            }
 			ImGui::End();
 		}
 	}
@@ -1639,9 +2022,22 @@ void LandAndWaves::drawRenderItems(const std::vector<FrameUtil::RenderItem*>& re
 
     uint32_t objectContantBufferSize = d3dUtil::CalcConstantBufferByteSize(sizeof(FrameUtil::ObjectConstants));
 
+    // 命令列表重置时设置的PSO，只在相邻渲染项需要不同的PSO时才切换
+    ID3D12PipelineState* currentPipelineState = graphicsPSOs[isWireframe ? "opaque_wireframe" : "opaque"].Get();
+
     for (size_t renderItemIndex = 0; renderItemIndex < renderItems.size(); renderItemIndex++) {
         auto renderItem = renderItems[renderItemIndex];
 
+        // 调色板格式的帧纹理加载完成之后，只有标记为palettized的渲染项换成查表的像素着色器
+        if (!isWireframe) {
+            ID3D12PipelineState* pipelineState = graphicsPSOs[renderItem->palettized && paletteTexture ? "opaque_palettized" : "opaque"].Get();
+
+            if (pipelineState != currentPipelineState) {
+                commandList->SetPipelineState(pipelineState);
+                currentPipelineState = pipelineState;
+            }
+        }
+
         commandList->IASetVertexBuffers(0, 1, &renderItem->geometry->VertexBufferView());
         commandList->IASetIndexBuffer(&renderItem->geometry->IndexBufferView());
         commandList->IASetPrimitiveTopology(renderItem->primitiveType);
@@ -1665,6 +2061,10 @@ void LandAndWaves::drawRenderItems(const std::vector<FrameUtil::RenderItem*>& re
         commandList->SetGraphicsRootDescriptorTable(5, samplerDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
 
         commandList->DrawIndexedInstanced(renderItem->indexCount, 1, renderItem->startIndexLocation, renderItem->baseVertexLocation, 0);
+
+        for (const auto& submesh : renderItem->extraSubmeshes) {
+            commandList->DrawIndexedInstanced(submesh.IndexCount, 1, submesh.StartIndexLocation, submesh.BaseVertexLocation, 0);
+        }
     }
 }
 
@@ -4,6 +4,9 @@
 #include "Common/MathHelper.h"
 #include "Common/UploadBuffer.h"
 #include "Common/GeometryGenerator.h"
+#include "Common/AssetLoader.h"
+#include "Common/DerivedDataCache.h"
+#include "Common/MeshCache.h"
 #include <windef.h>
 
 #include "imgui/imgui.h"
@@ -20,6 +23,34 @@ enum class RenderLayer : int {
 	Count
 };
 
+// 在工作线程中解码好的图片，每一帧一个像素数组
+struct DecodedImages {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowPitch = 0;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    std::vector<std::vector<uint8_t>> frames;
+    // format为DXGI_FORMAT_R8_UINT时每一帧的调色板，每帧Palettized::paletteSize个R8G8B8A8颜色
+    std::vector<uint32_t> palettes;
+};
+
+// 在工作线程中加载并处理好的网格，已经是GPU的顶点格式和16位索引。
+// 命中缓存时数据直接指向内存映射的缓存文件，上传时不再复制
+struct LoadedMesh {
+    std::shared_ptr<MeshCache::View> cache;
+    // 缓存没有命中并且也没能写出新缓存时使用的数据
+    std::vector<FrameUtil::Vertex> vertices;
+    std::vector<uint16_t> indices;
+    std::vector<MeshCache::SubmeshRecord> submeshes;
+
+    const void* vertexData() const { return cache ? cache->vertexData() : vertices.data(); }
+    uint32_t vertexBytes() const { return static_cast<uint32_t>(cache ? cache->vertexBytes() : vertices.size() * sizeof(FrameUtil::Vertex)); }
+    const void* indexData() const { return cache ? cache->indexData() : indices.data(); }
+    uint32_t indexBytes() const { return static_cast<uint32_t>(cache ? cache->indexBytes() : indices.size() * sizeof(uint16_t)); }
+    const MeshCache::SubmeshRecord* submeshData() const { return cache ? cache->submeshes() : submeshes.data(); }
+    size_t submeshCount() const { return cache ? cache->submeshCount() : submeshes.size(); }
+};
+
 class LandAndWaves : public d3dApp {
 public:
 
@@ -48,6 +79,7 @@ protected:
     void createCBVSRVDescriptorHeaps();
     void createFrameResources();
     void createConstantBufferViews();
+    void createNullShaderResourceViews();
     void createShaderResourceView();
     void createSampler();
     void createRootSignature();
@@ -55,8 +87,14 @@ protected:
     void createBoxGeometry();
     void createPipelineStateOjbect();
 
-    void loadResources();
-    GeometryGenerator::MeshData loadSkullMeshData();
+    void requestAssets();
+    static DecodedImages decodeImages(const std::string& fileName, DerivedDataCache* cache);
+    static bool decodePalettizedImages(const std::string& fileName, DecodedImages& decodedImages);
+    void loadPaletteTexture(const DecodedImages& images);
+    void buildFrameTextures(const DecodedImages& images);
+    static LoadedMesh loadSkullMeshData(DerivedDataCache* derivedDataCache);
+    void buildSkullGeometry(const LoadedMesh& mesh);
+    void addSubmeshes(MeshGeometry* geometry, const std::string& name, const std::vector<GeometryGenerator::Submesh16>& parts, uint32_t vertexOffset, uint32_t indexOffset, const std::vector<FrameUtil::Vertex>& vertices);
     void buildShapeGeometry();
     void buildWavesGeometryBuffers();
     std::unique_ptr<FrameUtil::RenderItem> createRenderItem(const XMMATRIX& world, uint32_t objectConstantBufferIndex, MeshGeometry* geometry, const std::string& name);
@@ -94,14 +132,22 @@ private:
 
     ComPtr<IDxcBlob> vertexShaderByteCode = nullptr;
     ComPtr<IDxcBlob> pixelShaderByteCode = nullptr;
+    ComPtr<IDxcBlob> palettizedPixelShaderByteCode = nullptr;
 
     ComPtr<ID3D12Resource> texture;
+    // 帧纹理异步加载，描述符堆和根签名按maxFrameTextures预留位置，加载完成之前为空
+    static const uint32_t maxFrameTextures = 256;
     std::vector<ComPtr<ID3D12Resource>> textures;
     ComPtr<ID3D12Resource> textureUpload;
+    // 调色板格式的纹理所用的调色板，256 x 帧数
+    ComPtr<ID3D12Resource> paletteTexture;
+    ComPtr<ID3D12Resource> paletteUpload;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout;
 
     FrameUtil::RenderItem* wavesRenderItemCopy = nullptr;
+    // 骷髅模型异步加载，上传完成之前不参与绘制
+    FrameUtil::RenderItem* skullRenderItemCopy = nullptr;
 
     std::unique_ptr<Waves> waves;
 
@@ -143,7 +189,17 @@ private:
     float xScale = 0.1f;
     float zScale = 0.1f;
     float zoomSpeed = 0.5f;
-    DXGI_FORMAT textureFormat;
+    DXGI_FORMAT textureFormat = DXGI_FORMAT_UNKNOWN;
     XMFLOAT3 cameraPosition;
     bool isPan = false;
+
+    std::unique_ptr<DerivedDataCache> derivedDataCache;
+
+    // 放在最后，保证先于其他成员析构，工作线程不会访问到已经销毁的成员
+    std::unique_ptr<AssetLoader> assetLoader;
+    AssetLoader::Handle<DecodedImages> textureImages;
+    AssetLoader::Handle<ComPtr<IDxcBlob>> compiledVertexShader;
+    AssetLoader::Handle<ComPtr<IDxcBlob>> compiledPixelShader;
+    AssetLoader::Handle<ComPtr<IDxcBlob>> compiledPalettizedPixelShader;
+    AssetLoader::Handle<LoadedMesh> skullMeshData;
 };
\ No newline at end of file
@@ -25,6 +25,8 @@ struct VertexIn
 	float3 PosL  : POSITION;
     float4 color : COLOR;
 	float2 uv : TEXCOORD;
+	// R10G10B10A2_UNORM：xyz在[0, 1]，w为1表示右手系，0表示左手系
+	float4 tangent : TANGENT;
 };
 
 struct VertexOut
@@ -37,6 +39,27 @@ struct VertexOut
 Texture2D textures[] : register(t0);
 SamplerState textureSampler : register(s0);
 
+// 调色板格式的帧纹理(DXGI_FORMAT_R8_UINT)放在单独的寄存器空间，根签名中这一段与textures
+// 指向描述符堆中同一段帧纹理描述符。调色板纹理每一行是一帧的256个颜色
+Texture2D<uint> frameIndices[] : register(t0, space2);
+Texture2D<float4> palette : register(t0, space1);
+
+// 点采样，Wrap寻址，与CPU端的Palettized::sample相同
+float4 samplePalettized(uint frame, float2 uv)
+{
+	uint width;
+	uint height;
+	frameIndices[frame].GetDimensions(width, height);
+
+	int2 size = int2(width, height);
+	int2 texel = int2(floor(uv * float2(size)));
+	texel = ((texel % size) + size) % size;
+
+	uint index = frameIndices[frame].Load(int3(texel, 0));
+
+	return palette.Load(int3(index, frame, 0));
+}
+
 VertexOut VS(VertexIn input)
 {
 	VertexOut output;
@@ -100,4 +123,10 @@ float4 PS(VertexOut input) : SV_Target
 	return input.color;
 }
 
+// 帧纹理是调色板格式时使用的版本，materialIndex为当前帧
+float4 PSPalettized(VertexOut input) : SV_Target
+{
+	return samplePalettized(materialIndex, input.uv);
+}
+
 
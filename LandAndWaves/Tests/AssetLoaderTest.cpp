@@ -0,0 +1,216 @@
+#include "Common/AssetLoader.h"
+#include "TestUtil.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    // 让工作线程停在任务中，直到测试打开闸门
+    class Gate {
+    public:
+        void open() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                opened = true;
+            }
+
+            condition.notify_all();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return opened; });
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool opened = false;
+    };
+
+    const AssetLoader::Timing* findTiming(const std::vector<AssetLoader::Timing>& timings, const std::string& name) {
+        for (const auto& timing : timings) {
+            if (timing.name == name) {
+                return &timing;
+            }
+        }
+
+        return nullptr;
+    }
+
+    bool finished(AssetLoader& loader, const std::string& name) {
+        auto timings = loader.timings();
+        const auto* timing = findTiming(timings, name);
+
+        return timing != nullptr && timing->finished;
+    }
+
+    void testLoadAndGet() {
+        AssetLoader loader(2);
+        Gate gate;
+
+        auto handle = loader.load("value", [&gate]() {
+            gate.wait();
+            return std::string("decoded");
+        });
+
+        CHECK(handle.valid() && !handle.isReady());
+        CHECK(!finished(loader, "value") && loader.isBusy());
+
+        gate.open();
+
+        CHECK(handle.get() == "decoded" && handle.isReady());
+        CHECK(AssetLoader::Handle<int>().valid() == false);
+
+        // 工作函数的异常在get()时重新抛出，耗时照样记录
+        auto failing = loader.load("failing", []() -> int { throw std::runtime_error("broken file"); });
+        bool thrown = false;
+
+        try {
+            failing.get();
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+
+        CHECK(thrown);
+
+        while (loader.isBusy()) {
+            std::this_thread::yield();
+        }
+
+        CHECK(finished(loader, "failing"));
+    }
+
+    // 上传回调在资源完成后的第一次processUploads()中按登记顺序执行，没完成的留到下一次
+    void testUploadsWaitForLoads() {
+        AssetLoader loader(2);
+        Gate gate;
+        std::vector<std::string> uploads;
+
+        auto first = loader.load("first", []() { return 1; });
+        auto second = loader.load("second", [&gate]() {
+            gate.wait();
+            return 2;
+        });
+
+        loader.whenReady(second, [&uploads](int value) { uploads.push_back("second " + std::to_string(value)); });
+        loader.whenReady(first, [&uploads](int value) { uploads.push_back("first " + std::to_string(value)); });
+
+        first.wait();
+
+        CHECK(loader.processUploads() == 1);
+        CHECK(uploads.size() == 1 && uploads[0] == "first 1");
+        CHECK(!finished(loader, "second") && loader.isBusy());
+
+        gate.open();
+        second.wait();
+
+        CHECK(loader.processUploads() == 1);
+        CHECK(uploads.size() == 2 && uploads[1] == "second 2");
+        CHECK(loader.processUploads() == 0);
+    }
+
+    // 加载已经完成之后才调用whenReady()：资源在上传完成之前不算完成，总时间包括上传，
+    // 加载时间仍然是任务中记下的时间
+    void testWhenReadyAfterCompletion() {
+        AssetLoader loader(1);
+
+        auto handle = loader.load("late", []() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            return 7;
+        });
+
+        handle.wait();
+
+        while (!finished(loader, "late")) {
+            std::this_thread::yield();
+        }
+
+        auto beforeUpload = *findTiming(loader.timings(), "late");
+        CHECK(beforeUpload.load >= 15.0 && beforeUpload.total >= beforeUpload.load && beforeUpload.upload == 0.0);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+        int uploaded = 0;
+        loader.whenReady(handle, [&uploaded](int value) { uploaded = value; });
+
+        CHECK(!finished(loader, "late"));
+        CHECK(loader.processUploads() == 1 && uploaded == 7);
+
+        auto afterUpload = *findTiming(loader.timings(), "late");
+        CHECK(afterUpload.finished);
+        CHECK(afterUpload.load == beforeUpload.load && afterUpload.queued == beforeUpload.queued);
+        CHECK(afterUpload.total >= beforeUpload.total + 25.0);
+    }
+
+    // run()的任务不记录耗时；析构时丢弃还在排队的任务，正在执行的任务执行完毕
+    void testRunAndShutdown() {
+        std::atomic<int> count(0);
+        Gate started;
+        Gate gate;
+        std::thread opener;
+
+        {
+            AssetLoader loader(1);
+
+            loader.run([&started, &gate, &count]() {
+                started.open();
+                gate.wait();
+                count++;
+            });
+
+            for (int i = 0; i < 100; i++) {
+                loader.run([&count]() { count += 1000; });
+            }
+
+            CHECK(loader.timings().empty() && loader.isBusy());
+
+            // 析构函数开始等待工作线程之后才放行第一个任务
+            started.wait();
+            opener = std::thread([&gate]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                gate.open();
+            });
+        }
+
+        opener.join();
+
+        CHECK(count == 1);
+    }
+
+    void testPerformance() {
+        AssetLoader loader;
+        const int count = 10000;
+
+        std::vector<AssetLoader::Handle<int>> handles;
+        handles.reserve(count);
+
+        double milliseconds = TestUtil::timeMilliseconds(1, [&] {
+            for (int i = 0; i < count; i++) {
+                handles.push_back(loader.load("asset", [i]() { return i; }));
+                loader.whenReady(handles.back(), [](int) {});
+            }
+
+            for (const auto& handle : handles) {
+                handle.wait();
+            }
+
+            loader.processUploads();
+        });
+
+        printf("%d loads with uploads: %.1f ms (%.2f us per asset)\n", count, milliseconds, milliseconds * 1000.0 / count);
+    }
+}
+
+int main() {
+    testLoadAndGet();
+    testUploadsWaitForLoads();
+    testWhenReadyAfterCompletion();
+    testRunAndShutdown();
+    testPerformance();
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,361 @@
+#include "Common/DDSFile.h"
+#include "Common/TextureFootprint.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Texture {
+        DDSFile::Description description;
+        // 每个子资源紧密排列的数据，也就是DDS文件中的内容
+        std::vector<std::vector<uint8_t>> tight;
+        // 写出时使用的数据，padded时每行和每个切片后面有填充
+        std::vector<std::vector<uint8_t>> source;
+        std::vector<DDSFile::Subresource> subresources;
+    };
+
+    std::string temporaryFileName(const char* name) {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    std::vector<uint8_t> readBytes(const std::string& fileName) {
+        std::ifstream file(fileName, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void writeBytes(const std::string& fileName, const std::vector<uint8_t>& bytes) {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    // 随机内容的纹理，padded时行距和切片距大于紧密排列的大小(像回读堆那样)
+    bool makeTexture(const DDSFile::Description& description, bool padded, std::mt19937& random, Texture& texture) {
+        texture.description = description;
+
+        uint32_t count = description.mipLevels * description.arraySize;
+        texture.tight.assign(count, {});
+        texture.source.assign(count, {});
+        texture.subresources.assign(count, {});
+
+        for (uint32_t arraySlice = 0; arraySlice < description.arraySize; arraySlice++) {
+            for (uint32_t mip = 0; mip < description.mipLevels; mip++) {
+                uint32_t index = mip + arraySlice * description.mipLevels;
+                uint32_t width = std::max<uint32_t>(1, description.width >> mip);
+                uint32_t height = std::max<uint32_t>(1, description.height >> mip);
+                uint32_t depth = std::max<uint32_t>(1, description.depth >> mip);
+
+                uint64_t rowBytes = 0;
+                uint64_t numRows = 0;
+                uint64_t slicePitch = 0;
+
+                if (!DDSFile::getSurfaceInfo(description.format, width, height, rowBytes, numRows, slicePitch)) {
+                    return false;
+                }
+
+                auto& tight = texture.tight[index];
+                tight.resize(static_cast<size_t>(slicePitch) * depth);
+
+                for (auto& byte : tight) {
+                    byte = static_cast<uint8_t>(random());
+                }
+
+                auto& subresource = texture.subresources[index];
+
+                if (padded) {
+                    size_t rowPitch = static_cast<size_t>(rowBytes) + 13;
+                    size_t paddedSlicePitch = rowPitch * numRows + 7;
+
+                    auto& source = texture.source[index];
+                    source.assign(paddedSlicePitch * depth, 0xee);
+
+                    for (uint32_t z = 0; z < depth; z++) {
+                        for (uint64_t row = 0; row < numRows; row++) {
+                            memcpy(source.data() + z * paddedSlicePitch + row * rowPitch, tight.data() + z * slicePitch + row * rowBytes, rowBytes);
+                        }
+                    }
+
+                    subresource.data = source.data();
+                    subresource.rowPitch = rowPitch;
+                    subresource.slicePitch = paddedSlicePitch;
+                } else {
+                    // 行距和切片距为0表示紧密排列
+                    subresource.data = tight.data();
+                }
+            }
+        }
+
+        return true;
+    }
+
+    DDSFile::Description makeDescription(D3D12_RESOURCE_DIMENSION dimension, DXGI_FORMAT format, uint32_t width, uint32_t height,
+                                         uint32_t depth, uint32_t mipLevels, uint32_t arraySize, bool isCubeMap = false) {
+        DDSFile::Description description;
+        description.dimension = dimension;
+        description.format = format;
+        description.width = width;
+        description.height = height;
+        description.depth = depth;
+        description.mipLevels = mipLevels;
+        description.arraySize = arraySize;
+        description.isCubeMap = isCubeMap;
+
+        return description;
+    }
+
+    bool sameDescription(const DDSFile::Description& a, const DDSFile::Description& b) {
+        return a.dimension == b.dimension && a.format == b.format && a.width == b.width && a.height == b.height
+            && a.depth == b.depth && a.mipLevels == b.mipLevels && a.arraySize == b.arraySize && a.isCubeMap == b.isCubeMap;
+    }
+
+    // write写出，再用View::open(内存映射 + parse)读回，描述和每个子资源的内容都与写入的相同。
+    // expectLegacy表示这个纹理应该使用遗留头部
+    void testRoundTrip(const char* name, const DDSFile::Description& description, bool expectLegacy, std::mt19937& random) {
+        const std::string fileName = temporaryFileName("DDSFileTest.dds");
+
+        for (bool padded : { false, true }) {
+            for (bool forceDX10Header : { false, true }) {
+                Texture texture;
+
+                if (!CHECK(makeTexture(description, padded, random, texture))) {
+                    printf("%s: unsupported format\n", name);
+                    return;
+                }
+
+                if (!CHECK(DDSFile::write(fileName, description, texture.subresources.data(), forceDX10Header))) {
+                    printf("%s: write failed\n", name);
+                    continue;
+                }
+
+                // 文件 = magic + 头部 + (DX10扩展头) + 紧密排列的数据
+                size_t dataBytes = 0;
+
+                for (const auto& tight : texture.tight) {
+                    dataBytes += tight.size();
+                }
+
+                bool legacy = expectLegacy && !forceDX10Header;
+                size_t headerBytes = sizeof(uint32_t) + sizeof(DDSFile::Header) + (legacy ? 0 : sizeof(DDSFile::HeaderDXT10));
+
+                if (!CHECK(std::filesystem::file_size(fileName) == headerBytes + dataBytes)) {
+                    printf("%s: padded %d, forceDX10Header %d\n", name, padded, forceDX10Header);
+                }
+
+                DDSFile::View view;
+
+                if (!CHECK(view.open(fileName))) {
+                    printf("%s: padded %d, forceDX10Header %d\n", name, padded, forceDX10Header);
+                    continue;
+                }
+
+                CHECK(sameDescription(view.description(), description));
+
+                if (!CHECK(view.subresourceCount() == texture.tight.size())) {
+                    continue;
+                }
+
+                bool dataMatches = true;
+
+                for (uint32_t i = 0; i < view.subresourceCount(); i++) {
+                    const auto& subresource = view.subresource(i);
+                    const auto& tight = texture.tight[i];
+
+                    dataMatches = dataMatches && subresource.slicePitch * subresource.depth == tight.size()
+                        && memcmp(subresource.data, tight.data(), tight.size()) == 0;
+                }
+
+                if (!CHECK(dataMatches)) {
+                    printf("%s: padded %d, forceDX10Header %d\n", name, padded, forceDX10Header);
+                }
+            }
+        }
+
+        std::filesystem::remove(fileName);
+    }
+
+    void testRoundTrips() {
+        std::mt19937 random(2024);
+
+        const auto texture1D = D3D12_RESOURCE_DIMENSION_TEXTURE1D;
+        const auto texture2D = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        const auto texture3D = D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+
+        // 有对应像素格式的单个2D纹理、立方体贴图和3D纹理使用遗留头部
+        testRoundTrip("RGBA8 2D", makeDescription(texture2D, DXGI_FORMAT_R8G8B8A8_UNORM, 37, 19, 1, 6, 1), true, random);
+        testRoundTrip("BGRA8 2D", makeDescription(texture2D, DXGI_FORMAT_B8G8R8A8_UNORM, 64, 64, 1, 7, 1), true, random);
+        testRoundTrip("B5G6R5 2D", makeDescription(texture2D, DXGI_FORMAT_B5G6R5_UNORM, 10, 3, 1, 1, 1), true, random);
+        testRoundTrip("RGBA16F 2D", makeDescription(texture2D, DXGI_FORMAT_R16G16B16A16_FLOAT, 7, 5, 1, 3, 1), true, random);
+        testRoundTrip("BC1 2D", makeDescription(texture2D, DXGI_FORMAT_BC1_UNORM, 37, 19, 1, 6, 1), true, random);
+        testRoundTrip("BC3 2D", makeDescription(texture2D, DXGI_FORMAT_BC3_UNORM, 256, 128, 1, 9, 1), true, random);
+        testRoundTrip("BC5 2D", makeDescription(texture2D, DXGI_FORMAT_BC5_UNORM, 33, 33, 1, 2, 1), true, random);
+        testRoundTrip("RGBA8 cube", makeDescription(texture2D, DXGI_FORMAT_R8G8B8A8_UNORM, 16, 16, 1, 5, 6, true), true, random);
+        testRoundTrip("RGBA8 3D", makeDescription(texture3D, DXGI_FORMAT_R8G8B8A8_UNORM, 9, 7, 5, 4, 1), true, random);
+        testRoundTrip("BC1 3D", makeDescription(texture3D, DXGI_FORMAT_BC1_UNORM, 16, 8, 3, 2, 1), true, random);
+
+        // 格式、数组或者1D纹理只能用DX10扩展头表示
+        testRoundTrip("RGBA8 sRGB 2D", makeDescription(texture2D, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 37, 19, 1, 6, 1), false, random);
+        testRoundTrip("BC7 2D", makeDescription(texture2D, DXGI_FORMAT_BC7_UNORM, 37, 19, 1, 6, 1), false, random);
+        testRoundTrip("BC6H 2D", makeDescription(texture2D, DXGI_FORMAT_BC6H_UF16, 20, 12, 1, 3, 1), false, random);
+        testRoundTrip("RGBA8 array", makeDescription(texture2D, DXGI_FORMAT_R8G8B8A8_UNORM, 37, 19, 1, 6, 3), false, random);
+        testRoundTrip("BC3 cube array", makeDescription(texture2D, DXGI_FORMAT_BC3_UNORM, 16, 16, 1, 5, 12, true), false, random);
+        testRoundTrip("R32F 1D array", makeDescription(texture1D, DXGI_FORMAT_R32_FLOAT, 100, 1, 1, 7, 2), false, random);
+    }
+
+    // copyToUpload按getCopyableFootprints的布局把映射中的数据放到上传堆，行之间的填充不被写入
+    void testCopyToUpload() {
+        std::mt19937 random(7);
+        const std::string fileName = temporaryFileName("DDSFileTest.dds");
+
+        Texture texture;
+        auto description = makeDescription(D3D12_RESOURCE_DIMENSION_TEXTURE2D, DXGI_FORMAT_BC1_UNORM, 100, 36, 1, 4, 2);
+
+        if (!CHECK(makeTexture(description, false, random, texture))) {
+            return;
+        }
+
+        CHECK(DDSFile::write(fileName, description, texture.subresources.data()));
+
+        DDSFile::View view;
+
+        if (!CHECK(view.open(fileName))) {
+            return;
+        }
+
+        uint32_t count = view.subresourceCount();
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(count);
+        std::vector<uint32_t> numRows(count);
+        std::vector<uint64_t> rowSizeInBytes(count);
+        uint64_t totalBytes = 0;
+
+        if (!CHECK(TextureFootprint::getCopyableFootprints(DDSFile::resourceDesc(view.description()), 0, count, 0,
+                                                           layouts.data(), numRows.data(), rowSizeInBytes.data(), &totalBytes))) {
+            return;
+        }
+
+        std::vector<uint8_t> upload(static_cast<size_t>(totalBytes), 0xcd);
+        view.copyToUpload(upload.data(), 0, count, layouts.data(), numRows.data(), rowSizeInBytes.data());
+
+        bool rowsMatch = true;
+        bool paddingIntact = true;
+
+        for (uint32_t i = 0; i < count; i++) {
+            const auto& tight = texture.tight[i];
+
+            for (uint32_t row = 0; row < numRows[i]; row++) {
+                const uint8_t* dest = upload.data() + layouts[i].Offset + static_cast<size_t>(row) * layouts[i].Footprint.RowPitch;
+                rowsMatch = rowsMatch && memcmp(dest, tight.data() + row * rowSizeInBytes[i], rowSizeInBytes[i]) == 0;
+
+                // totalBytes不包括最后一行之后的填充
+                size_t rowEnd = std::min<size_t>(layouts[i].Footprint.RowPitch, upload.data() + upload.size() - dest);
+
+                for (size_t x = static_cast<size_t>(rowSizeInBytes[i]); x < rowEnd; x++) {
+                    paddingIntact = paddingIntact && dest[x] == 0xcd;
+                }
+            }
+        }
+
+        CHECK(rowsMatch);
+        CHECK(paddingIntact);
+
+        view.close();
+        std::filesystem::remove(fileName);
+    }
+
+    // 损坏或截断的文件被拒绝，不会读到映射之外
+    void testMalformed() {
+        std::mt19937 random(11);
+        const std::string fileName = temporaryFileName("DDSFileTest.dds");
+
+        Texture texture;
+        auto description = makeDescription(D3D12_RESOURCE_DIMENSION_TEXTURE2D, DXGI_FORMAT_R8G8B8A8_UNORM, 32, 16, 1, 6, 1);
+
+        if (!CHECK(makeTexture(description, false, random, texture)) || !CHECK(DDSFile::write(fileName, description, texture.subresources.data()))) {
+            return;
+        }
+
+        const std::vector<uint8_t> original = readBytes(fileName);
+        const size_t headerOffset = sizeof(uint32_t);
+
+        DDSFile::Description parsed;
+        std::vector<DDSFile::Subresource> subresources;
+
+        CHECK(DDSFile::parse(original.data(), original.size(), parsed, subresources));
+        CHECK(!DDSFile::parse(original.data(), original.size() - 1, parsed, subresources));
+        CHECK(!DDSFile::parse(original.data(), sizeof(uint32_t) + sizeof(DDSFile::Header) - 1, parsed, subresources));
+        CHECK(!DDSFile::parse(nullptr, 0, parsed, subresources));
+
+        auto corrupt = [&](size_t offset, uint32_t value) {
+            auto bytes = original;
+            memcpy(bytes.data() + offset, &value, sizeof(value));
+            return DDSFile::parse(bytes.data(), bytes.size(), parsed, subresources);
+        };
+
+        CHECK(!corrupt(0, 0x20534445));
+        CHECK(!corrupt(headerOffset + offsetof(DDSFile::Header, size), 100));
+        CHECK(!corrupt(headerOffset + offsetof(DDSFile::Header, width), 0));
+        CHECK(!corrupt(headerOffset + offsetof(DDSFile::Header, mipMapCount), 40));
+        CHECK(!corrupt(headerOffset + offsetof(DDSFile::Header, width), 0x10000000));
+        CHECK(!corrupt(headerOffset + offsetof(DDSFile::Header, pixelFormat) + offsetof(DDSFile::PixelFormat, size), 0));
+
+        // 文件末尾多余的数据不影响读取
+        auto longer = original;
+        longer.push_back(0);
+        writeBytes(fileName, longer);
+
+        DDSFile::View view;
+        CHECK(view.open(fileName));
+        view.close();
+
+        // 截断的文件
+        auto truncated = original;
+        truncated.resize(truncated.size() - 1);
+        writeBytes(fileName, truncated);
+        CHECK(!view.open(fileName));
+
+        std::filesystem::remove(fileName);
+        CHECK(!view.open(fileName));
+    }
+
+    void testPerformance() {
+        std::mt19937 random(3);
+        const std::string fileName = temporaryFileName("DDSFileTest.dds");
+
+        Texture texture;
+        auto description = makeDescription(D3D12_RESOURCE_DIMENSION_TEXTURE2D, DXGI_FORMAT_R8G8B8A8_UNORM, 2048, 2048, 1, 12, 1);
+
+        // 回读堆的行距按256字节对齐，这里用填充的行模拟
+        if (!CHECK(makeTexture(description, true, random, texture))) {
+            return;
+        }
+
+        double writeMilliseconds = TestUtil::timeMilliseconds(5, [&] {
+            CHECK(DDSFile::write(fileName, description, texture.subresources.data()));
+        });
+
+        double openMilliseconds = TestUtil::timeMilliseconds(20, [&] {
+            DDSFile::View view;
+            CHECK(view.open(fileName));
+        });
+
+        printf("2048x2048 RGBA8 with mips (%.1f MB): write %.2f ms, open %.3f ms\n",
+            std::filesystem::file_size(fileName) / (1024.0 * 1024.0), writeMilliseconds, openMilliseconds);
+
+        std::filesystem::remove(fileName);
+    }
+}
+
+int main() {
+    testRoundTrips();
+    testCopyToUpload();
+    testMalformed();
+    testPerformance();
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,255 @@
+#include "Common/DerivedDataCache.h"
+#include "TestUtil.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    // 与DerivedDataCache::entryFileName相同的命名规则
+    std::filesystem::path entryPath(const std::filesystem::path& directory, uint64_t key) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.ddc", static_cast<unsigned long long>(key));
+
+        return directory / name;
+    }
+
+    std::vector<uint8_t> readBytes(const std::filesystem::path& fileName) {
+        std::ifstream file(fileName, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void writeBytes(const std::filesystem::path& fileName, const std::vector<uint8_t>& bytes) {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    std::vector<uint8_t> makePayload(size_t size, uint8_t seed) {
+        std::vector<uint8_t> payload(size);
+
+        for (size_t i = 0; i < size; i++) {
+            payload[i] = static_cast<uint8_t>(seed + i * 7);
+        }
+
+        return payload;
+    }
+
+    uint64_t directorySize(const std::filesystem::path& directory) {
+        uint64_t size = 0;
+
+        for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+            std::error_code error;
+
+            if (entry.is_regular_file(error)) {
+                size += entry.file_size();
+            }
+        }
+
+        return size;
+    }
+
+    void setLastUsed(const std::filesystem::path& directory, uint64_t key, std::chrono::hours age) {
+        std::filesystem::last_write_time(entryPath(directory, key), std::filesystem::file_time_type::clock::now() - age);
+    }
+
+    void testKeys(const std::filesystem::path& directory) {
+        const char text[] = "source data";
+
+        uint64_t key = DerivedDataCache::makeKey(text, sizeof(text), "decoder:v1");
+        CHECK(key == DerivedDataCache::makeKey(text, sizeof(text), "decoder:v1"));
+        CHECK(key != DerivedDataCache::makeKey(text, sizeof(text), "decoder:v2"));
+        CHECK(key != DerivedDataCache::makeKey(text, sizeof(text) - 1, "decoder:v1"));
+
+        // 文件的键只取决于内容，与文件名无关
+        std::filesystem::create_directories(directory);
+
+        auto fileName = directory / "source.bin";
+        writeBytes(fileName, std::vector<uint8_t>(text, text + sizeof(text)));
+
+        uint64_t fileKey = 0;
+        CHECK(DerivedDataCache::makeFileKey(fileName.string(), "decoder:v1", fileKey) && fileKey == key);
+        CHECK(!DerivedDataCache::makeFileKey((directory / "missing.bin").string(), "decoder:v1", fileKey));
+
+        std::filesystem::remove(fileName);
+    }
+
+    void testPutGet(const std::filesystem::path& directory) {
+        DerivedDataCache cache(directory.string());
+
+        auto payload = makePayload(5000, 1);
+        std::vector<uint8_t> result;
+
+        CHECK(!cache.get(1, result));
+        CHECK(cache.put(1, payload.data(), payload.size()));
+        CHECK(cache.get(1, result) && result == payload);
+
+        // 覆盖已有的条目
+        auto replacement = makePayload(100, 2);
+        CHECK(cache.put(1, replacement.data(), replacement.size()));
+        CHECK(cache.get(1, result) && result == replacement);
+
+        CHECK(cache.put(2, nullptr, 0));
+        CHECK(cache.get(2, result) && result.empty());
+
+        // 没有遗留临时文件
+        uint32_t temporaryFiles = 0;
+
+        for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+            temporaryFiles += entry.path().extension() == ".tmp";
+        }
+
+        CHECK(temporaryFiles == 0);
+    }
+
+    // 损坏、截断或者键不匹配的条目都被拒绝
+    void testCorruption(const std::filesystem::path& directory) {
+        DerivedDataCache cache(directory.string());
+
+        auto payload = makePayload(1000, 3);
+        CHECK(cache.put(10, payload.data(), payload.size()));
+
+        const auto original = readBytes(entryPath(directory, 10));
+        std::vector<uint8_t> result;
+
+        auto corrupted = original;
+        corrupted.back() ^= 0x10;
+        writeBytes(entryPath(directory, 10), corrupted);
+        CHECK(!cache.get(10, result));
+
+        corrupted = original;
+        corrupted.resize(corrupted.size() - 1);
+        writeBytes(entryPath(directory, 10), corrupted);
+        CHECK(!cache.get(10, result));
+
+        writeBytes(entryPath(directory, 10), std::vector<uint8_t>(original.begin(), original.begin() + 8));
+        CHECK(!cache.get(10, result));
+
+        // 另一个键的文件名下的条目
+        writeBytes(entryPath(directory, 11), original);
+        CHECK(!cache.get(11, result));
+
+        writeBytes(entryPath(directory, 10), original);
+        CHECK(cache.get(10, result) && result == payload);
+    }
+
+    // 超过上限时按最近使用时间淘汰，get会更新最近使用时间
+    void testTrim(const std::filesystem::path& directory) {
+        auto payload = makePayload(1000, 4);
+        const uint64_t entrySize = 32 + payload.size();
+
+        DerivedDataCache cache(directory.string(), entrySize * 3);
+
+        for (uint64_t key = 1; key <= 3; key++) {
+            CHECK(cache.put(key, payload.data(), payload.size()));
+        }
+
+        setLastUsed(directory, 1, std::chrono::hours(3));
+        setLastUsed(directory, 2, std::chrono::hours(2));
+        setLastUsed(directory, 3, std::chrono::hours(1));
+
+        std::vector<uint8_t> result;
+        CHECK(cache.get(1, result));
+
+        CHECK(cache.put(4, payload.data(), payload.size()));
+
+        CHECK(!std::filesystem::exists(entryPath(directory, 2)));
+        CHECK(cache.get(1, result) && cache.get(3, result) && cache.get(4, result));
+        CHECK(directorySize(directory) <= cache.getMaxSize());
+
+#if !defined(_WIN32)
+        // 无法读取状态的条目(这里是指向不存在文件的符号链接，相当于遍历时被其他线程删除的文件)
+        // 只跳过它自己，其余的条目仍然参与淘汰
+        for (const char* name : { "0000000000000000.ddc", "7fffffffffffffff.ddc", "ffffffffffffffff.ddc" }) {
+            std::filesystem::create_symlink(directory / "missing", directory / name);
+        }
+
+        for (uint64_t key = 5; key <= 8; key++) {
+            CHECK(cache.put(key, payload.data(), payload.size()));
+        }
+
+        CHECK(directorySize(directory) <= cache.getMaxSize());
+        CHECK(cache.get(8, result));
+#endif
+    }
+
+    // 多个线程同时读写同一组键，读到的要么不存在，要么是完整的数据
+    void testConcurrentAccess(const std::filesystem::path& directory) {
+        DerivedDataCache cache(directory.string(), 64 * 1024);
+
+        std::vector<std::vector<uint8_t>> payloads;
+
+        for (uint8_t key = 0; key < 8; key++) {
+            payloads.push_back(makePayload(4000 + key * 100, key));
+        }
+
+        bool allValid = true;
+        std::vector<std::thread> threads;
+        // 每个线程写自己的元素，不能用vector<bool>(元素共用字节)
+        std::vector<uint8_t> threadValid(4, 1);
+
+        for (uint32_t thread = 0; thread < 4; thread++) {
+            threads.emplace_back([&, thread] {
+                std::vector<uint8_t> result;
+
+                for (uint32_t i = 0; i < 200; i++) {
+                    uint64_t key = (i * 5 + thread) % payloads.size();
+
+                    if (i % 2 == 0) {
+                        cache.put(key, payloads[key].data(), payloads[key].size());
+                    }
+                    else if (cache.get(key, result) && result != payloads[key]) {
+                        threadValid[thread] = 0;
+                    }
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (uint8_t valid : threadValid) {
+            allValid = allValid && valid != 0;
+        }
+
+        CHECK(allValid);
+    }
+
+    void testPerformance(const std::filesystem::path& directory) {
+        DerivedDataCache cache(directory.string());
+
+        auto payload = makePayload(16 << 20, 5);
+        std::vector<uint8_t> result;
+
+        double putMilliseconds = TestUtil::timeMilliseconds(5, [&] {
+            CHECK(cache.put(100, payload.data(), payload.size()));
+        });
+
+        double getMilliseconds = TestUtil::timeMilliseconds(10, [&] {
+            CHECK(cache.get(100, result));
+        });
+
+        printf("16 MB entry: put %.2f ms, get %.2f ms\n", putMilliseconds, getMilliseconds);
+    }
+}
+
+int main() {
+    const auto root = std::filesystem::temp_directory_path() / "DerivedDataCacheTest";
+    std::filesystem::remove_all(root);
+
+    testKeys(root);
+    testPutGet(root / "putget");
+    testCorruption(root / "corruption");
+    testTrim(root / "trim");
+    testConcurrentAccess(root / "concurrent");
+    testPerformance(root / "performance");
+
+    std::filesystem::remove_all(root);
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// 测试用的最小GIF编码器：在内存中生成已知像素的GIF，交给GifDecoder解码后逐像素比较。
+// 调色板颜色与GifDecoder::Palette相同，R8G8B8A8，R在最低字节(alpha被忽略)
+namespace GifWriter {
+    struct Frame {
+        uint32_t left = 0;
+        uint32_t top = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        // 按正常行序排列的调色板索引，交错存储的帧由write重新排列
+        std::vector<uint8_t> indices;
+        // 为空时使用全局调色板
+        std::vector<uint32_t> localPalette;
+        bool interlaced = false;
+        int32_t transparentIndex = -1;
+        uint32_t disposal = 0;
+        // 1/100秒
+        uint32_t delay = 0;
+        // 只编码前encodedPixels个像素就写结束码，用来模拟提前结束的数据
+        size_t encodedPixels = SIZE_MAX;
+    };
+
+    // 按LSB优先的顺序把变长码写成字节流
+    class BitWriter {
+    public:
+        void write(uint32_t code, uint32_t codeSize) {
+            bitBuffer |= static_cast<uint64_t>(code) << bitCount;
+            bitCount += codeSize;
+
+            while (bitCount >= 8) {
+                bytes.push_back(static_cast<uint8_t>(bitBuffer));
+                bitBuffer >>= 8;
+                bitCount -= 8;
+            }
+        }
+
+        std::vector<uint8_t> finish() {
+            if (bitCount > 0) {
+                bytes.push_back(static_cast<uint8_t>(bitBuffer));
+            }
+
+            bitBuffer = 0;
+            bitCount = 0;
+
+            return std::move(bytes);
+        }
+
+    private:
+        std::vector<uint8_t> bytes;
+        uint64_t bitBuffer = 0;
+        uint32_t bitCount = 0;
+    };
+
+    // 能容纳colorCount个颜色的调色板位数，GIF中最少为1
+    inline uint32_t paletteBits(size_t colorCount) {
+        uint32_t bits = 1;
+
+        while ((size_t(1) << bits) < colorCount) {
+            bits++;
+        }
+
+        return bits;
+    }
+
+    inline void appendU16(std::vector<uint8_t>& out, uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    inline void appendPalette(std::vector<uint8_t>& out, const std::vector<uint32_t>& palette) {
+        size_t colorCount = size_t(1) << paletteBits(palette.size());
+
+        for (size_t i = 0; i < colorCount; i++) {
+            uint32_t color = i < palette.size() ? palette[i] : 0;
+
+            out.push_back(static_cast<uint8_t>(color));
+            out.push_back(static_cast<uint8_t>(color >> 8));
+            out.push_back(static_cast<uint8_t>(color >> 16));
+        }
+    }
+
+    inline void appendSubBlocks(std::vector<uint8_t>& out, const std::vector<uint8_t>& data) {
+        for (size_t position = 0; position < data.size(); position += 255) {
+            size_t blockSize = data.size() - position < 255 ? data.size() - position : 255;
+
+            out.push_back(static_cast<uint8_t>(blockSize));
+            out.insert(out.end(), data.begin() + position, data.begin() + position + blockSize);
+        }
+
+        out.push_back(0);
+    }
+
+    // 标准的GIF LZW编码，码表满了(4096项)时写清除码重新开始
+    inline std::vector<uint8_t> encodeLZW(const uint8_t* indices, size_t count, uint32_t minCodeSize) {
+        const uint32_t clearCode = 1u << minCodeSize;
+        const uint32_t endCode = clearCode + 1;
+
+        BitWriter writer;
+        std::unordered_map<uint32_t, uint32_t> table;
+
+        uint32_t codeSize = minCodeSize + 1;
+        uint32_t nextCode = clearCode + 2;
+
+        writer.write(clearCode, codeSize);
+
+        if (count > 0) {
+            uint32_t prefix = indices[0];
+
+            for (size_t i = 1; i < count; i++) {
+                uint32_t key = (prefix << 8) | indices[i];
+                auto found = table.find(key);
+
+                if (found != table.end()) {
+                    prefix = found->second;
+                    continue;
+                }
+
+                writer.write(prefix, codeSize);
+
+                // 解码器读到下一个码时才加入这一项，所以码长在nextCode超过2^codeSize时才增加
+                table[key] = nextCode++;
+
+                if (nextCode > (1u << codeSize) && codeSize < 12) {
+                    codeSize++;
+                }
+
+                if (nextCode == 4096) {
+                    writer.write(clearCode, codeSize);
+                    table.clear();
+                    codeSize = minCodeSize + 1;
+                    nextCode = clearCode + 2;
+                }
+
+                prefix = indices[i];
+            }
+
+            writer.write(prefix, codeSize);
+        }
+
+        writer.write(endCode, codeSize);
+
+        return writer.finish();
+    }
+
+    // 交错存储的行序：第1遍每8行从第0行开始，第2遍每8行从第4行开始，第3遍每4行从第2行开始，第4遍每2行从第1行开始
+    inline std::vector<uint8_t> interlace(const std::vector<uint8_t>& indices, uint32_t width, uint32_t height) {
+        static const uint32_t passStart[4] = { 0, 4, 2, 1 };
+        static const uint32_t passStep[4] = { 8, 8, 4, 2 };
+
+        std::vector<uint8_t> result;
+        result.reserve(indices.size());
+
+        for (int pass = 0; pass < 4; pass++) {
+            for (uint32_t row = passStart[pass]; row < height; row += passStep[pass]) {
+                result.insert(result.end(), indices.begin() + size_t(row) * width, indices.begin() + size_t(row + 1) * width);
+            }
+        }
+
+        return result;
+    }
+
+    // loopCount >= 0时写NETSCAPE2.0扩展，0表示无限循环
+    inline std::vector<uint8_t> write(uint32_t width, uint32_t height, const std::vector<uint32_t>& globalPalette,
+                                      uint32_t backgroundIndex, const std::vector<Frame>& frames, int32_t loopCount = -1) {
+        std::vector<uint8_t> out = { 'G', 'I', 'F', '8', '9', 'a' };
+
+        appendU16(out, width);
+        appendU16(out, height);
+
+        if (globalPalette.empty()) {
+            out.push_back(0);
+        }
+        else {
+            out.push_back(static_cast<uint8_t>(0x80 | (paletteBits(globalPalette.size()) - 1)));
+        }
+
+        out.push_back(static_cast<uint8_t>(backgroundIndex));
+        out.push_back(0);
+
+        if (!globalPalette.empty()) {
+            appendPalette(out, globalPalette);
+        }
+
+        if (loopCount >= 0) {
+            const uint8_t extension[] = { 0x21, 0xff, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1 };
+            out.insert(out.end(), extension, extension + sizeof(extension));
+            appendU16(out, static_cast<uint32_t>(loopCount));
+            out.push_back(0);
+        }
+
+        for (const auto& frame : frames) {
+            // 图形控制扩展
+            out.push_back(0x21);
+            out.push_back(0xf9);
+            out.push_back(4);
+            out.push_back(static_cast<uint8_t>((frame.disposal << 2) | (frame.transparentIndex >= 0 ? 1 : 0)));
+            appendU16(out, frame.delay);
+            out.push_back(static_cast<uint8_t>(frame.transparentIndex >= 0 ? frame.transparentIndex : 0));
+            out.push_back(0);
+
+            // 图像描述
+            out.push_back(0x2c);
+            appendU16(out, frame.left);
+            appendU16(out, frame.top);
+            appendU16(out, frame.width);
+            appendU16(out, frame.height);
+
+            uint8_t flags = frame.interlaced ? 0x40 : 0x00;
+            const auto& palette = frame.localPalette.empty() ? globalPalette : frame.localPalette;
+
+            if (!frame.localPalette.empty()) {
+                flags |= static_cast<uint8_t>(0x80 | (paletteBits(frame.localPalette.size()) - 1));
+            }
+
+            out.push_back(flags);
+
+            if (!frame.localPalette.empty()) {
+                appendPalette(out, frame.localPalette);
+            }
+
+            // 最小码长不能小于2
+            uint32_t minCodeSize = paletteBits(palette.size());
+            minCodeSize = minCodeSize < 2 ? 2 : minCodeSize;
+
+            auto stored = frame.interlaced ? interlace(frame.indices, frame.width, frame.height) : frame.indices;
+            size_t count = frame.encodedPixels < stored.size() ? frame.encodedPixels : stored.size();
+
+            out.push_back(static_cast<uint8_t>(minCodeSize));
+            appendSubBlocks(out, encodeLZW(stored.data(), count, minCodeSize));
+        }
+
+        out.push_back(0x3b);
+
+        return out;
+    }
+}
@@ -0,0 +1,168 @@
+#include "Common/MeshBounds.h"
+#include "Common/MeshLoader.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace {
+    // 标量的参考实现
+    void referenceMinMax(const std::vector<uint8_t>& data, size_t count, size_t stride, XMFLOAT3& minimum, XMFLOAT3& maximum) {
+        minimum = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+        maximum = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+        for (size_t i = 0; i < count; i++) {
+            XMFLOAT3 p;
+            memcpy(&p, data.data() + i * stride, sizeof(p));
+
+            minimum = XMFLOAT3(std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z));
+            maximum = XMFLOAT3(std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z));
+        }
+    }
+
+    // 紧密排列时数据正好在最后一个顶点之后结束，越界读取会被地址检查工具发现
+    std::vector<uint8_t> randomPositions(std::mt19937& random, size_t count, size_t stride) {
+        std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+        std::vector<uint8_t> data(count * stride);
+
+        for (size_t i = 0; i < count; i++) {
+            XMFLOAT3 p(distribution(random), distribution(random), distribution(random));
+            memcpy(data.data() + i * stride, &p, sizeof(p));
+
+            // 顶点的其他成员填上比任何坐标都大的值，误用第4个分量时会被发现
+            for (size_t offset = sizeof(p); offset + 4 <= stride; offset += 4) {
+                float padding = 1.0e9f;
+                memcpy(data.data() + i * stride + offset, &padding, sizeof(padding));
+            }
+        }
+
+        return data;
+    }
+
+    bool sameBox(const BoundingBox& box, const XMFLOAT3& minimum, const XMFLOAT3& maximum) {
+        return box.Center.x == 0.5f * (minimum.x + maximum.x) && box.Center.y == 0.5f * (minimum.y + maximum.y) && box.Center.z == 0.5f * (minimum.z + maximum.z)
+            && box.Extents.x == 0.5f * (maximum.x - minimum.x) && box.Extents.y == 0.5f * (maximum.y - minimum.y) && box.Extents.z == 0.5f * (maximum.z - minimum.z);
+    }
+
+    bool containsAll(const BoundingSphere& sphere, const uint8_t* positions, size_t count, size_t stride) {
+        for (size_t i = 0; i < count; i++) {
+            XMFLOAT3 p;
+            memcpy(&p, positions + i * stride, sizeof(p));
+
+            float x = p.x - sphere.Center.x, y = p.y - sphere.Center.y, z = p.z - sphere.Center.z;
+
+            if (std::sqrt(x * x + y * y + z * z) > sphere.Radius * (1.0f + 1.0e-5f)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void testBoxMatchesScalar() {
+        std::mt19937 random(12345);
+        bool allMatch = true;
+
+        for (size_t stride : { size_t(12), size_t(16), size_t(44) }) {
+            for (size_t count = 1; count < 40; count++) {
+                std::vector<uint8_t> data = randomPositions(random, count, stride);
+
+                XMFLOAT3 minimum, maximum;
+                referenceMinMax(data, count, stride, minimum, maximum);
+
+                allMatch = allMatch && sameBox(MeshBounds::computeBox(data.data(), count, stride), minimum, maximum);
+            }
+        }
+
+        CHECK(allMatch);
+    }
+
+    void testDynamicBounds() {
+        GeometryGenerator geometryGenerator;
+        GeometryGenerator::MeshData grid = geometryGenerator.CreateGrid(160.0f, 160.0f, 129, 129);
+
+        std::vector<XMFLOAT3> positions(grid.Vertices.size());
+
+        for (size_t i = 0; i < positions.size(); i++) {
+            positions[i] = grid.Vertices[i].Position;
+        }
+
+        BoundingBox box = MeshBounds::computeBox(positions.data(), positions.size(), sizeof(XMFLOAT3));
+        BoundingSphere sphere = MeshBounds::computeSphere(positions.data(), positions.size(), sizeof(XMFLOAT3));
+        XMFLOAT3 initialCenter = sphere.Center;
+
+        // 模拟波浪：只改变高度
+        for (size_t i = 0; i < positions.size(); i++) {
+            positions[i].y = 3.0f * std::sin(positions[i].x * 0.1f) * std::cos(positions[i].z * 0.07f);
+        }
+
+        positions[positions.size() / 2].y = 9.0f;
+
+        MeshBounds::updateDynamicBounds(positions.data(), positions.size(), sizeof(XMFLOAT3), box, sphere);
+
+        std::vector<uint8_t> bytes(positions.size() * sizeof(XMFLOAT3));
+        memcpy(bytes.data(), positions.data(), bytes.size());
+
+        XMFLOAT3 minimum, maximum;
+        referenceMinMax(bytes, positions.size(), sizeof(XMFLOAT3), minimum, maximum);
+
+        CHECK(sameBox(box, minimum, maximum));
+        CHECK(sphere.Center.x == initialCenter.x && sphere.Center.y == initialCenter.y && sphere.Center.z == initialCenter.z);
+        CHECK(containsAll(sphere, bytes.data(), positions.size(), sizeof(XMFLOAT3)));
+
+        // 半径正好是到某个顶点的距离，而不是包围盒的外接球
+        float circumRadius = std::sqrt(box.Extents.x * box.Extents.x + box.Extents.y * box.Extents.y + box.Extents.z * box.Extents.z);
+        CHECK(sphere.Radius < circumRadius);
+
+        double milliseconds = TestUtil::timeMilliseconds(200, [&] {
+            MeshBounds::updateDynamicBounds(positions.data(), positions.size(), sizeof(XMFLOAT3), box, sphere);
+        });
+
+        printf("waves    %6zu vertices, updateDynamicBounds %.3f ms\n", positions.size(), milliseconds);
+    }
+
+    void testSkull() {
+        GeometryGenerator::MeshData skull;
+
+        if (!CHECK(MeshLoader::loadSkullText("Models/skull.txt", skull))) {
+            return;
+        }
+
+        const uint8_t* positions = reinterpret_cast<const uint8_t*>(skull.Vertices.data());
+        size_t count = skull.Vertices.size();
+        size_t stride = sizeof(GeometryGenerator::Vertex);
+
+        BoundingBox box;
+        BoundingSphere sphere;
+
+        double boxMilliseconds = TestUtil::timeMilliseconds(200, [&] {
+            box = MeshBounds::computeBox(positions, count, stride);
+        });
+
+        double sphereMilliseconds = TestUtil::timeMilliseconds(20, [&] {
+            sphere = MeshBounds::computeSphere(positions, count, stride);
+        });
+
+        float circumRadius = std::sqrt(box.Extents.x * box.Extents.x + box.Extents.y * box.Extents.y + box.Extents.z * box.Extents.z);
+
+        CHECK(containsAll(sphere, positions, count, stride));
+        CHECK(sphere.Radius <= circumRadius);
+
+        printf("skull    %6zu vertices, computeBox %.3f ms, computeSphere %.3f ms, radius %.3f (box circumsphere %.3f)\n",
+            count, boxMilliseconds, sphereMilliseconds, sphere.Radius, circumRadius);
+    }
+}
+
+int main() {
+    testBoxMatchesScalar();
+    testDynamicBounds();
+    testSkull();
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,165 @@
+#include "Common/MeshCache.h"
+#include "TestUtil.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace DirectX;
+
+namespace {
+    // 与FrameUtil::Vertex大小不同的顶点，确认缓存只按调用者给的步长处理
+    struct TestVertex {
+        XMFLOAT3 position;
+        uint32_t color;
+    };
+
+    std::vector<uint8_t> readBytes(const std::string& fileName) {
+        std::ifstream file(fileName, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void writeBytes(const std::string& fileName, const std::vector<uint8_t>& bytes) {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    template<typename T>
+    void patch(std::vector<uint8_t>& bytes, size_t offset, T value) {
+        memcpy(bytes.data() + offset, &value, sizeof(value));
+    }
+
+    bool openCache(const std::string& cacheFileName, const std::string& sourceFileName,
+                   MeshCache::MissingSource missingSource = MeshCache::MissingSource::Reject) {
+        MeshCache::View view;
+        return view.open(cacheFileName, sourceFileName, sizeof(TestVertex), sizeof(uint16_t), missingSource);
+    }
+}
+
+int main() {
+    auto directory = std::filesystem::temp_directory_path() / "MeshCacheTest";
+    std::filesystem::create_directories(directory);
+
+    const std::string sourceFileName = (directory / "mesh.txt").string();
+    const std::string cacheFileName = MeshCache::cacheFileNameFor(sourceFileName);
+
+    writeBytes(sourceFileName, { 'm', 'e', 's', 'h' });
+
+    std::vector<TestVertex> vertices(100);
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        vertices[i].position = XMFLOAT3(float(i), float(i) * 2.0f, -float(i));
+        vertices[i].color = static_cast<uint32_t>(i * 0x01010101u);
+    }
+
+    std::vector<uint16_t> indices(297);
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = static_cast<uint16_t>((i * 7) % vertices.size());
+    }
+
+    std::vector<MeshCache::SubmeshRecord> submeshes = {
+        MeshCache::makeSubmeshRecord("Part", 150, 0, 0, 60, BoundingBox(XMFLOAT3(1, 2, 3), XMFLOAT3(4, 5, 6)), BoundingSphere(XMFLOAT3(7, 8, 9), 10)),
+        MeshCache::makeSubmeshRecord("Part_1", 147, 150, 60, 40, BoundingBox(XMFLOAT3(-1, -2, -3), XMFLOAT3(1, 1, 1)), BoundingSphere(XMFLOAT3(0, 0, 0), 2)),
+    };
+
+    CHECK(MeshCache::write(cacheFileName, sourceFileName,
+                           vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(TestVertex),
+                           indices.data(), static_cast<uint32_t>(indices.size()), sizeof(uint16_t),
+                           submeshes));
+
+    // 读回的数据与写入的完全一致，包围体直接来自记录
+    {
+        MeshCache::View view;
+
+        if (CHECK(view.open(cacheFileName, sourceFileName, sizeof(TestVertex), sizeof(uint16_t)))) {
+            CHECK(view.vertexCount() == vertices.size());
+            CHECK(view.vertexBytes() == vertices.size() * sizeof(TestVertex));
+            CHECK(memcmp(view.vertexData(), vertices.data(), vertices.size() * sizeof(TestVertex)) == 0);
+            CHECK(reinterpret_cast<uintptr_t>(view.vertexData()) % MeshCache::blobAlignment == 0);
+
+            CHECK(view.indexCount() == indices.size());
+            CHECK(view.indexBytes() == indices.size() * sizeof(uint16_t));
+            CHECK(memcmp(view.indexData(), indices.data(), indices.size() * sizeof(uint16_t)) == 0);
+
+            CHECK(view.submeshCount() == 2);
+            CHECK(strcmp(view.submeshes()[1].name, "Part_1") == 0);
+            CHECK(view.submeshes()[1].startIndexLocation == 150);
+            CHECK(view.submeshes()[1].baseVertexLocation == 60);
+
+            BoundingBox box = MeshCache::boxOf(view.submeshes()[0]);
+            BoundingSphere sphere = MeshCache::sphereOf(view.submeshes()[0]);
+            CHECK(box.Center.y == 2.0f && box.Extents.z == 6.0f);
+            CHECK(sphere.Center.x == 7.0f && sphere.Radius == 10.0f);
+        }
+    }
+
+    // 顶点或索引格式与调用者期望的不同时不能使用
+    {
+        MeshCache::View view;
+        CHECK(!view.open(cacheFileName, sourceFileName, sizeof(TestVertex) + 4, sizeof(uint16_t)));
+        CHECK(!view.open(cacheFileName, sourceFileName, sizeof(TestVertex), sizeof(uint32_t)));
+    }
+
+    const std::vector<uint8_t> original = readBytes(cacheFileName);
+
+    // 头部的偏移量不在校验和的范围内，必须单独验证
+    {
+        auto bytes = original;
+        patch<uint64_t>(bytes, offsetof(MeshCache::Header, submeshOffset), 0);
+        writeBytes(cacheFileName, bytes);
+        CHECK(!openCache(cacheFileName, sourceFileName));
+
+        bytes = original;
+        patch<uint64_t>(bytes, offsetof(MeshCache::Header, vertexOffset), UINT64_MAX - 63);
+        writeBytes(cacheFileName, bytes);
+        CHECK(!openCache(cacheFileName, sourceFileName));
+
+        bytes = original;
+        patch<uint32_t>(bytes, offsetof(MeshCache::Header, indexCount), UINT32_MAX);
+        writeBytes(cacheFileName, bytes);
+        CHECK(!openCache(cacheFileName, sourceFileName));
+
+        bytes = original;
+        patch<uint32_t>(bytes, offsetof(MeshCache::Header, submeshCount), 1000);
+        writeBytes(cacheFileName, bytes);
+        CHECK(!openCache(cacheFileName, sourceFileName));
+
+        // 截断的文件
+        bytes = original;
+        bytes.resize(bytes.size() - 1);
+        writeBytes(cacheFileName, bytes);
+        CHECK(!openCache(cacheFileName, sourceFileName));
+
+        // 数据损坏
+        bytes = original;
+        bytes.back() ^= 1;
+        writeBytes(cacheFileName, bytes);
+        CHECK(!openCache(cacheFileName, sourceFileName));
+
+        writeBytes(cacheFileName, original);
+        CHECK(openCache(cacheFileName, sourceFileName));
+    }
+
+    // 源文件修改后缓存过期
+    {
+        writeBytes(sourceFileName, { 'm', 'e', 's', 'h', '2' });
+        CHECK(!openCache(cacheFileName, sourceFileName));
+    }
+
+    // 源文件不存在时默认视为过期，只有明确允许时才使用
+    {
+        std::filesystem::remove(sourceFileName);
+        CHECK(!openCache(cacheFileName, sourceFileName));
+
+        CHECK(openCache(cacheFileName, sourceFileName, MeshCache::MissingSource::Accept));
+    }
+
+    std::filesystem::remove_all(directory);
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,150 @@
+#include "Common/MeshCodec.h"
+#include "Common/MeshLoader.h"
+#include "TestUtil.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace {
+    bool sameMesh(const GeometryGenerator::MeshData& a, const GeometryGenerator::MeshData& b) {
+        return a.Vertices.size() == b.Vertices.size() && a.Indices32 == b.Indices32
+            && (a.Vertices.empty() || memcmp(a.Vertices.data(), b.Vertices.data(), a.Vertices.size() * sizeof(GeometryGenerator::Vertex)) == 0);
+    }
+
+    void writeHeaderField(std::vector<uint8_t>& encoded, size_t field, uint32_t value) {
+        memcpy(encoded.data() + field * 4, &value, sizeof(value));
+    }
+
+    void testRoundTrip(const char* name, const GeometryGenerator::MeshData& meshData) {
+        std::vector<uint8_t> encoded = MeshCodec::encodeMesh(meshData);
+        GeometryGenerator::MeshData decoded;
+
+        CHECK(MeshCodec::decodeMesh(encoded.data(), encoded.size(), decoded));
+        CHECK(sameMesh(meshData, decoded));
+
+        size_t rawBytes = meshData.Vertices.size() * sizeof(GeometryGenerator::Vertex) + meshData.Indices32.size() * sizeof(uint32_t);
+        double milliseconds = TestUtil::timeMilliseconds(20, [&] {
+            MeshCodec::decodeMesh(encoded.data(), encoded.size(), decoded);
+        });
+
+        printf("%-10s %8zu -> %8zu bytes (%.2fx), decode %.3f ms, %.2f GB/s\n", name, rawBytes, encoded.size(),
+            double(rawBytes) / encoded.size(), milliseconds, rawBytes / milliseconds / 1e6);
+    }
+
+    // 头部字段依次是magic, version, vertexCount, indexCount, vertexStride, vertexBytes, indexBytes
+    void testMalformed(const GeometryGenerator::MeshData& meshData) {
+        std::vector<uint8_t> encoded = MeshCodec::encodeMesh(meshData);
+        GeometryGenerator::MeshData decoded;
+
+        for (size_t size : { size_t(0), size_t(27), encoded.size() - 1 }) {
+            CHECK(!MeshCodec::decodeMesh(encoded.data(), size, decoded));
+        }
+
+        // 顶点数与游程记号对不上，不能按头部的数量分配内存
+        std::vector<uint8_t> corrupted = encoded;
+        writeHeaderField(corrupted, 2, 0xffffffffu);
+        CHECK(!MeshCodec::decodeMesh(corrupted.data(), corrupted.size(), decoded));
+        CHECK(decoded.Vertices.size() < 0xffffffffu);
+
+        // 伪造的头部：每个平面只有一个覆盖整个平面的零值游程记号，记号本身与头部一致，
+        // 必须返回false而不是按0xffffffff个顶点分配内存
+        std::vector<uint8_t> forged(7 * sizeof(uint32_t));
+        const uint32_t vertexStride = sizeof(GeometryGenerator::Vertex);
+
+        for (uint32_t plane = 0; plane < vertexStride; plane++) {
+            // varint(0xffffffff)和varint(0)
+            forged.insert(forged.end(), { 0xff, 0xff, 0xff, 0xff, 0x0f, 0x00 });
+        }
+
+        writeHeaderField(forged, 0, MeshCodec::meshMagic);
+        writeHeaderField(forged, 1, MeshCodec::meshVersion);
+        writeHeaderField(forged, 2, 0xffffffffu);
+        writeHeaderField(forged, 3, 0);
+        writeHeaderField(forged, 4, vertexStride);
+        writeHeaderField(forged, 5, vertexStride * 6);
+        writeHeaderField(forged, 6, 0);
+
+        decoded = GeometryGenerator::MeshData();
+        CHECK(!MeshCodec::decodeMesh(forged.data(), forged.size(), decoded));
+        CHECK(decoded.Vertices.empty());
+
+        // 每个平面都是最长的零值游程时，顶点数正好是上限，可以解码
+        const uint32_t runs = 4;
+        forged.resize(7 * sizeof(uint32_t));
+
+        for (uint32_t plane = 0; plane < vertexStride; plane++) {
+            for (uint32_t run = 0; run < runs; run++) {
+                forged.insert(forged.end(), { 0x80, 0x02, 0x00 });
+            }
+        }
+
+        writeHeaderField(forged, 2, MeshCodec::maxZeroRun * runs);
+        writeHeaderField(forged, 5, vertexStride * runs * 3);
+
+        CHECK(MeshCodec::decodeMesh(forged.data(), forged.size(), decoded));
+        CHECK(decoded.Vertices.size() == MeshCodec::maxZeroRun * runs);
+
+        // 超过maxZeroRun的零值游程记号
+        forged.resize(7 * sizeof(uint32_t));
+
+        for (uint32_t plane = 0; plane < vertexStride; plane++) {
+            forged.insert(forged.end(), { 0x81, 0x02, 0x00 });
+        }
+
+        writeHeaderField(forged, 2, MeshCodec::maxZeroRun + 1);
+        writeHeaderField(forged, 5, vertexStride * 3);
+        CHECK(!MeshCodec::decodeMesh(forged.data(), forged.size(), decoded));
+
+        corrupted = encoded;
+        writeHeaderField(corrupted, 2, static_cast<uint32_t>(meshData.Vertices.size() + 1));
+        CHECK(!MeshCodec::decodeMesh(corrupted.data(), corrupted.size(), decoded));
+
+        // 索引数超过索引流能描述的上限
+        corrupted = encoded;
+        writeHeaderField(corrupted, 3, 0xfffffff0u);
+        CHECK(!MeshCodec::decodeMesh(corrupted.data(), corrupted.size(), decoded));
+        CHECK(decoded.Indices32.size() < 0xfffffff0u);
+
+        // 顶点减少后原来的索引越界
+        GeometryGenerator::MeshData truncated = meshData;
+        truncated.Vertices.pop_back();
+        corrupted = MeshCodec::encodeMesh(truncated);
+        CHECK(!MeshCodec::decodeMesh(corrupted.data(), corrupted.size(), decoded));
+    }
+}
+
+int main() {
+    GeometryGenerator geometryGenerator;
+
+    testRoundTrip("box", geometryGenerator.CreateBox(1.5f, 0.5f, 1.5f, 3));
+    testRoundTrip("sphere", geometryGenerator.CreateSphere(0.5f, 20, 20));
+    testRoundTrip("grid", geometryGenerator.CreateGrid(160.0f, 160.0f, 50, 50));
+    testRoundTrip("empty", GeometryGenerator::MeshData());
+
+    GeometryGenerator::MeshData skull;
+
+    if (CHECK(MeshLoader::loadSkullText("Models/skull.txt", skull))) {
+        testRoundTrip("skull", skull);
+
+        // loadMeshFile按扩展名识别.mshc文件
+        std::string fileName = (std::filesystem::temp_directory_path() / "MeshCodecTest.mshc").string();
+        std::vector<uint8_t> encoded = MeshCodec::encodeMesh(skull);
+
+        {
+            std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+        }
+
+        GeometryGenerator::MeshData compressedSkull;
+        CHECK(MeshLoader::loadMeshFile(fileName, compressedSkull));
+        CHECK(sameMesh(skull, compressedSkull));
+
+        std::filesystem::remove(fileName);
+    }
+
+    testMalformed(geometryGenerator.CreateSphere(0.5f, 20, 20));
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,215 @@
+#include "Common/MeshLoader.h"
+#include "TestUtil.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace {
+    // 改为整块读入 + from_chars之前的实现(逐行getline、split、atof)，原样保留作为性能和结果的基准
+    void split(const std::string& inString, const std::string& pattern, std::vector<std::string>& result) {
+        std::string source = inString;
+
+        // 当最后一次find时会找到末尾的pattern，方便退出循环
+        source += pattern;
+
+        size_t size = source.size();
+
+        for (size_t i = 0; i < size; i++) {
+            size_t position = source.find(pattern, i);
+
+            // 找到位于末尾的pattern时，position = size - 1
+            // 正好可以处理最后一个字符串子串，就不用对它
+            // 进行特殊处理了
+            if (position < size) {
+                // 截取find起始位置和pattern出现位置之间的字符串(注意和下面的注释配合理解)
+                std::string slice = source.substr(i, position - i);
+                result.push_back(slice);
+                // 将i跳到上一次pattern出现的位置，
+                // 下次循环i++之后正好位于pattern后字符串的首位
+                i = position + pattern.size() - 1;
+            }
+        }
+    }
+
+    GeometryGenerator::Vertex createVertex(const std::vector<std::string>& vertexString) {
+        GeometryGenerator::Vertex vertex;
+
+        vertex.Position.x = static_cast<float>(atof(vertexString[0].c_str()));
+        vertex.Position.y = static_cast<float>(atof(vertexString[1].c_str()));
+        vertex.Position.z = static_cast<float>(atof(vertexString[2].c_str()));
+        vertex.Normal.x =static_cast<float>(atof(vertexString[3].c_str()));
+        vertex.Normal.y =static_cast<float>(atof(vertexString[4].c_str()));
+        vertex.Normal.z =static_cast<float>(atof(vertexString[5].c_str()));
+        vertex.TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        vertex.TexC = XMFLOAT2(0.0f, 0.0f);
+
+        return vertex;
+    }
+
+    GeometryGenerator::MeshData loadSkullTextBaseline(const std::string& fileName) {
+        std::ifstream file(fileName);
+
+        const size_t lineLength = 256;
+
+        std::string line;
+
+        std::string vertexCountPattern = "VertexCount: ";
+        std::string triangleCountPattern = "TriangleCount: ";
+
+        std::vector<GeometryGenerator::Vertex> vertices;
+        std::vector<uint32_t> indices;
+
+        if (!file.eof()) {
+            uint32_t vertexCount = 0;
+            uint32_t triangleCount = 0;
+
+            // 获得顶点数:VertexCount: 31076
+            std::getline(file, line);
+
+            size_t position = line.find(vertexCountPattern);
+
+            if (position != std::string::npos) {
+                std::string vertexCountString = line.substr(vertexCountPattern.size(), lineLength - vertexCountPattern.size());
+                vertexCount = atoi(vertexCountString.c_str());
+            }
+
+            std::getline(file, line);
+
+            // 获得三角形数:TriangleCount: 60339
+            position = line.find(triangleCountPattern);
+
+            if (position != std::string::npos) {
+                std::string triangleCountString = line.substr(triangleCountPattern.size(), lineLength - triangleCountPattern.size());
+                triangleCount = atoi(triangleCountString.c_str());
+            }
+
+            // VertexList (pos, normal)
+            std::getline(file, line);
+
+            // {
+            std::getline(file, line);
+
+            uint32_t counter = 0;
+
+            std::vector<std::string> vertexString;
+
+            while (counter < vertexCount) {
+                std::getline(file, line);
+
+                // 删除开头的\t制表符
+                line.erase(line.begin());            
+                split(line, " ", vertexString);
+                vertices.emplace_back(createVertex(vertexString));
+                vertexString.clear();
+                counter++;
+            }
+
+            // }
+            std::getline(file, line);
+
+            // TriangleList
+            std::getline(file, line);
+
+            // {
+            std::getline(file, line);
+
+            counter = 0;
+
+            std::vector<std::string> indexString;
+
+            while (counter < triangleCount) {
+                std::getline(file, line);
+
+                // 删除开头的\t制表符
+                line.erase(line.begin());
+
+                split(line, " ", indexString);
+                indices.emplace_back(atoi(indexString[0].c_str()));
+                indices.emplace_back(atoi(indexString[1].c_str()));
+                indices.emplace_back(atoi(indexString[2].c_str()));
+                indexString.clear();
+                counter++;
+            }
+
+        }
+
+        GeometryGenerator::MeshData meshData;
+        meshData.Vertices = vertices;
+        meshData.Indices32 = indices;
+        return meshData;
+    }
+
+    bool sameMesh(const GeometryGenerator::MeshData& a, const GeometryGenerator::MeshData& b) {
+        return a.Vertices.size() == b.Vertices.size() && a.Indices32 == b.Indices32
+            && memcmp(a.Vertices.data(), b.Vertices.data(), a.Vertices.size() * sizeof(GeometryGenerator::Vertex)) == 0;
+    }
+
+    bool parse(const std::string& text, GeometryGenerator::MeshData& meshData) {
+        return MeshLoader::parseSkullText(text.data(), text.data() + text.size(), meshData);
+    }
+
+    void testMalformed() {
+        GeometryGenerator::MeshData meshData;
+
+        const std::string valid =
+            "VertexCount: 3\nTriangleCount: 1\nVertexList (pos, normal)\n{\n"
+            "\t0 0 0 0 1 0\n\t1 0 0 0 1 0\n\t0 0 1 0 1 0\n}\nTriangleList\n{\n\t0 1 2\n}\n";
+
+        CHECK(parse(valid, meshData));
+        CHECK(meshData.Vertices.size() == 3 && meshData.Indices32 == std::vector<uint32_t>({ 0, 1, 2 }));
+
+        // 索引越界、缺少数值、数量与头部不符都必须失败
+        std::string outOfRange = valid;
+        outOfRange.replace(outOfRange.find("0 1 2"), 5, "0 1 3");
+        CHECK(!parse(outOfRange, meshData));
+
+        std::string missingValue = valid;
+        missingValue.replace(missingValue.find("\t1 0 0 0 1 0"), 13, "\t1 0 0 0 1");
+        CHECK(!parse(missingValue, meshData));
+
+        CHECK(!parse(valid.substr(0, valid.find("TriangleList")), meshData));
+        CHECK(!parse("", meshData));
+    }
+}
+
+int main() {
+    testMalformed();
+
+    GeometryGenerator::MeshData baseline;
+    GeometryGenerator::MeshData serial;
+    GeometryGenerator::MeshData parallel;
+
+    double baselineMilliseconds = TestUtil::timeMilliseconds(5, [&] {
+        baseline = loadSkullTextBaseline("Models/skull.txt");
+    });
+
+    double loadMilliseconds = TestUtil::timeMilliseconds(5, [&] {
+        CHECK(MeshLoader::loadSkullText("Models/skull.txt", parallel));
+    });
+
+    // 单独测量不含文件读取的解析时间，分别用单线程和多线程
+    std::ifstream file("Models/skull.txt", std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    double serialMilliseconds = TestUtil::timeMilliseconds(5, [&] {
+        CHECK(parse(text, serial));
+    });
+
+    GeometryGenerator::MeshData threaded;
+    CHECK(MeshLoader::parseSkullTextParallel(text.data(), text.data() + text.size(), threaded, 4));
+
+    CHECK(baseline.Vertices.size() == 31076 && baseline.Indices32.size() == 60339 * 3);
+    CHECK(sameMesh(baseline, parallel));
+    CHECK(sameMesh(baseline, serial));
+    CHECK(sameMesh(baseline, threaded));
+
+    printf("skull.txt getline/split/atof %.2f ms, loadSkullText %.2f ms (%.1fx), parseSkullText %.2f ms\n",
+        baselineMilliseconds, loadMilliseconds, baselineMilliseconds / loadMilliseconds, serialMilliseconds);
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,240 @@
+#include "Common/MeshLoader.h"
+#include "Common/MeshProcessing.h"
+#include "TestUtil.h"
+
+#include <cmath>
+#include <limits>
+
+namespace {
+    GeometryGenerator::Vertex makeVertex(float x, float y, float z, float u = 0.0f, float v = 0.0f) {
+        GeometryGenerator::Vertex vertex;
+        vertex.Position = DirectX::XMFLOAT3(x, y, z);
+        vertex.Normal = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+        vertex.TangentU = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+        vertex.TexC = DirectX::XMFLOAT2(u, v);
+
+        return vertex;
+    }
+
+    size_t weldedCount(const std::vector<GeometryGenerator::Vertex>& vertices, const MeshProcessing::WeldOptions& options = MeshProcessing::WeldOptions()) {
+        std::vector<uint32_t> remap;
+        std::vector<GeometryGenerator::Vertex> welded;
+
+        MeshProcessing::weldVertices(vertices, options, remap, welded);
+
+        return welded.size();
+    }
+
+    // 把索引网格展开成每个三角形独立的三个顶点，再加上一点小于epsilon的扰动
+    GeometryGenerator::MeshData unweld(const GeometryGenerator::MeshData& meshData, float jitter) {
+        GeometryGenerator::MeshData result;
+
+        for (size_t i = 0; i < meshData.Indices32.size(); i++) {
+            GeometryGenerator::Vertex vertex = meshData.Vertices[meshData.Indices32[i]];
+            float offset = (i % 3 == 0 ? 1.0f : (i % 3 == 1 ? -1.0f : 0.0f)) * jitter;
+
+            vertex.Position.x += offset;
+            vertex.Position.z -= offset;
+            result.Vertices.push_back(vertex);
+            result.Indices32.push_back(static_cast<uint32_t>(i));
+        }
+
+        return result;
+    }
+
+    void testDuplicatedMesh(const char* name, const GeometryGenerator::MeshData& meshData) {
+        GeometryGenerator::MeshData duplicated = unweld(meshData, 2.0e-6f);
+        size_t originalTriangles = duplicated.Indices32.size() / 3;
+
+        MeshProcessing::weldMesh(duplicated);
+
+        // 原网格本身也可能含有重复顶点(细分出来的边中点)
+        GeometryGenerator::MeshData expected = meshData;
+        MeshProcessing::weldMesh(expected);
+
+        CHECK(duplicated.Vertices.size() == expected.Vertices.size());
+        CHECK(duplicated.Indices32.size() == meshData.Indices32.size());
+
+        // 焊接后每个索引指向的顶点与原网格中对应的顶点相同(允许扰动的误差)
+        bool samePositions = true;
+
+        for (size_t i = 0; i < duplicated.Indices32.size(); i++) {
+            const auto& a = duplicated.Vertices[duplicated.Indices32[i]].Position;
+            const auto& b = meshData.Vertices[meshData.Indices32[i]].Position;
+
+            samePositions = samePositions && std::fabs(a.x - b.x) <= 1.0e-5f && std::fabs(a.y - b.y) <= 1.0e-5f && std::fabs(a.z - b.z) <= 1.0e-5f;
+        }
+
+        CHECK(samePositions);
+        printf("%-8s %6zu -> %6zu vertices\n", name, originalTriangles * 3, duplicated.Vertices.size());
+    }
+
+    void testLargeCoordinates() {
+        // 按1e-5量化时30000已经超出int32的范围，两个顶点不能因为溢出而被合并
+        CHECK(weldedCount({ makeVertex(30000.0f, 0.0f, 0.0f), makeVertex(30000.5f, 0.0f, 0.0f) }) == 2);
+        CHECK(weldedCount({ makeVertex(-30000.0f, 0.0f, 0.0f), makeVertex(-30000.5f, 0.0f, 0.0f) }) == 2);
+        CHECK(weldedCount({ makeVertex(30000.0f, 0.0f, 0.0f), makeVertex(30000.0f, 0.0f, 0.0f) }) == 1);
+        CHECK(weldedCount({ makeVertex(1.0e30f, 0.0f, 0.0f), makeVertex(1.0e30f, 0.0f, 0.0f) }) == 2);
+
+        // NaN和无穷大不参与焊接
+        float nan = std::numeric_limits<float>::quiet_NaN();
+        float infinity = std::numeric_limits<float>::infinity();
+
+        CHECK(weldedCount({ makeVertex(nan, 0.0f, 0.0f), makeVertex(nan, 0.0f, 0.0f) }) == 2);
+        CHECK(weldedCount({ makeVertex(infinity, 0.0f, 0.0f), makeVertex(infinity, 0.0f, 0.0f), makeVertex(0.0f, 0.0f, 0.0f) }) == 3);
+    }
+
+    void testCellBoundary() {
+        // 格子边长是8e-5，1.0正好在格子边界上。两个顶点相差6e-6，分别落在边界两侧
+        float below = 1.0f - 3.0e-6f;
+        float above = 1.0f + 3.0e-6f;
+
+        CHECK(weldedCount({ makeVertex(below, 0.0f, 0.0f), makeVertex(above, 0.0f, 0.0f) }) == 1);
+        CHECK(weldedCount({ makeVertex(below, below, below), makeVertex(above, above, above) }) == 1);
+        CHECK(weldedCount({ makeVertex(-below, 0.0f, 0.0f), makeVertex(-above, 0.0f, 0.0f) }) == 1);
+
+        // 相差超过epsilon的顶点不合并
+        CHECK(weldedCount({ makeVertex(1.0f, 0.0f, 0.0f), makeVertex(1.0f + 2.0e-5f, 0.0f, 0.0f) }) == 2);
+
+        // 位置相同但纹理坐标不同的顶点(纹理接缝)不合并，只比较位置时合并
+        std::vector<GeometryGenerator::Vertex> seam = { makeVertex(below, 0.0f, 0.0f, 0.0f), makeVertex(above, 0.0f, 0.0f, 1.0f) };
+        MeshProcessing::WeldOptions positionsOnly;
+        positionsOnly.compareAttributes = false;
+
+        CHECK(weldedCount(seam) == 2);
+        CHECK(weldedCount(seam, positionsOnly) == 1);
+    }
+
+    void testFirstOccurrenceOrder() {
+        std::vector<GeometryGenerator::Vertex> vertices = {
+            makeVertex(0.0f, 0.0f, 0.0f), makeVertex(1.0f, 0.0f, 0.0f), makeVertex(0.0f, 0.0f, 0.0f), makeVertex(2.0f, 0.0f, 0.0f), makeVertex(1.0f, 0.0f, 0.0f)
+        };
+
+        std::vector<uint32_t> remap;
+        std::vector<GeometryGenerator::Vertex> welded;
+        MeshProcessing::weldVertices(vertices, MeshProcessing::WeldOptions(), remap, welded);
+
+        CHECK(welded.size() == 3);
+        CHECK(remap == std::vector<uint32_t>({ 0, 1, 0, 2, 1 }));
+    }
+
+    // 两个三角形共用一条边，左边u = x + 1，右边u = 1 - x，即纹理坐标沿接缝镜像，v = z
+    void testMirroredSeam() {
+        GeometryGenerator::MeshData quad;
+        quad.Vertices = {
+            makeVertex(-1.0f, 0.0f, 0.0f, 0.0f, 0.0f),
+            makeVertex(0.0f, 0.0f, 1.0f, 1.0f, 1.0f),
+            makeVertex(0.0f, 0.0f, -1.0f, 1.0f, -1.0f),
+            makeVertex(1.0f, 0.0f, 0.0f, 0.0f, 0.0f)
+        };
+        quad.Indices32 = { 0, 1, 2, 2, 1, 3 };
+
+        std::vector<uint32_t> packedTangents;
+        size_t splitCount = MeshProcessing::computeTangents(quad, &packedTangents);
+
+        // 接缝上的两个顶点各复制一份，每个三角形内部的手性一致且两个三角形相反
+        CHECK(splitCount == 2);
+        CHECK(quad.Vertices.size() == 6 && packedTangents.size() == 6);
+
+        float handedness[2] = {};
+
+        for (size_t triangle = 0; triangle < 2; triangle++) {
+            for (size_t corner = 0; corner < 3; corner++) {
+                DirectX::XMFLOAT3 tangent;
+                float w = 0.0f;
+                MeshProcessing::unpackTangent(packedTangents[quad.Indices32[triangle * 3 + corner]], tangent, w);
+
+                if (corner == 0) {
+                    handedness[triangle] = w;
+                }
+
+                CHECK(w == handedness[triangle]);
+            }
+        }
+
+        CHECK(handedness[0] == -handedness[1]);
+
+        // 两侧的切线都沿u增加的方向，不会在接缝处抵消成零向量
+        CHECK(quad.Vertices[quad.Indices32[1]].TangentU.x > 0.99f);
+        CHECK(quad.Vertices[quad.Indices32[4]].TangentU.x < -0.99f);
+    }
+
+    bool tangentsOrthonormal(const GeometryGenerator::MeshData& meshData) {
+        for (const auto& vertex : meshData.Vertices) {
+            const auto& t = vertex.TangentU;
+            const auto& n = vertex.Normal;
+
+            float length = std::sqrt(t.x * t.x + t.y * t.y + t.z * t.z);
+            float d = t.x * n.x + t.y * n.y + t.z * n.z;
+
+            if (std::fabs(length - 1.0f) > 1.0e-3f || std::fabs(d) > 1.0e-3f) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void testTangents(const GeometryGenerator::MeshData& skull) {
+        GeometryGenerator geometryGenerator;
+
+        // 网格的u沿x轴增加，切线应当是+x，没有镜像，不需要拆分
+        GeometryGenerator::MeshData grid = geometryGenerator.CreateGrid(10.0f, 10.0f, 20, 20);
+        CHECK(MeshProcessing::computeTangents(grid) == 0);
+        CHECK(tangentsOrthonormal(grid));
+        CHECK(grid.Vertices[0].TangentU.x > 0.999f);
+
+        testMirroredSeam();
+
+        // 骷髅没有纹理坐标，用xz平面投影作为纹理坐标：朝上和朝下的三角形正好互为镜像
+        GeometryGenerator::MeshData projected = skull;
+
+        for (auto& vertex : projected.Vertices) {
+            vertex.TexC = DirectX::XMFLOAT2(vertex.Position.x * 0.1f, vertex.Position.z * 0.1f);
+        }
+
+        GeometryGenerator::MeshData result;
+        std::vector<uint32_t> packedTangents;
+        size_t splitCount = 0;
+
+        double milliseconds = TestUtil::timeMilliseconds(5, [&] {
+            result = projected;
+            splitCount = MeshProcessing::computeTangents(result, &packedTangents);
+        });
+
+        CHECK(splitCount > 0);
+        CHECK(result.Vertices.size() == projected.Vertices.size() + splitCount);
+        CHECK(tangentsOrthonormal(result));
+        printf("tangents %6zu triangles, %zu mirrored vertices split, %.2f ms\n", result.Indices32.size() / 3, splitCount, milliseconds);
+    }
+}
+
+int main() {
+    GeometryGenerator geometryGenerator;
+
+    testLargeCoordinates();
+    testCellBoundary();
+    testFirstOccurrenceOrder();
+
+    testDuplicatedMesh("box", geometryGenerator.CreateBox(1.5f, 0.5f, 1.5f, 3));
+    testDuplicatedMesh("grid", geometryGenerator.CreateGrid(160.0f, 160.0f, 100, 100));
+
+    GeometryGenerator::MeshData skull;
+
+    if (CHECK(MeshLoader::loadSkullText("Models/skull.txt", skull))) {
+        GeometryGenerator::MeshData duplicated = unweld(skull, 0.0f);
+        std::vector<uint32_t> remap;
+        std::vector<GeometryGenerator::Vertex> welded;
+
+        double milliseconds = TestUtil::timeMilliseconds(10, [&] {
+            MeshProcessing::weldVertices(duplicated.Vertices, MeshProcessing::WeldOptions(), remap, welded);
+        });
+
+        CHECK(welded.size() <= skull.Vertices.size());
+        printf("skull    %6zu -> %6zu vertices, weld %.2f ms\n", duplicated.Vertices.size(), welded.size(), milliseconds);
+
+        testTangents(skull);
+    }
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,168 @@
+#include "Common/MeshLoader.h"
+#include "Common/ObjLoader.h"
+#include "TestUtil.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+    std::string writeTemporary(const std::string& name, const std::string& text) {
+        std::string fileName = (std::filesystem::temp_directory_path() / name).string();
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file << text;
+
+        return fileName;
+    }
+
+    bool loadText(const std::string& text, GeometryGenerator::MeshData& meshData, std::vector<ObjLoader::Submesh>& submeshes) {
+        std::string fileName = writeTemporary("ObjLoaderTest.obj", text);
+        bool result = ObjLoader::load(fileName, meshData, submeshes);
+        std::filesystem::remove(fileName);
+
+        return result;
+    }
+
+    void testFaces() {
+        GeometryGenerator::MeshData meshData;
+        std::vector<ObjLoader::Submesh> submeshes;
+
+        // 一个四边形和一个三角形共用两个角，负索引相对于当前末尾
+        const char* text =
+            "# comment\n"
+            "v 0 0 0\n"
+            "v 1 0 0\n"
+            "v 1 1 0\n"
+            "v 0 1 0\n"
+            "vt 0 0\n"
+            "vt 1 1\n"
+            "vt 0.5\n"
+            "vn 0 0 1\n"
+            "f 1/1/1 2/2/1 3/1/1 4/2/1\n"
+            "f -4/-3/-1 -2/-3/-1 4/3/1\r\n"
+            "f 1 2 3";
+
+        if (!CHECK(loadText(text, meshData, submeshes))) {
+            return;
+        }
+
+        // 扇形三角化：(0, 1, 2), (0, 2, 3)，第二个面的1/1/1和3/1/1已经存在
+        CHECK(meshData.Indices32.size() == 12);
+        CHECK(meshData.Indices32[0] == 0 && meshData.Indices32[1] == 1 && meshData.Indices32[2] == 2);
+        CHECK(meshData.Indices32[3] == 0 && meshData.Indices32[4] == 2 && meshData.Indices32[5] == 3);
+        CHECK(meshData.Indices32[6] == 0 && meshData.Indices32[7] == 2);
+
+        // 4个角 + 4/3/1 + 最后一个面没有纹理坐标和法线的3个顶点
+        CHECK(meshData.Vertices.size() == 8);
+
+        // 只有u的vt，v按0处理，翻转之后为1
+        const auto& onlyU = meshData.Vertices[meshData.Indices32[8]];
+        CHECK(onlyU.TexC.x == 0.5f && onlyU.TexC.y == 1.0f);
+        CHECK(onlyU.Normal.z == 1.0f);
+
+        CHECK(meshData.Vertices[1].TexC.x == 1.0f && meshData.Vertices[1].TexC.y == 0.0f);
+        CHECK(meshData.Vertices[6].Normal.z == 0.0f);
+
+        CHECK(submeshes.size() == 1);
+        CHECK(submeshes[0].material.empty() && submeshes[0].indexCount == 12);
+    }
+
+    void testMaterialRanges() {
+        GeometryGenerator::MeshData meshData;
+        std::vector<ObjLoader::Submesh> submeshes;
+
+        // A、B、A三段，中间没有三角形的C和重复的usemtl B不产生范围
+        const char* text =
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+            "usemtl A\n"
+            "f 1 2 3\n"
+            "usemtl C\n"
+            "usemtl B\n"
+            "f 1 2 3\n"
+            "usemtl B\n"
+            "f 3 2 1\n"
+            "usemtl A \n"
+            "f 2 3 1\n";
+
+        if (!CHECK(loadText(text, meshData, submeshes))) {
+            return;
+        }
+
+        CHECK(meshData.Indices32.size() == 12);
+
+        if (!CHECK(submeshes.size() == 3)) {
+            return;
+        }
+
+        CHECK(submeshes[0].material == "A" && submeshes[0].startIndexLocation == 0 && submeshes[0].indexCount == 3);
+        CHECK(submeshes[1].material == "B" && submeshes[1].startIndexLocation == 3 && submeshes[1].indexCount == 6);
+        CHECK(submeshes[2].material == "A" && submeshes[2].startIndexLocation == 9 && submeshes[2].indexCount == 3);
+
+        // 各范围首尾相接，覆盖整个索引数组
+        CHECK(meshData.Indices32[9] == 1 && meshData.Indices32[10] == 2 && meshData.Indices32[11] == 0);
+    }
+
+    void testMalformed() {
+        GeometryGenerator::MeshData meshData;
+        std::vector<ObjLoader::Submesh> submeshes;
+
+        CHECK(!loadText("v 0 0\n", meshData, submeshes));
+        CHECK(!loadText("vt\n", meshData, submeshes));
+        CHECK(!loadText("vt 0 x\n", meshData, submeshes));
+        CHECK(!loadText("v 0 0 0\nv 1 0 0\nf 1 2\n", meshData, submeshes));
+        CHECK(!loadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n", meshData, submeshes));
+        CHECK(!loadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 0\n", meshData, submeshes));
+        CHECK(!loadText("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1/1 2 3\n", meshData, submeshes));
+        CHECK(!ObjLoader::load("Models/does-not-exist.obj", meshData, submeshes));
+    }
+
+    // 跨越读取块边界的行，以及比整个缓冲区还长的行
+    void testBlockBoundaries() {
+        std::string text;
+        size_t vertexCount = 0;
+
+        while (text.size() < ObjLoader::blockSize * 2 + 100) {
+            text += "v " + std::to_string(vertexCount) + ".25 1 2\n";
+            vertexCount++;
+        }
+
+        text += "# " + std::string(ObjLoader::blockSize + 10, 'x') + "\n";
+        text += "f 1 2 3\nf -1 -2 -3";
+
+        GeometryGenerator::MeshData meshData;
+        std::vector<ObjLoader::Submesh> submeshes;
+
+        if (!CHECK(loadText(text, meshData, submeshes))) {
+            return;
+        }
+
+        CHECK(meshData.Indices32.size() == 6);
+        CHECK(meshData.Vertices.size() == 6);
+        CHECK(meshData.Vertices[3].Position.x == float(vertexCount - 1) + 0.25f);
+    }
+
+    // MeshLoader::loadMeshFile按扩展名转给ObjLoader
+    void testMeshLoader() {
+        std::string fileName = writeTemporary("ObjLoaderTest.OBJ", "v 0 0 0\nv 1 0 0\nv 0 1 0\nusemtl A\nf 1 2 3\nusemtl B\nf 3 2 1\n");
+
+        GeometryGenerator::MeshData meshData;
+
+        if (CHECK(MeshLoader::loadMeshFile(fileName, meshData))) {
+            CHECK(meshData.Vertices.size() == 3);
+            CHECK(meshData.Indices32.size() == 6);
+        }
+
+        std::filesystem::remove(fileName);
+    }
+}
+
+int main() {
+    testFaces();
+    testMaterialRanges();
+    testMalformed();
+    testBlockBoundaries();
+    testMeshLoader();
+
+    return TestUtil::finish();
+}
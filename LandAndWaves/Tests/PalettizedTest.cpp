@@ -0,0 +1,272 @@
+#include "Common/Palettized.h"
+#include "GifWriter.h"
+#include "TestUtil.h"
+
+#include <random>
+#include <vector>
+
+namespace {
+    GifDecoder::GIF parseGif(const std::vector<uint8_t>& bytes) {
+        GifDecoder::GIF gif;
+        CHECK(GifDecoder::parse(bytes.data(), bytes.size(), gif));
+        gif.fileData = bytes;
+
+        return gif;
+    }
+
+    std::vector<uint8_t> patternIndices(uint32_t width, uint32_t height, uint32_t colorCount) {
+        std::vector<uint8_t> indices(size_t(width) * height);
+
+        for (size_t i = 0; i < indices.size(); i++) {
+            indices[i] = static_cast<uint8_t>((i * 7 + i / width) % colorCount);
+        }
+
+        return indices;
+    }
+
+    std::vector<uint32_t> grayPalette(uint32_t colorCount) {
+        std::vector<uint32_t> palette(colorCount);
+
+        for (uint32_t i = 0; i < colorCount; i++) {
+            palette[i] = 0xff000000u | (i * 0x010101u);
+        }
+
+        return palette;
+    }
+
+    // 展开后与原来的像素逐个相同，调色板中只有实际出现的颜色
+    void testFromRGBA() {
+        std::mt19937 random(40);
+        std::vector<uint32_t> colors(256);
+
+        for (auto& color : colors) {
+            color = random();
+        }
+
+        // 连续相同的像素和交替出现的颜色都有
+        std::vector<uint32_t> pixels;
+
+        for (uint32_t i = 0; i < 5000; i++) {
+            pixels.push_back(colors[(i / 3 + (i % 2) * 17) % colors.size()]);
+        }
+
+        std::vector<uint8_t> indices;
+        uint32_t palette[Palettized::paletteSize];
+        uint32_t colorCount = 0;
+
+        CHECK(Palettized::fromRGBA(pixels.data(), pixels.size(), indices, palette, colorCount));
+        CHECK(colorCount == 256 && indices.size() == pixels.size());
+
+        std::vector<uint32_t> expanded(pixels.size());
+        Palettized::expand(indices.data(), indices.size(), palette, expanded.data());
+        CHECK(expanded == pixels);
+
+        // 少于256种颜色时剩余的调色板项为0
+        std::vector<uint32_t> fewColors = { 0xff0000ffu, 0xff0000ffu, 0x00000000u, 0x80ff00ffu, 0xff0000ffu };
+        CHECK(Palettized::fromRGBA(fewColors.data(), fewColors.size(), indices, palette, colorCount));
+        CHECK(colorCount == 3 && palette[0] == 0xff0000ffu && palette[2] == 0x80ff00ffu && palette[3] == 0);
+        CHECK(indices == std::vector<uint8_t>({ 0, 0, 1, 2, 0 }));
+
+        CHECK(Palettized::fromRGBA(nullptr, 0, indices, palette, colorCount) && colorCount == 0 && indices.empty());
+    }
+
+    // 第257种颜色出现时返回false，不管它在哪个位置
+    void testFromRGBAOverflow() {
+        std::vector<uint32_t> pixels;
+
+        for (uint32_t i = 0; i < 257; i++) {
+            // 只有高位不同的颜色，容易在哈希表中相互冲突
+            pixels.push_back(i << 20);
+        }
+
+        std::vector<uint8_t> indices;
+        uint32_t palette[Palettized::paletteSize];
+        uint32_t colorCount = 0;
+
+        CHECK(!Palettized::fromRGBA(pixels.data(), pixels.size(), indices, palette, colorCount));
+
+        std::vector<uint32_t> exactly256(pixels.begin(), pixels.begin() + 256);
+        exactly256.insert(exactly256.end(), exactly256.begin(), exactly256.end());
+        CHECK(Palettized::fromRGBA(exactly256.data(), exactly256.size(), indices, palette, colorCount) && colorCount == 256);
+
+        auto lateOverflow = exactly256;
+        lateOverflow.push_back(0xdeadbeefu);
+        CHECK(!Palettized::fromRGBA(lateOverflow.data(), lateOverflow.size(), indices, palette, colorCount));
+    }
+
+    // sample是Shader中samplePalettized的参考实现：点采样，uv乘以尺寸向下取整，Wrap寻址
+    void testSample() {
+        const uint32_t width = 5;
+        const uint32_t height = 3;
+
+        std::vector<uint32_t> pixels(width * height);
+
+        for (uint32_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = 0xff000000u | (i * 0x0b0d11u);
+        }
+
+        std::vector<uint8_t> indices;
+        uint32_t palette[Palettized::paletteSize];
+        uint32_t colorCount = 0;
+        CHECK(Palettized::fromRGBA(pixels.data(), pixels.size(), indices, palette, colorCount));
+
+        auto texel = [&](uint32_t x, uint32_t y) { return pixels[y * width + x]; };
+        auto sample = [&](float u, float v) { return Palettized::sample(indices.data(), width, height, palette, u, v); };
+
+        // 纹素中心、左上边界和右下边界前一点
+        bool centersMatch = true;
+
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                centersMatch = centersMatch && sample((x + 0.5f) / width, (y + 0.5f) / height) == texel(x, y);
+                centersMatch = centersMatch && sample(float(x) / width, float(y) / height) == texel(x, y);
+                centersMatch = centersMatch && sample((x + 0.99f) / width, (y + 0.99f) / height) == texel(x, y);
+            }
+        }
+
+        CHECK(centersMatch);
+
+        // Wrap寻址：1.0回到第0个纹素，负数从另一边开始
+        CHECK(sample(1.0f, 1.0f) == texel(0, 0));
+        CHECK(sample(-0.01f, 0.5f) == texel(4, 1));
+        CHECK(sample(-1.0f, -1.0f / 3.0f) == texel(0, 2));
+        CHECK(sample(2.5f, 3.1f) == texel(2, 0));
+        CHECK(sample(-7.9f, 0.0f) == texel(0, 0));
+
+        // 透明的调色板项采样得到0
+        uint32_t transparentPalette[Palettized::paletteSize] = {};
+        uint8_t transparentIndex = 7;
+        CHECK(Palettized::sample(&transparentIndex, 1, 1, transparentPalette, 0.3f, 0.3f) == 0);
+    }
+
+    // fromGIF得到的索引展开后，在帧矩形内等于decodeFrameRGBA的结果，帧矩形外完全透明
+    bool matchesDecoder(const GifDecoder::GIF& gif, uint32_t frameIndex, const std::vector<uint8_t>& indices, const uint32_t* palette) {
+        const auto& frame = gif.frames[frameIndex];
+
+        std::vector<uint32_t> framePixels;
+
+        if (!GifDecoder::decodeFrameRGBA(gif, frameIndex, framePixels) || indices.size() != size_t(gif.width) * gif.height) {
+            return false;
+        }
+
+        std::vector<uint32_t> expanded(indices.size());
+        Palettized::expand(indices.data(), indices.size(), palette, expanded.data());
+
+        for (uint32_t y = 0; y < gif.height; y++) {
+            for (uint32_t x = 0; x < gif.width; x++) {
+                bool inside = x >= frame.leftTop[0] && x < frame.leftTop[0] + frame.size[0]
+                    && y >= frame.leftTop[1] && y < frame.leftTop[1] + frame.size[1];
+
+                uint32_t expected = inside ? framePixels[size_t(y - frame.leftTop[1]) * frame.size[0] + (x - frame.leftTop[0])] : 0;
+
+                if (expanded[size_t(y) * gif.width + x] != expected) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void testFromGIF() {
+        std::vector<uint8_t> indices;
+        uint32_t palette[Palettized::paletteSize];
+
+        // 覆盖整个画面的帧直接使用解码出的索引，透明索引在调色板中是0
+        GifWriter::Frame full;
+        full.width = 9;
+        full.height = 6;
+        full.indices = patternIndices(9, 6, 16);
+        full.transparentIndex = 3;
+
+        // 没有覆盖整个画面、有透明索引：帧外填透明索引
+        GifWriter::Frame transparent;
+        transparent.left = 2;
+        transparent.top = 1;
+        transparent.width = 4;
+        transparent.height = 3;
+        transparent.indices = patternIndices(4, 3, 16);
+        transparent.transparentIndex = 5;
+
+        // 没有透明索引：帧外填调色板之外的第一个索引(16)。帧的右下部分超出画面
+        GifWriter::Frame opaque = transparent;
+        opaque.left = 6;
+        opaque.top = 4;
+        opaque.transparentIndex = -1;
+
+        auto gif = parseGif(GifWriter::write(9, 6, grayPalette(16), 0, { full, transparent, opaque }));
+
+        CHECK(Palettized::fromGIF(gif, 0, indices, palette) && indices == full.indices);
+        CHECK(palette[3] == 0 && palette[4] == 0xff040404u && palette[16] == 0);
+        CHECK(matchesDecoder(gif, 0, indices, palette));
+
+        CHECK(Palettized::fromGIF(gif, 1, indices, palette) && indices[0] == 5 && indices[9 * 6 - 1] == 5);
+        CHECK(matchesDecoder(gif, 1, indices, palette));
+
+        CHECK(Palettized::fromGIF(gif, 2, indices, palette) && indices[0] == 16 && palette[16] == 0);
+        CHECK(indices[4 * 9 + 6] == opaque.indices[0] && indices[5 * 9 + 8] == opaque.indices[4 + 2]);
+
+        CHECK(!Palettized::fromGIF(gif, 3, indices, palette));
+
+        // 256色调色板又没有透明索引时找不到可以填充的索引
+        GifWriter::Frame noFill = transparent;
+        noFill.transparentIndex = -1;
+        noFill.indices = patternIndices(4, 3, 256);
+
+        auto fullPaletteGif = parseGif(GifWriter::write(9, 6, grayPalette(256), 0, { noFill }));
+        CHECK(!Palettized::fromGIF(fullPaletteGif, 0, indices, palette));
+
+        // 同样的帧用局部调色板，调色板来自局部调色板
+        GifWriter::Frame local = transparent;
+        local.localPalette = { 0xff0000ffu, 0xff00ff00u, 0xffff0000u, 0xffffffffu, 0xff00ffffu, 0xffff00ffu, 0xff808080u, 0xff101010u };
+        local.indices = patternIndices(4, 3, 8);
+
+        auto localGif = parseGif(GifWriter::write(9, 6, grayPalette(256), 0, { local }));
+        CHECK(Palettized::fromGIF(localGif, 0, indices, palette) && palette[1] == 0xff00ff00u && palette[5] == 0 && palette[8] == 0);
+        CHECK(matchesDecoder(localGif, 0, indices, palette));
+    }
+
+    void testTextureFrames() {
+        GifDecoder::GIF gif;
+
+        if (!CHECK(GifDecoder::load("Textures/Kanna0.gif", gif))) {
+            return;
+        }
+
+        std::vector<uint8_t> indices;
+        uint32_t palette[Palettized::paletteSize];
+        bool allMatch = true;
+
+        double milliseconds = TestUtil::timeMilliseconds(3, [&] {
+            for (uint32_t frameIndex = 0; frameIndex < gif.frameCount; frameIndex++) {
+                allMatch = Palettized::fromGIF(gif, frameIndex, indices, palette) && matchesDecoder(gif, frameIndex, indices, palette) && allMatch;
+            }
+        });
+
+        CHECK(allMatch);
+
+        // R8G8B8A8的帧重新转回调色板格式
+        std::vector<uint32_t> pixels(indices.size());
+        Palettized::expand(indices.data(), indices.size(), palette, pixels.data());
+
+        uint32_t colorCount = 0;
+        std::vector<uint8_t> converted;
+
+        double convertMilliseconds = TestUtil::timeMilliseconds(10, [&] {
+            CHECK(Palettized::fromRGBA(pixels.data(), pixels.size(), converted, palette, colorCount));
+        });
+
+        printf("Kanna0.gif: fromGIF + check %u frames %.2f ms, fromRGBA %ux%u %.3f ms (%u colors)\n",
+               gif.frameCount, milliseconds, gif.width, gif.height, convertMilliseconds, colorCount);
+    }
+}
+
+int main() {
+    testFromRGBA();
+    testFromRGBAOverflow();
+    testSample();
+    testFromGIF();
+    testTextureFrames();
+
+    return TestUtil::finish();
+}
@@ -0,0 +1,283 @@
+#include "Common/TextureFootprint.h"
+#include "TestUtil.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(_WIN32)
+#include <wrl/client.h>
+#endif
+
+namespace {
+    struct ExpectedLayout {
+        uint64_t offset;
+        uint32_t width;
+        uint32_t height;
+        uint32_t depth;
+        uint32_t rowPitch;
+        uint32_t numRows;
+        uint64_t rowSize;
+    };
+
+    // ID3D12Device::GetCopyableFootprints对这些资源给出的结果
+    struct FootprintCase {
+        const char* name;
+        D3D12_RESOURCE_DIMENSION dimension;
+        DXGI_FORMAT format;
+        uint64_t width;
+        uint32_t height;
+        uint16_t depthOrArraySize;
+        uint16_t mipLevels;
+        uint32_t firstSubresource;
+        uint64_t baseOffset;
+        std::vector<ExpectedLayout> layouts;
+        uint64_t totalBytes;
+    };
+
+    D3D12_RESOURCE_DESC makeDesc(const FootprintCase& footprintCase) {
+        D3D12_RESOURCE_DESC desc = {};
+
+        desc.Dimension = footprintCase.dimension;
+        desc.Width = footprintCase.width;
+        desc.Height = footprintCase.height;
+        desc.DepthOrArraySize = footprintCase.depthOrArraySize;
+        desc.MipLevels = footprintCase.mipLevels;
+        desc.Format = footprintCase.format;
+        desc.SampleDesc.Count = 1;
+
+        return desc;
+    }
+
+    const D3D12_RESOURCE_DIMENSION texture1D = D3D12_RESOURCE_DIMENSION_TEXTURE1D;
+    const D3D12_RESOURCE_DIMENSION texture2D = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    const D3D12_RESOURCE_DIMENSION texture3D = D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+
+    const std::vector<FootprintCase> footprintCases = {
+        // 行大小400对齐到512，最后一行不含对齐填充
+        { "RGBA8 100x100", texture2D, DXGI_FORMAT_R8G8B8A8_UNORM, 100, 100, 1, 1, 0, 0,
+          { { 0, 100, 100, 1, 512, 100, 400 } }, 512 * 99 + 400 },
+
+        // 完整的mip链，每个子资源的起始位置对齐到512
+        { "RGBA8 64x64 mips", texture2D, DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 1, 7, 0, 0,
+          { { 0,     64, 64, 1, 256, 64, 256 },
+            { 16384, 32, 32, 1, 256, 32, 128 },
+            { 24576, 16, 16, 1, 256, 16, 64 },
+            { 28672, 8,  8,  1, 256, 8,  32 },
+            { 30720, 4,  4,  1, 256, 4,  16 },
+            { 31744, 2,  2,  1, 256, 2,  8 },
+            { 32256, 1,  1,  1, 256, 1,  4 } }, 32260 },
+
+        // 从中间的子资源开始，偏移量从baseOffset算起
+        { "RGBA8 64x64 mips 2..3", texture2D, DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 1, 7, 2, 1024,
+          { { 1024, 16, 16, 1, 256, 16, 64 },
+            { 5120, 8,  8,  1, 256, 8,  32 } }, 4096 + 256 * 7 + 32 },
+
+        // 非2的幂的mip向下取整，第0级占1280字节，下一级从1536开始
+        { "RGBA16F 7x5 mips", texture2D, DXGI_FORMAT_R16G16B16A16_FLOAT, 7, 5, 1, 3, 0, 0,
+          { { 0,    7, 5, 1, 256, 5, 56 },
+            { 1536, 3, 2, 1, 256, 2, 24 },
+            { 2048, 1, 1, 1, 256, 1, 8 } }, 2056 },
+
+        // 压缩格式：宽高向上对齐到4，一行是一行块
+        { "BC1 130x66", texture2D, DXGI_FORMAT_BC1_UNORM, 130, 66, 1, 1, 0, 0,
+          { { 0, 132, 68, 1, 512, 17, 264 } }, 512 * 16 + 264 },
+
+        // 小于一个块的mip也占一整个块
+        { "BC7 8x8 mips", texture2D, DXGI_FORMAT_BC7_UNORM, 8, 8, 1, 4, 0, 0,
+          { { 0,    8, 8, 1, 256, 2, 32 },
+            { 512,  4, 4, 1, 256, 1, 16 },
+            { 1024, 4, 4, 1, 256, 1, 16 },
+            { 1536, 4, 4, 1, 256, 1, 16 } }, 1552 },
+
+        // 打包格式：两个像素一个块
+        { "R8G8_B8G8 5x3", texture2D, DXGI_FORMAT_R8G8_B8G8_UNORM, 5, 3, 1, 1, 0, 0,
+          { { 0, 6, 3, 1, 256, 3, 12 } }, 256 * 2 + 12 },
+
+        // 纹理数组：子资源编号 = mip + arraySlice * MipLevels
+        { "R8 300x10 array", texture2D, DXGI_FORMAT_R8_UNORM, 300, 10, 3, 1, 0, 0,
+          { { 0,     300, 10, 1, 512, 10, 300 },
+            { 5120,  300, 10, 1, 512, 10, 300 },
+            { 10240, 300, 10, 1, 512, 10, 300 } }, 10240 + 512 * 9 + 300 },
+
+        { "RGBA8 16x16 array mips", texture2D, DXGI_FORMAT_R8G8B8A8_UNORM, 16, 16, 2, 2, 0, 0,
+          { { 0,    16, 16, 1, 256, 16, 64 },
+            { 4096, 8,  8,  1, 256, 8,  32 },
+            { 6144, 16, 16, 1, 256, 16, 64 },
+            { 10240, 8, 8,  1, 256, 8,  32 } }, 10240 + 256 * 7 + 32 },
+
+        // 3D纹理：每个mip的深度也减半，Depth个切片连续排列
+        { "RGBA8 32x32x4 mips", texture3D, DXGI_FORMAT_R8G8B8A8_UNORM, 32, 32, 4, 2, 0, 0,
+          { { 0,     32, 32, 4, 256, 32, 128 },
+            { 32768, 16, 16, 2, 256, 16, 64 } }, 32768 + 256 * 31 + 64 },
+
+        // 1D纹理忽略Height
+        { "R32F 1000 1D", texture1D, DXGI_FORMAT_R32_FLOAT, 1000, 1, 1, 1, 0, 0,
+          { { 0, 1000, 1, 1, 4096, 1, 4000 } }, 4000 },
+    };
+
+    bool sameLayouts(const FootprintCase& footprintCase,
+                     const std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT>& layouts,
+                     const std::vector<uint32_t>& numRows,
+                     const std::vector<uint64_t>& rowSizes,
+                     uint64_t totalBytes) {
+        bool same = totalBytes == footprintCase.totalBytes;
+
+        for (size_t index = 0; index < footprintCase.layouts.size(); index++) {
+            const ExpectedLayout& expected = footprintCase.layouts[index];
+            const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout = layouts[index];
+
+            same = same
+                && layout.Offset == expected.offset
+                && layout.Footprint.Format == footprintCase.format
+                && layout.Footprint.Width == expected.width
+                && layout.Footprint.Height == expected.height
+                && layout.Footprint.Depth == expected.depth
+                && layout.Footprint.RowPitch == expected.rowPitch
+                && numRows[index] == expected.numRows
+                && rowSizes[index] == expected.rowSize;
+        }
+
+        if (!same) {
+            printf("footprint mismatch: %s\n", footprintCase.name);
+        }
+
+        return same;
+    }
+
+    void testRecordedFootprints() {
+        for (const auto& footprintCase : footprintCases) {
+            size_t count = footprintCase.layouts.size();
+
+            std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(count);
+            std::vector<uint32_t> numRows(count);
+            std::vector<uint64_t> rowSizes(count);
+            uint64_t totalBytes = 0;
+
+            bool result = TextureFootprint::getCopyableFootprints(makeDesc(footprintCase), footprintCase.firstSubresource,
+                                                                  static_cast<uint32_t>(count), footprintCase.baseOffset,
+                                                                  layouts.data(), numRows.data(), rowSizes.data(), &totalBytes);
+
+            if (CHECK(result)) {
+                CHECK(sameLayouts(footprintCase, layouts, numRows, rowSizes, totalBytes));
+            }
+        }
+    }
+
+    void testUnsupported() {
+        D3D12_RESOURCE_DESC desc = {};
+        desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        desc.Width = 64;
+        desc.Height = 64;
+        desc.DepthOrArraySize = 1;
+        desc.MipLevels = 1;
+        desc.SampleDesc.Count = 1;
+
+        uint64_t totalBytes = 0;
+
+        // 多平面格式
+        desc.Format = DXGI_FORMAT_NV12;
+        CHECK(!TextureFootprint::getCopyableFootprints(desc, 0, 1, 0, nullptr, nullptr, nullptr, &totalBytes));
+
+        desc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+        CHECK(!TextureFootprint::getCopyableFootprints(desc, 0, 1, 0, nullptr, nullptr, nullptr, &totalBytes));
+
+        // 子资源超出范围
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        CHECK(!TextureFootprint::getCopyableFootprints(desc, 0, 2, 0, nullptr, nullptr, nullptr, &totalBytes));
+
+        desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        CHECK(!TextureFootprint::getCopyableFootprints(desc, 0, 1, 0, nullptr, nullptr, nullptr, &totalBytes));
+    }
+
+    // copySubresource按footprint写入，行尾的对齐填充和子资源之外的内容保持不变
+    void testCopySubresource() {
+        const FootprintCase& footprintCase = footprintCases[9];   // RGBA8 32x32x4 mips
+        const ExpectedLayout& expected = footprintCase.layouts[1];
+
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+        uint32_t numRows = 0;
+        uint64_t rowSize = 0;
+        uint64_t totalBytes = 0;
+
+        if (!CHECK(TextureFootprint::getCopyableFootprints(makeDesc(footprintCase), 1, 1, 0, &layout, &numRows, &rowSize, &totalBytes))) {
+            return;
+        }
+
+        std::mt19937 random(11);
+        size_t srcRowPitch = static_cast<size_t>(rowSize) + 12;
+        size_t srcSlicePitch = srcRowPitch * numRows + 40;
+        std::vector<uint8_t> src(srcSlicePitch * expected.depth);
+
+        for (auto& byte : src) {
+            byte = static_cast<uint8_t>(random());
+        }
+
+        std::vector<uint8_t> mapped(layout.Offset + totalBytes + 64, 0xcd);
+        TextureFootprint::copySubresource(mapped.data(), layout, numRows, rowSize, src.data(), srcRowPitch, srcSlicePitch);
+
+        bool rowsMatch = true;
+        bool paddingIntact = true;
+
+        for (uint32_t slice = 0; slice < expected.depth; slice++) {
+            for (uint32_t row = 0; row < numRows; row++) {
+                size_t destOffset = layout.Offset + static_cast<size_t>(layout.Footprint.RowPitch) * (slice * numRows + row);
+
+                rowsMatch = rowsMatch && memcmp(mapped.data() + destOffset, src.data() + srcSlicePitch * slice + srcRowPitch * row, rowSize) == 0;
+
+                for (size_t x = rowSize; x < layout.Footprint.RowPitch && destOffset + x < mapped.size(); x++) {
+                    paddingIntact = paddingIntact && mapped[destOffset + x] == 0xcd;
+                }
+            }
+        }
+
+        CHECK(rowsMatch);
+        CHECK(paddingIntact);
+    }
+
+#if defined(_WIN32)
+    // Windows上再用设备实际的GetCopyableFootprints核对这张表，表本身有错时也能发现
+    void testAgainstDevice() {
+        Microsoft::WRL::ComPtr<ID3D12Device> device;
+
+        if (FAILED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(device.GetAddressOf())))) {
+            printf("no D3D12 device, skipping device comparison\n");
+            return;
+        }
+
+        bool allMatch = true;
+
+        for (const auto& footprintCase : footprintCases) {
+            D3D12_RESOURCE_DESC desc = makeDesc(footprintCase);
+            UINT count = static_cast<UINT>(footprintCase.layouts.size());
+
+            std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(count);
+            std::vector<UINT> numRows(count);
+            std::vector<UINT64> rowSizes(count);
+            UINT64 totalBytes = 0;
+
+            device->GetCopyableFootprints(&desc, footprintCase.firstSubresource, count, footprintCase.baseOffset,
+                                          layouts.data(), numRows.data(), rowSizes.data(), &totalBytes);
+
+            allMatch = allMatch && sameLayouts(footprintCase, layouts,
+                                               std::vector<uint32_t>(numRows.begin(), numRows.end()),
+                                               std::vector<uint64_t>(rowSizes.begin(), rowSizes.end()),
+                                               totalBytes);
+        }
+
+        CHECK(allMatch);
+    }
+#endif
+}
+
+int main() {
+    testRecordedFootprints();
+    testUnsupported();
+    testCopySubresource();
+
+#if defined(_WIN32)
+    testAgainstDevice();
+#endif
+
+    return TestUtil::finish();
+}
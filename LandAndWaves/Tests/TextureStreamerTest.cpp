@@ -0,0 +1,402 @@
+#include "Common/TextureStreamer.h"
+#include "TestUtil.h"
+
+#include <cmath>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace {
+    struct LoadCall {
+        uint32_t texture;
+        uint32_t firstMip;
+        uint32_t mipCount;
+    };
+
+    D3D12_RESOURCE_DESC textureDesc(uint32_t width, uint32_t height, uint16_t mipLevels = 0) {
+        D3D12_RESOURCE_DESC desc = {};
+        desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        desc.Width = width;
+        desc.Height = height;
+        desc.DepthOrArraySize = 1;
+        desc.MipLevels = mipLevels;
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+
+        return desc;
+    }
+
+    // 记录每次调用的load函数，failures不为0时先失败这么多次
+    TextureStreamer::LoadFunction recordingLoad(std::vector<LoadCall>& calls, uint32_t texture, int* failures = nullptr) {
+        return [&calls, texture, failures](uint32_t firstMip, uint32_t mipCount) {
+            calls.push_back({ texture, firstMip, mipCount });
+
+            if (failures != nullptr && *failures > 0) {
+                (*failures)--;
+                return false;
+            }
+
+            return true;
+        };
+    }
+
+    uint64_t tailBytes(const TextureStreamer& streamer, TextureStreamer::TextureId texture, uint32_t mipLevels) {
+        uint64_t bytes = 0;
+
+        for (uint32_t mip = streamer.tailMip(texture); mip < mipLevels; mip++) {
+            bytes += streamer.mipBytes(texture, mip);
+        }
+
+        return bytes;
+    }
+
+    bool withinBudget(const TextureStreamer& streamer) {
+        return streamer.stats().residentBytes + streamer.stats().loadingBytes <= streamer.getOptions().memoryBudget;
+    }
+
+    void testMipTail() {
+        std::vector<LoadCall> calls;
+        TextureStreamer streamer;
+
+        // 1024x1024的完整mip链共11级，64x64(mip 4)及以下是mip尾
+        auto square = streamer.add(textureDesc(1024, 1024), recordingLoad(calls, 0));
+        auto wide = streamer.add(textureDesc(256, 64), recordingLoad(calls, 1));
+
+        D3D12_RESOURCE_DESC buffer = textureDesc(1024, 1);
+        buffer.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        CHECK(streamer.add(buffer, recordingLoad(calls, 2)) == TextureStreamer::invalidId);
+
+        CHECK(streamer.tailMip(square) == 4);
+        CHECK(streamer.mipBytes(square, 0) == 1024 * 1024 * 4);
+        CHECK(streamer.mipBytes(square, 10) == 4);
+        CHECK(streamer.tailMip(wide) == 2);
+
+        // mip尾在add()时立即请求，结果在下一次update()生效
+        if (CHECK(calls.size() == 2)) {
+            CHECK(calls[0].firstMip == 4 && calls[0].mipCount == 7);
+            CHECK(calls[1].firstMip == 2 && calls[1].mipCount == 7);
+        }
+
+        CHECK(!streamer.isReady(square));
+        CHECK(streamer.residentMip(square) == 11);
+
+        auto events = streamer.update();
+
+        CHECK(events.size() == 2);
+        CHECK(streamer.isReady(square) && streamer.residentMip(square) == 4);
+        CHECK(streamer.stats().residentBytes == tailBytes(streamer, square, 11) + tailBytes(streamer, wide, 9));
+
+        // 没有请求的纹理只需要mip尾
+        streamer.update();
+        CHECK(calls.size() == 2);
+    }
+
+    // 请求之后从粗到细每帧加载一级，直到需要的mip
+    void testRequest() {
+        std::vector<LoadCall> calls;
+        TextureStreamer streamer;
+
+        auto texture = streamer.add(textureDesc(1024, 1024), recordingLoad(calls, 0));
+
+        streamer.request(texture, 100.0f);
+        streamer.request(texture, 256.0f);
+        streamer.update();
+
+        // 同一帧取最大的请求：1024 / 256 = 4倍，需要mip 2
+        CHECK(streamer.desiredMip(texture) == 2);
+
+        for (int frame = 0; frame < 4; frame++) {
+            streamer.request(texture, 256.0f);
+            streamer.update();
+        }
+
+        CHECK(streamer.residentMip(texture) == 2);
+
+        if (CHECK(calls.size() == 3)) {
+            CHECK(calls[1].firstMip == 3 && calls[1].mipCount == 1);
+            CHECK(calls[2].firstMip == 2 && calls[2].mipCount == 1);
+        }
+
+        // 比纹理还大时需要mip 0
+        for (int frame = 0; frame < 4; frame++) {
+            streamer.request(texture, 4000.0f);
+            streamer.update();
+        }
+
+        CHECK(streamer.desiredMip(texture) == 0);
+        CHECK(streamer.residentMip(texture) == 0);
+
+        // mipBias让需要的mip更粗
+        auto options = streamer.getOptions();
+        options.mipBias = 1.0f;
+        streamer.setOptions(options);
+
+        streamer.request(texture, 1024.0f);
+        streamer.update();
+        CHECK(streamer.desiredMip(texture) == 1);
+
+        CHECK(std::fabs(TextureStreamer::screenSize(1.0f, 10.0f, 1000.0f, 1.5707964f) - 100.0f) < 0.01f);
+        CHECK(TextureStreamer::screenSize(1.0f, 0.5f, 1000.0f, 1.0f) == 1000.0f);
+    }
+
+    // 每帧提交的字节数不超过frameBudget，超过预算的一级在没有其他加载的帧单独提交，优先级高的先提交
+    void testFrameBudget() {
+        std::vector<LoadCall> calls;
+
+        TextureStreamer::Options options;
+        options.frameBudget = 512 * 1024;
+
+        TextureStreamer streamer(options);
+
+        auto a = streamer.add(textureDesc(1024, 1024), recordingLoad(calls, 0));
+        auto b = streamer.add(textureDesc(1024, 1024), recordingLoad(calls, 1));
+
+        auto frame = [&] {
+            calls.clear();
+            streamer.request(a, 1024.0f);
+            streamer.request(b, 1024.0f);
+            streamer.update();
+        };
+
+        // mip 3(64KB)和mip 2(256KB)两个纹理都能在一帧内提交
+        frame();
+        CHECK(calls.size() == 2 && streamer.stats().deferredLoads == 0);
+        frame();
+        CHECK(calls.size() == 2 && streamer.stats().frameBytes == 512 * 1024);
+
+        // mip 1(1MB)超过预算，只提交一个
+        frame();
+
+        if (CHECK(calls.size() == 1)) {
+            CHECK(calls[0].texture == 0 && calls[0].firstMip == 1);
+        }
+
+        CHECK(streamer.stats().deferredLoads == 1);
+        CHECK(streamer.stats().frameBytes == 1024 * 1024);
+
+        // b的驻留mip被放大得更多，优先于a的mip 0
+        frame();
+
+        if (CHECK(calls.size() == 1)) {
+            CHECK(calls[0].texture == 1 && calls[0].firstMip == 1);
+        }
+
+        for (int i = 0; i < 4; i++) {
+            frame();
+        }
+
+        CHECK(streamer.residentMip(a) == 0 && streamer.residentMip(b) == 0);
+    }
+
+    // 超过memoryBudget时按LRU从最细的一级开始淘汰，mip尾不淘汰，本帧请求的纹理只淘汰超过需要的部分
+    void testEviction() {
+        std::vector<LoadCall> calls;
+        TextureStreamer streamer;
+
+        auto a = streamer.add(textureDesc(1024, 1024), recordingLoad(calls, 0));
+        auto b = streamer.add(textureDesc(1024, 1024), recordingLoad(calls, 1));
+        auto c = streamer.add(textureDesc(1024, 1024), recordingLoad(calls, 2));
+
+        const uint64_t tail = tailBytes(streamer, a, 11);
+        const uint64_t chain = streamer.mipBytes(a, 0) + streamer.mipBytes(a, 1) + streamer.mipBytes(a, 2) + streamer.mipBytes(a, 3);
+
+        // 三个mip尾、一个完整的mip链和一个mip 3
+        auto options = streamer.getOptions();
+        options.memoryBudget = tail * 3 + chain + streamer.mipBytes(c, 3);
+        options.frameBudget = options.memoryBudget;
+        streamer.setOptions(options);
+
+        for (int frame = 0; frame < 6; frame++) {
+            streamer.request(a, 1024.0f);
+            streamer.update();
+        }
+
+        CHECK(streamer.residentMip(a) == 0);
+
+        // c比a更晚被请求
+        for (int frame = 0; frame < 3; frame++) {
+            streamer.request(c, 128.0f);
+            streamer.update();
+        }
+
+        CHECK(streamer.residentMip(c) == 3);
+
+        std::vector<TextureStreamer::Event> evictions;
+        bool alwaysWithinBudget = true;
+
+        for (int frame = 0; frame < 8; frame++) {
+            streamer.request(b, 1024.0f);
+
+            for (const auto& event : streamer.update()) {
+                if (event.type == TextureStreamer::Event::Type::Evicted) {
+                    evictions.push_back(event);
+                }
+            }
+
+            alwaysWithinBudget = alwaysWithinBudget && withinBudget(streamer);
+        }
+
+        CHECK(alwaysWithinBudget);
+        CHECK(streamer.residentMip(b) == 0);
+
+        // 最久没有被请求的a被淘汰到mip尾，从mip 0开始；c的mip 3正好放得下，不被淘汰
+        CHECK(streamer.residentMip(a) == streamer.tailMip(a));
+        CHECK(streamer.residentMip(c) == 3);
+
+        if (CHECK(evictions.size() == 4)) {
+            for (uint32_t i = 0; i < 4; i++) {
+                CHECK(evictions[i].texture == a && evictions[i].firstMip == i && evictions[i].residentMip == i + 1);
+            }
+        }
+
+        // 预算调小：先淘汰没有请求的c，再淘汰b超过需要(mip 2)的部分
+        options.memoryBudget = tail * 3 + streamer.mipBytes(b, 2) + streamer.mipBytes(b, 3);
+        streamer.setOptions(options);
+
+        streamer.request(b, 256.0f);
+        auto events = streamer.update();
+
+        CHECK(withinBudget(streamer));
+        CHECK(streamer.residentMip(b) == 2 && streamer.residentMip(c) == 4);
+
+        if (CHECK(events.size() == 3)) {
+            CHECK(events[0].texture == c && events[0].firstMip == 3);
+            CHECK(events[1].texture == b && events[1].firstMip == 0);
+            CHECK(events[2].texture == b && events[2].firstMip == 1);
+        }
+
+        // 预算比需要的还小时，需要的mip和mip尾都保留
+        options.memoryBudget = tail;
+        streamer.setOptions(options);
+
+        streamer.request(b, 256.0f);
+        CHECK(streamer.update().empty());
+        CHECK(streamer.residentMip(b) == 2);
+        CHECK(streamer.isReady(a) && streamer.isReady(c));
+    }
+
+    // 加载失败的mip尾和mip在之后的帧重新请求
+    void testRetry() {
+        std::vector<LoadCall> calls;
+        TextureStreamer streamer;
+
+        int failures = 2;
+        auto texture = streamer.add(textureDesc(512, 512), recordingLoad(calls, 0, &failures));
+
+        // 第一次失败，update()时重新提交，第二次也失败
+        CHECK(streamer.update().empty());
+        CHECK(!streamer.isReady(texture));
+        CHECK(streamer.stats().residentBytes == 0);
+
+        CHECK(streamer.update().empty());
+        CHECK(calls.size() == 3);
+
+        auto events = streamer.update();
+        CHECK(events.size() == 1 && streamer.isReady(texture));
+        CHECK(calls.size() == 3 && calls[2].firstMip == streamer.tailMip(texture));
+
+        // 更高的mip失败时驻留不变，下一帧重新提交同一级
+        failures = 1;
+        calls.clear();
+
+        streamer.request(texture, 512.0f);
+        streamer.update();
+        streamer.request(texture, 512.0f);
+        CHECK(streamer.update().empty());
+        CHECK(streamer.residentMip(texture) == streamer.tailMip(texture));
+
+        streamer.request(texture, 512.0f);
+        events = streamer.update();
+        CHECK(events.size() == 1 && events[0].firstMip == streamer.tailMip(texture) - 1);
+
+        if (CHECK(calls.size() == 3)) {
+            CHECK(calls[0].firstMip == calls[1].firstMip);
+        }
+    }
+
+    // 异步的executor：加载完成之前只统计为加载中，加载中被移除的纹理在完成后丢弃
+    void testExecutor() {
+        std::vector<LoadCall> calls;
+        std::vector<std::function<void()>> tasks;
+
+        TextureStreamer streamer(TextureStreamer::Options(), [&tasks](std::function<void()> task) {
+            tasks.push_back(std::move(task));
+        });
+
+        auto runTasks = [&] {
+            auto pending = std::move(tasks);
+            tasks.clear();
+
+            for (auto& task : pending) {
+                task();
+            }
+        };
+
+        auto a = streamer.add(textureDesc(256, 256), recordingLoad(calls, 0));
+        auto b = streamer.add(textureDesc(256, 256), recordingLoad(calls, 1));
+
+        CHECK(calls.empty() && tasks.size() == 2);
+        CHECK(streamer.stats().loadsInFlight == 2);
+        CHECK(streamer.stats().loadingBytes == tailBytes(streamer, a, 9) * 2);
+
+        CHECK(streamer.update().empty());
+
+        streamer.remove(b);
+        runTasks();
+
+        auto events = streamer.update();
+        CHECK(events.size() == 1 && events[0].texture == a);
+        CHECK(streamer.stats().loadsInFlight == 0 && streamer.stats().loadingBytes == 0);
+        CHECK(streamer.stats().residentBytes == tailBytes(streamer, a, 9));
+
+        // 被移除的槽位在加载完成之后复用
+        auto c = streamer.add(textureDesc(256, 256), recordingLoad(calls, 2));
+        CHECK(c == b);
+
+        streamer.remove(a);
+        runTasks();
+        streamer.update();
+
+        CHECK(streamer.stats().residentBytes == tailBytes(streamer, c, 9));
+    }
+
+    void testPerformance() {
+        TextureStreamer::Options options;
+        options.memoryBudget = 64ull << 20;
+
+        TextureStreamer streamer(options);
+        std::vector<TextureStreamer::TextureId> textures;
+
+        for (uint32_t i = 0; i < 2000; i++) {
+            textures.push_back(streamer.add(textureDesc(1024, 1024), [](uint32_t, uint32_t) { return true; }));
+        }
+
+        uint32_t frame = 0;
+
+        double milliseconds = TestUtil::timeMilliseconds(200, [&] {
+            for (uint32_t i = 0; i < textures.size(); i++) {
+                streamer.request(textures[i], static_cast<float>((i * 37 + frame * 11) % 1200));
+            }
+
+            streamer.update();
+            frame++;
+        });
+
+        CHECK(withinBudget(streamer));
+
+        printf("%zu textures, request + update %.3f ms, %.1f MB loaded, %.1f MB evicted\n", textures.size(), milliseconds,
+            streamer.stats().totalLoadedBytes / (1024.0 * 1024.0), streamer.stats().totalEvictedBytes / (1024.0 * 1024.0));
+    }
+}
+
+int main() {
+    testMipTail();
+    testRequest();
+    testFrameBudget();
+    testEviction();
+    testRetry();
+    testExecutor();
+    testPerformance();
+
+    return TestUtil::finish();
+}
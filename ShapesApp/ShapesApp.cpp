@@ -40,6 +40,9 @@ LRESULT shapesApp::msgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 }
 
 bool shapesApp::initialize() {
+    // 先把纹理解码和着色器的编译、读取交给工作线程，与设备和窗口的创建同时进行
+    requestAssets();
+
     if(!d3dApp::initialize()) {
         return false;
     }
@@ -509,8 +512,9 @@ void shapesApp::createRootSignature() {
 
 void shapesApp::createShadersAndInputLayout() {
 
-    vertexShaderByteCode = d3dUtil::compileShader(L"Shaders/color.hlsl", L"VS", L"vs_6_0");
-    pixelShaderByteCode = d3dUtil::compileShader(L"Shaders/color.hlsl", L"PS", L"ps_6_0");
+    // 编译在requestAssets中就已经交给工作线程，这里通常不需要等待
+    vertexShaderByteCode = compiledVertexShader.get();
+    pixelShaderByteCode = compiledPixelShader.get();
     
     inputLayout = 
     {
@@ -637,16 +641,12 @@ void shapesApp::createPipelineStateOjbect() {
     pipelineStateObjectDesc.InputLayout = {inputLayout.data(), (UINT)inputLayout.size()};
     pipelineStateObjectDesc.pRootSignature = rootSignature.Get();
 
-    std::string vertexShader;
-    
-    d3dUtil::loadShader("Shaders/vs.bin", vertexShader);
+    const std::string& vertexShader = vertexShaderBinary.get();
 
     pipelineStateObjectDesc.VS.pShaderBytecode = vertexShader.data();
     pipelineStateObjectDesc.VS.BytecodeLength = vertexShader.size();
 
-    std::string pixelShader;
-
-     d3dUtil::loadShader("Shaders/ps.bin", pixelShader);
+    const std::string& pixelShader = pixelShaderBinary.get();
 
     pipelineStateObjectDesc.PS.pShaderBytecode = pixelShader.data();
     pipelineStateObjectDesc.PS.BytecodeLength = pixelShader.size();
@@ -687,14 +687,59 @@ void shapesApp::createPipelineStateOjbect() {
     graphicsPSOs["opaque_wireframe"] = opaqueWireframePipelineStateObject;
 }
 
-void shapesApp::loadResources() {
-    uint32_t textureWidth = 0;
-    uint32_t textureHeight = 0;
+void shapesApp::requestAssets() {
+    assetLoader = std::make_unique<AssetLoader>();
+
+    // 纹理数量决定了描述符堆的大小，loadResources中等待它完成
+    // textureImages = assetLoader->load("Textures/Kanna.gif", []() { return decodeImages(L"Textures/Kanna.gif"); });
+    textureImages = assetLoader->load("Textures/Kanna0.gif", []() { return decodeImages(L"Textures/Kanna0.gif"); });
+
+    // PSO要用到着色器，createShadersAndInputLayout和createPipelineStateOjbect中等待
+    compiledVertexShader = assetLoader->load("Shaders/color.hlsl VS", []() { return d3dUtil::compileShader(L"Shaders/color.hlsl", L"VS", L"vs_6_0"); });
+    compiledPixelShader = assetLoader->load("Shaders/color.hlsl PS", []() { return d3dUtil::compileShader(L"Shaders/color.hlsl", L"PS", L"ps_6_0"); });
+    vertexShaderBinary = assetLoader->load("Shaders/vs.bin", []() { return loadShaderBinary("Shaders/vs.bin"); });
+    pixelShaderBinary = assetLoader->load("Shaders/ps.bin", []() { return loadShaderBinary("Shaders/ps.bin"); });
+}
+
+DecodedImages shapesApp::decodeImages(const std::wstring& fileName) {
+    DecodedImages decodedImages;
     uint32_t bpp = 0;
-    uint32_t rowPitch = 0;
 
-    // auto images = WICLoadImage(L"Textures/Kanna.gif", textureWidth, textureHeight, bpp, rowPitch, textureFormat);
-    auto images = WICLoadImage(L"Textures/Kanna0.gif", textureWidth, textureHeight, bpp, rowPitch, textureFormat);
+    auto images = WICLoadImage(fileName, decodedImages.width, decodedImages.height, bpp, decodedImages.rowPitch, decodedImages.format);
+
+    decodedImages.frames.resize(images.size());
+
+    for (size_t imageIndex = 0; imageIndex < images.size(); imageIndex++) {
+        auto& pixels = decodedImages.frames[imageIndex];
+        pixels.resize(static_cast<size_t>(decodedImages.rowPitch) * decodedImages.height);
+
+        // 真正的解码发生在CopyPixels中
+        ThrowIfFailed(images[imageIndex]->CopyPixels(
+            nullptr,
+            decodedImages.rowPitch,
+            static_cast<uint32_t>(pixels.size()),
+            pixels.data()));
+    }
+
+    return decodedImages;
+}
+
+std::string shapesApp::loadShaderBinary(const std::string& fileName) {
+    std::string shaderData;
+    d3dUtil::loadShader(fileName, shaderData);
+
+    return shaderData;
+}
+
+void shapesApp::loadResources() {
+    // 解码在工作线程中进行，这里只等待结果
+    const auto& images = textureImages.get();
+
+    uint32_t textureWidth = images.width;
+    uint32_t textureHeight = images.height;
+    uint32_t rowPitch = images.rowPitch;
+
+    textureFormat = images.format;
 
     D3D12_RESOURCE_DESC textureDesc = {};
 
@@ -710,9 +755,9 @@ void shapesApp::loadResources() {
     textureDesc.SampleDesc.Count = 1;
     textureDesc.SampleDesc.Quality = 0;
 
-    textures.resize(images.size());
+    textures.resize(images.frames.size());
 
-    for (size_t imageIndex = 0; imageIndex < images.size(); imageIndex++) {
+    for (size_t imageIndex = 0; imageIndex < images.frames.size(); imageIndex++) {
         // 创建默认堆上的资源,类型是Texture2D,GPU对默认堆资源的访问速度是最快的
         // 因为纹理资源一般是不易变的资源,所以我们通常使用上传堆复制到默认堆中
         ThrowIfFailed(device->CreateCommittedResource(
@@ -759,27 +804,12 @@ void shapesApp::loadResources() {
         IID_PPV_ARGS(textureUpload.GetAddressOf())));
 
     for (size_t textureIndex = 0; textureIndex < textures.size(); textureIndex++) {
-        // 按照资源缓冲大小来分配实际图片数据存储的内存大小
-        void* imageData = ::HeapAlloc(::GetProcessHeap(), HEAP_ZERO_MEMORY, uploadBufferStep);
-
-        if (imageData == nullptr) {
-            ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-        }
-
-        auto image = images[textureIndex];
-
-        // 从图片中取出数据
-        HRESULT hr = image->CopyPixels(
-            nullptr,
-            rowPitch,
-            static_cast<uint32_t>(rowPitch * textureHeight),    // 注意这里才是图片数据真实的大小，这个值通常小于缓冲的大小
-            reinterpret_cast<byte*>(imageData));
-
-        ThrowIfFailed(hr);
+        // 图片数据已经在工作线程中解码好了
+        const byte* imageData = images.frames[textureIndex].data();
 
         std::string fileName = "test" + std::to_string(textureIndex) + ".png"; 
 
-        // saveImage(fileName, reinterpret_cast<byte*>(imageData), textureWidth, textureHeight);
+        // saveImage(fileName, const_cast<byte*>(imageData), textureWidth, textureHeight);
 
         // 获取向上传堆拷贝纹理数据的一些纹理转换尺寸信息
         // 对于复杂的DDS纹理这是非常必要的过程
@@ -846,9 +876,6 @@ void shapesApp::loadResources() {
         //     UpdateSubresources(commandList.Get(), textures[textureIndex].Get(), textureUpload.Get(), textureIndex * uploadBufferStep, 0, 1, &textureData);
         // }
 
-        // 释放图片数据，做一个干净的程序员
-        ::HeapFree(::GetProcessHeap(), 0, imageData);
-
         // 向命令队列发出从上传堆复制纹理数据到默认堆的命令
         // textureLayouts中包含了在textureUpload中的偏移
         // (D3D12_PLACED_SUBRESOURCE_FOOTPRINT::Offset字段) 
@@ -1154,6 +1181,16 @@ void shapesApp::buildImGuiWidgets()
 			ImGui::Text("counter = %d", counter);
 
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+            for (const auto& timing : assetLoader->timings()) {
+                if (timing.finished) {
+                    ImGui::Text("%s: queued %.2f ms, load %.2f ms, total %.2f ms",
+                                timing.name.c_str(), timing.queued, timing.load, timing.total);
+                }
+                else {
+                    ImGui::Text("%s: loading...", timing.name.c_str());
+                }
+            }
 			ImGui::End();
 		}
 	}